@@ -52,6 +52,10 @@ namespace ServerControlPanel
         QCommandLineOption restartOption("stop", "Restarts a server.", "[server/s]");
         parser.addOption(restartOption);
 
+        // --create-patch <old> <new> <patch>
+        QCommandLineOption createPatchOption("create-patch", "Creates a delta patch for the self-updater.", "[old]");
+        parser.addOption(createPatchOption);
+
         /**
          * Handling of Command Line Arguments
          */
@@ -135,6 +139,18 @@ namespace ServerControlPanel
             execServers("stop", restartOption, args, parser);
         }
 
+        // --create-patch <old> <new> <patch>
+        if (parser.isSet(createPatchOption)) {
+            if (args.size() != 2) {
+                printHelpText(QString("Error: --create-patch needs <old> <new> <patch>."));
+            }
+            QString errorMessage;
+            if (!Updater::DeltaPatch::create(parser.value(createPatchOption), args.at(0), args.at(1), &errorMessage)) {
+                printHelpText(QString("Error: %1").arg(errorMessage));
+            }
+            exit(0);
+        }
+
         // if(parser.unknownOptionNames().count() > 1) {
         printHelpText(QString("Error: Unknown option."));
         //}
@@ -209,6 +225,8 @@ namespace ServerControlPanel
             "      --start <servers>                Starts one or more <servers>. \n"
             "      --stop <servers>                 Stops one or more <servers>. \n"
             "      --restart <servers>              Restarts one or more <servers>. "
+            "\n"
+            "      --create-patch <old> <new> <patch>  Creates a delta <patch> from <old> to <new>. "
             "\n\n";
         colorPrint(options);
 
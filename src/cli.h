@@ -2,6 +2,7 @@
 #define CLI_H
 
 #include "servers.h"
+#include "updater/deltapatch.h"
 #include "version.h"
 #include "Windows.h"
 
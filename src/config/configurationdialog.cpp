@@ -3,14 +3,26 @@
 
 #include "nginxaddserverdialog.h"
 #include "nginxaddupstreamdialog.h"
+#include "nginxupstreams.h"
+#include "phpextensions.h"
+#include "phpinstallations.h"
 #include "src/file/ini.h"
 #include "src/file/json.h"
+#include "src/file/phpini.h"
 #include "src/file/yml.h"
+#include "src/updater/componentstore.h"
+
+#include <QTimer>
+#include <QtConcurrent>
 
 namespace Configuration
 {
-    ConfigurationDialog::ConfigurationDialog(QWidget *parent) : QDialog(parent), ui(new Ui::ConfigurationDialog)
+    ConfigurationDialog::ConfigurationDialog(QWidget *parent)
+        : QDialog(parent), ui(new Ui::ConfigurationDialog), servers(nullptr), isShown(false),
+          isNginxUpstreamsLoaded(false)
     {
+        openTimer.start();
+
         ui->setupUi(this);
 
         setWindowTitle("WPN-XM Server Control Panel - Configuration");
@@ -19,20 +31,16 @@ namespace Configuration
         setWindowFlags(windowFlags() & ~Qt::WindowContextHelpButtonHint);
 
         settings = new Settings::SettingsManager;
-        readSettings();
 
-        hideComponentsNotInstalledInMenuTree();
+        // the pages read their settings and data, when they are shown for the first time
+        connect(ui->stackedWidget, SIGNAL(currentChanged(int)), this, SLOT(initializePage(int)));
+        connect(&nginxUpstreamsWatcher, SIGNAL(finished()), this, SLOT(nginxUpstreamsLoaded()));
+        connect(&phpExtensionsWatcher, SIGNAL(finished()), this, SLOT(phpExtensionsLoaded()));
+        connect(&phpInstallationsWatcher, SIGNAL(finished()), this, SLOT(phpInstallationsAdopted()));
 
-        // setup autostart section
-        hideAutostartCheckboxesOfNotInstalledServers();
-        toggleAutostartServerCheckboxes(ui->checkbox_autostartServers->isChecked());
         connect(ui->checkbox_autostartServers, SIGNAL(clicked(bool)), this,
                 SLOT(toggleAutostartServerCheckboxes(bool)));
 
-        // load initial data for pages
-        loadNginxUpstreams();
-
-        createPHPExtensionListWidget();
         QObject::connect(ui->php_extensions_listWidget, SIGNAL(itemChanged(QListWidgetItem *)), this,
                          SLOT(PHPExtensionListWidgetHighlightChecked(QListWidgetItem *)));
 
@@ -41,66 +49,158 @@ namespace Configuration
         ui->configMenuTreeWidget->expandAll();
     }
 
-    ConfigurationDialog::~ConfigurationDialog() { delete ui; }
-
-    QStringList ConfigurationDialog::getAvailablePHPExtensions()
+    ConfigurationDialog::~ConfigurationDialog()
     {
-        QStringList availableExtensions;
+        // the background loaders write into the inventories, they are finished first
+        nginxUpstreamsWatcher.waitForFinished();
+        phpExtensionsWatcher.waitForFinished();
+        phpInstallationsWatcher.waitForFinished();
+        delete ui;
+    }
 
-        QString folder = QDir::currentPath() + "/bin/php/ext";
-        QDir ext(folder);
-        ext.setNameFilters(QStringList() << "*.dll");
-        QStringList fileList = ext.entryList();
+    void ConfigurationDialog::showEvent(QShowEvent *event)
+    {
+        QDialog::showEvent(event);
 
-        for (int i = 0; i < fileList.size(); ++i) {
-            availableExtensions << fileList.at(i).chopped(4).mid(4);
+        if (isShown) {
+            return;
         }
+        isShown = true;
+
+        // the servers are known now (setServers() is called after the constructor)
+        hideComponentsNotInstalledInMenuTree();
 
-        // qDebug() << availableExtensions;
+        initializePage(ui->stackedWidget->currentIndex());
 
-        return availableExtensions;
+        // the dialog is interactive, when the event loop processes the first events after showing it
+        QTimer::singleShot(0, this, SLOT(logOpenTime()));
     }
 
-    QStringList ConfigurationDialog::getEnabledPHPExtensions()
+    void ConfigurationDialog::logOpenTime()
     {
-        QStringList enabledExtensions;
+        qDebug() << "[ConfigurationDialog] Interactive after" << openTimer.elapsed() << "ms";
+    }
 
-        QString filename = QDir::toNativeSeparators(QDir::currentPath() + "/bin/php/php.ini");
-        QFile f(filename);
-        if (!f.open(QIODevice::ReadOnly | QIODevice::Text)) {
-            qDebug() << " Could not open the file for reading";
+    bool ConfigurationDialog::isPageInitialized(const QString &page) const { return initializedPages.contains(page); }
+
+    /**
+     * Reads the settings and data of a page of the stacked widget, once.
+     */
+    void ConfigurationDialog::initializePage(int index)
+    {
+        QWidget *page = ui->stackedWidget->widget(index);
+        if (!isShown || page == nullptr || isPageInitialized(page->objectName())) {
+            return;
         }
 
-        QTextStream in(&f);
-        while (!in.atEnd()) {
-            QString line = in.readLine();
-            if (line.startsWith("extension=")) {
-                enabledExtensions << line.mid(10);
-            }
+        const QString name = page->objectName();
+        initializedPages.insert(name);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        if (name == "servercontrolpanel") {
+            readSettings_ServerControlPanel();
+            hideAutostartCheckboxesOfNotInstalledServers();
+            toggleAutostartServerCheckboxes(ui->checkbox_autostartServers->isChecked());
+        } else if (name == "updater") {
+            readSettings_Updater();
+        } else if (name == "nginx") {
+            loadNginxUpstreams();
+        } else if (name == "php") {
+            loadPHPVersions();
+            createPHPExtensionListWidget();
+        } else if (name == "xdebug") {
+            readSettings_Xdebug();
+        } else if (name == "mariadb") {
+            readSettings_MariaDB();
+        } else if (name == "mongodb") {
+            readSettings_MongoDB();
+        } else if (name == "postgresql") {
+            readSettings_PostgreSQL();
+        } else if (name == "redis") {
+            readSettings_Redis();
         }
 
-        f.close();
+        qDebug() << "[ConfigurationDialog] Page" << name << "initialized in" << timer.elapsed() << "ms";
+    }
 
-        return enabledExtensions;
+    QStringList ConfigurationDialog::getEnabledPHPExtensions()
+    {
+        // php.ini is parsed once and shared, until it changes on disk
+        File::PhpIni ini = File::PhpIni::shared(getPHPIniFile());
+        if (!ini.isValid()) {
+            qDebug() << " Could not open the file for reading";
+        }
+        return ini.enabledExtensions();
+    }
+
+    QString ConfigurationDialog::getPHPIniFile()
+    {
+        return QDir(settings->get("php/config", "./bin/php/php.ini").toString()).absolutePath();
     }
 
     void ConfigurationDialog::createPHPExtensionListWidget()
     {
-        QStringList availableList = getAvailablePHPExtensions();
-        QStringList enabledList   = getEnabledPHPExtensions();
+        // placeholder, until the extension binaries are inspected
+        ui->php_extensions_listWidget->clear();
+        ui->php_extensions_listWidget->addItem(tr("Loading extensions..."));
+        ui->php_extensions_listWidget->setEnabled(false);
+
+        QString phpFolder  = QDir::currentPath() + "/bin/php";
+        QString phpIniFile = getPHPIniFile();
+
+        phpExtensionsWatcher.setFuture(QtConcurrent::run([phpFolder, phpIniFile]() {
+            // parse php.ini in the background, too: the list reads the shared copy then
+            File::PhpIni::shared(phpIniFile);
+            return PhpExtensions::shared().inventory(phpFolder);
+        }));
+    }
 
-        ui->php_extensions_listWidget->addItems(availableList);
+    void ConfigurationDialog::phpExtensionsLoaded()
+    {
+        // the items are created with their check state, without saving it again
+        QObject::disconnect(ui->php_extensions_listWidget, SIGNAL(itemChanged(QListWidgetItem *)), this,
+                            SLOT(PHPExtensionListWidgetHighlightChecked(QListWidgetItem *)));
 
-        QListWidgetItem *item = nullptr;
-        for (int i = 0; i < ui->php_extensions_listWidget->count(); ++i) {
-            item = ui->php_extensions_listWidget->item(i);
+        populatePHPExtensionListWidget(phpExtensionsWatcher.result());
+        ui->php_extensions_listWidget->setEnabled(true);
+
+        QObject::connect(ui->php_extensions_listWidget, SIGNAL(itemChanged(QListWidgetItem *)), this,
+                         SLOT(PHPExtensionListWidgetHighlightChecked(QListWidgetItem *)));
+    }
+
+    void ConfigurationDialog::populatePHPExtensionListWidget(const QList<PhpExtensions::Extension> &extensions)
+    {
+        QStringList enabledList = getEnabledPHPExtensions();
+
+        ui->php_extensions_listWidget->clear();
+
+        foreach (const PhpExtensions::Extension &extension, extensions) {
+            auto *item = new QListWidgetItem(extension.name, ui->php_extensions_listWidget);
             item->setFlags(item->flags() | Qt::ItemIsUserCheckable);
-            if (enabledList.contains(item->text())) {
-                item->setCheckState(Qt::Checked);
-                item->setBackgroundColor(QColor("#90ee90"));
+            item->setCheckState(enabledList.contains(extension.name) ? Qt::Checked : Qt::Unchecked);
+
+            // an incompatible extension would stop PHP from starting, it is marked before it is enabled
+            item->setData(Qt::UserRole, extension.incompatibility);
+            if (extension.incompatibility.isEmpty()) {
+                item->setToolTip(extension.build.toString());
             } else {
-                item->setCheckState(Qt::Unchecked);
+                item->setToolTip(QString("Incompatible: %1 (%2)").arg(extension.incompatibility,
+                                                                       extension.build.toString()));
             }
+            highlightPHPExtension(item);
+        }
+    }
+
+    void ConfigurationDialog::highlightPHPExtension(QListWidgetItem *item)
+    {
+        if (!item->data(Qt::UserRole).toString().isEmpty()) {
+            item->setBackgroundColor(QColor("#ffb6c1"));
+        } else if (item->checkState() == Qt::Checked) {
+            item->setBackgroundColor(QColor("#90ee90"));
+        } else {
+            item->setBackgroundColor(QColor("#ffffff"));
         }
     }
 
@@ -111,13 +211,8 @@ namespace Configuration
         QObject::disconnect(ui->php_extensions_listWidget, SIGNAL(itemChanged(QListWidgetItem *)), this,
                             SLOT(PHPExtensionListWidgetHighlightChecked(QListWidgetItem *)));
 
-        if (item->checkState() == Qt::Checked) {
-            item->setBackgroundColor(QColor("#90ee90"));
-            savePHPExtensionState(item->text(), true);
-        } else {
-            item->setBackgroundColor(QColor("#ffffff"));
-            savePHPExtensionState(item->text(), false);
-        }
+        highlightPHPExtension(item);
+        savePHPExtensionState(item->text(), item->checkState() == Qt::Checked);
 
         QObject::connect(ui->php_extensions_listWidget, SIGNAL(itemChanged(QListWidgetItem *)), this,
                          SLOT(PHPExtensionListWidgetHighlightChecked(QListWidgetItem *)));
@@ -125,38 +220,14 @@ namespace Configuration
 
     void ConfigurationDialog::savePHPExtensionState(QString ext, bool enable)
     {
-        QString filename = QDir::toNativeSeparators(QDir::currentPath() + "/bin/php/php.ini");
-        QFile f(filename);
-        if (!f.open(QIODevice::ReadWrite | QIODevice::Text)) {
-            qDebug() << " Could not open the file for reading and writing.";
-        }
+        // only the line of the extension is changed
+        File::PhpIni ini = File::PhpIni::shared(getPHPIniFile());
+        ini.setExtensionEnabled(ext, enable);
 
-        QString content;
-        QTextStream in(&f);
-        while (!in.atEnd()) {
-            content = in.readAll();
+        QString error;
+        if (!ini.save(&error)) {
+            qDebug() << " Could not save the extension state:" << error;
         }
-
-        QString extName = QString("extension=").append(ext);
-
-        if (content.contains(extName)) {
-            if (enable) {
-                content.replace(QString(";extension=").append(ext), extName);
-            } else {
-                content.replace(extName, QString(";extension=").append(ext));
-            }
-        } else {
-            // no entry in ini, yet. add to ini
-            if (enable) {
-                content.append(extName);
-            } else {
-                content.append(QString(";extension=").append(ext));
-            }
-        }
-
-        f.seek(0);
-        f.write(content.toUtf8());
-        f.close();
     }
 
     /**
@@ -204,11 +275,10 @@ namespace Configuration
     void ConfigurationDialog::setServers(Servers::Servers *servers) { this->servers = servers; }
 
     /**
-     * @brief ConfigurationDialog::readSettings
-     *
-     * Reads settings from INI and prefills config dialog items with default values.
+     * The readSettings_* functions read the settings of one page from INI
+     * and prefill the config dialog items with default values.
      */
-    void ConfigurationDialog::readSettings()
+    void ConfigurationDialog::readSettings_ServerControlPanel()
     {
         ui->checkbox_runOnStartUp->setChecked(getSettingBool("global/runonstartup", false));
         ui->checkbox_autostartServers->setChecked(getSettingBool("global/autostartservers", false));
@@ -229,11 +299,13 @@ namespace Configuration
         ui->checkbox_onStartAllOpenWebinterface->setChecked(getSettingBool("global/onstartallopenwebinterface", false));
 
         ui->lineEdit_SelectedEditor->setText(getSettingString("global/editor", QString("notepad.exe")));
+    }
 
-        //
-        // Configuration > Updater > Self Updater
-        //
-
+    /**
+     * Configuration > Updater > Self Updater
+     */
+    void ConfigurationDialog::readSettings_Updater()
+    {
         ui->checkBox_SelfUpdater_RunOnStartUp->setChecked(getSettingBool("selfupdater/runonstartup", false));
         ui->checkBox_SelfUpdater_AutoUpdate->setChecked(getSettingBool("selfupdater/autoupdate", false));
         ui->checkBox_SelfUpdater_AutoRestart->setChecked(getSettingBool("selfupdater/autorestart", false));
@@ -241,11 +313,13 @@ namespace Configuration
         ui->comboBox_SelfUpdater_Interval->setCurrentText(getSettingString("selfupdater/interval", QString("1")));
         ui->dateTimeEdit_SelfUpdater_Last_Time_Checked->setDateTime(
             settings->get("selfupdater/last_time_checked", QVariant(0)).toDateTime());
+    }
 
-        //
-        // Configuration > Components > Xdebug
-        //
-
+    /**
+     * Configuration > Components > Xdebug
+     */
+    void ConfigurationDialog::readSettings_Xdebug()
+    {
         // remote
         ui->checkBox_xdebug_remote_enable->setChecked(getSettingBool("xdebug/remote_enable", true));
         ui->lineEdit_xdebug_remote_host->setText(getSettingString("xdebug/remote_host", QString("127.0.0.1")));
@@ -258,36 +332,43 @@ namespace Configuration
         ui->checkBox_xdebug_remove_old_logs->setChecked(getSettingBool("xdebug/remove_old_logs", true));
 
         ui->lineEdit_xdebug_idekey->setText(getSettingString("xdebug/idekey", QString("netbeans-xdebug")));
+    }
 
-        //
-        // Configuration > Components > MariaDB
-        //
-
+    /**
+     * Configuration > Components > MariaDB
+     */
+    void ConfigurationDialog::readSettings_MariaDB()
+    {
         ui->lineEdit_mariadb_port->setText(getSettingString("mariadb/port", QString("3306")));
+    }
 
-        //
-        // Configuration > Components > MongoDb
-        //
-
+    /**
+     * Configuration > Components > MongoDb
+     */
+    void ConfigurationDialog::readSettings_MongoDB()
+    {
         if (isServerInstalled("mongodb")) {
             ui->lineEdit_mongodb_port->setText(getSettingString("mongodb/port", QString("27017")));
 
             ui->lineEdit_mongodb_dbpath->setText(getSettingString(
                 "mongodb/dbpath", QDir::toNativeSeparators(QDir::currentPath() + "/bin/mongodb/data/db")));
         }
+    }
 
-        //
-        // Configuration > Components > PostgreSQL
-        //
-
+    /**
+     * Configuration > Components > PostgreSQL
+     */
+    void ConfigurationDialog::readSettings_PostgreSQL()
+    {
         if (isServerInstalled("postgresql")) {
             ui->lineEdit_postgresql_port->setText(getSettingString("postgresql/port", QString("3306")));
         }
+    }
 
-        //
-        // Configuration > Components > Memcached
-        //
-        /*
+    //
+    // Configuration > Components > Memcached
+    //
+    /*
                 if (servers->isInstalled("memcached")) {
                     ui->lineEdit_memcached_tcpport->setText(getSettingString("memcached/tcpport",
            QString("11211")));
@@ -300,11 +381,13 @@ namespace Configuration
                     ui->lineEdit_memcached_maxmemory->setText(getSettingString("memcached/maxmemory",
            QString("2048")));
                 }
-        */
-        //
-        // Configuration > Components > Redis
-        //
+    */
 
+    /**
+     * Configuration > Components > Redis
+     */
+    void ConfigurationDialog::readSettings_Redis()
+    {
         if (isServerInstalled("redis")) {
             ui->lineEdit_redis_port->setText(getSettingString("redis/port", QString("6379")));
         }
@@ -326,82 +409,96 @@ namespace Configuration
         // because i like having a simple 0/1 in the INI file, instead of true/false.
         // if boolean is saved as string to ini, you'll get "\x1" as value for true.
 
+        // a page, which was never shown, holds no settings: it is not saved
+
         //
         // Configuration > Server Control Panel > Tab "Configuration"
         //
 
-        settings->set("global/runonstartup", int(ui->checkbox_runOnStartUp->isChecked()));
-        settings->set("global/startminimized", int(ui->checkbox_startMinimized->isChecked()));
-        settings->set("global/autostartservers", int(ui->checkbox_autostartServers->isChecked()));
+        if (isPageInitialized("servercontrolpanel")) {
+            settings->set("global/runonstartup", int(ui->checkbox_runOnStartUp->isChecked()));
+            settings->set("global/startminimized", int(ui->checkbox_startMinimized->isChecked()));
+            settings->set("global/autostartservers", int(ui->checkbox_autostartServers->isChecked()));
 
-        settings->set("global/clearlogsonstart", int(ui->checkbox_clearLogsOnStart->isChecked()));
-        settings->set("global/stopserversonquit", int(ui->checkbox_stopServersOnQuit->isChecked()));
+            settings->set("global/clearlogsonstart", int(ui->checkbox_clearLogsOnStart->isChecked()));
+            settings->set("global/stopserversonquit", int(ui->checkbox_stopServersOnQuit->isChecked()));
 
-        settings->set("global/onstartallminimize", int(ui->checkbox_onStartAllMinimize->isChecked()));
-        settings->set("global/onstartallopenwebinterface", int(ui->checkbox_onStartAllOpenWebinterface->isChecked()));
+            settings->set("global/onstartallminimize", int(ui->checkbox_onStartAllMinimize->isChecked()));
+            settings->set("global/onstartallopenwebinterface",
+                          int(ui->checkbox_onStartAllOpenWebinterface->isChecked()));
 
-        settings->set("global/editor", QString(ui->lineEdit_SelectedEditor->text()));
+            settings->set("global/editor", QString(ui->lineEdit_SelectedEditor->text()));
 
-        //
-        // Autostart Servers with the Server Control Panel
-        //
+            //
+            // Autostart Servers with the Server Control Panel
+            //
 
-        settings->set("autostart/nginx", int(ui->checkbox_autostart_Nginx->isChecked()));
-        settings->set("autostart/php", int(ui->checkbox_autostart_PHP->isChecked()));
-        settings->set("autostart/mariadb", int(ui->checkbox_autostart_MariaDb->isChecked()));
+            settings->set("autostart/nginx", int(ui->checkbox_autostart_Nginx->isChecked()));
+            settings->set("autostart/php", int(ui->checkbox_autostart_PHP->isChecked()));
+            settings->set("autostart/mariadb", int(ui->checkbox_autostart_MariaDb->isChecked()));
 
-        // checkboxes are automatically removed by hideAutostartCheckboxes...
-        settings->set("autostart/mongodb", int(ui->checkbox_autostart_MongoDb->isChecked()));
-        settings->set("autostart/memcached", int(ui->checkbox_autostart_Memcached->isChecked()));
-        settings->set("autostart/postgresql", int(ui->checkbox_autostart_Postgresql->isChecked()));
-        settings->set("autostart/redis", int(ui->checkbox_autostart_Redis->isChecked()));
+            // checkboxes are automatically removed by hideAutostartCheckboxes...
+            settings->set("autostart/mongodb", int(ui->checkbox_autostart_MongoDb->isChecked()));
+            settings->set("autostart/memcached", int(ui->checkbox_autostart_Memcached->isChecked()));
+            settings->set("autostart/postgresql", int(ui->checkbox_autostart_Postgresql->isChecked()));
+            settings->set("autostart/redis", int(ui->checkbox_autostart_Redis->isChecked()));
 
-        QApplication::processEvents();
+            QApplication::processEvents();
+        }
 
         //
         // Configuration > Updater > Update Notification Settings
         //
 
-        settings->set("selfupdater/runonstartup", int(ui->checkBox_SelfUpdater_RunOnStartUp->isChecked()));
-        settings->set("selfupdater/autoupdate", int(ui->checkBox_SelfUpdater_AutoUpdate->isChecked()));
-        settings->set("selfupdater/autorestart", int(ui->checkBox_SelfUpdater_AutoRestart->isChecked()));
+        if (isPageInitialized("updater")) {
+            settings->set("selfupdater/runonstartup", int(ui->checkBox_SelfUpdater_RunOnStartUp->isChecked()));
+            settings->set("selfupdater/autoupdate", int(ui->checkBox_SelfUpdater_AutoUpdate->isChecked()));
+            settings->set("selfupdater/autorestart", int(ui->checkBox_SelfUpdater_AutoRestart->isChecked()));
 
-        settings->set("selfupdater/interval", QString("1"));
-        // settings->set("selfupdater/last_time_checked", QVariant(0)).toDateTime());
+            settings->set("selfupdater/interval", QString("1"));
+            // settings->set("selfupdater/last_time_checked", QVariant(0)).toDateTime());
 
-        QApplication::processEvents();
+            QApplication::processEvents();
+        }
 
         //
         // Configuration > Components > Nginx > Tab "Upstream"
         //
 
-        saveSettings_Nginx_Upstream();
-        QApplication::processEvents();
+        // the tables are filled in the background, they are saved only when complete
+        if (isNginxUpstreamsLoaded) {
+            saveSettings_Nginx_Upstream();
+            QApplication::processEvents();
+        }
 
         //
         // Configuration > Components > XDebug > Tab "Configuration"
         //
 
-        settings->set("xdebug/remote_enable", int(ui->checkBox_xdebug_remote_enable->isChecked()));
-        settings->set("xdebug/remote_host", QString(ui->lineEdit_xdebug_remote_host->text()));
-        settings->set("xdebug/remote_port", QString(ui->lineEdit_xdebug_remote_port->text()));
-        settings->set("xdebug/remote_autostart", int(ui->checkBox_xdebug_remote_autostart->isChecked()));
-        settings->set("xdebug/remote_handler", QString(ui->lineEdit_xdebug_remote_handler->text()));
-        settings->set("xdebug/remote_mode", QString(ui->comboBox_xdebug_remote_mode->currentText()));
+        if (isPageInitialized("xdebug")) {
+            settings->set("xdebug/remote_enable", int(ui->checkBox_xdebug_remote_enable->isChecked()));
+            settings->set("xdebug/remote_host", QString(ui->lineEdit_xdebug_remote_host->text()));
+            settings->set("xdebug/remote_port", QString(ui->lineEdit_xdebug_remote_port->text()));
+            settings->set("xdebug/remote_autostart", int(ui->checkBox_xdebug_remote_autostart->isChecked()));
+            settings->set("xdebug/remote_handler", QString(ui->lineEdit_xdebug_remote_handler->text()));
+            settings->set("xdebug/remote_mode", QString(ui->comboBox_xdebug_remote_mode->currentText()));
 
-        settings->set("xdebug/idekey", QString(ui->lineEdit_xdebug_idekey->text()));
+            settings->set("xdebug/idekey", QString(ui->lineEdit_xdebug_idekey->text()));
 
-        QApplication::processEvents();
+            QApplication::processEvents();
+        }
 
         //
         // Configuration > Components > MariaDBTab > Tab "Configuration"
         //
 
-        settings->set("mariadb/port", QString(ui->lineEdit_mariadb_port->text()));
+        if (isPageInitialized("mariadb")) {
+            settings->set("mariadb/port", QString(ui->lineEdit_mariadb_port->text()));
 
-        saveSettings_MariaDB_Configuration();
+            saveSettings_MariaDB_Configuration();
 
-        QApplication::processEvents();
+            QApplication::processEvents();
+        }
 
         //
         // Configuration > Components > MongoDB
@@ -410,7 +507,7 @@ namespace Configuration
         // We do not save mongodb values into the wpn-xm.ini file.
         // All setting go directly into mongod.conf yaml file.
 
-        if (isServerInstalled("mongodb")) {
+        if (isPageInitialized("mongodb") && isServerInstalled("mongodb")) {
             saveSettings_MongoDB_Configuration();
             QApplication::processEvents();
         }
@@ -419,7 +516,7 @@ namespace Configuration
         // Configuration > Components > PostgreSQL
         //
 
-        if (isServerInstalled("postgresql")) {
+        if (isPageInitialized("postgresql") && isServerInstalled("postgresql")) {
             settings->set("postgresql/port", QString(ui->lineEdit_postgresql_port->text()));
             QApplication::processEvents();
         }
@@ -428,7 +525,7 @@ namespace Configuration
         // Configuration > Components > Memcached
         //
 
-        if (isServerInstalled("memcached")) {
+        if (isPageInitialized("memcached") && isServerInstalled("memcached")) {
             settings->set("memcached/tcpport", QString(ui->lineEdit_memcached_tcpport->text()));
             settings->set("memcached/udpport", QString(ui->lineEdit_memcached_udpport->text()));
             settings->set("memcached/threads", QString(ui->lineEdit_memcached_threads->text()));
@@ -441,7 +538,7 @@ namespace Configuration
         // Configuration > Components > Redis > Tab "Configuration"
         //
 
-        if (isServerInstalled("redis")) {
+        if (isPageInitialized("redis") && isServerInstalled("redis")) {
             settings->set("redis/port", QString(ui->lineEdit_redis_port->text()));
 
             saveSettings_Redis_Configuration();
@@ -525,29 +622,31 @@ namespace Configuration
 
     void ConfigurationDialog::saveSettings_Xdebug_Configuration()
     {
-        // get xdebug configuration file path
         // xdebug configuration directives are set in php.ini
-        QString file = QDir(settings->get("php/config").toString()).absolutePath();
+        QString file = getPHPIniFile();
 
         if (!QFile(file).exists()) {
             qDebug() << "[Error][" << Q_FUNC_INFO << "]" << file << "not found";
         }
 
-        File::INI *ini = new File::INI(file.toLatin1());
+        // the directives are collected and written at once
+        File::PhpIni ini = File::PhpIni::shared(file);
+
+        auto setBool = [&ini](const QString &key, bool value) { ini.setValue("xdebug", key, value ? "1" : "0"); };
 
         // remote
-        ini->setBoolValue("xdebug", "remote_enable", ui->checkBox_xdebug_remote_enable->isChecked());
-        ini->setStringValue("xdebug", "remote_host", ui->lineEdit_xdebug_remote_host->text().toLatin1());
-        ini->setStringValue("xdebug", "remote_port", ui->lineEdit_xdebug_remote_port->text().toLatin1());
-        ini->setBoolValue("xdebug", "remote_autostart", ui->checkBox_xdebug_remote_autostart->isChecked());
-        ini->setStringValue("xdebug", "remote_handler", ui->lineEdit_xdebug_remote_handler->text().toLatin1());
-        ini->setStringValue("xdebug", "remote_mode", ui->comboBox_xdebug_remote_mode->currentText().toLatin1());
+        setBool("xdebug.remote_enable", ui->checkBox_xdebug_remote_enable->isChecked());
+        ini.setValue("xdebug", "xdebug.remote_host", ui->lineEdit_xdebug_remote_host->text());
+        ini.setValue("xdebug", "xdebug.remote_port", ui->lineEdit_xdebug_remote_port->text());
+        setBool("xdebug.remote_autostart", ui->checkBox_xdebug_remote_autostart->isChecked());
+        ini.setValue("xdebug", "xdebug.remote_handler", ui->lineEdit_xdebug_remote_handler->text());
+        ini.setValue("xdebug", "xdebug.remote_mode", ui->comboBox_xdebug_remote_mode->currentText());
         // profiler
-        ini->setBoolValue("xdebug", "enable_profiler", ui->checkBox_xdebug_enable_profiler->isChecked());
-        ini->setBoolValue("xdebug", "remove_old_logs", ui->checkBox_xdebug_remove_old_logs->isChecked());
-        ini->setStringValue("xdebug", "idekey", ui->lineEdit_xdebug_idekey->text().toLatin1());
+        setBool("xdebug.profiler_enable", ui->checkBox_xdebug_enable_profiler->isChecked());
+        setBool("xdebug.remove_old_logs", ui->checkBox_xdebug_remove_old_logs->isChecked());
+        ini.setValue("xdebug", "xdebug.idekey", ui->lineEdit_xdebug_idekey->text());
 
-        ini->writeConfigFile();
+        ini.save();
     }
 
     void ConfigurationDialog::saveSettings_MariaDB_Configuration()
@@ -604,81 +703,17 @@ namespace Configuration
 
     void ConfigurationDialog::writeNginxUpstreamConfigs(const QJsonDocument &jsonDoc)
     {
-        createNginxConfUpstreamFolderIfNotExists_And_clearOldConfigs();
-
-        // build servers string by iterating over all pools
-
-        QJsonObject json      = jsonDoc.object();
-        QJsonObject jsonPools = json["pools"].toObject();
-
-        // iterate over 1..n pools (key)
-        for (QJsonObject::Iterator iter = jsonPools.begin(); iter != jsonPools.end(); ++iter) {
-            // the "value" object has the key/value pairs of a pool
-            QJsonObject jsonPool = iter.value().toObject();
-
-            QString poolName        = jsonPool["name"].toString();
-            QString method          = jsonPool["method"].toString();
-            QJsonObject jsonServers = jsonPool["servers"].toObject();
-
-            // build "servers" block for later insertion into the upstream template
-            // string
-            QString servers;
-
-            // iterate over all servers
-            for (int i = 0; i < jsonServers.count(); ++i) {
-                // get values for this server
-                QJsonObject s = jsonServers.value(QString::number(i)).toObject();
-
-                // use values to build server string
-                QString server = QString("    server %1:%2 weight=%3 max_fails=%4 fail_timeout=%5;\n")
-                                     .arg(s["address"].toString(), s["port"].toString(), s["weight"].toString(),
-                                          s["maxfails"].toString(), s["failtimeout"].toString());
-
-                servers.append(server);
-            }
-
-            // upstream template string
-            QString upstream(
-                "#\n"
-                "# Automatically generated Nginx Upstream definition.\n"
-                "# Do not edit manually!\n"
-                "\n"
-                "upstream " +
-                poolName +
-                " {\n"
-                "    " +
-                method +
-                ";\n"
-                "\n" +
-                servers + "}\n");
-
-            QString filename("./bin/nginx/conf/upstreams/" + poolName + ".conf");
-
-            QFile file(filename);
-            if (file.open(QIODevice::ReadWrite | QFile::Truncate)) {
-                QTextStream stream(&file);
-                stream << upstream << endl;
-            }
-            file.close();
-
-            qDebug() << "[Nginx][Upstream Config] Saved: " << filename;
-        }
-    }
-
-    void ConfigurationDialog::createNginxConfUpstreamFolderIfNotExists_And_clearOldConfigs()
-    {
-        QDir dir("./bin/nginx/conf/upstreams");
+        QStringList changed =
+            NginxUpstreams::write(NginxUpstreams::render(jsonDoc), QDir::currentPath() + "/bin/nginx/conf/upstreams");
 
-        // create Nginx Conf Upstream Folder If Not Exists
-        if (!dir.exists()) {
-            dir.mkpath(".");
+        if (changed.isEmpty()) {
+            qDebug() << "[Nginx][Upstream Config] Unchanged.";
+            return;
         }
 
-        // delete old upstream configs
-        dir.setNameFilters(QStringList() << "*.conf");
-        dir.setFilter(QDir::Files);
-        foreach (QString dirFile, dir.entryList()) {
-            dir.remove(dirFile);
+        // a running Nginx picks up the configs with a reload, several saves in a row result in one reload
+        if (servers != nullptr && servers->getInstalledServerNames().contains("nginx")) {
+            servers->scheduleNginxReload();
         }
     }
 
@@ -740,7 +775,10 @@ namespace Configuration
     void ConfigurationDialog::onClickedButtonBoxOk()
     {
         writeSettings();
-        toggleRunOnStartup();
+
+        if (isPageInitialized("servercontrolpanel")) {
+            toggleRunOnStartup();
+        }
     }
 
     bool ConfigurationDialog::runOnStartUp() const { return (ui->checkbox_runOnStartUp->checkState() == Qt::Checked); }
@@ -773,6 +811,10 @@ namespace Configuration
     // show only installed items/childs underneath "Components"
     void ConfigurationDialog::hideComponentsNotInstalledInMenuTree()
     {
+        if (servers == nullptr) {
+            return;
+        }
+
         installedServersList = servers->getInstalledServerNames();
 
         // force append xdebug as installed server to unhide it
@@ -782,6 +824,9 @@ namespace Configuration
         QList<QTreeWidgetItem *> itemList = ui->configMenuTreeWidget->findItems("Components", Qt::MatchFixedString);
         QTreeWidgetItem *components       = itemList[0];
 
+        // the server names are matched on a copy, installedServersList is used by isServerInstalled()
+        QStringList unmatchedServers = installedServersList;
+
         // iterate over childs
         for (int i = 0; i < components->childCount(); i++) {
             // get child and hide it
@@ -790,7 +835,7 @@ namespace Configuration
 
             // iterate over installed server names
             // for (int j=0; j < installed.count(); j++)
-            QMutableStringListIterator installedML(installedServersList);
+            QMutableStringListIterator installedML(unmatchedServers);
             while (installedML.hasNext()) {
                 // get servername
                 QString serverName = installedML.next();
@@ -808,6 +853,10 @@ namespace Configuration
 
     void ConfigurationDialog::hideAutostartCheckboxesOfNotInstalledServers()
     {
+        if (servers == nullptr) {
+            return;
+        }
+
         QStringList installed = this->servers->getInstalledServerNames();
 
         QList<QCheckBox *> boxes = ui->tabWidget->findChildren<QCheckBox *>(QRegExp("checkbox_autostart_\\w"));
@@ -937,86 +986,62 @@ namespace Configuration
 
     void ConfigurationDialog::on_pushButton_searchPHPInstallations_clicked()
     {
-        ui->comboBox_PHPVersions->setDisabled(true);
-
-        // find all folders inside "bin" containing a php executable
-        QStringList filters = {"php.exe"};
-        QString binFolder   = QDir::currentPath() + "/bin/";
-
-        QList<PhpVersions> list;
-
-        QDirIterator it(binFolder, filters, QDir::NoSymLinks | QDir::Files | QDir::Dirs, QDirIterator::Subdirectories);
-        while (it.hasNext()) {
-            QString php_exe = it.next();
-
-            QFile f(php_exe);
-            QString path        = f.fileName();
-            QString originalDir = path.section("/", 0, -2);
-            QString phpDirName  = path.remove(binFolder).section("/", 0, -2);
+        if (phpInstallationsWatcher.isRunning()) {
+            return;
+        }
 
-            PhpVersions v;
-            v.php_dir = phpDirName;
-            v.version = getPHPVersionFromExe(php_exe);
+        ui->comboBox_PHPVersions->setDisabled(true);
+        ui->pushButton_searchPHPInstallations->setDisabled(true);
 
-            qDebug() << v.php_dir << v.version;
+        Updater::ComponentStore &store = Updater::ComponentStore::shared();
 
-            // rename folders = versionize PHP folders ("php-version")
-            QString expectedPhpDirName = QString("php-").append(v.version);
+        // php.exe is at the top of an installation, so only the folders inside "bin" are candidates:
+        // "bin/php" or the versionized "bin/php-version" folders of older releases, which are not in the store yet
+        QString binFolder = QDir::currentPath() + "/bin/";
 
-            if (phpDirName == "php") {
-                qDebug() << "Skipping bin/php folder.";
-            } else if (phpDirName == expectedPhpDirName) {
-                qDebug() << "Folder already correctly versionized.";
-            } else {
-                QString dest(binFolder);
-                dest.append(expectedPhpDirName);
-                qDebug() << "dest: " << dest;
-                QDir dir;
-                if (!dir.rename(originalDir, dest)) {
-                    qDebug() << "Error renaming folder.";
-                } else {
-                    qDebug() << "Folder renamed: " << originalDir << dest;
-                }
+        QStringList folders;
+        foreach (const QString &folder, QDir(binFolder).entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            if (folder == "store" || (folder == "php" && store.isManaged("php"))) {
+                continue;
+            }
+            if (QFile::exists(binFolder + folder + "/php.exe")) {
+                folders << binFolder + folder;
             }
-
-            list.append(v);
         }
 
-        //        for (int i = 0; i < list.count(); ++i) {
-        //            qDebug() << list[i].version;
-        //        }
-
-        // TODO: do we really need to sort the values from QDirIterator?
-        // sort the php version list
-        int i, j;
-        for (i = 0; i < list.count(); ++i) {
-            for (j = i + 1; j < list.count(); ++j) {
-                QVersionNumber version1 = QVersionNumber::fromString(list[i].version);
-                QVersionNumber version2 = QVersionNumber::fromString(list[j].version);
-                // qDebug() << version1.toString() << version2.toString();
-                // TODO: compare WTF: -1,0,1? but i get -8 to 2. thanks qt
-                // qDebug() << QVersionNumber::compare(version1, version2);
-                if (QVersionNumber::compare(version1, version2) >= 1) {
-                    list.move(i, j);
-                    i = 0;
+        // adopt them: each version is stored once, files of equal content are shared between versions.
+        // probing and hashing whole PHP trees takes seconds, the list is updated, when it is done
+        phpInstallationsWatcher.setFuture(QtConcurrent::run([folders]() {
+            Updater::ComponentStore &store = Updater::ComponentStore::shared();
+            foreach (const PhpInstallations::Installation &installation, PhpInstallations::shared().probe(folders)) {
+                QString error;
+                if (!store.adopt("php", installation.version, installation.folder, &error)) {
+                    qDebug() << "[PHP] Adding" << installation.folder << "to the component store failed:" << error;
                 }
             }
-        }
+        }));
+    }
 
-        //        for (int i = 0; i < list.count(); ++i) {
-        //            qDebug() << list[i].version;
-        //        }
+    void ConfigurationDialog::phpInstallationsAdopted()
+    {
+        loadPHPVersions();
+        ui->pushButton_searchPHPInstallations->setEnabled(true);
+    }
 
-        // populate php version dropdown
+    /**
+     * Populates the php version dropdown with the versions in the component store.
+     */
+    void ConfigurationDialog::loadPHPVersions()
+    {
+        Updater::ComponentStore &store = Updater::ComponentStore::shared();
+
+        QString activeVersion = store.activeVersion("php");
         ui->comboBox_PHPVersions->clear();
-        for (int i = 0; i < list.count(); ++i) {
-            // qDebug() << list[i].version;
-            ui->comboBox_PHPVersions->addItem(list[i].version);
-            // highlight the currently selected php version for bin/php
-            if (list[i].php_dir == "php") {
-                ui->comboBox_PHPVersions->setCurrentText(list[i].version);
-                ui->lineEdit_currentPHPVersion->setText(list[i].version);
-            }
+        ui->comboBox_PHPVersions->addItems(store.versions("php"));
+        // highlight the currently selected php version for bin/php
+        if (!activeVersion.isEmpty()) {
+            ui->comboBox_PHPVersions->setCurrentText(activeVersion);
+            ui->lineEdit_currentPHPVersion->setText(activeVersion);
         }
         ui->comboBox_PHPVersions->setEnabled(true);
     }
@@ -1024,71 +1049,20 @@ namespace Configuration
     void ConfigurationDialog::on_pushButton_setPHPVersionForBinFolder_clicked()
     {
         QString selectedPHPVersion = ui->comboBox_PHPVersions->currentText();
-        QString currentPHPVersion  = ui->lineEdit_currentPHPVersion->text();
 
         if (ui->lineEdit_currentPHPVersion->text() == selectedPHPVersion) {
             qDebug() << "This PHP version is already set for bin/php.";
-        } else {
-            QString binFolder          = QDir::currentPath() + "/bin/";
-            QString selectedPhpDirName = QString("php-").append(selectedPHPVersion);
-            QString currentPhPDirName  = QString("php-").append(currentPHPVersion);
-
-            // rename (current) "bin/php" to "bin/php-version"
-
-            QString current(binFolder);
-            current.append(currentPhPDirName);
-
-            QDir dir;
-            if (!dir.rename(binFolder + "php", current)) {
-                qDebug() << "Error renaming folder.";
-            } else {
-                qDebug() << "Folder renamed: bin/php to " << current;
-            }
-
-            // rename (selected) "bin/php-version" to "bin/php"
-
-            QString src(binFolder);
-            src.append(selectedPhpDirName);
-            QDir dir2;
-            if (!dir2.rename(src, binFolder + "php")) {
-                qDebug() << "Error renaming folder.";
-            } else {
-                qDebug() << "Folder renamed: " << src << "to bin/php";
-            }
-
-            ui->lineEdit_currentPHPVersion->setText(selectedPHPVersion);
-        }
-    }
-
-    QString ConfigurationDialog::getPHPVersionFromExe(QString pathToPHPExecutable)
-    {
-        // this happens only during testing
-        if (!QFile::exists(pathToPHPExecutable)) {
-            return "0.0.0";
+            return;
         }
 
-        QProcess process;
-        process.setProcessChannelMode(QProcess::MergedChannels);
-        process.start(pathToPHPExecutable.append(" -n -v"));
-
-        if (!process.waitForFinished()) {
-            qDebug() << "[PHP] Version failed:" << process.errorString();
-            return "";
+        // "bin/php" is a link into the component store, switching replaces the link
+        QString error;
+        if (!Updater::ComponentStore::shared().activate("php", selectedPHPVersion, &error)) {
+            qDebug() << "[PHP] Switching to" << selectedPHPVersion << "failed:" << error;
+            return;
         }
 
-        QByteArray p_stdout = process.readLine();
-
-        // qDebug() << "[PHP] Version: \n" << p_stdout;
-
-        // - grab inside "PHP x (cli)"
-        // - "\\d.\\d.\\d." = grab "1.2.3"
-        // - "(\\w+\\d+)?" = grab optional "alpha2" version
-        QRegExp regex("PHP\\s(\\d.\\d.\\d.(\\w+\\d+)?)");
-        regex.indexIn(p_stdout);
-
-        // qDebug() << regex.capturedTexts();
-
-        return regex.cap(1).trimmed();
+        ui->lineEdit_currentPHPVersion->setText(selectedPHPVersion);
     }
 
     void ConfigurationDialog::on_configMenuTreeWidget_clicked(const QModelIndex &index)
@@ -1170,8 +1144,26 @@ namespace Configuration
         ui->tableWidget_Nginx_Upstreams->setRowCount(0);
         ui->tableWidget_Nginx_Servers->setRowCount(0);
 
-        // load JSON
-        QJsonDocument jsonDoc = File::JSON::load("./bin/wpnxm-scp/nginx-upstreams.json");
+        // placeholder, until the JSON file is loaded
+        isNginxUpstreamsLoaded = false;
+        ui->tableWidget_Nginx_Upstreams->setEnabled(false);
+        ui->tableWidget_Nginx_Servers->setEnabled(false);
+
+        nginxUpstreamsWatcher.setFuture(
+            QtConcurrent::run(&File::JSON::load, QString("./bin/wpnxm-scp/nginx-upstreams.json")));
+    }
+
+    void ConfigurationDialog::nginxUpstreamsLoaded()
+    {
+        populateNginxUpstreams(nginxUpstreamsWatcher.result());
+
+        ui->tableWidget_Nginx_Upstreams->setEnabled(true);
+        ui->tableWidget_Nginx_Servers->setEnabled(true);
+        isNginxUpstreamsLoaded = true;
+    }
+
+    void ConfigurationDialog::populateNginxUpstreams(const QJsonDocument &jsonDoc)
+    {
         QJsonObject json      = jsonDoc.object();
         QJsonObject jsonPools = json["pools"].toObject();
 
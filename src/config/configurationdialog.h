@@ -13,9 +13,15 @@
 #include <QListWidget>
 #include <QListWidgetItem>
 
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QJsonDocument>
+#include <QSet>
+
 #include "../servers.h"
 #include "../settings.h"
 #include "../windowsapi.h"
+#include "phpextensions.h"
 
 namespace Configuration
 {
@@ -72,13 +78,22 @@ namespace Configuration
         QJsonObject getNginxUpstreamPoolByName(const QString &poolName);
         void updateServersTable(QJsonObject jsonPool);
 
-        void createNginxConfUpstreamFolderIfNotExists_And_clearOldConfigs();
-
         void createPHPExtensionListWidget();
-        QStringList getAvailablePHPExtensions();
+        void populatePHPExtensionListWidget(const QList<PhpExtensions::Extension> &extensions);
+        void highlightPHPExtension(QListWidgetItem *item);
         QStringList getEnabledPHPExtensions();
+        QString getPHPIniFile();
+
+    protected:
+        void showEvent(QShowEvent *event) override;
 
     private slots:
+        void initializePage(int index);
+        void logOpenTime();
+        void nginxUpstreamsLoaded();
+        void phpExtensionsLoaded();
+        void phpInstallationsAdopted();
+
         void toggleAutostartServerCheckboxes(bool run = true);
         void onClickedButtonBoxOk();
 
@@ -130,21 +145,35 @@ namespace Configuration
         QCheckBox *checkbox_autostart_PostgreSQL;
         QCheckBox *checkbox_autostart_Redis;
 
-        struct PhpVersions
-        {
-            QString php_dir;
-            QString version;
-        };
-
         QStringList installedServersList;
         bool isServerInstalled(const QString &serverName) const;
 
-        void readSettings();
+        // pages are initialized, when they are shown for the first time
+        QSet<QString> initializedPages;
+        bool isPageInitialized(const QString &page) const;
+        bool isShown;
+        QElapsedTimer openTimer;
+
+        // expensive data is loaded in the background, the page shows a placeholder meanwhile
+        QFutureWatcher<QJsonDocument> nginxUpstreamsWatcher;
+        QFutureWatcher<QList<PhpExtensions::Extension>> phpExtensionsWatcher;
+        QFutureWatcher<void> phpInstallationsWatcher;
+        bool isNginxUpstreamsLoaded;
+
+        void readSettings_ServerControlPanel();
+        void readSettings_Updater();
+        void readSettings_Xdebug();
+        void readSettings_MariaDB();
+        void readSettings_MongoDB();
+        void readSettings_PostgreSQL();
+        void readSettings_Redis();
         void writeSettings();
 
         void toggleRunOnStartup();
 
         void loadNginxUpstreams();
+        void populateNginxUpstreams(const QJsonDocument &jsonDoc);
+        void loadPHPVersions();
 
         bool getSettingBool(const QString &key, const QVariant &defaultValue);
         bool getSettingBool(const QString &key, const bool &defaultValue);
@@ -155,8 +184,6 @@ namespace Configuration
         QString getSettingString(const QString &key, const QVariant &defaultValue);
         QString getSettingString(const QString &key, const QString &defaultValue);
 
-        static bool sortByPhpVersion(const PhpVersions &d1, const PhpVersions &d2);
-        QString getPHPVersionFromExe(QString pathToPHPExecutable);
     };
 } // namespace Configuration
 
@@ -0,0 +1,111 @@
+#include "nginxupstreams.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSaveFile>
+
+namespace Configuration
+{
+    /**
+     * Returns the configs of all pools: file name => content.
+     */
+    QMap<QString, QByteArray> NginxUpstreams::render(const QJsonDocument &upstreams)
+    {
+        QMap<QString, QByteArray> configs;
+
+        QJsonObject jsonPools = upstreams.object()["pools"].toObject();
+
+        // iterate over 1..n pools (key)
+        for (QJsonObject::Iterator iter = jsonPools.begin(); iter != jsonPools.end(); ++iter) {
+            // the "value" object has the key/value pairs of a pool
+            QJsonObject jsonPool = iter.value().toObject();
+
+            configs.insert(jsonPool["name"].toString() + ".conf", renderPool(jsonPool));
+        }
+
+        return configs;
+    }
+
+    QByteArray NginxUpstreams::renderPool(const QJsonObject &pool)
+    {
+        QString poolName        = pool["name"].toString();
+        QString method          = pool["method"].toString();
+        QJsonObject jsonServers = pool["servers"].toObject();
+
+        // build "servers" block for later insertion into the upstream template string
+        QString servers;
+
+        // iterate over all servers
+        for (int i = 0; i < jsonServers.count(); ++i) {
+            // get values for this server
+            QJsonObject s = jsonServers.value(QString::number(i)).toObject();
+
+            // use values to build server string
+            servers.append(QString("    server %1:%2 weight=%3 max_fails=%4 fail_timeout=%5;\n")
+                               .arg(s["address"].toString(), s["port"].toString(), s["weight"].toString(),
+                                    s["maxfails"].toString(), s["failtimeout"].toString()));
+        }
+
+        // upstream template string
+        QString upstream = QString("#\n"
+                                   "# Automatically generated Nginx Upstream definition.\n"
+                                   "# Do not edit manually!\n"
+                                   "\n"
+                                   "upstream %1 {\n"
+                                   "    %2;\n"
+                                   "\n"
+                                   "%3}\n\n")
+                               .arg(poolName, method, servers);
+
+        return upstream.toUtf8();
+    }
+
+    /**
+     * Writes the changed configs into the folder and removes the configs of pools, which no longer exist.
+     * Returns the names of the files, which were written or removed; empty, when nothing changed.
+     */
+    QStringList NginxUpstreams::write(const QMap<QString, QByteArray> &configs, const QString &folder)
+    {
+        QStringList changed;
+
+        QDir dir(folder);
+
+        // create Nginx Conf Upstream Folder If Not Exists
+        if (!dir.exists()) {
+            dir.mkpath(".");
+        }
+
+        for (auto config = configs.cbegin(); config != configs.cend(); ++config) {
+            const QString fileName = dir.filePath(config.key());
+
+            QFile current(fileName);
+            if (current.open(QIODevice::ReadOnly) && current.size() == config.value().size() &&
+                current.readAll() == config.value()) {
+                continue;
+            }
+            current.close();
+
+            // the file is replaced as a whole, Nginx never reads a partially written config
+            QSaveFile file(fileName);
+            if (!file.open(QIODevice::WriteOnly) || file.write(config.value()) != config.value().size() ||
+                !file.commit()) {
+                qDebug() << "[Nginx][Upstream Config] Writing" << fileName << "failed:" << file.errorString();
+                continue;
+            }
+
+            changed << config.key();
+            qDebug() << "[Nginx][Upstream Config] Saved: " << fileName;
+        }
+
+        // remove old upstream configs, after the new ones are in place
+        foreach (const QString &dirFile, dir.entryList(QStringList() << "*.conf", QDir::Files)) {
+            if (!configs.contains(dirFile) && dir.remove(dirFile)) {
+                changed << dirFile;
+                qDebug() << "[Nginx][Upstream Config] Removed: " << dir.filePath(dirFile);
+            }
+        }
+
+        return changed;
+    }
+} // namespace Configuration
@@ -0,0 +1,31 @@
+#ifndef NGINXUPSTREAMS_H
+#define NGINXUPSTREAMS_H
+
+#include <QByteArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+
+namespace Configuration
+{
+    /**
+     * NginxUpstreams renders the upstream pools ("bin/wpnxm-scp/nginx-upstreams.json")
+     * to Nginx config files ("bin/nginx/conf/upstreams/<pool>.conf").
+     *
+     * The configs are rendered in memory and compared with the files on disk.
+     * Only a changed config is written, atomically (QSaveFile), configs of removed pools are deleted last.
+     * Nginx always finds a complete set of configs, and an unchanged save needs no reload.
+     */
+    class NginxUpstreams
+    {
+    public:
+        static QMap<QString, QByteArray> render(const QJsonDocument &upstreams);
+        static QByteArray renderPool(const QJsonObject &pool);
+
+        static QStringList write(const QMap<QString, QByteArray> &configs, const QString &folder);
+    };
+} // namespace Configuration
+
+#endif // NGINXUPSTREAMS_H
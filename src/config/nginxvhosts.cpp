@@ -0,0 +1,307 @@
+#include "nginxvhosts.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSaveFile>
+
+namespace Configuration
+{
+    // the document roots of a project, in the order they are tried
+    static const char *const rootCandidates[][2] = {
+        {"public", "public/index.php"}, {"web", "web/index.php"}, {"", "index.php"}, {"", "index.html"}};
+
+    // the first line of every generated vhost, only files starting with it are replaced or removed
+    static const char generatedMarker[] = "# Automatically generated Nginx vhost";
+
+    static const char defaultTemplate[] = "# Automatically generated Nginx vhost for the project \"{{name}}\".\n"
+                                          "# Do not edit manually!\n"
+                                          "\n"
+                                          "server {\n"
+                                          "    listen {{port}};\n"
+                                          "    server_name {{name}}.{{domain}};\n"
+                                          "    root \"{{root}}\";\n"
+                                          "    index index.php index.html;\n"
+                                          "\n"
+                                          "    location / {\n"
+                                          "        try_files $uri $uri/ /index.php?$query_string;\n"
+                                          "    }\n"
+                                          "\n"
+                                          "    location ~ \\.php$ {\n"
+                                          "        try_files $uri =404;\n"
+                                          "        fastcgi_pass {{upstream}};\n"
+                                          "        fastcgi_param SCRIPT_FILENAME $document_root$fastcgi_script_name;\n"
+                                          "        include fastcgi_params;\n"
+                                          "    }\n"
+                                          "}\n";
+
+    NginxVhosts::NginxVhosts(const QString &projectsFolder, const QString &vhostsFolder, QObject *parent)
+        : QObject(parent), projectsFolder(QDir::cleanPath(QDir(projectsFolder).absolutePath())),
+          vhostsFolder(QDir::cleanPath(QDir(vhostsFolder).absolutePath())), templateText(defaultTemplate),
+          domain("test"), port("80"), upstream("php_pool"), isRescanPending(false)
+    {
+        // changes arrive in bursts (a checkout, an unpacked archive), they are handled once they settled
+        updateTimer.setSingleShot(true);
+        updateTimer.setInterval(250);
+
+        connect(&updateTimer, SIGNAL(timeout()), this, SLOT(update()));
+        connect(&watcher, SIGNAL(directoryChanged(QString)), this, SLOT(directoryChanged(QString)));
+    }
+
+    void NginxVhosts::setTemplate(const QString &templateFile)
+    {
+        QFile file(templateFile);
+        if (file.open(QIODevice::ReadOnly)) {
+            templateText = file.readAll();
+        } else {
+            qDebug() << "[Nginx][Vhosts] Template" << templateFile << "not found. Using the default template.";
+        }
+    }
+
+    void NginxVhosts::setDomain(const QString &domain) { this->domain = domain; }
+
+    void NginxVhosts::setPort(const QString &port) { this->port = port; }
+
+    void NginxVhosts::setUpstream(const QString &upstream) { this->upstream = upstream; }
+
+    /**
+     * Scans all projects, writes their vhosts and starts watching.
+     */
+    void NginxVhosts::start()
+    {
+        QDir().mkpath(vhostsFolder);
+
+        watcher.addPath(projectsFolder);
+
+        isRescanPending = true;
+        update();
+    }
+
+    QList<NginxVhosts::Project> NginxVhosts::projects() const { return projectList.values(); }
+
+    /**
+     * A project name becomes the host label of "server_name <name>.<domain>" and the name of the vhost file.
+     * Letters, digits and hyphens, not starting or ending with a hyphen, at most 63 characters (RFC 1123).
+     */
+    bool NginxVhosts::isValidName(const QString &name)
+    {
+        static const QRegExp hostLabel("[A-Za-z0-9]([A-Za-z0-9-]{0,61}[A-Za-z0-9])?");
+        QRegExp regex(hostLabel);
+        return regex.exactMatch(name);
+    }
+
+    /**
+     * Returns the document root of a project folder, or an empty string, when it is no project.
+     */
+    QString NginxVhosts::documentRoot(const QString &projectFolder)
+    {
+        for (const auto &candidate : rootCandidates) {
+            if (QFile::exists(projectFolder + "/" + candidate[1])) {
+                return QDir::cleanPath(projectFolder + "/" + candidate[0]);
+            }
+        }
+        return QString();
+    }
+
+    void NginxVhosts::directoryChanged(const QString &path)
+    {
+        const QString changed = QDir::cleanPath(path);
+
+        if (changed == projectsFolder) {
+            // a project was added, renamed or removed
+            isRescanPending = true;
+        } else {
+            // "www/<project>" or "www/<project>/public"
+            dirtyProjects.insert(changed.mid(projectsFolder.size() + 1).section('/', 0, 0));
+        }
+
+        updateTimer.start();
+    }
+
+    /**
+     * Renders the vhosts of the dirty projects.
+     */
+    void NginxVhosts::update()
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        if (isRescanPending) {
+            isRescanPending = false;
+
+            // the project list is compared by name, so a rescan renders only added and removed projects
+            const QStringList folders = QDir(projectsFolder).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+            QSet<QString> names       = QSet<QString>::fromList(folders);
+
+            foreach (const QString &name, names) {
+                if (!projectList.contains(name)) {
+                    dirtyProjects.insert(name);
+                }
+            }
+            foreach (const QString &name, projectList.keys()) {
+                if (!names.contains(name)) {
+                    dirtyProjects.insert(name);
+                }
+            }
+
+            // generated vhosts of projects, which were removed while the vhosts were not watched
+            foreach (const QString &file, QDir(vhostsFolder).entryList(QStringList() << "*.conf", QDir::Files)) {
+                const QString name = file.chopped(5);
+                if (!names.contains(name) && isGenerated(vhostsFolder + "/" + file)) {
+                    dirtyProjects.insert(name);
+                }
+            }
+        }
+
+        QStringList changed;
+        foreach (const QString &name, dirtyProjects) {
+            if (updateProject(name)) {
+                changed << name;
+            }
+        }
+        dirtyProjects.clear();
+
+        if (changed.isEmpty()) {
+            return;
+        }
+
+        changed.sort();
+        qDebug() << "[Nginx][Vhosts] Updated" << changed.size() << "of" << projectList.size() << "projects in"
+                 << timer.elapsed() << "ms";
+
+        emit vhostsChanged(changed);
+    }
+
+    /**
+     * Detects the document root of the project and writes or removes its vhost.
+     * Returns true, when the vhost changed.
+     */
+    bool NginxVhosts::updateProject(const QString &name)
+    {
+        const QString fileName = vhostsFolder + "/" + name + ".conf";
+        const QString folder   = projectsFolder + "/" + name;
+        const bool isValid     = isValidName(name);
+        const QString root     = isValid ? documentRoot(folder) : QString();
+
+        if (!isValid && QFileInfo(folder).isDir()) {
+            qDebug() << "[Nginx][Vhosts] Skipped" << name << "- the folder name is not a valid host name.";
+        }
+
+        if (root.isEmpty()) {
+            projectList.remove(name);
+            vhosts.remove(name);
+            unwatch(folder);
+
+            if (isGenerated(fileName) && QFile::remove(fileName)) {
+                qDebug() << "[Nginx][Vhosts] Removed: " << fileName;
+                return true;
+            }
+            // a folder without document root, the project is detected, when its root appears
+            if (isValid && QFileInfo(folder).isDir()) {
+                watch(Project{name, folder, folder});
+            }
+            return false;
+        }
+
+        Project project{name, folder, root};
+        projectList.insert(name, project);
+        watch(project);
+
+        const QByteArray content = render(project);
+
+        // compared in memory, the vhost on disk is read only once
+        auto known = vhosts.constFind(name);
+        if (known != vhosts.constEnd() && *known == content) {
+            return false;
+        }
+        if (known == vhosts.constEnd()) {
+            // a vhost written by hand for this project is kept
+            if (QFile::exists(fileName) && !isGenerated(fileName)) {
+                qDebug() << "[Nginx][Vhosts] Skipped" << name << "-" << fileName << "was not generated.";
+                return false;
+            }
+
+            QFile current(fileName);
+            if (current.open(QIODevice::ReadOnly) && current.size() == content.size() &&
+                current.readAll() == content) {
+                vhosts.insert(name, content);
+                return false;
+            }
+        }
+
+        // Nginx never reads a partially written vhost
+        QSaveFile file(fileName);
+        if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size() || !file.commit()) {
+            qDebug() << "[Nginx][Vhosts] Writing" << fileName << "failed:" << file.errorString();
+            return false;
+        }
+
+        vhosts.insert(name, content);
+
+        qDebug() << "[Nginx][Vhosts] Saved: " << fileName;
+        return true;
+    }
+
+    /**
+     * Returns true, when the file was written by the generator (it starts with the marker line).
+     * Vhosts written by hand, e.g. the shipped "localhost.conf", are never replaced or removed.
+     */
+    bool NginxVhosts::isGenerated(const QString &fileName)
+    {
+        QFile file(fileName);
+        return file.open(QIODevice::ReadOnly) && file.readLine(256).startsWith(generatedMarker);
+    }
+
+    QByteArray NginxVhosts::render(const Project &project) const
+    {
+        QByteArray vhost = templateText;
+        if (!vhost.startsWith(generatedMarker)) {
+            vhost.prepend(QByteArray(generatedMarker) + " for the project \"{{name}}\".\n");
+        }
+        vhost.replace("{{name}}", project.name.toUtf8());
+        vhost.replace("{{domain}}", domain.toUtf8());
+        vhost.replace("{{root}}", QDir::fromNativeSeparators(project.root).toUtf8());
+        vhost.replace("{{port}}", port.toUtf8());
+        vhost.replace("{{upstream}}", upstream.toUtf8());
+        return vhost;
+    }
+
+    /**
+     * Watches the project folder and the folders, in which a document root might appear.
+     */
+    void NginxVhosts::watch(const Project &project)
+    {
+        QStringList paths;
+        paths << project.folder;
+        for (const auto &candidate : rootCandidates) {
+            const QString subfolder = project.folder + "/" + candidate[0];
+            if (candidate[0][0] != '\0' && QFileInfo(subfolder).isDir()) {
+                paths << subfolder;
+            }
+        }
+
+        // addPath() warns about paths, which are watched already
+        foreach (const QString &path, paths) {
+            if (!watchedFolders.contains(path)) {
+                watchedFolders.insert(path);
+                watcher.addPath(path);
+            }
+        }
+    }
+
+    void NginxVhosts::unwatch(const QString &folder)
+    {
+        for (auto path = watchedFolders.begin(); path != watchedFolders.end();) {
+            if (*path == folder || path->startsWith(folder + "/")) {
+                // a deleted folder is not watched anymore, removePath() is a no-op then
+                watcher.removePath(*path);
+                path = watchedFolders.erase(path);
+            } else {
+                ++path;
+            }
+        }
+    }
+} // namespace Configuration
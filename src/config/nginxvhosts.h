@@ -0,0 +1,89 @@
+#ifndef NGINXVHOSTS_H
+#define NGINXVHOSTS_H
+
+#include <QByteArray>
+#include <QFileSystemWatcher>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QString>
+#include <QStringList>
+#include <QTimer>
+
+namespace Configuration
+{
+    /**
+     * NginxVhosts generates one Nginx "server {}" block per project folder.
+     *
+     * A folder inside the projects folder ("www") is a project, when it has a document root:
+     * "public/index.php", "web/index.php", "index.php" or "index.html", in this order.
+     * The vhost "<vhosts folder>/<project>.conf" serves "<project>.<domain>" from that root.
+     * Folders, whose name is not a valid host label ("my project", "app_v2"), are skipped.
+     * Every generated vhost starts with a marker line. Only those files are replaced or removed,
+     * vhosts written by hand in the same folder are left alone.
+     * It is rendered from a template with the placeholders {{name}}, {{domain}}, {{root}},
+     * {{port}} and {{upstream}}. nginx.conf includes the vhosts with "include vhosts/*.conf;".
+     *
+     * The projects folder and the project folders are watched. A change marks only the
+     * affected project as dirty. Dirty projects are rendered after the changes settled;
+     * a vhost is written, when its content differs, and removed, when the project is gone.
+     * vhostsChanged() is emitted once per update, so a burst of changes results in one reload.
+     */
+    class NginxVhosts : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        struct Project
+        {
+            QString name;
+            QString folder;
+            QString root;
+        };
+
+        NginxVhosts(const QString &projectsFolder, const QString &vhostsFolder, QObject *parent = nullptr);
+
+        void setTemplate(const QString &templateFile);
+        void setDomain(const QString &domain);
+        void setPort(const QString &port);
+        void setUpstream(const QString &upstream);
+
+        void start();
+        QList<Project> projects() const;
+
+        static bool isValidName(const QString &name);
+        static bool isGenerated(const QString &fileName);
+        static QString documentRoot(const QString &projectFolder);
+
+    signals:
+        void vhostsChanged(const QStringList &projects);
+
+    private slots:
+        void directoryChanged(const QString &path);
+        void update();
+
+    private:
+        bool updateProject(const QString &name);
+        QByteArray render(const Project &project) const;
+        void watch(const Project &project);
+        void unwatch(const QString &folder);
+
+        QString projectsFolder;
+        QString vhostsFolder;
+        QByteArray templateText;
+        QString domain;
+        QString port;
+        QString upstream;
+
+        QHash<QString, Project> projectList;
+        QHash<QString, QByteArray> vhosts; // the content on disk, by project
+        QSet<QString> dirtyProjects;
+        bool isRescanPending;
+
+        QFileSystemWatcher watcher;
+        QSet<QString> watchedFolders;
+        QTimer updateTimer;
+    };
+} // namespace Configuration
+
+#endif // NGINXVHOSTS_H
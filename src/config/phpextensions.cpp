@@ -0,0 +1,229 @@
+#include "phpextensions.h"
+#include "src/file/json.h"
+#include "src/file/pe.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QRegExp>
+#include <QtConcurrent>
+
+namespace Configuration
+{
+    QString PhpExtensions::Build::toString() const
+    {
+        if (!isValid()) {
+            return "unknown build";
+        }
+        return QString("%1, %2, API%3, %4").arg(machine, threadSafe ? "TS" : "NTS", api, compiler);
+    }
+
+    PhpExtensions::PhpExtensions(const QString &cacheFile) : file(cacheFile) { load(); }
+
+    PhpExtensions &PhpExtensions::shared()
+    {
+        static PhpExtensions extensions(QDir::currentPath() + "/bin/wpnxm-scp/php-extensions.json");
+        return extensions;
+    }
+
+    /**
+     * Returns the extensions of the PHP installation, sorted by name,
+     * with the reason, why an extension cannot be loaded by this PHP.
+     */
+    QList<PhpExtensions::Extension> PhpExtensions::inventory(const QString &phpFolder)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        QStringList binaries;
+        const QString core = coreBinary(phpFolder);
+        if (!core.isEmpty()) {
+            binaries << core;
+        }
+
+        const QFileInfoList dlls =
+            QDir(phpFolder + "/ext").entryInfoList(QStringList() << "php_*.dll", QDir::Files, QDir::Name);
+        foreach (const QFileInfo &dll, dlls) {
+            binaries << dll.canonicalFilePath();
+        }
+
+        const QList<Build> builds = lookup(binaries);
+        const Build coreBuild     = core.isEmpty() ? Build{QString(), QString(), false, QString()} : builds.first();
+        const int offset          = core.isEmpty() ? 0 : 1;
+
+        QList<Extension> list;
+        for (int i = 0; i < dlls.size(); ++i) {
+            Extension extension;
+            extension.name            = dlls.at(i).fileName().chopped(4).mid(4);
+            extension.file            = dlls.at(i).absoluteFilePath();
+            extension.build           = builds.at(i + offset);
+            extension.incompatibility = checkCompatibility(extension.build, coreBuild);
+            list.append(extension);
+
+            if (!extension.incompatibility.isEmpty()) {
+                qDebug() << "[PHP] Extension" << extension.name << "is incompatible:" << extension.incompatibility;
+            }
+        }
+
+        qDebug() << "[PHP] Extension inventory of" << phpFolder << "in" << timer.elapsed() << "ms";
+        return list;
+    }
+
+    /**
+     * The build of the PHP core (php7ts.dll, php8.dll, ...).
+     */
+    PhpExtensions::Build PhpExtensions::core(const QString &phpFolder)
+    {
+        const QString binary = coreBinary(phpFolder);
+        if (binary.isEmpty()) {
+            return Build{QString(), QString(), false, QString()};
+        }
+        return lookup(QStringList(binary)).first();
+    }
+
+    /**
+     * Reads the build of a PHP binary: the build id is compiled into the core and every extension
+     * (ZEND_MODULE_BUILD_ID), the architecture is taken from the PE header.
+     */
+    PhpExtensions::Build PhpExtensions::inspect(const QString &binary)
+    {
+        Build build{File::PE::machine(binary), QString(), false, QString()};
+
+        static const QRegExp buildId("^API(\\d{8}),(NTS|TS)(?:,(\\w+))?");
+        foreach (const QString &candidate, File::PE::strings(binary, "API20")) {
+            QRegExp regex(buildId);
+            if (regex.indexIn(candidate) == 0) {
+                build.api        = regex.cap(1);
+                build.threadSafe = regex.cap(2) == "TS";
+                build.compiler   = regex.cap(3);
+                break;
+            }
+        }
+        return build;
+    }
+
+    /**
+     * Returns the builds of the binaries, from the cache or inspected in parallel.
+     */
+    QList<PhpExtensions::Build> PhpExtensions::lookup(const QStringList &binaries)
+    {
+        // the inventory is read from the configuration dialog's loader thread, too
+        QMutexLocker locker(&mutex);
+
+        QList<Build> builds;
+        QStringList pending;
+        QList<int> pendingIndexes;
+
+        for (int i = 0; i < binaries.size(); ++i) {
+            const QFileInfo info(binaries.at(i));
+            auto cached = entries.constFind(binaries.at(i));
+            if (cached != entries.constEnd() && cached->size == info.size() &&
+                cached->modified == info.lastModified().toMSecsSinceEpoch()) {
+                builds.append(cached->build);
+            } else {
+                builds.append(Build{QString(), QString(), false, QString()});
+                pending << binaries.at(i);
+                pendingIndexes << i;
+            }
+        }
+
+        if (pending.isEmpty()) {
+            return builds;
+        }
+
+        const QList<Build> inspected = QtConcurrent::blockingMapped<QList<Build>>(pending, &PhpExtensions::inspect);
+        for (int i = 0; i < pending.size(); ++i) {
+            const QFileInfo info(pending.at(i));
+            entries.insert(pending.at(i), Entry{info.size(), info.lastModified().toMSecsSinceEpoch(), inspected.at(i)});
+            builds[pendingIndexes.at(i)] = inspected.at(i);
+        }
+        save();
+
+        return builds;
+    }
+
+    QString PhpExtensions::coreBinary(const QString &phpFolder)
+    {
+        // QRegExp keeps its match state and the lookup runs in the loader thread, so each call uses a copy
+        static const QRegExp coreNamePattern("php\\d+(ts)?\\.dll", Qt::CaseInsensitive);
+        QRegExp coreName(coreNamePattern);
+        foreach (const QFileInfo &dll, QDir(phpFolder).entryInfoList(QStringList() << "php*.dll", QDir::Files)) {
+            if (coreName.exactMatch(dll.fileName())) {
+                return dll.canonicalFilePath();
+            }
+        }
+        return QString();
+    }
+
+    QString PhpExtensions::checkCompatibility(const Build &extension, const Build &core)
+    {
+        // without a build id, there is nothing to compare with
+        if (!extension.isValid() || !core.isValid()) {
+            return QString();
+        }
+        if (!extension.machine.isEmpty() && !core.machine.isEmpty() && extension.machine != core.machine) {
+            return QString("built for %1, PHP is %2").arg(extension.machine, core.machine);
+        }
+        if (extension.api != core.api) {
+            return QString("built for PHP API %1, PHP has API %2").arg(extension.api, core.api);
+        }
+        if (extension.threadSafe != core.threadSafe) {
+            return extension.threadSafe ? QString("thread safe build, PHP is non thread safe")
+                                        : QString("non thread safe build, PHP is thread safe");
+        }
+        // the CRTs of different compilers (VC15, VS16) are not binary compatible
+        if (!extension.compiler.isEmpty() && !core.compiler.isEmpty() &&
+            extension.compiler.compare(core.compiler, Qt::CaseInsensitive) != 0) {
+            return QString("built with %1, PHP is built with %2").arg(extension.compiler, core.compiler);
+        }
+        return QString();
+    }
+
+    void PhpExtensions::load()
+    {
+        if (!QFile::exists(file)) {
+            return;
+        }
+
+        const QJsonObject json = File::JSON::load(file).object();
+        for (auto it = json.begin(); it != json.end(); ++it) {
+            const QJsonObject values = it.value().toObject();
+
+            Entry entry;
+            entry.size             = static_cast<qint64>(values["size"].toDouble());
+            entry.modified         = static_cast<qint64>(values["modified"].toDouble());
+            entry.build.machine    = values["machine"].toString();
+            entry.build.api        = values["api"].toString();
+            entry.build.threadSafe = values["ts"].toBool();
+            entry.build.compiler   = values["compiler"].toString();
+            entries.insert(it.key(), entry);
+        }
+    }
+
+    void PhpExtensions::save() const
+    {
+        QJsonObject json;
+        for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+            // entries of removed installations are dropped
+            if (!QFile::exists(it.key())) {
+                continue;
+            }
+
+            QJsonObject values;
+            values["size"]     = static_cast<double>(it.value().size);
+            values["modified"] = static_cast<double>(it.value().modified);
+            values["machine"]  = it.value().build.machine;
+            values["api"]      = it.value().build.api;
+            values["ts"]       = it.value().build.threadSafe;
+            values["compiler"] = it.value().build.compiler;
+            json[it.key()]     = values;
+        }
+
+        QDir().mkpath(QFileInfo(file).absolutePath());
+        File::JSON::save(QJsonDocument(json), file);
+    }
+} // namespace Configuration
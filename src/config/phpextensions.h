@@ -0,0 +1,74 @@
+#ifndef PHPEXTENSIONS_H
+#define PHPEXTENSIONS_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+
+namespace Configuration
+{
+    /**
+     * PhpExtensions is the inventory of the extensions ("ext/php_*.dll") of a PHP installation.
+     *
+     * The headers of each extension binary are inspected for the architecture and
+     * the build id ("API20190902,TS,VC15": PHP API version, thread safety, compiler).
+     * An extension, which does not match the build of the PHP core, is reported as incompatible:
+     * PHP would refuse to load it, when the server starts.
+     *
+     * Binaries are inspected in parallel. The results are cached in "bin/wpnxm-scp/php-extensions.json"
+     * by size and modification time of each binary, so reopening the list only costs a stat per file.
+     */
+    class PhpExtensions
+    {
+    public:
+        struct Build
+        {
+            QString machine;
+            QString api;
+            bool threadSafe;
+            QString compiler;
+
+            bool isValid() const { return !api.isEmpty(); }
+            QString toString() const;
+        };
+
+        struct Extension
+        {
+            QString name;
+            QString file;
+            Build build;
+            QString incompatibility; // empty, when the extension is compatible
+        };
+
+        explicit PhpExtensions(const QString &cacheFile);
+
+        static PhpExtensions &shared();
+
+        QList<Extension> inventory(const QString &phpFolder);
+        Build core(const QString &phpFolder);
+
+        static Build inspect(const QString &binary);
+
+    private:
+        struct Entry
+        {
+            qint64 size;
+            qint64 modified; // ms since epoch
+            Build build;
+        };
+
+        QList<Build> lookup(const QStringList &binaries);
+        static QString coreBinary(const QString &phpFolder);
+        static QString checkCompatibility(const Build &extension, const Build &core);
+
+        void load();
+        void save() const;
+
+        QString file;
+        QHash<QString, Entry> entries;
+        QMutex mutex;
+    };
+} // namespace Configuration
+
+#endif // PHPEXTENSIONS_H
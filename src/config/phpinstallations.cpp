@@ -0,0 +1,157 @@
+#include "phpinstallations.h"
+#include "src/file/json.h"
+#include "src/file/pe.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QMutexLocker>
+#include <QProcess>
+#include <QRegExp>
+#include <QVersionNumber>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+namespace Configuration
+{
+    PhpInstallations::PhpInstallations(const QString &cacheFile) : file(cacheFile) { load(); }
+
+    PhpInstallations &PhpInstallations::shared()
+    {
+        static PhpInstallations installations(QDir::currentPath() + "/bin/wpnxm-scp/php-installations.json");
+        return installations;
+    }
+
+    /**
+     * Returns the installations in the folders, sorted by version (the oldest first).
+     */
+    QList<PhpInstallations::Installation> PhpInstallations::probe(const QStringList &folders)
+    {
+        QMutexLocker locker(&mutex);
+
+        QElapsedTimer timer;
+        timer.start();
+
+        QList<Installation> list;
+        QStringList pending;
+        bool changed = false;
+
+        foreach (const QString &folder, folders) {
+            const QString phpExecutable = QDir::cleanPath(folder) + "/php.exe";
+            const QFileInfo info(phpExecutable);
+            if (!info.exists()) {
+                changed |= entries.remove(phpExecutable) > 0;
+                continue;
+            }
+
+            auto cached = entries.constFind(phpExecutable);
+            if (cached != entries.constEnd() && cached->size == info.size() &&
+                cached->modified == info.lastModified().toMSecsSinceEpoch()) {
+                list.append(Installation{QDir::cleanPath(folder), cached->version});
+            } else {
+                pending << phpExecutable;
+            }
+        }
+
+        // the installations, which changed since the last probe, are probed at the same time
+        const QStringList versions = QtConcurrent::blockingMapped<QStringList>(pending, &PhpInstallations::versionOf);
+
+        for (int i = 0; i < pending.size(); ++i) {
+            const QFileInfo info(pending.at(i));
+            if (versions.at(i).isEmpty()) {
+                continue;
+            }
+
+            entries.insert(pending.at(i),
+                           Entry{info.size(), info.lastModified().toMSecsSinceEpoch(), versions.at(i)});
+            list.append(Installation{info.absolutePath(), versions.at(i)});
+            changed = true;
+        }
+
+        if (changed) {
+            save();
+        }
+
+        std::sort(list.begin(), list.end(), [](const Installation &a, const Installation &b) {
+            return QVersionNumber::fromString(a.version) < QVersionNumber::fromString(b.version);
+        });
+
+        qDebug() << "[PHP] Found" << list.size() << "installations in" << timer.elapsed() << "ms," << pending.size()
+                 << "probed.";
+        return list;
+    }
+
+    /**
+     * Reads the version from the binary, spawns "php -n -v" as fallback.
+     */
+    QString PhpInstallations::versionOf(const QString &phpExecutable)
+    {
+        const QString version = File::PE::productVersion(phpExecutable);
+        if (!version.isEmpty()) {
+            return version;
+        }
+        return versionFromProcess(phpExecutable);
+    }
+
+    QString PhpInstallations::versionFromProcess(const QString &phpExecutable)
+    {
+        // this happens only during testing
+        if (!QFile::exists(phpExecutable)) {
+            return "0.0.0";
+        }
+
+        QProcess process;
+        process.setProcessChannelMode(QProcess::MergedChannels);
+        process.start(phpExecutable, QStringList() << "-n"
+                                                   << "-v");
+
+        if (!process.waitForFinished()) {
+            qDebug() << "[PHP] Version failed:" << process.errorString();
+            return "";
+        }
+
+        QByteArray p_stdout = process.readLine();
+
+        // - grab inside "PHP x (cli)"
+        // - "\\d.\\d.\\d." = grab "1.2.3"
+        // - "(\\w+\\d+)?" = grab optional "alpha2" version
+        QRegExp regex("PHP\\s(\\d.\\d.\\d.(\\w+\\d+)?)");
+        regex.indexIn(p_stdout);
+
+        return regex.cap(1).trimmed();
+    }
+
+    void PhpInstallations::load()
+    {
+        if (!QFile::exists(file)) {
+            return;
+        }
+
+        const QJsonObject json = File::JSON::load(file).object();
+        for (auto it = json.begin(); it != json.end(); ++it) {
+            const QJsonObject values = it.value().toObject();
+            entries.insert(it.key(), Entry{static_cast<qint64>(values["size"].toDouble()),
+                                           static_cast<qint64>(values["modified"].toDouble()),
+                                           values["version"].toString()});
+        }
+    }
+
+    void PhpInstallations::save() const
+    {
+        QJsonObject json;
+        for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+            QJsonObject values;
+            values["size"]     = static_cast<double>(it.value().size);
+            values["modified"] = static_cast<double>(it.value().modified);
+            values["version"]  = it.value().version;
+            json[it.key()]     = values;
+        }
+
+        QDir().mkpath(QFileInfo(file).absolutePath());
+        File::JSON::save(QJsonDocument(json), file);
+    }
+} // namespace Configuration
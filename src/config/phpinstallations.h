@@ -0,0 +1,56 @@
+#ifndef PHPINSTALLATIONS_H
+#define PHPINSTALLATIONS_H
+
+#include <QHash>
+#include <QList>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+
+namespace Configuration
+{
+    /**
+     * PhpInstallations detects the versions of PHP installations (folders with a "php.exe").
+     *
+     * The version is read from the version resource of the memory-mapped php.exe,
+     * "php -n -v" is only spawned, when the binary has none. Several installations are
+     * probed in parallel. The results are cached in "bin/wpnxm-scp/php-installations.json"
+     * by size and modification time of php.exe, so unchanged installations are not probed again.
+     * probe() is thread-safe, the updater probes in the background.
+     */
+    class PhpInstallations
+    {
+    public:
+        struct Installation
+        {
+            QString folder;
+            QString version;
+        };
+
+        explicit PhpInstallations(const QString &cacheFile);
+
+        static PhpInstallations &shared();
+
+        QList<Installation> probe(const QStringList &folders);
+
+        static QString versionOf(const QString &phpExecutable);
+        static QString versionFromProcess(const QString &phpExecutable);
+
+    private:
+        struct Entry
+        {
+            qint64 size;
+            qint64 modified; // ms since epoch
+            QString version;
+        };
+
+        void load();
+        void save() const;
+
+        QString file;
+        QHash<QString, Entry> entries;
+        QMutex mutex;
+    };
+} // namespace Configuration
+
+#endif // PHPINSTALLATIONS_H
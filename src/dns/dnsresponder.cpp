@@ -0,0 +1,582 @@
+#include "dnsresponder.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QtEndian>
+
+namespace DNS
+{
+    namespace
+    {
+        const int HeaderSize        = 12;
+        const quint32 Ttl           = 60;
+        const int ForwardTimeout    = 5000;
+        const int MaxPendingForward = 4096;
+
+        quint16 readUInt16(const QByteArray &data, int offset)
+        {
+            return qFromBigEndian<quint16>(reinterpret_cast<const uchar *>(data.constData() + offset));
+        }
+
+        void appendUInt16(QByteArray &data, quint16 value)
+        {
+            data.append(static_cast<char>(value >> 8));
+            data.append(static_cast<char>(value & 0xFF));
+        }
+
+        void appendUInt32(QByteArray &data, quint32 value)
+        {
+            appendUInt16(data, static_cast<quint16>(value >> 16));
+            appendUInt16(data, static_cast<quint16>(value & 0xFFFF));
+        }
+
+        void writeUInt16(QByteArray &data, int offset, quint16 value)
+        {
+            data[offset]     = static_cast<char>(value >> 8);
+            data[offset + 1] = static_cast<char>(value & 0xFF);
+        }
+
+        /**
+         * Reads the (uncompressed) name of the question section into a lowercase,
+         * dot separated name. Returns the offset after the name or -1 on a malformed name.
+         */
+        int readQuestionName(const QByteArray &query, QByteArray *name)
+        {
+            int offset = HeaderSize;
+            name->reserve(64);
+
+            while (offset < query.size()) {
+                const int length = static_cast<uchar>(query.at(offset));
+                ++offset;
+
+                if (length == 0) {
+                    return offset;
+                }
+                // compression pointers and extended label types are not used in questions
+                if (length > 63 || offset + length > query.size()) {
+                    return -1;
+                }
+                if (!name->isEmpty()) {
+                    name->append('.');
+                }
+                for (int i = 0; i < length; ++i) {
+                    char c = query.at(offset + i);
+                    name->append((c >= 'A' && c <= 'Z') ? static_cast<char>(c + ('a' - 'A')) : c);
+                }
+                offset += length;
+
+                if (name->size() > 253) {
+                    return -1;
+                }
+            }
+            return -1;
+        }
+
+        void appendAnswer(QByteArray &response, quint16 type, const QByteArray &rdata)
+        {
+            appendUInt16(response, 0xC000 | HeaderSize); // pointer to the name of the question
+            appendUInt16(response, type);
+            appendUInt16(response, 1); // class IN
+            appendUInt32(response, Ttl);
+            appendUInt16(response, static_cast<quint16>(rdata.size()));
+            response.append(rdata);
+        }
+
+        QByteArray ipv4Data(const QHostAddress &address)
+        {
+            QByteArray data;
+            appendUInt32(data, address.toIPv4Address());
+            return data;
+        }
+
+        QByteArray ipv6Data(const QHostAddress &address)
+        {
+            const Q_IPV6ADDR ipv6 = address.toIPv6Address();
+            return QByteArray(reinterpret_cast<const char *>(ipv6.c), 16);
+        }
+    } // namespace
+
+    ZoneTrie::ZoneTrie() { nodes.resize(1); }
+
+    /**
+     * Splits a pattern like "*.Project.test." into the lowercase domain "project.test"
+     * and returns true, if it is a wildcard pattern.
+     */
+    bool ZoneTrie::parsePattern(const QString &pattern, QByteArray *name)
+    {
+        *name = pattern.trimmed().toLower().toUtf8();
+        if (name->endsWith('.')) {
+            name->chop(1);
+        }
+
+        if (*name == "*") {
+            name->clear();
+            return true;
+        }
+        if (name->startsWith("*.")) {
+            name->remove(0, 2);
+            return true;
+        }
+        return false;
+    }
+
+    QString ZoneTrie::normalizedPattern(const QByteArray &name, bool wildcard)
+    {
+        if (!wildcard) {
+            return QString::fromUtf8(name);
+        }
+        return name.isEmpty() ? QStringLiteral("*") : QStringLiteral("*.") + QString::fromUtf8(name);
+    }
+
+    void ZoneTrie::insert(const QString &pattern, const QHostAddress &address)
+    {
+        QByteArray name;
+        const bool wildcard = parsePattern(pattern, &name);
+
+        // walk the labels from right to left, e.g. "project.test" => "test", "project"
+        int node = 0;
+        int end  = name.size();
+        while (end > 0) {
+            const int dot          = name.lastIndexOf('.', end - 1);
+            const QByteArray label = name.mid(dot + 1, end - dot - 1);
+
+            auto it = nodes.at(node).children.constFind(label);
+            if (it != nodes.at(node).children.constEnd()) {
+                node = it.value();
+            } else {
+                const int child = nodes.size();
+                nodes.append(Node());
+                nodes[node].children.insert(label, child);
+                node = child;
+            }
+            end = dot;
+        }
+
+        if (wildcard) {
+            nodes[node].wildcard    = address;
+            nodes[node].hasWildcard = true;
+        } else {
+            nodes[node].exact    = address;
+            nodes[node].hasExact = true;
+        }
+
+        const QString normalized = normalizedPattern(name, wildcard);
+        if (!patternList.contains(normalized)) {
+            patternList.append(normalized);
+        }
+    }
+
+    bool ZoneTrie::remove(const QString &pattern)
+    {
+        QByteArray name;
+        const bool wildcard = parsePattern(pattern, &name);
+
+        int node = 0;
+        int end  = name.size();
+        while (end > 0) {
+            const int dot = name.lastIndexOf('.', end - 1);
+            auto it       = nodes.at(node).children.constFind(name.mid(dot + 1, end - dot - 1));
+            if (it == nodes.at(node).children.constEnd()) {
+                return false;
+            }
+            node = it.value();
+            end  = dot;
+        }
+
+        // the nodes stay in place, they are reused when the pattern is added again
+        bool &flag = wildcard ? nodes[node].hasWildcard : nodes[node].hasExact;
+        if (!flag) {
+            return false;
+        }
+        flag = false;
+
+        patternList.removeAll(normalizedPattern(name, wildcard));
+        return true;
+    }
+
+    void ZoneTrie::clear()
+    {
+        nodes.clear();
+        nodes.resize(1);
+        patternList.clear();
+    }
+
+    bool ZoneTrie::lookup(const QByteArray &name, QHostAddress *address) const
+    {
+        const Node *wildcardNode = nullptr;
+
+        int node = 0;
+        int end  = name.size();
+        while (end > 0) {
+            // there is at least one label left, so the queried name is a subdomain of this node
+            if (nodes.at(node).hasWildcard) {
+                wildcardNode = &nodes.at(node);
+            }
+
+            const int dot = name.lastIndexOf('.', end - 1);
+            auto it       = nodes.at(node).children.constFind(
+                QByteArray::fromRawData(name.constData() + dot + 1, end - dot - 1));
+            if (it == nodes.at(node).children.constEnd()) {
+                break;
+            }
+            node = it.value();
+            end  = dot;
+
+            if (end < 0 && nodes.at(node).hasExact) {
+                *address = nodes.at(node).exact;
+                return true;
+            }
+        }
+
+        if (wildcardNode != nullptr) {
+            *address = wildcardNode->wildcard;
+            return true;
+        }
+        return false;
+    }
+
+    QStringList ZoneTrie::patterns() const { return patternList; }
+
+    Responder::Responder(QObject *parent) : QObject(parent), forwarderPort(53), nextForwardId(1)
+    {
+        connect(&udpSocket, SIGNAL(readyRead()), this, SLOT(readUdpQueries()));
+        connect(&forwarderSocket, SIGNAL(readyRead()), this, SLOT(readForwarderResponses()));
+        connect(&tcpServer, SIGNAL(newConnection()), this, SLOT(acceptTcpConnection()));
+
+        expireTimer.setInterval(1000);
+        connect(&expireTimer, SIGNAL(timeout()), this, SLOT(expireForwards()));
+    }
+
+    Responder::~Responder() { stop(); }
+
+    bool Responder::start(const QHostAddress &address, quint16 port)
+    {
+        stop();
+
+        if (!udpSocket.bind(address, port)) {
+            qDebug() << "[DNS] Could not bind UDP" << address.toString() << port << udpSocket.errorString();
+            return false;
+        }
+        if (!tcpServer.listen(address, port)) {
+            qDebug() << "[DNS] Could not listen on TCP" << address.toString() << port << tcpServer.errorString();
+            udpSocket.close();
+            return false;
+        }
+
+        qDebug() << "[DNS] Responder listening on" << address.toString() << port << "for" << zoneTrie.patterns();
+        return true;
+    }
+
+    void Responder::stop()
+    {
+        expireTimer.stop();
+        pendingForwards.clear();
+
+        for (QTcpSocket *socket : tcpBuffers.keys()) {
+            socket->disconnect(this);
+            socket->abort();
+            socket->deleteLater();
+        }
+        tcpBuffers.clear();
+
+        udpSocket.close();
+        tcpServer.close();
+        forwarderSocket.close();
+    }
+
+    bool Responder::isRunning() const { return udpSocket.state() == QAbstractSocket::BoundState; }
+
+    void Responder::addZone(const QString &pattern, const QHostAddress &address)
+    {
+        zoneTrie.insert(pattern, address);
+    }
+
+    bool Responder::removeZone(const QString &pattern) { return zoneTrie.remove(pattern); }
+
+    QStringList Responder::zones() const { return zoneTrie.patterns(); }
+
+    void Responder::setForwarder(const QHostAddress &server, quint16 port)
+    {
+        // forwarding to ourself would loop forever
+        if (server == udpSocket.localAddress() && port == udpSocket.localPort()) {
+            qDebug() << "[DNS] Ignoring forwarder" << server.toString() << port << "(the responder itself)";
+            return;
+        }
+
+        forwarder     = server;
+        forwarderPort = port;
+    }
+
+    bool Responder::resolve(const QByteArray &query, QByteArray *response) const
+    {
+        response->clear();
+
+        // too short to carry an ID: there is nobody to answer to
+        if (query.size() < HeaderSize) {
+            return true;
+        }
+
+        const quint16 flags   = readUInt16(query, 2);
+        const quint16 qdcount = readUInt16(query, 4);
+
+        // ignore responses
+        if (flags & 0x8000) {
+            return true;
+        }
+
+        const int opcode = (flags >> 11) & 0x0F;
+        if (opcode != 0) {
+            *response = errorResponse(query, HeaderSize, NotImplemented);
+            return true;
+        }
+        if (qdcount != 1) {
+            *response = errorResponse(query, HeaderSize, FormatError);
+            return true;
+        }
+
+        QByteArray name;
+        const int nameEnd = readQuestionName(query, &name);
+        if (nameEnd < 0 || nameEnd + 4 > query.size()) {
+            *response = errorResponse(query, HeaderSize, FormatError);
+            return true;
+        }
+
+        const int questionEnd = nameEnd + 4;
+        const quint16 qtype   = readUInt16(query, nameEnd);
+        const quint16 qclass  = readUInt16(query, nameEnd + 2);
+
+        QHostAddress address;
+        if (qclass != 1 || !zoneTrie.lookup(name, &address)) {
+            return false;
+        }
+
+        // header: same ID, QR + AA, RD copied from the query, RA when a forwarder is available
+        QByteArray &r = *response;
+        r.reserve(questionEnd + 2 * 28);
+        appendUInt16(r, readUInt16(query, 0));
+        appendUInt16(r, 0x8400 | (flags & 0x0100) | (forwarder.isNull() ? 0 : 0x0080));
+        appendUInt16(r, 1);
+        appendUInt16(r, 0);
+        appendUInt16(r, 0);
+        appendUInt16(r, 0);
+        r.append(query.constData() + HeaderSize, questionEnd - HeaderSize);
+
+        // other types of a local name are answered with NODATA
+        quint16 answers = 0;
+        if (qtype == TypeA || qtype == TypeANY) {
+            if (address.protocol() == QAbstractSocket::IPv4Protocol) {
+                appendAnswer(r, TypeA, ipv4Data(address));
+                ++answers;
+            }
+        }
+        if (qtype == TypeAAAA || qtype == TypeANY) {
+            if (address.protocol() == QAbstractSocket::IPv6Protocol) {
+                appendAnswer(r, TypeAAAA, ipv6Data(address));
+                ++answers;
+            } else if (address.isLoopback()) {
+                appendAnswer(r, TypeAAAA, ipv6Data(QHostAddress::LocalHostIPv6));
+                ++answers;
+            }
+        }
+        writeUInt16(r, 6, answers);
+
+        return true;
+    }
+
+    QByteArray Responder::errorResponse(const QByteArray &query, int questionEnd, ResponseCode code)
+    {
+        const quint16 flags = readUInt16(query, 2);
+
+        QByteArray response;
+        appendUInt16(response, readUInt16(query, 0));
+        appendUInt16(response, 0x8000 | (flags & 0x7900) | code); // QR, opcode and RD copied
+        appendUInt16(response, questionEnd > HeaderSize ? 1 : 0);
+        appendUInt16(response, 0);
+        appendUInt16(response, 0);
+        appendUInt16(response, 0);
+        response.append(query.constData() + HeaderSize, questionEnd - HeaderSize);
+        return response;
+    }
+
+    void Responder::readUdpQueries()
+    {
+        while (udpSocket.hasPendingDatagrams()) {
+            QByteArray query;
+            query.resize(static_cast<int>(udpSocket.pendingDatagramSize()));
+
+            QHostAddress sender;
+            quint16 senderPort;
+            if (udpSocket.readDatagram(query.data(), query.size(), &sender, &senderPort) < 0) {
+                continue;
+            }
+
+            handleQuery(query, sender, senderPort, nullptr);
+        }
+    }
+
+    void Responder::acceptTcpConnection()
+    {
+        while (QTcpSocket *socket = tcpServer.nextPendingConnection()) {
+            tcpBuffers.insert(socket, QByteArray());
+            connect(socket, SIGNAL(readyRead()), this, SLOT(readTcpQueries()));
+            connect(socket, SIGNAL(disconnected()), socket, SLOT(deleteLater()));
+            connect(socket, &QObject::destroyed, this,
+                    [this, socket]() { tcpBuffers.remove(socket); });
+        }
+    }
+
+    void Responder::readTcpQueries()
+    {
+        auto *socket = qobject_cast<QTcpSocket *>(sender());
+        if (socket == nullptr || !tcpBuffers.contains(socket)) {
+            return;
+        }
+
+        // each message is prefixed with its length
+        QByteArray &buffer = tcpBuffers[socket];
+        buffer.append(socket->readAll());
+
+        int offset = 0;
+        while (buffer.size() - offset >= 2) {
+            const int length = readUInt16(buffer, offset);
+            if (buffer.size() - offset - 2 < length) {
+                break;
+            }
+            const QByteArray query = buffer.mid(offset + 2, length);
+            offset += 2 + length;
+
+            handleQuery(query, socket->peerAddress(), socket->peerPort(), socket);
+        }
+        buffer.remove(0, offset);
+    }
+
+    void Responder::handleQuery(const QByteArray &query, const QHostAddress &sender, quint16 senderPort,
+                                QTcpSocket *tcp)
+    {
+        QByteArray response;
+        if (resolve(query, &response)) {
+            if (!response.isEmpty()) {
+                reply(response, sender, senderPort, tcp);
+            }
+            return;
+        }
+
+        if (forwarder.isNull()) {
+            QByteArray name;
+            const int nameEnd = readQuestionName(query, &name);
+            reply(errorResponse(query, nameEnd + 4, Refused), sender, senderPort, tcp);
+            return;
+        }
+
+        forward(query, sender, senderPort, tcp);
+    }
+
+    void Responder::forward(const QByteArray &query, const QHostAddress &sender, quint16 senderPort, QTcpSocket *tcp)
+    {
+        QByteArray name;
+        const int questionEnd = readQuestionName(query, &name) + 4;
+
+        if (pendingForwards.size() >= MaxPendingForward) {
+            reply(errorResponse(query, questionEnd, ServerFailure), sender, senderPort, tcp);
+            return;
+        }
+
+        if (forwarderSocket.state() != QAbstractSocket::BoundState) {
+            const QHostAddress any = forwarder.protocol() == QAbstractSocket::IPv6Protocol ? QHostAddress::AnyIPv6
+                                                                                          : QHostAddress::AnyIPv4;
+            if (!forwarderSocket.bind(any, 0)) {
+                qDebug() << "[DNS] Could not bind the forwarder socket" << forwarderSocket.errorString();
+                reply(errorResponse(query, questionEnd, ServerFailure), sender, senderPort, tcp);
+                return;
+            }
+        }
+
+        // the upstream server sees our own ID, so that answers can be matched to the clients
+        while (pendingForwards.contains(nextForwardId)) {
+            ++nextForwardId;
+        }
+        const quint16 id = nextForwardId++;
+
+        PendingForward pending;
+        pending.originalId = readUInt16(query, 0);
+        pending.sender     = sender;
+        pending.senderPort = senderPort;
+        pending.tcp        = tcp;
+        pending.viaTcp     = tcp != nullptr;
+        pending.expires    = QDateTime::currentMSecsSinceEpoch() + ForwardTimeout;
+        pendingForwards.insert(id, pending);
+
+        QByteArray forwarded = query;
+        writeUInt16(forwarded, 0, id);
+        forwarderSocket.writeDatagram(forwarded, forwarder, forwarderPort);
+
+        if (!expireTimer.isActive()) {
+            expireTimer.start();
+        }
+    }
+
+    void Responder::readForwarderResponses()
+    {
+        while (forwarderSocket.hasPendingDatagrams()) {
+            QByteArray response;
+            response.resize(static_cast<int>(forwarderSocket.pendingDatagramSize()));
+
+            QHostAddress from;
+            quint16 fromPort;
+            if (forwarderSocket.readDatagram(response.data(), response.size(), &from, &fromPort) < HeaderSize) {
+                continue;
+            }
+            if (from != forwarder || fromPort != forwarderPort) {
+                continue;
+            }
+
+            auto it = pendingForwards.find(readUInt16(response, 0));
+            if (it == pendingForwards.end()) {
+                continue;
+            }
+            const PendingForward pending = it.value();
+            pendingForwards.erase(it);
+
+            // the client connection might be gone already
+            if (pending.viaTcp && pending.tcp.isNull()) {
+                continue;
+            }
+
+            writeUInt16(response, 0, pending.originalId);
+            reply(response, pending.sender, pending.senderPort, pending.tcp.data());
+        }
+    }
+
+    void Responder::expireForwards()
+    {
+        const qint64 now = QDateTime::currentMSecsSinceEpoch();
+
+        // clients retry on their own, so unanswered queries are simply dropped
+        for (auto it = pendingForwards.begin(); it != pendingForwards.end();) {
+            if (it.value().expires <= now) {
+                it = pendingForwards.erase(it);
+            } else {
+                ++it;
+            }
+        }
+
+        if (pendingForwards.isEmpty()) {
+            expireTimer.stop();
+        }
+    }
+
+    void Responder::reply(const QByteArray &response, const QHostAddress &sender, quint16 senderPort, QTcpSocket *tcp)
+    {
+        if (tcp != nullptr) {
+            if (tcp->state() != QAbstractSocket::ConnectedState) {
+                return;
+            }
+            QByteArray lengthPrefix;
+            appendUInt16(lengthPrefix, static_cast<quint16>(response.size()));
+            tcp->write(lengthPrefix + response);
+            return;
+        }
+
+        udpSocket.writeDatagram(response, sender, senderPort);
+    }
+} // namespace DNS
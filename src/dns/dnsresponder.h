@@ -0,0 +1,141 @@
+#ifndef DNSRESPONDER_H
+#define DNSRESPONDER_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QHostAddress>
+#include <QObject>
+#include <QPointer>
+#include <QStringList>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QVector>
+
+namespace DNS
+{
+    /**
+     * ZoneTrie maps domain patterns to addresses.
+     *
+     * The labels of a pattern are stored from right to left, e.g. "*.project.test"
+     * is stored as "test" -> "project" -> wildcard. A lookup walks the labels of
+     * the queried name once and returns the exact match or the deepest wildcard.
+     * A wildcard matches all subdomains, but not the domain itself.
+     */
+    class ZoneTrie
+    {
+    public:
+        ZoneTrie();
+
+        void insert(const QString &pattern, const QHostAddress &address);
+        bool remove(const QString &pattern);
+        void clear();
+        bool lookup(const QByteArray &name, QHostAddress *address) const;
+        QStringList patterns() const;
+
+    private:
+        static bool parsePattern(const QString &pattern, QByteArray *name);
+        static QString normalizedPattern(const QByteArray &name, bool wildcard);
+
+        struct Node
+        {
+            QHash<QByteArray, int> children;
+            QHostAddress exact;
+            QHostAddress wildcard;
+            bool hasExact    = false;
+            bool hasWildcard = false;
+        };
+
+        QVector<Node> nodes; // nodes[0] is the root
+        QStringList patternList;
+    };
+
+    /**
+     * Responder is a small authoritative DNS server for local development domains.
+     *
+     * It listens for UDP and TCP queries (by default on 127.0.0.1:53) and answers
+     * A and AAAA queries for the configured zones, e.g. "*.test", from memory.
+     * All other queries are forwarded to an upstream DNS server, if one is configured,
+     * otherwise they are refused.
+     *
+     * Adding a zone or domain takes effect immediately, without a hosts file rewrite.
+     * Test with: dig @127.0.0.1 myproject.test
+     */
+    class Responder : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        explicit Responder(QObject *parent = nullptr);
+        ~Responder();
+
+        bool start(const QHostAddress &address = QHostAddress::LocalHost, quint16 port = 53);
+        void stop();
+        bool isRunning() const;
+
+        void addZone(const QString &pattern, const QHostAddress &address = QHostAddress::LocalHost);
+        bool removeZone(const QString &pattern);
+        QStringList zones() const;
+
+        void setForwarder(const QHostAddress &server, quint16 port = 53);
+
+        enum ResponseCode
+        {
+            NoError        = 0,
+            FormatError    = 1,
+            ServerFailure  = 2,
+            NameError      = 3,
+            NotImplemented = 4,
+            Refused        = 5
+        };
+
+        enum RecordType
+        {
+            TypeA    = 1,
+            TypeAAAA = 28,
+            TypeANY  = 255
+        };
+
+        // builds the response for a query. returns false, if the query is not for a local zone.
+        bool resolve(const QByteArray &query, QByteArray *response) const;
+
+    private slots:
+        void readUdpQueries();
+        void readForwarderResponses();
+        void acceptTcpConnection();
+        void readTcpQueries();
+        void expireForwards();
+
+    private:
+        void handleQuery(const QByteArray &query, const QHostAddress &sender, quint16 senderPort, QTcpSocket *tcp);
+        void forward(const QByteArray &query, const QHostAddress &sender, quint16 senderPort, QTcpSocket *tcp);
+        void reply(const QByteArray &response, const QHostAddress &sender, quint16 senderPort, QTcpSocket *tcp);
+        static QByteArray errorResponse(const QByteArray &query, int questionEnd, ResponseCode code);
+
+        struct PendingForward
+        {
+            quint16 originalId;
+            QHostAddress sender;
+            quint16 senderPort;
+            QPointer<QTcpSocket> tcp;
+            bool viaTcp;
+            qint64 expires;
+        };
+
+        QUdpSocket udpSocket;
+        QTcpServer tcpServer;
+        QUdpSocket forwarderSocket;
+        QTimer expireTimer;
+
+        ZoneTrie zoneTrie;
+
+        QHostAddress forwarder;
+        quint16 forwarderPort;
+        quint16 nextForwardId;
+        QHash<quint16, PendingForward> pendingForwards;
+        QHash<QTcpSocket *, QByteArray> tcpBuffers;
+    };
+} // namespace DNS
+
+#endif // DNSRESPONDER_H
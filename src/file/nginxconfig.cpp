@@ -0,0 +1,477 @@
+#include "nginxconfig.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QRegExp>
+#include <QSet>
+
+namespace File
+{
+    // include depth, at which a config is considered to include itself
+    static const int maxIncludeDepth = 16;
+
+    struct NginxConfigToken
+    {
+        enum Type
+        {
+            Word,
+            Semicolon,
+            BlockStart,
+            BlockEnd,
+            End
+        };
+
+        Type type;
+        QString text;
+        int line;
+    };
+
+    /**
+     * Splits a config file into words, ";", "{" and "}".
+     * Comments run from "#" to the end of the line, quoted words keep their whitespace.
+     */
+    struct NginxConfig::Lexer
+    {
+        Lexer(const QByteArray &content, const QString &fileName)
+            : data(content), file(fileName), pos(0), line(1)
+        {
+        }
+
+        NginxConfigToken next(QString *error)
+        {
+            const int size = data.size();
+
+            // skip whitespace and comments
+            while (pos < size) {
+                const char c = data.at(pos);
+                if (c == '\n') {
+                    ++line;
+                    ++pos;
+                } else if (c == ' ' || c == '\t' || c == '\r') {
+                    ++pos;
+                } else if (c == '#') {
+                    while (pos < size && data.at(pos) != '\n') {
+                        ++pos;
+                    }
+                } else {
+                    break;
+                }
+            }
+
+            if (pos >= size) {
+                return NginxConfigToken{NginxConfigToken::End, QString(), line};
+            }
+
+            const char c = data.at(pos);
+            if (c == ';' || c == '{' || c == '}') {
+                ++pos;
+                NginxConfigToken::Type type = c == ';' ? NginxConfigToken::Semicolon
+                                                       : (c == '{' ? NginxConfigToken::BlockStart
+                                                                   : NginxConfigToken::BlockEnd);
+                return NginxConfigToken{type, QString(QChar(c)), line};
+            }
+
+            const int startLine = line;
+
+            // quoted word
+            if (c == '"' || c == '\'') {
+                const char quote = c;
+                QByteArray word;
+                ++pos;
+                while (pos < size && data.at(pos) != quote) {
+                    if (data.at(pos) == '\\' && pos + 1 < size) {
+                        ++pos;
+                    }
+                    if (data.at(pos) == '\n') {
+                        ++line;
+                    }
+                    word.append(data.at(pos));
+                    ++pos;
+                }
+                if (pos >= size) {
+                    *error = QString("unterminated %1 quote").arg(QChar(quote));
+                    return NginxConfigToken{NginxConfigToken::End, QString(), startLine};
+                }
+                ++pos; // closing quote
+                return NginxConfigToken{NginxConfigToken::Word, QString::fromUtf8(word), startLine};
+            }
+
+            // plain word, "${variable}" braces belong to the word
+            const int start = pos;
+            while (pos < size) {
+                const char w = data.at(pos);
+                if (w == ' ' || w == '\t' || w == '\r' || w == '\n' || w == ';' || w == '{' || w == '}') {
+                    if (w == '{' && pos > start && data.at(pos - 1) == '$') {
+                        while (pos < size && data.at(pos) != '}') {
+                            ++pos;
+                        }
+                        if (pos < size) {
+                            ++pos;
+                        }
+                        continue;
+                    }
+                    break;
+                }
+                ++pos;
+            }
+            return NginxConfigToken{NginxConfigToken::Word, QString::fromUtf8(data.constData() + start, pos - start),
+                                    startLine};
+        }
+
+        const QByteArray &data;
+        QString file;
+        int pos;
+        int line;
+    };
+
+    QString NginxConfig::Error::toString() const
+    {
+        return QString("%1:%2: %3").arg(QDir::toNativeSeparators(file)).arg(line).arg(message);
+    }
+
+    NginxConfig NginxConfig::load(const QString &fileName)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        NginxConfig config;
+        config.mainFile   = QDir::cleanPath(QFileInfo(fileName).absoluteFilePath());
+        config.confFolder = QFileInfo(config.mainFile).absolutePath();
+
+        QStringList includeStack;
+        config.parseFile(config.mainFile, config.tree, includeStack);
+        config.validate();
+
+        qDebug() << "[NginxConfig] Parsed" << config.parsedFiles.size() << "files in" << timer.nsecsElapsed() / 1000
+                 << "us," << config.errorList.size() << "errors";
+
+        foreach (const Error &error, config.errorList) {
+            qDebug() << "[NginxConfig]" << error.toString();
+        }
+
+        return config;
+    }
+
+    bool NginxConfig::isValid() const { return !parsedFiles.isEmpty() && errorList.isEmpty(); }
+
+    QVector<NginxConfig::Error> NginxConfig::errors() const { return errorList; }
+
+    QString NginxConfig::fileName() const { return mainFile; }
+
+    QStringList NginxConfig::files() const { return parsedFiles; }
+
+    QVector<NginxConfig::Directive> NginxConfig::directives() const { return tree; }
+
+    static void collect(const QVector<NginxConfig::Directive> &directives, const QString &name,
+                        QVector<NginxConfig::Directive> &found)
+    {
+        foreach (const NginxConfig::Directive &directive, directives) {
+            if (directive.name == name) {
+                found.append(directive);
+            }
+            if (directive.isBlock) {
+                collect(directive.children, name, found);
+            }
+        }
+    }
+
+    /**
+     * Returns the directives with the name, from all contexts, in the order of the config.
+     */
+    QVector<NginxConfig::Directive> NginxConfig::find(const QString &name) const
+    {
+        QVector<Directive> found;
+        collect(tree, name, found);
+        return found;
+    }
+
+    /**
+     * The ports of all "listen" directives, unique, in the order of the config.
+     */
+    QStringList NginxConfig::listenPorts() const
+    {
+        QStringList ports;
+        foreach (const Directive &listen, find("listen")) {
+            const QString port = listen.args.isEmpty() ? QString() : portOf(listen.args.first());
+            if (!port.isEmpty() && !ports.contains(port)) {
+                ports << port;
+            }
+        }
+        return ports;
+    }
+
+    QStringList NginxConfig::serverNames() const
+    {
+        QStringList names;
+        foreach (const Directive &serverName, find("server_name")) {
+            foreach (const QString &name, serverName.args) {
+                if (!name.isEmpty() && !names.contains(name)) {
+                    names << name;
+                }
+            }
+        }
+        return names;
+    }
+
+    QStringList NginxConfig::upstreams() const
+    {
+        QStringList names;
+        foreach (const Directive &upstream, find("upstream")) {
+            if (upstream.isBlock && !upstream.args.isEmpty() && !names.contains(upstream.args.first())) {
+                names << upstream.args.first();
+            }
+        }
+        return names;
+    }
+
+    static const QStringList passDirectives = QStringList() << "fastcgi_pass"
+                                                            << "proxy_pass"
+                                                            << "uwsgi_pass"
+                                                            << "scgi_pass"
+                                                            << "grpc_pass";
+
+    /**
+     * Returns the name, a "*_pass" directive refers to, or an empty string for an address
+     * ("127.0.0.1:9000", "unix:/tmp/php.sock") or a variable.
+     * "http://backend/api" refers to "backend".
+     */
+    static QString passTarget(const NginxConfig::Directive &directive)
+    {
+        if (directive.args.isEmpty()) {
+            return QString();
+        }
+
+        QString host = directive.args.first();
+        if (host.contains("://")) {
+            host = host.section("://", 1);
+        }
+        host = host.section('/', 0, 0);
+
+        if (host.startsWith("unix:") || host.contains(':') || host.contains('$')) {
+            return QString();
+        }
+        return host;
+    }
+
+    /**
+     * Returns the names of the upstreams, which are referenced by "*_pass" directives.
+     */
+    QStringList NginxConfig::upstreamReferences() const
+    {
+        QStringList names;
+        foreach (const QString &pass, passDirectives) {
+            foreach (const Directive &directive, find(pass)) {
+                const QString name = passTarget(directive);
+                if (!name.isEmpty() && !names.contains(name)) {
+                    names << name;
+                }
+            }
+        }
+        return names;
+    }
+
+    QStringList NginxConfig::roots() const
+    {
+        QStringList folders;
+        foreach (const Directive &root, find("root")) {
+            if (!root.args.isEmpty() && !folders.contains(root.args.first())) {
+                folders << root.args.first();
+            }
+        }
+        return folders;
+    }
+
+    /**
+     * Returns the port of a "listen" address: "80", "127.0.0.1:8080", "[::]:443", "*:80", "localhost".
+     * A unix socket has no port.
+     */
+    QString NginxConfig::portOf(const QString &listen)
+    {
+        if (listen.startsWith("unix:")) {
+            return QString();
+        }
+
+        QString port = listen;
+        if (listen.startsWith('[')) {
+            // IPv6: "[::1]:8080" or "[::1]"
+            const int bracket = listen.indexOf(']');
+            port              = listen.mid(bracket + 1).startsWith(':') ? listen.mid(bracket + 2) : QString();
+        } else if (listen.contains(':')) {
+            port = listen.section(':', -1);
+        }
+
+        bool isNumber = false;
+        port.toInt(&isNumber);
+
+        // an address without a port listens on the default port
+        return isNumber ? port : QString("80");
+    }
+
+    void NginxConfig::parseFile(const QString &fileName, QVector<Directive> &into, QStringList &includeStack)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            addError(fileName, 0, "could not open file");
+            return;
+        }
+
+        const QByteArray content = file.readAll();
+
+        parsedFiles << fileName;
+        includeStack << fileName;
+
+        Lexer lexer(content, fileName);
+        parseBlock(lexer, into, false, includeStack);
+
+        includeStack.removeLast();
+    }
+
+    /**
+     * Parses directives until the end of the block ("}") or the end of the file.
+     */
+    void NginxConfig::parseBlock(Lexer &lexer, QVector<Directive> &into, bool nested, QStringList &includeStack)
+    {
+        Directive directive{QString(), QStringList(), false, QVector<Directive>(), lexer.file, 0};
+
+        forever {
+            QString lexerError;
+            const NginxConfigToken token = lexer.next(&lexerError);
+
+            if (!lexerError.isEmpty()) {
+                addError(lexer.file, token.line, lexerError);
+                return;
+            }
+
+            switch (token.type) {
+            case NginxConfigToken::Word:
+                if (directive.name.isEmpty()) {
+                    directive.name = token.text;
+                    directive.line = token.line;
+                } else {
+                    directive.args << token.text;
+                }
+                break;
+
+            case NginxConfigToken::Semicolon:
+                if (directive.name.isEmpty()) {
+                    addError(lexer.file, token.line, "unexpected \";\"");
+                    break;
+                }
+                if (directive.name == "include") {
+                    include(directive, into, includeStack);
+                } else {
+                    into.append(directive);
+                }
+                directive = Directive{QString(), QStringList(), false, QVector<Directive>(), lexer.file, 0};
+                break;
+
+            case NginxConfigToken::BlockStart:
+                if (directive.name.isEmpty()) {
+                    addError(lexer.file, token.line, "unexpected \"{\"");
+                }
+                directive.isBlock = true;
+                parseBlock(lexer, directive.children, true, includeStack);
+                into.append(directive);
+                directive = Directive{QString(), QStringList(), false, QVector<Directive>(), lexer.file, 0};
+                break;
+
+            case NginxConfigToken::BlockEnd:
+                if (!directive.name.isEmpty()) {
+                    addError(lexer.file, directive.line, QString("missing \";\" after \"%1\"").arg(directive.name));
+                }
+                if (!nested) {
+                    addError(lexer.file, token.line, "unexpected \"}\"");
+                    break;
+                }
+                return;
+
+            case NginxConfigToken::End:
+                if (!directive.name.isEmpty()) {
+                    addError(lexer.file, directive.line, QString("missing \";\" after \"%1\"").arg(directive.name));
+                }
+                if (nested) {
+                    addError(lexer.file, token.line, "unexpected end of file, expecting \"}\"");
+                }
+                return;
+            }
+        }
+    }
+
+    /**
+     * Parses the included files into the context of the "include" directive.
+     */
+    void NginxConfig::include(const Directive &directive, QVector<Directive> &into, QStringList &includeStack)
+    {
+        if (directive.args.size() != 1) {
+            addError(directive.file, directive.line, "invalid number of arguments in \"include\"");
+            return;
+        }
+
+        const QString pattern = QDir::cleanPath(QDir(confFolder).absoluteFilePath(directive.args.first()));
+
+        QStringList files;
+        if (pattern.contains(QRegExp("[*?\\[]"))) {
+            // a glob matches nothing without an error, like Nginx does
+            const QFileInfo info(pattern);
+            const QDir folder(info.absolutePath());
+            foreach (const QString &name, folder.entryList(QStringList(info.fileName()), QDir::Files, QDir::Name)) {
+                files << folder.absoluteFilePath(name);
+            }
+        } else if (QFile::exists(pattern)) {
+            files << pattern;
+        } else {
+            addError(directive.file, directive.line, QString("include file \"%1\" not found").arg(pattern));
+            return;
+        }
+
+        foreach (const QString &file, files) {
+            if (includeStack.contains(file) || includeStack.size() >= maxIncludeDepth) {
+                addError(directive.file, directive.line, QString("recursive include of \"%1\"").arg(file));
+                continue;
+            }
+            parseFile(file, into, includeStack);
+        }
+    }
+
+    /**
+     * Checks the directives, which are needed to find ports, names and upstreams.
+     */
+    void NginxConfig::validate()
+    {
+        static const QStringList needArguments = QStringList() << "listen"
+                                                               << "root"
+                                                               << "server_name"
+                                                               << "upstream";
+
+        foreach (const QString &name, needArguments) {
+            foreach (const Directive &directive, find(name)) {
+                if (directive.args.isEmpty()) {
+                    addError(directive.file, directive.line,
+                             QString("invalid number of arguments in \"%1\"").arg(directive.name));
+                }
+            }
+        }
+
+        // a pool, which was removed from the upstreams, but is still referenced, stops Nginx
+        const QSet<QString> defined = QSet<QString>::fromList(upstreams());
+        foreach (const QString &pass, passDirectives) {
+            foreach (const Directive &directive, find(pass)) {
+                const QString name = passTarget(directive);
+
+                // a host name with a domain or "localhost" is resolved by DNS
+                if (name.isEmpty() || defined.contains(name) || name.contains('.') || name == "localhost") {
+                    continue;
+                }
+                addError(directive.file, directive.line, QString("upstream \"%1\" is not defined").arg(name));
+            }
+        }
+    }
+
+    void NginxConfig::addError(const QString &file, int line, const QString &message)
+    {
+        errorList.append(Error{file, line, message});
+    }
+} // namespace File
@@ -0,0 +1,86 @@
+#ifndef NGINXCONFIG_H
+#define NGINXCONFIG_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace File
+{
+    /**
+     * NginxConfig - A parsed Nginx configuration tree ("nginx.conf" and everything it includes).
+     *
+     * The files are tokenized and parsed into directives, a block directive ("http", "server",
+     * "upstream", "location") holds its child directives. An "include" is resolved relative to the
+     * folder of the main config, globs ("upstreams/*.conf") are expanded in alphabetical order, like
+     * Nginx does, and the included directives take the place of the "include" directive.
+     *
+     * Structural errors are collected instead of aborting the parse: unbalanced braces, a missing ";",
+     * unterminated quotes, missing or recursive includes and references to upstreams, which are not defined.
+     * That is not a replacement for "nginx -t" (unknown directives or bad values are not detected),
+     * but it catches the errors of hand and generated edits, before Nginx is reloaded with them.
+     *
+     * NginxConfig config = NginxConfig::load("bin/nginx/conf/nginx.conf");
+     * if (config.isValid()) {
+     *     QStringList ports = config.listenPorts();
+     * }
+     */
+    class NginxConfig
+    {
+    public:
+        struct Directive
+        {
+            QString name;
+            QStringList args;
+            bool isBlock;
+            QVector<Directive> children;
+            QString file;
+            int line;
+        };
+
+        struct Error
+        {
+            QString file;
+            int line;
+            QString message;
+
+            QString toString() const;
+        };
+
+        static NginxConfig load(const QString &fileName);
+
+        bool isValid() const;
+        QVector<Error> errors() const;
+        QString fileName() const;
+        QStringList files() const;
+
+        QVector<Directive> directives() const;
+        QVector<Directive> find(const QString &name) const;
+
+        QStringList listenPorts() const;
+        QStringList serverNames() const;
+        QStringList upstreams() const;
+        QStringList upstreamReferences() const;
+        QStringList roots() const;
+
+        static QString portOf(const QString &listen);
+
+    private:
+        struct Lexer;
+
+        void parseFile(const QString &fileName, QVector<Directive> &into, QStringList &includeStack);
+        void parseBlock(Lexer &lexer, QVector<Directive> &into, bool nested, QStringList &includeStack);
+        void include(const Directive &directive, QVector<Directive> &into, QStringList &includeStack);
+        void validate();
+        void addError(const QString &file, int line, const QString &message);
+
+        QString mainFile;
+        QString confFolder;
+        QStringList parsedFiles;
+        QVector<Directive> tree;
+        QVector<Error> errorList;
+    };
+} // namespace File
+
+#endif // NGINXCONFIG_H
@@ -0,0 +1,127 @@
+#include "pe.h"
+
+#include <QFile>
+#include <QtEndian>
+
+namespace File
+{
+    /**
+     * Returns the "ProductVersion" of the version resource, e.g. "7.4.1" for php.exe.
+     *
+     * The resource stores each value as a String structure: the key as UTF-16LE,
+     * zero terminated and padded to 32 bits, followed by the value as UTF-16LE.
+     * Returns an empty string, when the file has no version resource.
+     */
+    QString PE::productVersion(const QString &fileName)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+            return QString();
+        }
+
+        uchar *memory = file.map(0, file.size());
+        if (memory == nullptr) {
+            return QString();
+        }
+
+        const QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char *>(memory), file.size());
+        static const QByteArray key = QByteArray::fromRawData(
+            reinterpret_cast<const char *>(u"ProductVersion"), static_cast<int>(sizeof(u"ProductVersion")));
+
+        // the resource section is at the end of the file
+        QString version;
+        int position = data.lastIndexOf(key);
+        if (position >= 0) {
+            position += key.size();
+
+            // skip the padding
+            while (position + 1 < data.size() && data.at(position) == 0 && data.at(position + 1) == 0) {
+                position += 2;
+            }
+            while (position + 1 < data.size() && version.size() < 64) {
+                const ushort character = static_cast<uchar>(data.at(position)) |
+                                         static_cast<ushort>(static_cast<uchar>(data.at(position + 1)) << 8);
+                if (character == 0) {
+                    break;
+                }
+                version.append(QChar(character));
+                position += 2;
+            }
+        }
+
+        file.unmap(memory);
+
+        version = version.trimmed();
+        if (version.isEmpty() || !version.at(0).isDigit()) {
+            return QString();
+        }
+        return version;
+    }
+
+    /**
+     * Returns the architecture from the COFF header ("x86", "x64", "arm64"), or empty, if the file is no PE file.
+     */
+    QString PE::machine(const QString &fileName)
+    {
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            return QString();
+        }
+
+        // the DOS header points to the PE signature, which is followed by the machine type
+        const QByteArray dosHeader = file.read(64);
+        if (dosHeader.size() < 64 || !dosHeader.startsWith("MZ")) {
+            return QString();
+        }
+        const auto *dos        = reinterpret_cast<const uchar *>(dosHeader.constData());
+        const quint32 peOffset = qFromLittleEndian<quint32>(dos + 60);
+        if (!file.seek(peOffset)) {
+            return QString();
+        }
+        const QByteArray peHeader = file.read(6);
+        if (peHeader.size() < 6 || !peHeader.startsWith(QByteArray("PE\0\0", 4))) {
+            return QString();
+        }
+
+        switch (qFromLittleEndian<quint16>(reinterpret_cast<const uchar *>(peHeader.constData()) + 4)) {
+        case 0x014c:
+            return "x86";
+        case 0x8664:
+            return "x64";
+        case 0xaa64:
+            return "arm64";
+        default:
+            return "unknown";
+        }
+    }
+
+    /**
+     * Returns the printable ASCII strings of the file, which start with the prefix.
+     */
+    QStringList PE::strings(const QString &fileName, const QByteArray &prefix, int maxLength)
+    {
+        QStringList list;
+
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly) || file.size() == 0) {
+            return list;
+        }
+
+        uchar *memory = file.map(0, file.size());
+        if (memory == nullptr) {
+            return list;
+        }
+
+        const QByteArray data = QByteArray::fromRawData(reinterpret_cast<const char *>(memory), file.size());
+        for (int position = data.indexOf(prefix); position >= 0; position = data.indexOf(prefix, position + 1)) {
+            int end = position;
+            while (end < data.size() && end - position < maxLength && data.at(end) >= 0x20 && data.at(end) < 0x7f) {
+                ++end;
+            }
+            list << QString::fromLatin1(data.constData() + position, end - position);
+        }
+
+        file.unmap(memory);
+        return list;
+    }
+} // namespace File
@@ -0,0 +1,25 @@
+#ifndef PE_H
+#define PE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+namespace File
+{
+    /**
+     * PE - Reads information from Windows executables and DLLs (Portable Executable),
+     * without loading or running them.
+     *
+     * The file is memory-mapped, only the pages, which are touched, are read.
+     */
+    class PE
+    {
+    public:
+        static QString productVersion(const QString &fileName);
+        static QString machine(const QString &fileName);
+        static QStringList strings(const QString &fileName, const QByteArray &prefix, int maxLength = 64);
+    };
+} // namespace File
+
+#endif // PE_H
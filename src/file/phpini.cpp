@@ -0,0 +1,439 @@
+#include "phpini.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QMutex>
+#include <QRegExp>
+#include <QSaveFile>
+#include <QSharedData>
+
+#include <algorithm>
+
+namespace File
+{
+    /**
+     * A line of php.ini, which holds a directive or a section header (empty key).
+     */
+    struct PhpIniLine
+    {
+        PhpIni::Directive directive;
+        QByteArray text;
+        bool changed;
+        qint64 insertAt; // for a new line: the offset, where it is inserted
+    };
+
+    struct PhpIniSection
+    {
+        QString name;
+        qint64 end; // end of the last line of the section (header or directive)
+    };
+
+    class PhpIniData : public QSharedData
+    {
+    public:
+        PhpIniData() : valid(false), size(0), modified(0) {}
+
+        QString fileName;
+        QByteArray content;
+        QByteArray newline;
+        bool valid;
+        qint64 size;
+        qint64 modified;
+
+        QVector<PhpIniLine> lines;
+        QVector<PhpIniSection> sections;
+    };
+
+    PhpIni::PhpIni() : d(new PhpIniData) {}
+
+    PhpIni::PhpIni(const PhpIni &other) = default;
+
+    PhpIni::~PhpIni() = default;
+
+    PhpIni &PhpIni::operator=(const PhpIni &other) = default;
+
+    PhpIni PhpIni::load(const QString &fileName)
+    {
+        PhpIni ini;
+        ini.d->fileName = QDir::cleanPath(QFileInfo(fileName).absoluteFilePath());
+
+        QFile file(ini.d->fileName);
+        if (!file.open(QIODevice::ReadOnly)) {
+            qDebug() << "[PhpIni] Could not open" << fileName;
+            return ini;
+        }
+
+        const QFileInfo info(file);
+        ini.d->content  = file.readAll();
+        ini.d->size     = info.size();
+        ini.d->modified = info.lastModified().toMSecsSinceEpoch();
+        ini.d->valid    = true;
+        ini.parse();
+        return ini;
+    }
+
+    static QMutex cacheMutex;
+
+    static QHash<QString, PhpIni> &cache()
+    {
+        static QHash<QString, PhpIni> files;
+        return files;
+    }
+
+    /**
+     * Returns the parsed file, shared by all callers. The file is parsed again,
+     * only when its size or modification time changed.
+     */
+    PhpIni PhpIni::shared(const QString &fileName)
+    {
+        const QString path = QDir::cleanPath(QFileInfo(fileName).absoluteFilePath());
+        const QFileInfo info(path);
+
+        QMutexLocker lock(&cacheMutex);
+        auto cached = cache().constFind(path);
+        if (cached != cache().constEnd() && cached->d->size == info.size() &&
+            cached->d->modified == info.lastModified().toMSecsSinceEpoch()) {
+            return *cached;
+        }
+
+        PhpIni ini = load(path);
+        cache().insert(path, ini);
+        return ini;
+    }
+
+    bool PhpIni::isValid() const { return d->valid; }
+
+    bool PhpIni::isModified() const
+    {
+        for (const PhpIniLine &line : d->lines) {
+            if (line.changed) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    QString PhpIni::fileName() const { return d->fileName; }
+
+    QVector<PhpIni::Directive> PhpIni::directives() const
+    {
+        QVector<Directive> list;
+        for (const PhpIniLine &line : d->lines) {
+            if (!line.directive.key.isEmpty()) {
+                list.append(line.directive);
+            }
+        }
+        return list;
+    }
+
+    QStringList PhpIni::sections() const
+    {
+        QStringList list;
+        for (const PhpIniSection &section : d->sections) {
+            list << section.name;
+        }
+        return list;
+    }
+
+    /**
+     * The value of the last active directive with the key (PHP uses the last one, too).
+     */
+    QString PhpIni::value(const QString &key, const QString &defaultValue) const
+    {
+        const QStringList list = values(key);
+        return list.isEmpty() ? defaultValue : list.last();
+    }
+
+    QStringList PhpIni::values(const QString &key) const
+    {
+        QStringList list;
+        for (const PhpIniLine &line : d->lines) {
+            if (!line.directive.commented && line.directive.key == key) {
+                list << line.directive.value;
+            }
+        }
+        return list;
+    }
+
+    /**
+     * The names of the enabled extensions ("extension" and "zend_extension"), e.g. "xdebug".
+     */
+    QStringList PhpIni::enabledExtensions() const
+    {
+        QStringList list;
+        for (const PhpIniLine &line : d->lines) {
+            const Directive &directive = line.directive;
+            if (!directive.commented && (directive.key == "extension" || directive.key == "zend_extension")) {
+                list << extensionName(directive.value);
+            }
+        }
+        return list;
+    }
+
+    /**
+     * Sets the directive: an active directive is changed, a commented one is enabled,
+     * otherwise the directive is added at the end of the section.
+     */
+    void PhpIni::setValue(const QString &section, const QString &key, const QString &value)
+    {
+        int index = -1;
+        for (int i = 0; i < d->lines.size(); ++i) {
+            const Directive &directive = d->lines.at(i).directive;
+            if (directive.key == key && (index < 0 || !directive.commented)) {
+                index = i;
+            }
+        }
+
+        const QByteArray text = QString("%1 = %2").arg(key, value).toUtf8();
+
+        if (index >= 0) {
+            PhpIniLine &line = d->lines[index];
+            if (!line.directive.commented && line.directive.value == value) {
+                return;
+            }
+            line.directive.value     = value;
+            line.directive.commented = false;
+            line.text                = text;
+            line.changed             = true;
+            return;
+        }
+
+        qint64 insertAt = -1;
+        for (const PhpIniSection &existing : d->sections) {
+            if (existing.name.compare(section, Qt::CaseInsensitive) == 0) {
+                insertAt = existing.end;
+            }
+        }
+        if (insertAt < 0) {
+            insertAt = d->content.size();
+            d->sections.append(PhpIniSection{section, insertAt});
+            d->lines.append(PhpIniLine{Directive{section, QString(), QString(), false, -1, 0},
+                                       QString("[%1]").arg(section).toUtf8(), true, insertAt});
+        }
+
+        d->lines.append(PhpIniLine{Directive{section, key, value, false, -1, 0}, text, true, insertAt});
+    }
+
+    /**
+     * Enables an extension by removing the comment of its directive, or adding one
+     * next to the other extensions. Disabling comments all its directives out.
+     */
+    void PhpIni::setExtensionEnabled(const QString &extension, bool enable)
+    {
+        int lastCommented = -1;
+        int lastExtension = -1;
+        bool isEnabled    = false;
+
+        for (int i = 0; i < d->lines.size(); ++i) {
+            const Directive &directive = d->lines.at(i).directive;
+            if (directive.key != "extension" && directive.key != "zend_extension") {
+                continue;
+            }
+            if (directive.key == "extension") {
+                lastExtension = i;
+            }
+            if (extensionName(directive.value).compare(extension, Qt::CaseInsensitive) != 0) {
+                continue;
+            }
+
+            if (directive.commented) {
+                lastCommented = i;
+            } else if (enable) {
+                isEnabled = true;
+            } else {
+                PhpIniLine &line         = d->lines[i];
+                line.directive.commented = true;
+                line.changed             = true;
+                line.text.prepend(';');
+            }
+        }
+
+        if (!enable || isEnabled) {
+            return;
+        }
+
+        if (lastCommented >= 0) {
+            PhpIniLine &line = d->lines[lastCommented];
+
+            // remove the semicolons and the whitespace after them, keep the indentation
+            int start = 0;
+            while (start < line.text.size() && (line.text.at(start) == ' ' || line.text.at(start) == '\t')) {
+                ++start;
+            }
+            int end = start;
+            while (end < line.text.size() &&
+                   (line.text.at(end) == ';' || line.text.at(end) == ' ' || line.text.at(end) == '\t')) {
+                ++end;
+            }
+            line.text.remove(start, end - start);
+            line.directive.commented = false;
+            line.changed             = true;
+            return;
+        }
+
+        if (lastExtension < 0) {
+            setValue("PHP", "extension", extension);
+            return;
+        }
+
+        const PhpIniLine &anchor = d->lines.at(lastExtension);
+        const qint64 insertAt =
+            anchor.directive.offset >= 0 ? anchor.directive.offset + anchor.directive.length : anchor.insertAt;
+        d->lines.append(PhpIniLine{Directive{anchor.directive.section, "extension", extension, false, -1, 0},
+                                   QString("extension=%1").arg(extension).toUtf8(), true, insertAt});
+    }
+
+    /**
+     * Writes the edits: only the changed lines are replaced and the new lines inserted,
+     * everything else is copied as it is.
+     */
+    bool PhpIni::save(QString *errorMessage)
+    {
+        if (!isModified()) {
+            return true;
+        }
+
+        struct Edit
+        {
+            qint64 offset;
+            qint64 length;
+            QByteArray text;
+        };
+
+        // new lines are grouped by their position, in the order they were added
+        QVector<Edit> edits;
+        QHash<qint64, int> insertions;
+        const bool endsWithNewline = d->content.endsWith('\n');
+
+        for (const PhpIniLine &line : d->lines) {
+            if (!line.changed) {
+                continue;
+            }
+            if (line.directive.offset >= 0) {
+                edits.append(Edit{line.directive.offset, line.directive.length, line.text});
+                continue;
+            }
+
+            // at the end of a file with a final newline, the line is appended after it
+            const bool atEnd      = line.insertAt == d->content.size() && endsWithNewline;
+            const QByteArray text = atEnd ? line.text + d->newline : d->newline + line.text;
+            if (insertions.contains(line.insertAt)) {
+                edits[insertions.value(line.insertAt)].text.append(text);
+            } else {
+                insertions.insert(line.insertAt, edits.size());
+                edits.append(Edit{line.insertAt, 0, text});
+            }
+        }
+
+        std::stable_sort(edits.begin(), edits.end(), [](const Edit &a, const Edit &b) { return a.offset < b.offset; });
+
+        QByteArray content;
+        content.reserve(d->content.size() + 256);
+        qint64 position = 0;
+        for (const Edit &edit : edits) {
+            content.append(d->content.constData() + position, static_cast<int>(edit.offset - position));
+            content.append(edit.text);
+            position = edit.offset + edit.length;
+        }
+        content.append(d->content.constData() + position, static_cast<int>(d->content.size() - position));
+
+        QSaveFile file(d->fileName);
+        if (!file.open(QIODevice::WriteOnly) || file.write(content) != content.size() || !file.commit()) {
+            if (errorMessage) {
+                *errorMessage = QString("Could not write %1: %2").arg(d->fileName, file.errorString());
+            }
+            qDebug() << "[PhpIni] Could not write" << d->fileName << file.errorString();
+            return false;
+        }
+
+        qDebug() << "[PhpIni] Saved" << edits.size() << "edits to" << d->fileName;
+
+        const QFileInfo info(d->fileName);
+        d->content  = content;
+        d->size     = info.size();
+        d->modified = info.lastModified().toMSecsSinceEpoch();
+        d->valid    = true;
+        parse();
+
+        QMutexLocker lock(&cacheMutex);
+        cache().insert(d->fileName, *this);
+        return true;
+    }
+
+    /**
+     * "php_xdebug.dll", "C:\php\ext\php_xdebug.dll" and "xdebug" are all "xdebug".
+     */
+    QString PhpIni::extensionName(const QString &value)
+    {
+        QString name = QFileInfo(value).fileName();
+        if (name.endsWith(".dll", Qt::CaseInsensitive) || name.endsWith(".so", Qt::CaseInsensitive)) {
+            name = name.section('.', 0, -2);
+        }
+        if (name.startsWith("php_", Qt::CaseInsensitive)) {
+            name = name.mid(4);
+        }
+        return name;
+    }
+
+    void PhpIni::parse()
+    {
+        static const QRegExp validKey("[A-Za-z_][A-Za-z0-9_.\\-]*");
+
+        d->lines.clear();
+        d->sections.clear();
+        d->newline = d->content.contains("\r\n") ? QByteArray("\r\n") : QByteArray("\n");
+
+        const QByteArray &content = d->content;
+        QString section;
+        qint64 position = 0;
+
+        while (position < content.size()) {
+            qint64 end = content.indexOf('\n', static_cast<int>(position));
+            if (end < 0) {
+                end = content.size();
+            }
+            qint64 lineEnd = end;
+            if (lineEnd > position && content.at(static_cast<int>(lineEnd - 1)) == '\r') {
+                --lineEnd;
+            }
+
+            const QByteArray raw = content.mid(static_cast<int>(position), static_cast<int>(lineEnd - position));
+            const QString text   = QString::fromUtf8(raw).trimmed();
+
+            if (text.startsWith('[') && text.endsWith(']')) {
+                section = text.mid(1, text.size() - 2).trimmed();
+                d->sections.append(PhpIniSection{section, lineEnd});
+            } else if (!text.isEmpty()) {
+                const bool commented = text.startsWith(';');
+
+                QString body = text;
+                while (body.startsWith(';')) {
+                    body = body.mid(1).trimmed();
+                }
+
+                const int equals  = body.indexOf('=');
+                const QString key = body.left(equals).trimmed();
+                if (equals > 0 && QRegExp(validKey).exactMatch(key)) {
+                    QString value = body.mid(equals + 1).trimmed();
+                    if (value.startsWith('"')) {
+                        value = value.mid(1).section('"', 0, 0);
+                    } else {
+                        value = value.section(';', 0, 0).trimmed();
+                    }
+
+                    d->lines.append(PhpIniLine{Directive{section, key, value, commented, position, lineEnd - position},
+                                               raw, false, -1});
+                    if (!d->sections.isEmpty()) {
+                        d->sections.last().end = lineEnd;
+                    }
+                }
+            }
+
+            position = end + 1;
+        }
+    }
+} // namespace File
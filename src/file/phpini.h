@@ -0,0 +1,87 @@
+#ifndef PHPINI_H
+#define PHPINI_H
+
+#include <QByteArray>
+#include <QSharedDataPointer>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+namespace File
+{
+    class PhpIniData;
+
+    /**
+     * PhpIni - A model of "php.ini".
+     *
+     * The file is parsed once into sections, directives and commented-out directives
+     * (";extension=xdebug"). Every directive knows the byte offset and length of its line.
+     *
+     * PhpIni is implicitly shared: copies are cheap, all readers share one parsed file,
+     * an edit detaches the editing copy only (copy-on-write). Use shared() to get the
+     * parsed file, it is parsed again only when the file changed on disk.
+     *
+     * Edits are collected and applied by save(): each edit replaces or inserts one line
+     * at its offset, the rest of the file is written as it was (comments, order, line endings).
+     *
+     * PHP does not scope directives by section, so directives are looked up by key;
+     * the section is only used to place a new directive.
+     *
+     * // Reader
+     *
+     * PhpIni ini = PhpIni::shared("bin/php/php.ini");
+     * QString memoryLimit = ini.value("memory_limit");
+     * QStringList extensions = ini.enabledExtensions();
+     *
+     * // Writer
+     *
+     * ini.setExtensionEnabled("xdebug", true);
+     * ini.setValue("xdebug", "xdebug.remote_port", "9000");
+     * ini.save();
+     */
+    class PhpIni
+    {
+    public:
+        struct Directive
+        {
+            QString section;
+            QString key;
+            QString value;
+            bool commented;
+            qint64 offset; // byte offset of the line, -1 for a directive, which is not saved yet
+            qint64 length; // byte length of the line, without line ending
+        };
+
+        PhpIni();
+        PhpIni(const PhpIni &other);
+        ~PhpIni();
+        PhpIni &operator=(const PhpIni &other);
+
+        static PhpIni load(const QString &fileName);
+        static PhpIni shared(const QString &fileName);
+
+        bool isValid() const;
+        bool isModified() const;
+        QString fileName() const;
+
+        QVector<Directive> directives() const;
+        QStringList sections() const;
+        QString value(const QString &key, const QString &defaultValue = QString()) const;
+        QStringList values(const QString &key) const;
+        QStringList enabledExtensions() const;
+
+        void setValue(const QString &section, const QString &key, const QString &value);
+        void setExtensionEnabled(const QString &extension, bool enable);
+
+        bool save(QString *errorMessage = nullptr);
+
+        static QString extensionName(const QString &value);
+
+    private:
+        void parse();
+
+        QSharedDataPointer<PhpIniData> d;
+    };
+} // namespace File
+
+#endif // PHPINI_H
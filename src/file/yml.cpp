@@ -1,7 +1,9 @@
 #include "src/file/yml.h"
 
-#include <iostream>
+#include <cstring>
 #include <fstream>
+#include <iostream>
+#include <limits>
 
 namespace YAML
 {
@@ -25,8 +27,128 @@ namespace YAML
         }
     }
 
-    const QRegExp _yamlScalarTrueValues  = QRegExp("true|True|TRUE|on|On|ON");
-    const QRegExp _yamlScalarFalseValues = QRegExp("false|False|FALSE|off|Off|OFF");
+    /**
+     * Scalar classification works directly on the raw scalar bytes of the node.
+     * It matches the same literals as the former regular expressions:
+     *
+     *   bool  : true|True|TRUE|on|On|ON and false|False|FALSE|off|Off|OFF
+     *   int   : [-+]?\d+
+     *   float : [-+]?\d*\.?\d+
+     *
+     * Everything else is returned as a string.
+     */
+    enum class ScalarType
+    {
+        String,
+        True,
+        False,
+        Integer,
+        Float
+    };
+
+    static inline bool isDigit(char c) { return static_cast<unsigned char>(c - '0') < 10; }
+
+    static inline bool equalsOneOf(const char *s, size_t n, const char *a, const char *b, const char *c)
+    {
+        return memcmp(s, a, n) == 0 || memcmp(s, b, n) == 0 || memcmp(s, c, n) == 0;
+    }
+
+    static ScalarType classifyBool(const char *s, size_t n)
+    {
+        // dispatch on the length first, so that only one keyword group is compared
+        switch (n) {
+        case 2:
+            return equalsOneOf(s, n, "on", "On", "ON") ? ScalarType::True : ScalarType::String;
+        case 3:
+            return equalsOneOf(s, n, "off", "Off", "OFF") ? ScalarType::False : ScalarType::String;
+        case 4:
+            return equalsOneOf(s, n, "true", "True", "TRUE") ? ScalarType::True : ScalarType::String;
+        case 5:
+            return equalsOneOf(s, n, "false", "False", "FALSE") ? ScalarType::False : ScalarType::String;
+        default:
+            return ScalarType::String;
+        }
+    }
+
+    static ScalarType classifyNumber(const char *s, size_t n)
+    {
+        size_t i = 0;
+
+        if (i < n && (s[i] == '-' || s[i] == '+')) {
+            ++i;
+        }
+
+        const size_t intStart = i;
+        while (i < n && isDigit(s[i])) {
+            ++i;
+        }
+
+        if (i == n) {
+            return (i > intStart) ? ScalarType::Integer : ScalarType::String;
+        }
+
+        if (s[i] != '.') {
+            return ScalarType::String;
+        }
+        ++i;
+
+        const size_t fractionStart = i;
+        while (i < n && isDigit(s[i])) {
+            ++i;
+        }
+
+        return (i == n && i > fractionStart) ? ScalarType::Float : ScalarType::String;
+    }
+
+    static ScalarType classifyScalar(const char *s, size_t n)
+    {
+        if (n == 0) {
+            return ScalarType::String;
+        }
+
+        // numbers start with a sign, a digit or a dot. everything else might be a bool keyword.
+        const char c = s[0];
+        if (isDigit(c) || c == '-' || c == '+' || c == '.') {
+            return classifyNumber(s, n);
+        }
+
+        return classifyBool(s, n);
+    }
+
+    static QVariant integerToVariant(const char *s, size_t n)
+    {
+        size_t i      = 0;
+        bool negative = false;
+
+        if (s[0] == '-' || s[0] == '+') {
+            negative = (s[0] == '-');
+            ++i;
+        }
+
+        // accumulate as negative number, because the negative range is one larger
+        qint64 value = 0;
+        for (; i < n; ++i) {
+            const int digit = s[i] - '0';
+            if (value < (std::numeric_limits<qint64>::min() + digit) / 10) {
+                // does not fit into 64 bit
+                return QVariant(QByteArray::fromRawData(s, static_cast<int>(n)).toDouble());
+            }
+            value = value * 10 - digit;
+        }
+
+        if (!negative) {
+            if (value == std::numeric_limits<qint64>::min()) {
+                return QVariant(QByteArray::fromRawData(s, static_cast<int>(n)).toDouble());
+            }
+            value = -value;
+        }
+
+        if (value >= std::numeric_limits<int>::min() && value <= std::numeric_limits<int>::max()) {
+            return QVariant(static_cast<int>(value));
+        }
+
+        return QVariant(static_cast<qlonglong>(value));
+    }
 
     QVariant yamlToVariant(const YAML::Node &node)
     {
@@ -48,22 +170,31 @@ namespace YAML
 
     QVariant yamlScalarToVariant(const YAML::Node &scalarNode)
     {
-        std::string stdScalar = scalarNode.as<std::string>();
-        QString scalarString  = QString::fromStdString(stdScalar);
-        if (_yamlScalarTrueValues.exactMatch(scalarString))
+        // reference the scalar, instead of copying it via as<std::string>()
+        const std::string &scalar = scalarNode.Scalar();
+        const char *s             = scalar.data();
+        const size_t n            = scalar.size();
+
+        switch (classifyScalar(s, n)) {
+        case ScalarType::True:
             return QVariant(true);
-        if (_yamlScalarFalseValues.exactMatch(scalarString))
+        case ScalarType::False:
             return QVariant(false);
-        if (QRegExp("[-+]?\\d+").exactMatch(scalarString))
-            return QVariant(scalarString.toInt());
-        if (QRegExp(R"([-+]?\d*\.?\d+)").exactMatch(scalarString))
-            return QVariant(scalarString.toDouble());
-        return QVariant(scalarString);
+        case ScalarType::Integer:
+            return integerToVariant(s, n);
+        case ScalarType::Float:
+            return QVariant(QByteArray::fromRawData(s, static_cast<int>(n)).toDouble());
+        case ScalarType::String:
+            break;
+        }
+
+        return QVariant(QString::fromUtf8(s, static_cast<int>(n)));
     }
 
     QVariant yamlSequenceToVariant(const YAML::Node &sequenceNode)
     {
         QVariantList vl;
+        vl.reserve(static_cast<int>(sequenceNode.size()));
         for (YAML::const_iterator it = sequenceNode.begin(); it != sequenceNode.end(); ++it) {
             vl << yamlToVariant(*it);
         }
@@ -74,7 +205,8 @@ namespace YAML
     {
         QVariantMap vm;
         for (YAML::const_iterator it = mapNode.begin(); it != mapNode.end(); ++it) {
-            vm.insert(QString::fromStdString(it->first.as<std::string>()), yamlToVariant(it->second));
+            const std::string &key = it->first.Scalar();
+            vm.insert(QString::fromUtf8(key.data(), static_cast<int>(key.size())), yamlToVariant(it->second));
         }
         return vm;
     }
@@ -1,20 +1,7 @@
 #ifndef HOST_H
 #define HOST_H
 
-// Windows / C++
-#include <Windows.h>
-#include <shellapi.h>
-#include <stdlib.h>
-#include <string>
-
-#include <QDir>
-#include <QFile>
-#include <QList>
 #include <QString>
-#include <QStringList>
-#include <QTemporaryFile>
-#include <QTextStream>
-#include <QThread>
 
 namespace HostsFileManager
 {
@@ -22,10 +9,7 @@ namespace HostsFileManager
     {
     public:
         explicit Host();
-        explicit Host(QString name, QString address);
-
-        static QList<Host *> GetHosts();
-        static void SetHosts(QList<Host *> listHosts);
+        explicit Host(const QString &name, const QString &address);
 
         QString name;
         QString address;
@@ -35,7 +19,6 @@ namespace HostsFileManager
         bool operator==(const Host &host) const;
 
     private:
-        static QString getHostFile();
         // bool m_bIsEnable;
     };
 } // namespace HostsFileManager
@@ -15,8 +15,9 @@ namespace HostsFileManager
         QPushButton *btnOk = new QPushButton(QApplication::style()->standardIcon(QStyle::SP_VistaShield), "OK", this);
         QPushButton *btnCancel = new QPushButton("Cancel", this);
 
-        auto *tableModel = new HostsTableModel(this);
-        tableModel->setList(Host::GetHosts());
+        // parse the hosts file once, the model reads from this store
+        hostsFile.load();
+        tableModel = new HostsTableModel(&hostsFile, this);
 
         tableView = new QTableView(this);
         tableView->setModel(tableModel);
@@ -26,6 +27,10 @@ namespace HostsFileManager
         tableView->setEditTriggers(QAbstractItemView::NoEditTriggers);
         tableView->setSelectionMode(QAbstractItemView::SingleSelection);
         tableView->setMinimumWidth(300);
+        // fixed row heights: the view never measures rows, which keeps it fast for 100k+ entries
+        tableView->setWordWrap(false);
+        tableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+        tableView->verticalHeader()->setDefaultSectionSize(tableView->fontMetrics().height() + 6);
 
         auto *gLayout = new QGridLayout;
         gLayout->addWidget(toolbar, 0, 0);
@@ -51,11 +56,7 @@ namespace HostsFileManager
         setFixedWidth(400);
     }
 
-    HostsManagerDialog::~HostsManagerDialog()
-    {
-        auto *model = dynamic_cast<HostsTableModel *>(tableView->model());
-        qDeleteAll(model->getList());
-    }
+    HostsManagerDialog::~HostsManagerDialog() {}
 
     void HostsManagerDialog::addEntry()
     {
@@ -65,18 +66,12 @@ namespace HostsFileManager
             QString name    = aDialog.name();
             QString address = aDialog.address();
 
-            auto *model = dynamic_cast<HostsTableModel *>(tableView->model());
-            QList<Host *> list     = model->getList();
-
             // do the add
-            Host host(name, address);
-            if (!list.contains(&host)) {
-                model->insertRows(0, 1, QModelIndex());
-
-                QModelIndex index = model->index(0, HostsTableModel::COLUMN_NAME, QModelIndex());
-                model->setData(index, name, Qt::EditRole);
-                index = model->index(0, HostsTableModel::COLUMN_ADDRESS, QModelIndex());
-                model->setData(index, address, Qt::EditRole);
+            int row = tableModel->addHost(Host(name, address));
+            if (row >= 0) {
+                QModelIndex index = tableModel->index(row, HostsTableModel::COLUMN_NAME, QModelIndex());
+                tableView->scrollTo(index);
+                tableView->selectRow(row);
             } else {
                 QMessageBox::information(this, tr("Duplicate Entry"), tr("The host mapping already exists."));
             }
@@ -135,8 +130,7 @@ namespace HostsFileManager
 
     void HostsManagerDialog::accept()
     {
-        auto *model = dynamic_cast<HostsTableModel *>(tableView->model());
-        Host::SetHosts(model->getList());
+        hostsFile.saveElevated();
         QDialog::accept();
     }
 }
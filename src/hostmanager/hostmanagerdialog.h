@@ -3,6 +3,7 @@
 
 #include "adddialog.h"
 #include "host.h"
+#include "hostsfile.h"
 #include "hosttablemodel.h"
 
 #include <QApplication>
@@ -36,6 +37,8 @@ namespace HostsFileManager
 
     private:
         QTableView *tableView;
+        HostsTableModel *tableModel;
+        HostsFile hostsFile;
     };
 }
 
@@ -0,0 +1,446 @@
+#include "hostsfile.h"
+
+// Windows / C++
+#include <Windows.h>
+#include <shellapi.h>
+#include <stdlib.h>
+#include <string>
+
+#include <algorithm>
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QStringList>
+#include <QTemporaryFile>
+
+namespace HostsFileManager
+{
+    HostsFile::HostsFile() {}
+
+    bool HostsFile::load(const QString &fileName)
+    {
+        file = fileName;
+
+        content.clear();
+        lines.clear();
+        entries.clear();
+        rows.clear();
+        index.clear();
+        addresses.clear();
+        duplicateCount = 0;
+
+        QFile hostFile(fileName);
+        if (!hostFile.open(QFile::ReadOnly)) {
+            qDebug() << "[HostsFile] Could not open" << fileName;
+            return false;
+        }
+
+        // read the whole file at once and index the lines in place
+        content = hostFile.readAll();
+        hostFile.close();
+
+        const char *data = content.constData();
+        const int size   = content.size();
+
+        // a rough guess of ~32 bytes per line avoids most reallocations
+        lines.reserve(size / 32 + 1);
+        entries.reserve(size / 32 + 1);
+        rows.reserve(size / 32 + 1);
+        index.reserve(size / 32 + 1);
+
+        int lineStart = 0;
+        for (int i = 0; i <= size; ++i) {
+            if (i == size || data[i] == '\n') {
+                int lineEnd = i;
+                if (lineEnd > lineStart && data[lineEnd - 1] == '\r') {
+                    --lineEnd;
+                }
+                // skip the empty tail after the final newline
+                if (i < size || lineEnd > lineStart) {
+                    parseLine(data, lineStart, lineEnd - lineStart);
+                }
+                lineStart = i + 1;
+            }
+        }
+
+        qDebug() << "[HostsFile] Loaded" << entries.size() << "entries," << duplicates().size() << "duplicates from"
+                 << fileName;
+
+        return true;
+    }
+
+    void HostsFile::parseLine(const char *data, int offset, int length)
+    {
+        Line line;
+        line.offset     = offset;
+        line.length        = length;
+        line.commentOffset = -1;
+        line.isHostLine    = false;
+
+        const int lineNumber = lines.size();
+
+        const char *p   = data + offset;
+        const char *end = p + length;
+
+        // tokenize: address, followed by 1..n hostnames, optionally followed by a "#" comment
+        const char *addressStart = nullptr;
+        int addressLength        = 0;
+        QStringList names;
+
+        while (p < end) {
+            while (p < end && (*p == ' ' || *p == '\t')) {
+                ++p;
+            }
+            if (p == end) {
+                break;
+            }
+            if (*p == '#') {
+                line.commentOffset = static_cast<int>(p - data);
+                break;
+            }
+            const char *tokenStart = p;
+            while (p < end && *p != ' ' && *p != '\t' && *p != '#') {
+                ++p;
+            }
+            if (addressStart == nullptr) {
+                addressStart  = tokenStart;
+                addressLength = static_cast<int>(p - tokenStart);
+            } else {
+                names << QString::fromUtf8(tokenStart, static_cast<int>(p - tokenStart));
+            }
+        }
+
+        // comments, blank lines and lines without a hostname are kept verbatim
+        if (!names.isEmpty()) {
+            line.isHostLine = true;
+
+            QString address = internAddress(addressStart, addressLength);
+            for (const QString &name : names) {
+                Host host;
+                host.address = address;
+                host.name    = name;
+                insertEntry(host, lineNumber);
+            }
+        }
+
+        lines.append(line);
+    }
+
+    QString HostsFile::internAddress(const char *data, int length)
+    {
+        // most lines of a blocklist share the same address, e.g. "0.0.0.0"
+        const QByteArray key = QByteArray::fromRawData(data, length);
+
+        auto it = addresses.constFind(key);
+        if (it != addresses.constEnd()) {
+            return it.value();
+        }
+
+        QString address = QString::fromLatin1(data, length);
+        addresses.insert(QByteArray(data, length), address);
+        return address;
+    }
+
+    void HostsFile::insertEntry(const Host &host, int line)
+    {
+        Entry entry;
+        entry.host      = host;
+        entry.line      = line;
+        entry.modified  = false;
+        entry.removed   = false;
+        entry.duplicate = false;
+
+        const int id = entries.size();
+
+        // the resolver uses the first mapping of a hostname, later ones are duplicates
+        auto it = index.constFind(host.name);
+        if (it != index.constEnd()) {
+            entry.duplicate = true;
+            ++duplicateCount;
+        } else {
+            index.insert(host.name, id);
+        }
+
+        entries.append(entry);
+        rows.append(id);
+    }
+
+    bool HostsFile::save(const QString &fileName) const
+    {
+        QFile out(fileName);
+        if (!out.open(QFile::WriteOnly | QFile::Truncate)) {
+            qDebug() << "[HostsFile] Could not open" << fileName << "for writing.";
+            return false;
+        }
+
+        const char *data = content.constData();
+
+        // stream the output in chunks, instead of building the whole file in memory
+        const int chunkSize = 64 * 1024;
+        QByteArray buffer;
+        buffer.reserve(chunkSize + 1024);
+
+        auto flush = [&out, &buffer, chunkSize](bool force) {
+            if (force || buffer.size() >= chunkSize) {
+                out.write(buffer);
+                buffer.resize(0);
+            }
+        };
+
+        auto writeEntry = [&buffer](const Host &host, const char *comment = nullptr, int commentLength = 0) {
+            buffer.append(host.address.toLatin1());
+            buffer.append("       ");
+            buffer.append(host.name.toUtf8());
+            if (commentLength > 0) {
+                buffer.append(' ');
+                buffer.append(comment, commentLength);
+            }
+            buffer.append("\r\n");
+        };
+
+        // entries of loaded lines are stored in line order, so one cursor walks along
+        int e = 0;
+
+        for (int l = 0; l < lines.size(); ++l) {
+            const Line &line = lines.at(l);
+
+            if (!line.isHostLine) {
+                buffer.append(data + line.offset, line.length);
+                buffer.append("\r\n");
+                flush(false);
+                continue;
+            }
+
+            // find the entries of this line and check, if any of them changed
+            const int first = e;
+            bool changed    = false;
+            while (e < entries.size() && entries.at(e).line == l) {
+                changed |= entries.at(e).modified || entries.at(e).removed;
+                ++e;
+            }
+
+            if (!changed) {
+                buffer.append(data + line.offset, line.length);
+                buffer.append("\r\n");
+            } else {
+                // the line is split into one line per entry, its trailing comment goes with the first one
+                const char *comment = nullptr;
+                int commentLength   = 0;
+                if (line.commentOffset >= 0) {
+                    comment       = data + line.commentOffset;
+                    commentLength = line.offset + line.length - line.commentOffset;
+                }
+
+                for (int i = first; i < e; ++i) {
+                    if (!entries.at(i).removed) {
+                        writeEntry(entries.at(i).host, comment, commentLength);
+                        commentLength = 0;
+                    }
+                }
+
+                // all entries of the line were removed, keep the comment on its own
+                if (commentLength > 0) {
+                    buffer.append(comment, commentLength);
+                    buffer.append("\r\n");
+                }
+            }
+
+            flush(false);
+        }
+
+        // append the new entries
+        bool separatorWritten = false;
+        for (; e < entries.size(); ++e) {
+            const Entry &entry = entries.at(e);
+            if (entry.removed) {
+                continue;
+            }
+            if (!separatorWritten) {
+                buffer.append("\r\n");
+                separatorWritten = true;
+            }
+            writeEntry(entry.host);
+            flush(false);
+        }
+
+        flush(true);
+        out.close();
+
+        return out.error() == QFile::NoError;
+    }
+
+    bool HostsFile::saveElevated() const
+    {
+        QTemporaryFile tempFile;
+        tempFile.setAutoRemove(false);
+        if (!tempFile.open()) {
+            return false;
+        }
+        tempFile.close();
+
+        if (!save(tempFile.fileName())) {
+            return false;
+        }
+
+        // Copy content of tempfile to host file
+        QString strHostFile = QDir::toNativeSeparators(file);
+        QString strTempFile = QDir::toNativeSeparators(tempFile.fileName());
+
+        QString strArguments = "/c copy /y \"" + strTempFile + "\" \"" + strHostFile + "\"";
+        std::wstring tmp     = strArguments.toStdWString();
+        LPCTSTR wcArguments  = tmp.c_str();
+
+        SHELLEXECUTEINFO shExecInfo;
+        shExecInfo.cbSize       = sizeof(SHELLEXECUTEINFO);
+        shExecInfo.fMask        = 0;
+        shExecInfo.hwnd         = nullptr;
+        shExecInfo.lpVerb       = L"runas";
+        shExecInfo.lpFile       = L"cmd.exe";
+        shExecInfo.lpParameters = wcArguments;
+        shExecInfo.lpDirectory  = nullptr;
+        shExecInfo.nShow        = SW_MAXIMIZE;
+        shExecInfo.hInstApp     = nullptr;
+
+        return ShellExecuteEx(&shExecInfo);
+    }
+
+    int HostsFile::count() const { return rows.size(); }
+
+    const Host &HostsFile::at(int row) const { return entries.at(rows.at(row)).host; }
+
+    bool HostsFile::isDuplicate(int row) const { return entries.at(rows.at(row)).duplicate; }
+
+    int HostsFile::indexOf(const QString &name) const
+    {
+        auto it = index.constFind(name);
+        if (it == index.constEnd()) {
+            return -1;
+        }
+        // rows are in entry order, so the row can be found by binary search
+        auto row = std::lower_bound(rows.constBegin(), rows.constEnd(), it.value());
+        return static_cast<int>(row - rows.constBegin());
+    }
+
+    bool HostsFile::contains(const QString &name) const { return index.contains(name); }
+
+    QStringList HostsFile::duplicates() const
+    {
+        QStringList list;
+        for (const Entry &entry : entries) {
+            if (entry.duplicate && !entry.removed) {
+                list << entry.host.name;
+            }
+        }
+        return list;
+    }
+
+    int HostsFile::add(const Host &host)
+    {
+        if (host.name.isEmpty() || contains(host.name)) {
+            return -1;
+        }
+
+        insertEntry(host, -1);
+        return rows.size() - 1;
+    }
+
+    bool HostsFile::setName(int row, const QString &name)
+    {
+        Entry &entry = entries[rows.at(row)];
+
+        if (entry.host.name == name) {
+            return true;
+        }
+        if (name.isEmpty() || contains(name)) {
+            return false;
+        }
+
+        const QString oldName = entry.host.name;
+        entry.host.name       = name;
+        entry.modified        = true;
+        index.insert(name, rows.at(row));
+
+        // the new name is unique, a renamed duplicate is the effective mapping of it
+        if (entry.duplicate) {
+            entry.duplicate = false;
+            --duplicateCount;
+        }
+
+        reindexName(oldName);
+        return true;
+    }
+
+    bool HostsFile::setAddress(int row, const QString &address)
+    {
+        Entry &entry = entries[rows.at(row)];
+
+        if (entry.host.address != address) {
+            entry.host.address = address;
+            entry.modified     = true;
+        }
+        return true;
+    }
+
+    void HostsFile::remove(int row)
+    {
+        Entry &entry  = entries[rows.at(row)];
+        entry.removed = true;
+        rows.remove(row);
+
+        if (entry.duplicate) {
+            entry.duplicate = false;
+            --duplicateCount;
+        }
+
+        reindexName(entry.host.name);
+    }
+
+    /**
+     * Points the index for "name" to the first remaining entry with that name.
+     * This is needed after an entry was renamed or removed,
+     * because a former duplicate might now be the effective mapping.
+     */
+    void HostsFile::reindexName(const QString &name)
+    {
+        auto it = index.find(name);
+        if (it != index.end()) {
+            const Entry &indexed = entries.at(it.value());
+            if (!indexed.removed && indexed.host.name == name) {
+                return;
+            }
+            index.erase(it);
+        }
+
+        if (duplicateCount == 0) {
+            return;
+        }
+
+        for (int id = 0; id < entries.size(); ++id) {
+            Entry &candidate = entries[id];
+            if (!candidate.removed && candidate.duplicate && candidate.host.name == name) {
+                candidate.duplicate = false;
+                --duplicateCount;
+                index.insert(name, id);
+                return;
+            }
+        }
+    }
+
+    QString HostsFile::fileName() const { return file; }
+
+    QString HostsFile::getDefaultFileName()
+    {
+        QString windir;
+
+        // "getenv("windir") is deprecated, use _dupenv_s"
+        char *buf = nullptr;
+        size_t sz = 0;
+        if (_dupenv_s(&buf, &sz, "windir") == 0 && buf != nullptr) {
+            windir = buf;
+            free(buf);
+        }
+
+        return windir + "\\System32\\drivers\\etc\\hosts";
+    }
+} // namespace HostsFileManager
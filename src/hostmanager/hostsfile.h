@@ -0,0 +1,84 @@
+#ifndef HOSTSFILE_H
+#define HOSTSFILE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "host.h"
+
+namespace HostsFileManager
+{
+    /**
+     * HostsFile is an indexed in-memory store for the entries of a hosts file.
+     *
+     * The file is parsed once. Every entry is indexed by hostname, which makes
+     * lookups and the duplicate check O(1), even for blocklist hosts files
+     * with several 100k lines.
+     *
+     * Comments, blank lines and untouched host lines are kept as offsets into the
+     * original file content. save() writes them back verbatim together with the
+     * modified and added entries in one streamed pass.
+     */
+    class HostsFile
+    {
+    public:
+        HostsFile();
+
+        bool load(const QString &fileName = getDefaultFileName());
+        bool save(const QString &fileName) const;
+        bool saveElevated() const;
+
+        int count() const;
+        const Host &at(int row) const;
+        bool isDuplicate(int row) const;
+
+        int indexOf(const QString &name) const;
+        bool contains(const QString &name) const;
+        QStringList duplicates() const;
+
+        int add(const Host &host);
+        bool setName(int row, const QString &name);
+        bool setAddress(int row, const QString &address);
+        void remove(int row);
+
+        QString fileName() const;
+        static QString getDefaultFileName();
+
+    private:
+        struct Line
+        {
+            int offset;
+            int length;
+            int commentOffset; // start of the trailing "#" comment, -1 if there is none
+            bool isHostLine;
+        };
+
+        struct Entry
+        {
+            Host host;
+            int line; // -1 for entries added after loading
+            bool modified;
+            bool removed;
+            bool duplicate;
+        };
+
+        void parseLine(const char *data, int offset, int length);
+        void insertEntry(const Host &host, int line);
+        void reindexName(const QString &name);
+        QString internAddress(const char *data, int length);
+
+        QString file;
+        QByteArray content;
+        QVector<Line> lines;
+        QVector<Entry> entries; // all entries in file order, added entries at the end
+        QVector<int> rows; // visible row => entry id
+        QHash<QString, int> index; // hostname => entry id of the first (effective) entry
+        QHash<QByteArray, QString> addresses; // shares one QString per distinct address
+        int duplicateCount = 0;
+    };
+} // namespace HostsFileManager
+
+#endif // HOSTSFILE_H
@@ -1,13 +1,20 @@
 #include "hosttablemodel.h"
 
+#include <QBrush>
+
 namespace HostsFileManager
 {
-    HostsTableModel::HostsTableModel(QObject *parent) : QAbstractTableModel(parent) {}
+    HostsTableModel::HostsTableModel(HostsFile *hostsFile, QObject *parent)
+        : QAbstractTableModel(parent), hostsFile(hostsFile)
+    {
+    }
 
     int HostsTableModel::rowCount(const QModelIndex &parent) const
     {
-        Q_UNUSED(parent);
-        return listHosts.size();
+        if (parent.isValid())
+            return 0;
+
+        return hostsFile->count();
     }
 
     int HostsTableModel::columnCount(const QModelIndex &parent) const
@@ -21,10 +28,10 @@ namespace HostsFileManager
         if (!index.isValid())
             return QVariant();
 
-        if (index.row() >= listHosts.size() || index.row() < 0)
+        if (index.row() >= hostsFile->count() || index.row() < 0)
             return QVariant();
 
-        Host *host = listHosts.at(index.row());
+        const Host &host = hostsFile->at(index.row());
 
         /*
   if (role == Qt::CheckStateRole){
@@ -36,11 +43,20 @@ namespace HostsFileManager
         if (role == Qt::DisplayRole) {
             switch (index.column()) {
             case COLUMN_ADDRESS:
-                return host->address;
+                return host.address;
             case COLUMN_NAME:
-                return host->name;
+                return host.name;
             }
         }
+
+        // a duplicate mapping is ignored by the resolver, highlight it
+        if (role == Qt::ForegroundRole && hostsFile->isDuplicate(index.row())) {
+            return QBrush(Qt::red);
+        }
+        if (role == Qt::ToolTipRole && hostsFile->isDuplicate(index.row())) {
+            return tr("Duplicate entry. The first mapping of \"%1\" is used.").arg(host.name);
+        }
+
         return QVariant();
     }
 
@@ -76,14 +92,15 @@ namespace HostsFileManager
         if (index.isValid() && role == Qt::EditRole) {
             int row = index.row();
 
-            Host *host = listHosts.value(row);
-
             switch (index.column()) {
             case COLUMN_ADDRESS:
-                host->address = value.toString();
+                hostsFile->setAddress(row, value.toString().trimmed());
                 break;
             case COLUMN_NAME:
-                host->name = value.toString();
+                // rejects a hostname, which is already mapped
+                if (!hostsFile->setName(row, value.toString().trimmed())) {
+                    return false;
+                }
                 break;
             default:
                 return false;
@@ -97,40 +114,37 @@ namespace HostsFileManager
         return false;
     }
 
-    bool HostsTableModel::insertRows(int position, int rows, const QModelIndex &index)
-    {
-        Q_UNUSED(index);
-        beginInsertRows(QModelIndex(), position, position + rows - 1);
-
-        for (int row = 0; row < rows; row++) {
-            auto *host = new Host();
-            listHosts.insert(position, host);
-        }
-
-        endInsertRows();
-        return true;
-    }
-
     bool HostsTableModel::removeRows(int position, int rows, const QModelIndex &index)
     {
         Q_UNUSED(index);
         beginRemoveRows(QModelIndex(), position, position + rows - 1);
 
         for (int row = 0; row < rows; ++row) {
-            Host *host = listHosts.takeAt(position);
-            delete host;
+            hostsFile->remove(position);
         }
 
         endRemoveRows();
         return true;
     }
 
-    void HostsTableModel::setList(QList<Host *> listHosts)
+    /**
+     * Adds a new host mapping to the end of the table.
+     * Returns the row of the new entry or -1, if the hostname is already mapped.
+     */
+    int HostsTableModel::addHost(const Host &host)
     {
-        listHosts        = listHosts;
-        QModelIndex root = index(0, 0);
-        emit(dataChanged(root, index(rowCount(QModelIndex()), columnCount(QModelIndex()))));
+        if (hostsFile->contains(host.name)) {
+            return -1;
+        }
+
+        const int row = hostsFile->count();
+
+        beginInsertRows(QModelIndex(), row, row);
+        hostsFile->add(host);
+        endInsertRows();
+
+        return row;
     }
 
-    QList<Host *> HostsTableModel::getList() { return listHosts; }
+    HostsFile *HostsTableModel::getHostsFile() const { return hostsFile; }
 } // namespace HostsFileManager
@@ -2,18 +2,22 @@
 #define HOSTTABLEMODEL_H
 
 #include <QAbstractTableModel>
-#include <QList>
 
-#include "host.h"
+#include "hostsfile.h"
 
 namespace HostsFileManager
 {
+    /**
+     * The model is a thin view over the HostsFile store.
+     * It does not copy any entries, rows are read from the store on demand,
+     * so the table stays responsive with very large hosts files.
+     */
     class HostsTableModel : public QAbstractTableModel
     {
         Q_OBJECT
 
     public:
-        explicit HostsTableModel(QObject *parent = 0);
+        explicit HostsTableModel(HostsFile *hostsFile, QObject *parent = 0);
 
         enum Columns
         {
@@ -27,18 +31,17 @@ namespace HostsFileManager
         QVariant headerData(int section, Qt::Orientation orientation, int role) const;
         Qt::ItemFlags flags(const QModelIndex &index) const;
         bool setData(const QModelIndex &index, const QVariant &value, int role = Qt::EditRole);
-        bool insertRows(int position, int rows, const QModelIndex &index = QModelIndex());
         bool removeRows(int position, int rows, const QModelIndex &index = QModelIndex());
 
-        void setList(QList<Host *> listHosts);
-        QList<Host *> getList();
+        int addHost(const Host &host);
+        HostsFile *getHostsFile() const;
 
     signals:
 
     public slots:
 
     private:
-        QList<Host *> listHosts;
+        HostsFile *hostsFile;
     };
 }
 
@@ -1,6 +1,7 @@
 #include "mainwindow.h"
 #include "ui_mainwindow.h"
 
+#include "file/nginxconfig.h"
 #include "file/yml.h"
 
 namespace ServerControlPanel
@@ -43,6 +44,9 @@ namespace ServerControlPanel
         ui->pushButton_Updater->hide();
 
         connect(this, SIGNAL(mainwindow_show()), this, SLOT(MainWindow_ShowEvent()));
+
+        connect(&nginxConfigWatcher, SIGNAL(fileChanged(QString)), this, SLOT(nginxConfigChanged()));
+        connect(&nginxConfigWatcher, SIGNAL(directoryChanged(QString)), this, SLOT(nginxConfigChanged()));
     }
 
     void MainWindow::setup()
@@ -71,6 +75,14 @@ namespace ServerControlPanel
             autostartServers();
         };
 
+        if (settings->get("dns/enabled", false).toBool()) {
+            startDnsResponder();
+        }
+
+        if (settings->get("nginx/vhosts", false).toBool()) {
+            startNginxVhosts();
+        }
+
         updateTrayIconTooltip();
         updateToolsPushButtons();
 
@@ -1108,6 +1120,96 @@ namespace ServerControlPanel
             servers->startRedis();
     }
 
+    /**
+     * Starts the loopback DNS responder, which resolves the local development zones
+     * (e.g. "*.test") without touching the hosts file.
+     *
+     * dns/zones is a comma separated list of "pattern" or "pattern=address" items.
+     */
+    void MainWindow::startDnsResponder()
+    {
+        dnsResponder = new DNS::Responder(this);
+
+        const QStringList zones = settings->get("dns/zones", "*.test").toString().split(",", QString::SkipEmptyParts);
+        for (const QString &zone : zones) {
+            const QString pattern = zone.section("=", 0, 0).trimmed();
+            const QString address = zone.section("=", 1, 1).trimmed();
+            dnsResponder->addZone(pattern, address.isEmpty() ? QHostAddress(QHostAddress::LocalHost)
+                                                             : QHostAddress(address));
+        }
+
+        const quint16 port = static_cast<quint16>(settings->get("dns/port", 53).toUInt());
+        if (!dnsResponder->start(QHostAddress::LocalHost, port)) {
+            QMessageBox::warning(this, tr("Warning"),
+                                 tr("The DNS responder could not listen on port %1.\n"
+                                    "Please check, if another DNS server is running.")
+                                     .arg(port));
+            return;
+        }
+
+        // the forwarder is "address" or "address:port", an IPv6 address with a port is written as "[address]:port"
+        const QString forwarder = settings->get("dns/forwarder", "").toString().trimmed();
+        if (!forwarder.isEmpty()) {
+            QString host = forwarder;
+            QString portText;
+
+            if (host.startsWith('[')) {
+                const int close = host.indexOf(']');
+                if (close > 0) {
+                    const QString rest = host.mid(close + 1);
+                    host               = host.mid(1, close - 1);
+                    portText           = rest.startsWith(':') ? rest.mid(1) : rest;
+                }
+            } else if (host.count(':') == 1) {
+                // more than one colon is a plain IPv6 address, e.g. "::1"
+                portText = host.section(":", 1, 1);
+                host     = host.section(":", 0, 0);
+            }
+
+            QHostAddress address;
+            bool isPortValid            = true;
+            const quint16 forwarderPort = portText.isEmpty() ? 53 : portText.toUShort(&isPortValid);
+
+            if (!address.setAddress(host) || !isPortValid || forwarderPort == 0) {
+                qDebug() << "[DNS] Invalid forwarder" << forwarder << ", unresolved names are not forwarded.";
+                return;
+            }
+
+            dnsResponder->setForwarder(address, forwarderPort);
+        }
+    }
+
+    /**
+     * Starts the vhost generator, which writes a "server {}" block per project in nginx/sites
+     * into "bin/nginx/conf/vhosts" and keeps them up to date, while projects are added or changed.
+     * nginx.conf includes them with "include vhosts/*.conf;" inside of the "http" block.
+     *
+     * nginx/vhostdomain is the domain of the projects ("<project>.test"),
+     * "bin/wpnxm-scp/nginx-vhost.tpl" replaces the default vhost template.
+     */
+    void MainWindow::startNginxVhosts()
+    {
+        const QString nginxConf = settings->get("nginx/config", QString("./bin/nginx/conf/nginx.conf")).toString();
+        const QStringList pools = File::NginxConfig::load(nginxConf).upstreams();
+
+        nginxVhosts = new Configuration::NginxVhosts(settings->get("nginx/sites", QString("./www")).toString(),
+                                                     QFileInfo(nginxConf).absolutePath() + "/vhosts", this);
+
+        if (QFile::exists("./bin/wpnxm-scp/nginx-vhost.tpl")) {
+            nginxVhosts->setTemplate("./bin/wpnxm-scp/nginx-vhost.tpl");
+        }
+        nginxVhosts->setDomain(settings->get("nginx/vhostdomain", QString("test")).toString());
+        nginxVhosts->setPort(getNginxPort());
+        if (!pools.isEmpty()) {
+            nginxVhosts->setUpstream(pools.first());
+        }
+
+        // several changed projects result in one reload
+        connect(nginxVhosts, SIGNAL(vhostsChanged(QStringList)), servers, SLOT(scheduleNginxReload()));
+
+        nginxVhosts->start();
+    }
+
     void MainWindow::setDefaultSettings()
     {
         // if the INI is not existing yet, set defaults, they will be written to file
@@ -1164,6 +1266,16 @@ namespace ServerControlPanel
             settings->set("selfupdater/interval", 7);
             settings->set("selfupdater/last_time_checked", 0);
 
+            settings->set("updater/maxconcurrentdownloads", 3);
+            settings->set("updater/bandwidthlimit", 0);
+            settings->set("updater/cachesize", 2048);
+            settings->set("updater/httpcachesize", 16);
+
+            settings->set("dns/enabled", 0);
+            settings->set("dns/port", 53);
+            settings->set("dns/zones", "*.test");
+            settings->set("dns/forwarder", "");
+
             qDebug() << "[Settings] Loaded Defaults...\n";
         }
     }
@@ -1483,7 +1595,7 @@ namespace ServerControlPanel
     {
         QString s = server.toLower();
         if (s == "nginx") {
-            return getNginxPort();
+            return getNginxPorts().join(", ");
         }
         if (s == "memcached") {
             return getMemcachedPort();
@@ -1553,7 +1665,50 @@ namespace ServerControlPanel
         }
     }
 
-    QString MainWindow::getNginxPort() { return settings->get("nginx/port").toString(); }
+    /**
+     * Returns the first port Nginx listens on, read from nginx.conf and its includes.
+     */
+    QString MainWindow::getNginxPort() { return getNginxPorts().first(); }
+
+    /**
+     * The ports are parsed once and cached, the status panel asks for them on every refresh.
+     * nginx.conf, its includes and their folders are watched, any change clears the cache.
+     */
+    QStringList MainWindow::getNginxPorts()
+    {
+        if (nginxPorts.isEmpty()) {
+            QString file = settings->get("nginx/config", QString("./bin/nginx/conf/nginx.conf")).toString();
+
+            File::NginxConfig config = File::NginxConfig::load(file);
+            nginxPorts               = config.listenPorts();
+
+            // an included file might be added to a globbed folder, e.g. "upstreams/*.conf"
+            QStringList paths = config.files();
+            foreach (const QString &configFile, config.files()) {
+                paths << QFileInfo(configFile).absolutePath();
+            }
+            paths.removeDuplicates();
+
+            if (!nginxConfigWatcher.files().isEmpty()) {
+                nginxConfigWatcher.removePaths(nginxConfigWatcher.files());
+            }
+            if (!nginxConfigWatcher.directories().isEmpty()) {
+                nginxConfigWatcher.removePaths(nginxConfigWatcher.directories());
+            }
+            if (!paths.isEmpty()) {
+                nginxConfigWatcher.addPaths(paths);
+            }
+        }
+
+        // no "listen" directive found, e.g. nginx.conf is missing
+        if (nginxPorts.isEmpty()) {
+            return QStringList() << settings->get("nginx/port", 80).toString();
+        }
+
+        return nginxPorts;
+    }
+
+    void MainWindow::nginxConfigChanged() { nginxPorts.clear(); }
 
     QString MainWindow::getMemcachedPort() { return settings->get("memcached/tcpport").toString(); }
 
@@ -1609,6 +1764,7 @@ namespace ServerControlPanel
     void MainWindow::openUpdaterDialog()
     {
         Updater::UpdaterDialog updaterDialog;
+        updaterDialog.setServers(servers);
         updaterDialog.exec();
     }
 
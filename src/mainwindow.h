@@ -3,10 +3,13 @@
 
 #include <QCheckBox>
 #include <QDialogButtonBox>
+#include <QFileSystemWatcher>
 #include <QMainWindow>
 #include <QSystemTrayIcon>
 
 #include "config/configurationdialog.h"
+#include "config/nginxvhosts.h"
+#include "dns/dnsresponder.h"
 #include "processviewer/processes.h"
 #include "processviewer/processviewerdialog.h"
 #include "selfupdater.h"
@@ -44,6 +47,7 @@ namespace ServerControlPanel
 
         QString getPHPPort();
         QString getNginxPort();
+        QStringList getNginxPorts();
         QString getMariaPort();
         QString getMongoPort();
         QString getMemcachedPort();
@@ -123,6 +127,11 @@ namespace ServerControlPanel
         Servers::Servers *servers;
         Updater::SelfUpdater *selfUpdater;
         Processes *processes;
+        DNS::Responder *dnsResponder = nullptr;
+        Configuration::NginxVhosts *nginxVhosts = nullptr;
+
+        QFileSystemWatcher nginxConfigWatcher;
+        QStringList nginxPorts; // parsed "listen" ports, cleared when a watched config changes
 
         QAction *minimizeAction;
         QAction *restoreAction;
@@ -134,6 +143,8 @@ namespace ServerControlPanel
 
         void setDefaultSettings();
         void autostartServers();
+        void startDnsResponder();
+        void startNginxVhosts();
 
         void renderServerStatusPanel();
 
@@ -162,6 +173,8 @@ namespace ServerControlPanel
 
         void updateServerStatusIndicatorsForAlreadyRunningServers();
 
+        void nginxConfigChanged();
+
     protected:
         void closeEvent(QCloseEvent *event);
         void changeEvent(QEvent *event);
@@ -2,38 +2,37 @@
 
 namespace SoftwareRegistry
 {
-    Manager::Manager() { download(); }
+    // the registry changes with new releases, revalidate at most every 3 days,
+    // unless the server sends its own Cache-Control
+    static const qint64 RegistryMaxAge = 3 * 24 * 60 * 60;
 
-    void Manager::download()
+    Manager::Manager(QObject *parent) : QObject(parent)
     {
         /**
          * foreach registry
-         *   if (not JSON file exists) and (JSON file not older than updateInterval)
-         *     fetch API data as JSON
-         *     write to JSON file
+         *   serve the JSON file immediately (may be stale or missing)
+         *   revalidate it with a conditional request, on refresh()
          */
 
-        // create "/bin/wpnxm-scp" folder, if not exists
-        QDir dir(QDir::currentPath() + "/bin/wpnxm-scp");
-        if (!dir.exists()) {
-            dir.mkpath(".");
-        }
-
         /**
          * Server Stack Software Registry
          */
         QString stackRegistryFile = QDir::currentPath() + "/bin/wpnxm-scp/stack-registry.json";
 
-        if (fileNotExistingOrOutdated(stackRegistryFile)) {
-            downloadRegistry(QUrl("https://wpn-xm.org/updatecheck.php?s=all"), stackRegistryFile);
-        } else {
-            qDebug() << "[Loading from Cache] Server Stack Software Registry";
-            stackSoftwareRegistry = File::JSON::load(stackRegistryFile);
-        }
+        stackRegistryFetcher = new Downloader::ConditionalFetcher(QUrl("https://wpn-xm.org/updatecheck.php?s=all"),
+                                                                  stackRegistryFile, this);
+        stackRegistryFetcher->setDefaultMaxAge(RegistryMaxAge);
+
+        connect(stackRegistryFetcher, SIGNAL(updated(QJsonDocument)), this,
+                SLOT(stackRegistryUpdated(QJsonDocument)));
+        connect(stackRegistryFetcher, SIGNAL(failed(QString)), this, SIGNAL(registryFailed(QString)));
+
+        qDebug() << "[Loading from Cache] Server Stack Software Registry";
+        stackSoftwareRegistry = stackRegistryFetcher->cached();
 
         /**
-   * PHconst P Ap&plicatconst ion Reg&isconst try
-   &*/
+         * PHP Application Registry
+         */
 
         // TODO download PHP Application Registry
 
@@ -44,67 +43,22 @@ namespace SoftwareRegistry
         // TODO download Registry Metadata
     }
 
-    void Manager::downloadRegistry(const QUrl &url, const QString &file)
-    {
-        QNetworkAccessManager network;
-
-        // QNAM is non-blocking / non-synchronous, but we want to wait until reply has
-        // been received
-        // create custom temporary event loop on stack to block the stack until
-        // finished received
-        QEventLoop eventLoop;
-
-        // "quit()" the event-loop, when the network request "finished()"
-        QObject::connect(&network, SIGNAL(finished(QNetworkReply *)), &eventLoop, SLOT(quit()));
-
-        // the HTTP request
-        QNetworkRequest req(url);
-        QNetworkReply *updateCheckResponse = network.get(req);
-
-        // run event loop, which blocks the stack, until "finished()" has been called
-        eventLoop.exec();
-
-        if (updateCheckResponse->error() == QNetworkReply::NoError) {
+    /**
+     * Revalidates the registries in the background. registryUpdated() is emitted,
+     * when a registry has changed.
+     */
+    void Manager::refresh(bool revalidate) { stackRegistryFetcher->fetch(revalidate); }
 
-            // read response and parse JSON
-            QString strReply           = (QString)updateCheckResponse->readAll();
-            QJsonDocument jsonResponse = QJsonDocument::fromJson(strReply.toUtf8());
-
-            // save JSON to file
-            File::JSON::save(jsonResponse, file);
-        } else {
-            // QNetworkReply::HostNotFoundError
-            qDebug() << "Request Failure: " << updateCheckResponse->errorString();
-
-            QMessageBox::critical(QApplication::activeWindow(), "Request Failure", updateCheckResponse->errorString(),
-                                  QMessageBox::Ok);
-        }
-
-        // cleanup pointer
-        delete updateCheckResponse;
-    }
-
-    bool Manager::fileNotExistingOrOutdated(const QString &fileName)
+    void Manager::stackRegistryUpdated(const QJsonDocument &document)
     {
-        // if the file doesn't exist, we need to update
-        if (!QFile::exists(fileName)) {
-            return true;
-        }
-
-        // if the file exists, we need to check if it is old
-        QDateTime fileModificationDate = QFileInfo(fileName).lastModified();
-        QDateTime today                = QDateTime::currentDateTime();
-
-        // updateInterval hardcoded to 3 days
-        if (3 <= fileModificationDate.daysTo(today)) {
-            return true;
-        }
-
-        return false;
+        stackSoftwareRegistry = document;
+        emit registryUpdated();
     }
 
     QJsonObject Manager::getServerStackSoftwareRegistry() { return stackSoftwareRegistry.object(); }
 
+    bool Manager::hasServerStackSoftwareRegistry() const { return !stackSoftwareRegistry.isNull(); }
+
     /*
 QJsonObject RegistriesDownloader::getPhpSoftwareRegistry()
 {
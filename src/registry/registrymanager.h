@@ -2,39 +2,45 @@
 #define REGISTRIESDOWNLOADER_H
 
 #include "src/file/json.h"
+#include "src/updater/conditionalfetcher.h"
 
-#include <QEventLoop>
-#include <QNetworkAccessManager>
-#include <QNetworkReply>
-#include <QNetworkRequest>
-#include <QUrl>
-
+#include <QDebug>
 #include <QDir>
-#include <QFile>
-#include <QFileInfo>
-
 #include <QJsonDocument>
 #include <QJsonObject>
-
-#include <QApplication>
-#include <QMessageBox>
+#include <QObject>
+#include <QUrl>
 
 namespace SoftwareRegistry
 {
-    class Manager
+    /**
+     * Manager serves the software registries from their local copy and
+     * revalidates them in the background (see Downloader::ConditionalFetcher).
+     */
+    class Manager : public QObject
     {
+        Q_OBJECT
+
     public:
-        Manager();
+        explicit Manager(QObject *parent = nullptr);
         QJsonObject getServerStackSoftwareRegistry();
         // QJsonObject getPhpSoftwareRegistry();
-    private:
-        void download();
-        void downloadRegistry(const QUrl &url, const QString &file);
-        bool fileNotExistingOrOutdated(const QString &fileName);
+        bool hasServerStackSoftwareRegistry() const;
+
+    public slots:
+        void refresh(bool revalidate = false);
+
+    signals:
+        void registryUpdated();
+        void registryFailed(const QString &errorString);
+
+    private slots:
+        void stackRegistryUpdated(const QJsonDocument &document);
 
     protected:
         QJsonDocument stackSoftwareRegistry;
         // QJsonDocument phpSoftwareRegistry;
+        Downloader::ConditionalFetcher *stackRegistryFetcher;
     };
 } // namespace SoftwareRegistry
 
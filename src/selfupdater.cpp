@@ -9,11 +9,11 @@ namespace Updater
      * Self_Update implements a self-update strategy for this executable.
      *
      * 1. check, if new version available
-     *    updateAvailable() -> getUpdateInfo()
-     * 2. download new version (zip)
+     *    run() -> versionInfoReceived() -> updateAvailable()
+     * 2. download new version (delta patch, or zip as fallback)
      * 3. remove .old file
      * 4. rename running "wpn-xm.exe" to "wpn-xm.exe.old"
-     * 5. extract "wpn-xm.exe" (new version replaces old one)
+     * 5. extract "wpn-xm.exe" (new version replaces old one), while the zip is downloading
      * 6. indicate need for a manual restart
      *    - if user selects "restart"
      *      - start new version as detached Process
@@ -24,13 +24,20 @@ namespace Updater
         qDebug() << "[SelfUpdater] Started...";
 
         userRequestedUpdate = false;
+
+        // the version info of the last check is kept, so that an unchanged answer is a 304 only
+        QString versionInfoFile = QDir::currentPath() + "/bin/wpnxm-scp/update-check.json";
+        versionCheck            = new Downloader::ConditionalFetcher(QUrl(getUpdateCheckURL()), versionInfoFile, this);
+        connect(versionCheck, SIGNAL(updated(QJsonDocument)), this, SLOT(versionInfoReceived()));
+        connect(versionCheck, SIGNAL(notModified()), this, SLOT(versionInfoReceived()));
+        connect(versionCheck, SIGNAL(failed(QString)), this, SLOT(versionCheckFailed(QString)));
     }
 
     SelfUpdater::~SelfUpdater() {}
 
     void SelfUpdater::run()
     {
-        if (network.networkAccessible() == QNetworkAccessManager::NotAccessible) {
+        if (!Downloader::NetworkService::shared().isAccessible()) {
             qDebug() << "[SelfUpdater] Run skipped, because no network.";
             return;
         }
@@ -79,155 +86,210 @@ namespace Updater
                 QDir(downloadFolder).mkpath(".");
             }
 
-            if (updateAvailable()) {
-                emit notifyUpdateAvailable(versionInfo);
-                if (settings->get("selfupdater/autoupdate").toBool()) {
-                    doUpdate();
-                }
+            // the answer arrives in versionInfoReceived()
+            versionCheck->setUrl(QUrl(getUpdateCheckURL()));
+            versionCheck->fetch(userRequestedUpdate);
+        }
+    }
+
+    void SelfUpdater::versionInfoReceived()
+    {
+        versionInfo = versionCheck->cached().object();
+
+        // qDebug() << versionInfo;
+
+        if (updateAvailable()) {
+            // connect to the download server, while the user reads the notification
+            Downloader::NetworkService::shared().warmUp(QUrl(versionInfo["url"].toString()));
+
+            emit notifyUpdateAvailable(versionInfo);
+            if (settings->get("selfupdater/autoupdate").toBool()) {
+                doUpdate();
             }
         }
     }
 
+    void SelfUpdater::versionCheckFailed(const QString &errorString)
+    {
+        qDebug() << "[SelfUpdater] Update check failed:" << errorString;
+
+        // a scheduled check fails silently, it is repeated with the next interval
+        if (userRequestedUpdate) {
+            QMessageBox::critical(QApplication::activeWindow(), "Request Failure", errorString, QMessageBox::Ok);
+        }
+    }
+
     void SelfUpdater::doUpdate()
     {
         downloadNewVersion();
         renameExecutable();
-        // extract();             is called when download transfer finished
+        // extracted();           is called when download and extraction finished
         // askForRestart();       is called when extraction finished
     }
 
-    bool SelfUpdater::updateAvailable()
-    {
-        versionInfo = getVersionInfo();
-
-        // qDebug() << versionInfo;
-
-        return versionInfo["update_available"].toBool();
-    }
+    bool SelfUpdater::updateAvailable() { return versionInfo["update_available"].toBool(); }
 
     void SelfUpdater::downloadNewVersion()
     {
         qDebug() << "SelfUpdater::downloadNewVersion";
 
-        QString downloadURL(versionInfo["url"].toString());
-
-        QNetworkRequest request(downloadURL);
-
         downloadManager.setDownloadFolder(downloadFolder);
         downloadManager.setDownloadMode(Downloader::DownloadItem::DownloadMode::SkipIfExists);
         downloadManager.setQueueMode(Downloader::DownloadManager::QueueMode::Serial);
-        downloadManager.get(request);
 
-        Downloader::TransferItem *transfer = downloadManager.findTransfer(downloadURL);
-        connect(transfer, SIGNAL(transferFinished(Downloader::TransferItem *)), this, SLOT(extract()));
+        // a delta patch for the installed version is preferred, the full archive is the fallback
+        const QJsonObject patchInfo = versionInfo["patch"].toObject();
+        if (!patchInfo["url"].toString().isEmpty()) {
+            downloadPatch(patchInfo);
+        } else {
+            downloadFullVersion();
+        }
 
         // finally: invoke downloading
         QMetaObject::invokeMethod(&downloadManager, "checkForAllDone", Qt::QueuedConnection);
     }
 
-    void SelfUpdater::renameExecutable()
+    /**
+     * Downloads the release archive and extracts the executable.
+     */
+    void SelfUpdater::downloadFullVersion()
     {
-        QString dirPath        = QCoreApplication::applicationDirPath();
-        QString exeFilePath    = QDir::toNativeSeparators(QCoreApplication::applicationFilePath());
-        QString exeName        = QFileInfo(exeFilePath).fileName();
-        QString oldExeName     = exeName + ".old";
-        QString oldExeFilePath = QDir::toNativeSeparators(dirPath + QDir::separator() + oldExeName);
+        QString downloadURL(versionInfo["url"].toString());
 
-        qDebug() << "[SelfUpdater] Renaming";
-        qDebug() << exeFilePath;
-        qDebug() << oldExeFilePath;
+        QNetworkRequest request(downloadURL);
 
-        // delete the destination file first (the old ".old" file)
-        if (QFile::exists(oldExeFilePath)) {
-            qDebug() << "[SelfUpdater] Deleted old wpn-xm.exe.old:" << QFile::remove(oldExeFilePath);
-        }
+        // the self-update goes first
+        downloadManager.get(request, Downloader::DownloadManager::HighPriority);
 
-        qDebug() << "[SelfUpdater] Renamed wpn-xm.exe to wpn-xm.exe.old:" << QFile::rename(exeFilePath, oldExeFilePath);
+        Downloader::TransferItem *transfer = downloadManager.findTransfer(downloadURL);
+        transfer->setExpectedChecksum(versionInfo["sha256"].toString().toLatin1());
+
+        QList<QUrl> mirrors;
+        foreach (const QJsonValue &mirror, versionInfo["mirrors"].toArray()) {
+            mirrors.append(QUrl(mirror.toString()));
+        }
+        transfer->setMirrors(mirrors);
+
+        // the executable is extracted while the archive is downloading, wherever it is located in the archive
+        const QString fileToExtract = "wpn-xm.exe";
+        const QString targetPath(QDir::toNativeSeparators(QCoreApplication::applicationDirPath()));
+
+        auto *pipeline = new InstallPipeline(
+            qobject_cast<Downloader::DownloadItem *>(transfer), targetPath, ZipExtractor::MergeFiles,
+            [fileToExtract](const QString &entryName) {
+                return QFileInfo(entryName).fileName() == fileToExtract ? fileToExtract : QString();
+            },
+            this);
+        connect(pipeline, SIGNAL(finished(bool, QString)), this, SLOT(extracted(bool, QString)));
+        connect(pipeline, SIGNAL(finished(bool, QString)), pipeline, SLOT(deleteLater()));
     }
 
-    void SelfUpdater::extract()
+    /**
+     * Downloads a delta patch from the installed to the new version (usually a few kilobytes).
+     * The patch is applied to the running executable while it downloads, the patched
+     * executable is written next to it.
+     *
+     * The version info advertises the patch as:
+     *   "patch": {"url": "...", "sha256": "<checksum of the patch file>"}
+     */
+    void SelfUpdater::downloadPatch(const QJsonObject &patchInfo)
     {
-        qDebug() << "[SelfUpdater] Extract started.";
-
-        QUrl url(versionInfo["url"].toString());
-        QString fileToExtract = "wpn-xm.exe";
-        QString zipArchiveFile(QDir::toNativeSeparators(downloadFolder + QDir::separator() + url.fileName()));
-        QString targetPath(QDir::toNativeSeparators(QCoreApplication::applicationDirPath()));
+        QString patchURL(patchInfo["url"].toString());
 
-        if (!QFile::exists(zipArchiveFile)) {
-            qDebug() << "[SelfUpdater] Zip File missing" << zipArchiveFile;
-        }
+        QNetworkRequest request(patchURL);
+        downloadManager.get(request, Downloader::DownloadManager::HighPriority);
 
-        qDebug() << "[SelfUpdater] Extracting " << fileToExtract << "from" << zipArchiveFile << "to" << targetPath;
+        Downloader::TransferItem *transfer = downloadManager.findTransfer(patchURL);
+        transfer->setExpectedChecksum(patchInfo["sha256"].toString().toLatin1());
 
-        QuaZipFileInfo info;
+        // the running executable is renamed to ".old" before the download starts
+        deltaPatch.reset(new DeltaPatch(getExecutableFilePath() + ".old", getExecutableFilePath() + ".new"));
 
-        QuaZip zipArchive(zipArchiveFile);
+        connect(transfer, SIGNAL(streamData(QByteArray)), this, SLOT(patchData(QByteArray)));
+        connect(transfer, SIGNAL(streamRestarted()), this, SLOT(patchRestarted()));
+        connect(transfer, SIGNAL(transferFinished(Downloader::TransferItem *)), this,
+                SLOT(patchDownloaded(Downloader::TransferItem *)));
+    }
 
-        if (!zipArchive.open(QuaZip::mdUnzip)) {
-            qWarning("Cannot open zip archive, error: %d", zipArchive.getZipError());
-            // return false;
+    void SelfUpdater::patchData(const QByteArray &data)
+    {
+        if (deltaPatch) {
+            deltaPatch->addData(data);
         }
+    }
 
-        qDebug() << "[SelfUpdater] Extracting files:" << zipArchive.getFileNameList();
-
-        QuaZipFile zippedFile(&zipArchive);
-
-        QFile outFile;
+    void SelfUpdater::patchRestarted()
+    {
+        if (deltaPatch) {
+            deltaPatch->restart();
+        }
+    }
 
-        for (bool more = zipArchive.goToFirstFile(); more; more = zipArchive.goToNextFile()) {
+    void SelfUpdater::patchDownloaded(Downloader::TransferItem *transfer)
+    {
+        const QString exeFilePath = getExecutableFilePath();
+        const QString newFilePath = exeFilePath + ".new";
 
-            if (!zipArchive.getCurrentFileInfo(&info)) {
-                qWarning("Cannot get zip file info, error: %d", zipArchive.getZipError());
-            }
+        const bool applied = deltaPatch && !transfer->failed && deltaPatch->finish();
+        const QString error =
+            transfer->failed ? transfer->errorString : deltaPatch ? deltaPatch->errorString() : QString();
+        deltaPatch.reset();
 
-            // it's a folder
-            if (info.name.endsWith("/")) {
-                QDir dir(targetPath);
-                dir.mkpath(info.name);
-                continue;
+        if (applied) {
+            if (QFile::exists(exeFilePath)) {
+                QFile::remove(exeFilePath);
             }
-
-            // is this the file we want?
-            if (!fileToExtract.isEmpty()) {
-                if (!info.name.contains(fileToExtract)) {
-                    continue;
-                }
+            if (QFile::rename(newFilePath, exeFilePath)) {
+                qDebug() << "[SelfUpdater] Patch applied.";
+                extracted(true, QString());
+                return;
             }
+        }
 
-            zippedFile.open(QIODevice::ReadOnly);
-
-            QString name = QString("%1/%2").arg(targetPath).arg(fileToExtract);
+        qDebug() << "[SelfUpdater] Patch failed, downloading the full version:" << error;
+        QFile::remove(newFilePath);
 
-            if (zippedFile.getZipError() != UNZ_OK) {
-                qWarning("Cannot get actual file name, error: %d", zippedFile.getZipError());
-            }
-
-            outFile.setFileName(name);
-            outFile.open(QIODevice::WriteOnly);
-            QByteArray data = zippedFile.readAll();
-            outFile.write(data);
-            outFile.close();
+        downloadFullVersion();
+        QMetaObject::invokeMethod(&downloadManager, "checkForAllDone", Qt::QueuedConnection);
+    }
 
-            if (zippedFile.getZipError() != UNZ_OK) {
-                qWarning("Read zip file error: %d", zippedFile.getZipError());
-            }
+    QString SelfUpdater::getExecutableFilePath()
+    {
+        return QDir::toNativeSeparators(QCoreApplication::applicationFilePath());
+    }
 
-            if (!zippedFile.atEnd()) {
-                qWarning("Read all data from zip file, but it's not EOF.");
-            }
+    void SelfUpdater::renameExecutable()
+    {
+        QString dirPath        = QCoreApplication::applicationDirPath();
+        QString exeFilePath    = getExecutableFilePath();
+        QString exeName        = QFileInfo(exeFilePath).fileName();
+        QString oldExeName     = exeName + ".old";
+        QString oldExeFilePath = QDir::toNativeSeparators(dirPath + QDir::separator() + oldExeName);
 
-            zippedFile.close();
+        qDebug() << "[SelfUpdater] Renaming";
+        qDebug() << exeFilePath;
+        qDebug() << oldExeFilePath;
 
-            if (zippedFile.getZipError() != UNZ_OK) {
-                qWarning("Cannot close zip file, error: %d", zippedFile.getZipError());
-            }
+        // delete the destination file first (the old ".old" file)
+        if (QFile::exists(oldExeFilePath)) {
+            qDebug() << "[SelfUpdater] Deleted old wpn-xm.exe.old:" << QFile::remove(oldExeFilePath);
         }
 
-        zipArchive.close();
+        qDebug() << "[SelfUpdater] Renamed wpn-xm.exe to wpn-xm.exe.old:" << QFile::rename(exeFilePath, oldExeFilePath);
+    }
 
-        if (zipArchive.getZipError() != UNZ_OK) {
-            qWarning("Cannot close zip archive: %d", zipArchive.getZipError());
+    void SelfUpdater::extracted(bool success, const QString &errorString)
+    {
+        // a truncated or tampered archive is never extracted
+        if (!success) {
+            qWarning() << "[SelfUpdater] Update failed:" << errorString;
+
+            // put the running executable back in place
+            const QString exeFilePath = getExecutableFilePath();
+            if (!QFile::exists(exeFilePath)) {
+                QFile::rename(exeFilePath + ".old", exeFilePath);
+            }
+            return;
         }
 
         qDebug() << "[SelfUpdater] Extract: OK.";
@@ -314,54 +376,6 @@ namespace Updater
 
     // ----------------------------------------------------------------
 
-    QJsonObject SelfUpdater::getVersionInfo()
-    {
-        QString url = getUpdateCheckURL();
-
-        // qDebug() << "[SelfUpdater] UpdateCheckURL: " << url;
-
-        // QNAM is non-blocking / non-synchronous, but we want to wait until reply has
-        // been received
-        // create custom temporary event loop on stack to block the stack until
-        // finished received
-        QEventLoop eventLoop;
-
-        // "quit()" the event-loop, when the network request "finished()"
-        QObject::connect(&network, SIGNAL(finished(QNetworkReply *)), &eventLoop, SLOT(quit()));
-
-        // the HTTP request
-        QNetworkRequest req(url);
-        QNetworkReply *updateCheckResponse = network.get(req);
-
-        // run event loop, which blocks the stack, until "exit()" has been called
-        eventLoop.exec();
-
-        QJsonDocument jsonResponse;
-
-        if (updateCheckResponse->error() == QNetworkReply::NoError) {
-
-            // read response and parse JSON
-            QString strReply = updateCheckResponse->readAll().data();
-            jsonResponse     = QJsonDocument::fromJson(strReply.toUtf8());
-
-            // qDebug() << "RawResponse: " << strReply;
-            // qDebug() << "JsonResponse: " << jsonResponse;
-        } else {
-            // QNetworkReply::HostNotFoundError
-            // qDebug() << "Request Failure: " << updateCheckResponse->errorString();
-
-            QMessageBox::critical(QApplication::activeWindow(), "Request Failure", updateCheckResponse->errorString(),
-                                  QMessageBox::Ok);
-        }
-
-        eventLoop.exit();
-
-        // cleanup
-        delete updateCheckResponse;
-
-        return jsonResponse.object();
-    }
-
     QString SelfUpdater::getUpdateCheckURL()
     {
         QString url("https://wpn-xm.org/updatecheck.php");
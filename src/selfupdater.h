@@ -2,24 +2,26 @@
 #define SELFUPDATER_H
 
 #include "settings.h"
+#include "updater/conditionalfetcher.h"
+#include "updater/deltapatch.h"
 #include "updater/downloadmanager.h"
+#include "updater/installpipeline.h"
 #include "version.h"
 #include "windowsapi.h"
 
-#include "quazip/JlCompress.h"
-
 #include <QApplication>
 #include <QCoreApplication>
 #include <QFileInfo>
 #include <QIcon>
+#include <QJsonArray>
 #include <QJsonDocument>
 #include <QJsonObject>
 #include <QJsonObject>
 #include <QMessageBox>
-#include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
 #include <QObject>
+#include <QScopedPointer>
 
 namespace Updater
 {
@@ -36,6 +38,8 @@ namespace Updater
         void doUpdate();
 
         void downloadNewVersion();
+        void downloadFullVersion();
+        void downloadPatch(const QJsonObject &patchInfo);
         void renameExecutable();
 
         void askForRestart();
@@ -49,19 +53,27 @@ namespace Updater
         };
 
     public slots:
-        void extract();
+        void extracted(bool success, const QString &errorString);
         void askForUpdate();
 
+    private slots:
+        void patchData(const QByteArray &data);
+        void patchRestarted();
+        void patchDownloaded(Downloader::TransferItem *transfer);
+        void versionInfoReceived();
+        void versionCheckFailed(const QString &errorString);
+
     private:
+        static QString getExecutableFilePath();
         QString getUpdateCheckURL();
-        QJsonObject getVersionInfo();
         QJsonObject versionInfo;
+        Downloader::ConditionalFetcher *versionCheck;
         QString downloadFolder;
         bool userRequestedUpdate;
+        QScopedPointer<DeltaPatch> deltaPatch;
 
     protected:
         Downloader::DownloadManager downloadManager;
-        QNetworkAccessManager network;
         Settings::SettingsManager *settings;
 
     signals:
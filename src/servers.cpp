@@ -1,7 +1,15 @@
 #include "servers.h"
+#include "src/config/phpextensions.h"
+#include "src/file/nginxconfig.h"
+#include "src/file/phpini.h"
 
 #include <QDebug>
 
+#ifndef Q_OS_WIN
+#include <csignal>
+#include <sys/types.h>
+#endif
+
 namespace Servers
 {
     Servers::Servers(QObject *parent) : QObject(parent), settings(new Settings::SettingsManager)
@@ -47,6 +55,10 @@ namespace Servers
 
             qDebug() << "[Servers] Server object added to serverList:\t" << serverName;
         }
+
+        nginxReloadTimer.setSingleShot(true);
+        nginxReloadTimer.setInterval(500);
+        connect(&nginxReloadTimer, SIGNAL(timeout()), this, SLOT(reloadNginx()));
     }
 
     void Servers::mapAction(QAction *action)
@@ -335,16 +347,58 @@ namespace Servers
 
     void Servers::reloadNginx()
     {
-        QString const reloadNginx = getServer("Nginx")->exe;
+        // a reload with a broken config is refused by the master process, with an entry in the error log only
+        if (!isNginxConfigValid()) {
+            return;
+        }
 
+        qDebug() << "[Nginx] Reloading...";
+
+#ifdef Q_OS_WIN
+        // "-s reload" signals the master process, nginx.exe is started directly, without a cmd.exe in between
         QStringList args;
-        args << "-p " + QDir::currentPath();
-        args << "-c " + QDir::currentPath() + "/bin/nginx/conf/nginx.conf";
-        args << "-s reload";
+        args << "-p" << QDir::currentPath();
+        args << "-c" << QDir::currentPath() + "/bin/nginx/conf/nginx.conf";
+        args << "-s" << "reload";
+
+        QProcess::startDetached(getServer("Nginx")->exe, args, getServer("Nginx")->workingDirectory);
+#else
+        // the master process reloads on SIGHUP
+        QFile pidFile(QDir::currentPath() + "/logs/nginx.pid");
+        if (!pidFile.open(QIODevice::ReadOnly)) {
+            qDebug() << "[Nginx] Not running... Skipping reload.";
+            return;
+        }
 
-        qDebug() << "[Nginx] Reloading...\n" << reloadNginx;
+        pid_t pid = pidFile.readAll().trimmed().toInt();
+        if (pid <= 0 || kill(pid, SIGHUP) != 0) {
+            qDebug() << "[Nginx] Reload failed. No master process with pid" << pid;
+        }
+#endif
+    }
 
-        Processes::startDetached(reloadNginx, args, getServer("Nginx")->workingDirectory);
+    /**
+     * Requests a reload of Nginx.
+     * Every request restarts the timer: a burst of config changes results in one reload, after the last change.
+     */
+    void Servers::scheduleNginxReload() { nginxReloadTimer.start(); }
+
+    /**
+     * Checks the structure of nginx.conf and its includes, in-process, without spawning "nginx -t".
+     */
+    bool Servers::isNginxConfigValid()
+    {
+        File::NginxConfig config = File::NginxConfig::load(QDir::currentPath() + "/bin/nginx/conf/nginx.conf");
+
+        if (!config.isValid()) {
+            qDebug() << "[Nginx] Configuration has errors. Skipping reload.";
+            foreach (const File::NginxConfig::Error &error, config.errors()) {
+                qDebug() << "        " << error.toString();
+            }
+            return false;
+        }
+
+        return true;
     }
 
     void Servers::restartNginx()
@@ -471,6 +525,18 @@ namespace Servers
         int phpVersion = process.readLine().toInt();
         qDebug() << "[PHP] Version " << phpVersion;
 
+        // report enabled extensions, which this PHP cannot load (the parsed php.ini and inventory are cached)
+        QString phpIniFile = QDir(settings->get("php/config", "./bin/php/php.ini").toString()).absolutePath();
+
+        QStringList enabledExtensions = File::PhpIni::shared(phpIniFile).enabledExtensions();
+        foreach (const Configuration::PhpExtensions::Extension &extension,
+                 Configuration::PhpExtensions::shared().inventory(QDir::currentPath() + "/bin/php")) {
+            if (!extension.incompatibility.isEmpty() && enabledExtensions.contains(extension.name)) {
+                qDebug() << "[PHP] Warning: enabled extension" << extension.name
+                         << "is incompatible:" << extension.incompatibility;
+            }
+        }
+
         // check that the tool "php-cgi-spawner" is present
         QString spawnUtilFile =
             QDir::toNativeSeparators(QDir::currentPath() + "/bin/php-cgi-spawner/php-cgi-spawner.exe");
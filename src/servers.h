@@ -77,6 +77,7 @@ namespace Servers
         void stopNginx();
         void reloadNginx();
         void restartNginx();
+        void scheduleNginxReload();
 
         // PHP Action Slots
         void startPHP();
@@ -113,6 +114,10 @@ namespace Servers
 
     private:
         QList<Server *> serverList;
+
+        // coalesces the reload requests of several config changes into one reload
+        QTimer nginxReloadTimer;
+        bool isNginxConfigValid();
     };
 } // namespace Servers
 #endif // SERVERS_H
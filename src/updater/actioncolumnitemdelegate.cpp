@@ -101,25 +101,44 @@ namespace Updater
         opt.textAlignment = Qt::AlignCenter;
         opt.state         = QStyle::State_Enabled | QStyle::State_Active | QStyle::State_Raised;
 
-        // get progress
-        QMap<QString, QVariant> progress = index.model()->data(index).toMap();
-
-        QString text = QString::fromLatin1(" %1 %2 %3 ")
-                           .arg(progress["percentage"].toString())
-                           .arg(progress["size"].toString())
-                           .arg(progress["speed"].toString());
-        //.arg(progress["time"].toString());
-        //.arg(progress["eta"].toString());
+        // get progress, the strings are only formatted here, when the cell is actually painted
+        const Downloader::TransferProgress progress = index.data().value<Downloader::TransferProgress>();
+
+        const int permille =
+            (progress.bytesTotal > 0) ? static_cast<int>(progress.bytesReceived * 1000 / progress.bytesTotal) : 0;
+
+        QString text = QString::fromLatin1(" %1% %2 %3/s ")
+                           .arg(permille / 10)
+                           .arg(getSizeHumanReadable(progress.bytesReceived))
+                           .arg(getSizeHumanReadable(static_cast<qint64>(progress.bytesPerSecond)));
+        if (progress.secondsRemaining >= 0) {
+            text.append(QString::fromLatin1("%1:%2 ")
+                            .arg(progress.secondsRemaining / 60)
+                            .arg(progress.secondsRemaining % 60, 2, 10, QLatin1Char('0')));
+        }
 
-        // set progress
+        // set progress (in permille, the byte counts do not fit into an int)
         opt.minimum  = 0;
-        opt.maximum  = progress["bytesTotal"].toFloat();
-        opt.progress = progress["bytesReceived"].toFloat();
+        opt.maximum  = 1000;
+        opt.progress = permille;
         opt.text     = text;
 
         bar->style()->drawControl(QStyle::CE_ProgressBar, &opt, painter, bar);
     }
 
+    QString ActionColumnItemDelegate::getSizeHumanReadable(qint64 bytes)
+    {
+        static const char *const units[] = {"bytes", "KB", "MB", "GB", "TB"};
+
+        double num = bytes;
+        int unit   = 0;
+        while (num >= 1024.0 && unit < 4) {
+            num /= 1024.0;
+            ++unit;
+        }
+        return QString::fromLatin1("%1 %2").arg(num, 3, 'f', 1).arg(QLatin1String(units[unit]));
+    }
+
     void ActionColumnItemDelegate::setPushButtonStyle(QPushButton *btn) const
     {
         QString style =
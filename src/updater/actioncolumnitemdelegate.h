@@ -50,6 +50,7 @@ namespace Updater
         QProgressBar *bar;
         void setPushButtonStyle(QPushButton *btn) const;
         void setProgressBarStyle(QProgressBar *bar) const;
+        static QString getSizeHumanReadable(qint64 bytes);
         int currentRow;
 
     public:
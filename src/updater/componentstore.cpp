@@ -0,0 +1,490 @@
+#include "componentstore.h"
+
+#include <QCryptographicHash>
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QVersionNumber>
+
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <Windows.h>
+#include <cstddef>
+#else
+#include <cstdio>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace Updater
+{
+#ifdef Q_OS_WIN
+    static LPCWSTR nativePath(const QString &path)
+    {
+        return reinterpret_cast<LPCWSTR>(path.utf16());
+    }
+
+    // REPARSE_DATA_BUFFER (mount point variant) is declared in the DDK only
+    struct MountPointReparseBuffer
+    {
+        DWORD ReparseTag;
+        WORD ReparseDataLength;
+        WORD Reserved;
+        WORD SubstituteNameOffset;
+        WORD SubstituteNameLength;
+        WORD PrintNameOffset;
+        WORD PrintNameLength;
+        WCHAR PathBuffer[1];
+    };
+
+    /**
+     * A junction works without administrator rights (unlike a symbolic link) and without a shell.
+     */
+    static bool createJunction(const QString &link, const QString &target)
+    {
+        const QString nativeLink = QDir::toNativeSeparators(link);
+        if (!CreateDirectoryW(nativePath(nativeLink), nullptr)) {
+            return false;
+        }
+
+        HANDLE handle = CreateFileW(nativePath(nativeLink), GENERIC_WRITE, 0, nullptr, OPEN_EXISTING,
+                                    FILE_FLAG_OPEN_REPARSE_POINT | FILE_FLAG_BACKUP_SEMANTICS, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            RemoveDirectoryW(nativePath(nativeLink));
+            return false;
+        }
+
+        const QString printName      = QDir::toNativeSeparators(QDir::cleanPath(target));
+        const QString substituteName = "\\??\\" + printName;
+        const WORD substituteBytes   = static_cast<WORD>(substituteName.size() * sizeof(WCHAR));
+        const WORD printBytes        = static_cast<WORD>(printName.size() * sizeof(WCHAR));
+
+        QByteArray buffer(static_cast<int>(offsetof(MountPointReparseBuffer, PathBuffer)) + substituteBytes +
+                              printBytes + 2 * sizeof(WCHAR),
+                          '\0');
+
+        // the data length counts everything after the header (tag, length, reserved)
+        const size_t headerSize = offsetof(MountPointReparseBuffer, SubstituteNameOffset);
+
+        auto *reparse                 = reinterpret_cast<MountPointReparseBuffer *>(buffer.data());
+        reparse->ReparseTag           = IO_REPARSE_TAG_MOUNT_POINT;
+        reparse->ReparseDataLength    = static_cast<WORD>(buffer.size() - headerSize);
+        reparse->SubstituteNameOffset = 0;
+        reparse->SubstituteNameLength = substituteBytes;
+        reparse->PrintNameOffset      = static_cast<WORD>(substituteBytes + sizeof(WCHAR));
+        reparse->PrintNameLength      = printBytes;
+        memcpy(reparse->PathBuffer, substituteName.utf16(), substituteBytes);
+        memcpy(reinterpret_cast<char *>(reparse->PathBuffer) + reparse->PrintNameOffset, printName.utf16(), printBytes);
+
+        DWORD returned = 0;
+        const BOOL isOk = DeviceIoControl(handle, FSCTL_SET_REPARSE_POINT, buffer.data(),
+                                          static_cast<DWORD>(buffer.size()), nullptr, 0, &returned, nullptr);
+        CloseHandle(handle);
+
+        if (!isOk) {
+            RemoveDirectoryW(nativePath(nativeLink));
+        }
+        return isOk;
+    }
+#endif
+
+    ComponentStore::ComponentStore(const QString &binFolder)
+        : bin(QDir::cleanPath(binFolder)), root(QDir::cleanPath(binFolder) + "/store")
+    {
+    }
+
+    ComponentStore &ComponentStore::shared()
+    {
+        static ComponentStore store(QDir::currentPath() + "/bin");
+        return store;
+    }
+
+    /**
+     * The versions of the component in the store, the oldest first.
+     */
+    QStringList ComponentStore::versions(const QString &component) const
+    {
+        QStringList list;
+        foreach (const QString &version, QDir(root + "/" + component).entryList(QDir::Dirs | QDir::NoDotAndDotDot)) {
+            if (!version.endsWith(".importing")) {
+                list << version;
+            }
+        }
+        std::sort(list.begin(), list.end(), [](const QString &a, const QString &b) {
+            return QVersionNumber::fromString(a) < QVersionNumber::fromString(b);
+        });
+        return list;
+    }
+
+    /**
+     * The version "bin/<component>" links to, or empty, if it is no link into the store.
+     */
+    QString ComponentStore::activeVersion(const QString &component) const
+    {
+        if (!isManaged(component)) {
+            return QString();
+        }
+
+        const QFileInfo target(QFileInfo(linkPath(component)).canonicalFilePath());
+        const QString storeFolder = QFileInfo(root + "/" + component).canonicalFilePath();
+        if (storeFolder.isEmpty() || target.absolutePath() != storeFolder) {
+            return QString();
+        }
+        return target.fileName();
+    }
+
+    bool ComponentStore::contains(const QString &component, const QString &version) const
+    {
+        return QFileInfo(versionPath(component, version)).isDir();
+    }
+
+    bool ComponentStore::isManaged(const QString &component) const { return isLink(linkPath(component)); }
+
+    QString ComponentStore::versionPath(const QString &component, const QString &version) const
+    {
+        return root + "/" + component + "/" + version;
+    }
+
+    QString ComponentStore::linkPath(const QString &component) const { return bin + "/" + component; }
+
+    QString ComponentStore::objectPath(const QByteArray &sha256) const
+    {
+        const QString hex = QString::fromLatin1(sha256);
+        return root + "/objects/" + hex.left(2) + "/" + hex;
+    }
+
+    /**
+     * Adds the files of the folder as a new version. The folder is not modified,
+     * its files are linked into the store (or copied, where hardlinks are not supported).
+     */
+    bool ComponentStore::importFolder(const QString &component, const QString &version, const QString &sourceFolder,
+                                      QString *errorMessage)
+    {
+        if (version.isEmpty() || version.contains('/') || version.contains('\\') || version.startsWith('.')) {
+            *errorMessage = QString("Invalid version \"%1\"").arg(version);
+            return false;
+        }
+
+        // a version is immutable, once it is in the store
+        const QString destination = versionPath(component, version);
+        if (contains(component, version)) {
+            qDebug() << "[ComponentStore]" << component << version << "is already in the store.";
+            return true;
+        }
+
+        const QString building = destination + ".importing";
+        QDir(building).removeRecursively();
+        if (!QDir().mkpath(building)) {
+            *errorMessage = QString("Cannot create folder %1").arg(building);
+            return false;
+        }
+
+        const QDir source(sourceFolder);
+        int linkedFiles = 0;
+        int copiedFiles = 0;
+
+        QDirIterator it(sourceFolder, QDir::Files | QDir::Dirs | QDir::Hidden | QDir::System | QDir::NoDotAndDotDot,
+                        QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            const QString path     = it.next();
+            const QString fileName = building + "/" + source.relativeFilePath(path);
+
+            if (it.fileInfo().isDir()) {
+                QDir().mkpath(fileName);
+                continue;
+            }
+            QDir().mkpath(QFileInfo(fileName).absolutePath());
+
+            if (isMutable(source.relativeFilePath(path))) {
+                if (!QFile::copy(path, fileName)) {
+                    *errorMessage = QString("Cannot copy %1").arg(path);
+                    QDir(building).removeRecursively();
+                    return false;
+                }
+                ++copiedFiles;
+                continue;
+            }
+
+            const QByteArray sha256 = hashFile(path);
+            if (sha256.isEmpty()) {
+                *errorMessage = QString("Cannot read %1").arg(path);
+                QDir(building).removeRecursively();
+                return false;
+            }
+
+            // an object, which was edited through one of its links, is not shared with a new version
+            const QString object = objectPath(sha256);
+            if (QFile::exists(object) && hashFile(object) != sha256) {
+                qDebug() << "[ComponentStore] Object" << object << "was modified in place, replacing it.";
+                QFile::remove(object);
+            }
+            if (!QFile::exists(object)) {
+                QDir().mkpath(QFileInfo(object).absolutePath());
+                if (!hardLink(path, object) && !QFile::copy(path, object)) {
+                    *errorMessage = QString("Cannot store %1").arg(path);
+                    QDir(building).removeRecursively();
+                    return false;
+                }
+            }
+
+            if (hardLink(object, fileName)) {
+                ++linkedFiles;
+            } else if (QFile::copy(object, fileName)) {
+                ++copiedFiles;
+            } else {
+                *errorMessage = QString("Cannot create %1").arg(fileName);
+                QDir(building).removeRecursively();
+                return false;
+            }
+        }
+
+        if (!QDir().rename(building, destination)) {
+            *errorMessage = QString("Cannot rename %1").arg(building);
+            QDir(building).removeRecursively();
+            return false;
+        }
+
+        qDebug() << "[ComponentStore] Imported" << component << version << "-" << linkedFiles << "files linked,"
+                 << copiedFiles << "copied.";
+        return true;
+    }
+
+    /**
+     * Moves a folder of the old layout ("bin/php" or "bin/php-x.y.z") into the store.
+     * When the folder is "bin/<component>", it is replaced by a link to the imported version.
+     */
+    bool ComponentStore::adopt(const QString &component, const QString &version, const QString &folder,
+                               QString *errorMessage)
+    {
+        const QString source = QDir::cleanPath(folder);
+        if (isLink(source)) {
+            return true;
+        }
+
+        if (!importFolder(component, version, source, errorMessage)) {
+            return false;
+        }
+
+        if (source == linkPath(component)) {
+            // the folder is renamed out of the way first, its files must not be in use
+            const QString adopting = source + ".adopting";
+            if (!QDir().rename(source, adopting)) {
+                *errorMessage = QString("%1 is in use, please stop the server and try again.").arg(source);
+                return false;
+            }
+            if (!activate(component, version, errorMessage)) {
+                QDir().rename(adopting, source);
+                return false;
+            }
+            QDir(adopting).removeRecursively();
+        } else {
+            // the store holds the files now, removing the folder only drops a link
+            QDir(source).removeRecursively();
+        }
+
+        qDebug() << "[ComponentStore] Adopted" << source << "as" << component << version;
+        return true;
+    }
+
+    /**
+     * Points "bin/<component>" to the version.
+     *
+     * The new link is created next to the old one and then renamed over it.
+     * On POSIX this is a single atomic rename. On Windows a junction cannot be renamed
+     * over another, so the old link is moved aside first, which takes two renames of a link.
+     */
+    bool ComponentStore::activate(const QString &component, const QString &version, QString *errorMessage)
+    {
+        if (!contains(component, version)) {
+            *errorMessage = QString("%1 %2 is not in the store").arg(component, version);
+            return false;
+        }
+
+        const QString link = linkPath(component);
+        if (QFileInfo::exists(link) && !isLink(link)) {
+            *errorMessage = QString("%1 is a folder, it has to be adopted into the store first").arg(link);
+            return false;
+        }
+
+        const QString switching = link + ".switching";
+        if (isLink(switching)) {
+            removeLink(switching);
+        }
+        if (!createLink(switching, versionPath(component, version))) {
+            *errorMessage = QString("Cannot create the link %1").arg(switching);
+            return false;
+        }
+
+#ifdef Q_OS_WIN
+        const QString unlinking = link + ".unlinking";
+        if (isLink(unlinking)) {
+            removeLink(unlinking);
+        }
+
+        const bool hasLink = isLink(link);
+        if (hasLink && !MoveFileW(nativePath(QDir::toNativeSeparators(link)),
+                                  nativePath(QDir::toNativeSeparators(unlinking)))) {
+            removeLink(switching);
+            *errorMessage = QString("Cannot replace the link %1").arg(link);
+            return false;
+        }
+        if (!MoveFileW(nativePath(QDir::toNativeSeparators(switching)), nativePath(QDir::toNativeSeparators(link)))) {
+            if (hasLink) {
+                MoveFileW(nativePath(QDir::toNativeSeparators(unlinking)), nativePath(QDir::toNativeSeparators(link)));
+            }
+            removeLink(switching);
+            *errorMessage = QString("Cannot replace the link %1").arg(link);
+            return false;
+        }
+        if (hasLink) {
+            removeLink(unlinking);
+        }
+#else
+        if (::rename(QFile::encodeName(switching).constData(), QFile::encodeName(link).constData()) != 0) {
+            removeLink(switching);
+            *errorMessage = QString("Cannot replace the link %1").arg(link);
+            return false;
+        }
+#endif
+
+        qDebug() << "[ComponentStore] Activated" << component << version;
+        return true;
+    }
+
+    bool ComponentStore::removeVersion(const QString &component, const QString &version, QString *errorMessage)
+    {
+        if (activeVersion(component) == version) {
+            *errorMessage = QString("%1 %2 is the active version").arg(component, version);
+            return false;
+        }
+        if (!QDir(versionPath(component, version)).removeRecursively()) {
+            *errorMessage = QString("Cannot remove %1 %2").arg(component, version);
+            return false;
+        }
+        collectGarbage();
+        return true;
+    }
+
+    /**
+     * Removes the objects, which are no longer used by any version.
+     * An object, which is only linked from "store/objects", has a link count of one.
+     */
+    int ComponentStore::collectGarbage()
+    {
+        int removed = 0;
+        QDirIterator it(root + "/objects", QDir::Files, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            const QString object = it.next();
+            if (linkCount(object) == 1 && QFile::remove(object)) {
+                ++removed;
+            }
+        }
+        if (removed > 0) {
+            qDebug() << "[ComponentStore] Removed" << removed << "unused objects.";
+        }
+        return removed;
+    }
+
+    bool ComponentStore::isLink(const QString &path)
+    {
+#ifdef Q_OS_WIN
+        const DWORD attributes = GetFileAttributesW(nativePath(QDir::toNativeSeparators(path)));
+        return attributes != INVALID_FILE_ATTRIBUTES && (attributes & FILE_ATTRIBUTE_REPARSE_POINT) != 0;
+#else
+        return QFileInfo(path).isSymLink();
+#endif
+    }
+
+    /**
+     * Removes a link without touching the folder it points to.
+     */
+    bool ComponentStore::removeLink(const QString &path)
+    {
+#ifdef Q_OS_WIN
+        return RemoveDirectoryW(nativePath(QDir::toNativeSeparators(path))) != 0;
+#else
+        return QFile::remove(path);
+#endif
+    }
+
+    QByteArray ComponentStore::hashFile(const QString &file)
+    {
+        QFile f(file);
+        if (!f.open(QIODevice::ReadOnly)) {
+            return QByteArray();
+        }
+        QCryptographicHash hash(QCryptographicHash::Sha256);
+        if (!hash.addData(&f)) {
+            return QByteArray();
+        }
+        return hash.result().toHex();
+    }
+
+    /**
+     * Returns true for a file (relative to the version folder), which might be edited in place.
+     */
+    bool ComponentStore::isMutable(const QString &relativePath)
+    {
+        static const QStringList suffixes = {"ini", "conf", "cnf", "cfg", "config", "pem", "crt", "key",
+                                             "json", "yml", "yaml", "xml", "php", "htaccess"};
+        static const QStringList folders  = {"conf", "config", "etc", "data", "ssl", "www", "logs", "temp", "tmp"};
+
+        if (suffixes.contains(QFileInfo(relativePath).suffix().toLower())) {
+            return true;
+        }
+
+        const QStringList parents = QFileInfo(relativePath).path().toLower().split('/', QString::SkipEmptyParts);
+        for (const QString &parent : parents) {
+            if (folders.contains(parent)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool ComponentStore::createLink(const QString &link, const QString &target)
+    {
+#ifdef Q_OS_WIN
+        return createJunction(link, target);
+#else
+        // relative, so that the server stack can be moved
+        const QString relativeTarget = QFileInfo(link).dir().relativeFilePath(target);
+        return ::symlink(QFile::encodeName(relativeTarget).constData(), QFile::encodeName(link).constData()) == 0;
+#endif
+    }
+
+    bool ComponentStore::hardLink(const QString &from, const QString &to)
+    {
+#ifdef Q_OS_WIN
+        return CreateHardLinkW(nativePath(QDir::toNativeSeparators(to)), nativePath(QDir::toNativeSeparators(from)),
+                               nullptr) != 0;
+#else
+        return ::link(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0;
+#endif
+    }
+
+    int ComponentStore::linkCount(const QString &file)
+    {
+#ifdef Q_OS_WIN
+        HANDLE handle = CreateFileW(nativePath(QDir::toNativeSeparators(file)), 0,
+                                    FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE, nullptr, OPEN_EXISTING,
+                                    FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (handle == INVALID_HANDLE_VALUE) {
+            return 0;
+        }
+        BY_HANDLE_FILE_INFORMATION info;
+        const BOOL isOk = GetFileInformationByHandle(handle, &info);
+        CloseHandle(handle);
+        return isOk ? static_cast<int>(info.nNumberOfLinks) : 0;
+#else
+        struct stat info;
+        if (::stat(QFile::encodeName(file).constData(), &info) != 0) {
+            return 0;
+        }
+        return static_cast<int>(info.st_nlink);
+#endif
+    }
+} // namespace Updater
@@ -0,0 +1,67 @@
+#ifndef COMPONENTSTORE_H
+#define COMPONENTSTORE_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+
+namespace Updater
+{
+    /**
+     * ComponentStore keeps every version of a software component exactly once.
+     *
+     * Layout (inside of "bin"):
+     *
+     *   store/objects/<ab>/<sha256>     file contents, addressed by their SHA-256
+     *   store/<component>/<version>/    immutable version folder, files are hardlinks to the objects
+     *   <component>                     link (junction on Windows) to the active version folder
+     *
+     * A file, which is identical in several versions, exists once on disk.
+     * Files, which are edited in place, are copied instead: configuration files, certificates,
+     * scripts (*.ini, *.conf, *.pem, *.php, ...) and everything in configuration and data folders
+     * ("conf", "etc", "data", "www", ...). An object, which was changed through a link anyway,
+     * is detected by its checksum on the next import and replaced.
+     *
+     * Switching versions replaces the link, no folder is renamed or copied,
+     * so a switch neither depends on the size of a version nor on files in use.
+     */
+    class ComponentStore
+    {
+    public:
+        explicit ComponentStore(const QString &binFolder);
+
+        static ComponentStore &shared();
+
+        QStringList versions(const QString &component) const;
+        QString activeVersion(const QString &component) const;
+        bool contains(const QString &component, const QString &version) const;
+        bool isManaged(const QString &component) const;
+
+        QString versionPath(const QString &component, const QString &version) const;
+        QString linkPath(const QString &component) const;
+
+        bool importFolder(const QString &component, const QString &version, const QString &sourceFolder,
+                          QString *errorMessage);
+        bool adopt(const QString &component, const QString &version, const QString &folder, QString *errorMessage);
+        bool activate(const QString &component, const QString &version, QString *errorMessage);
+        bool removeVersion(const QString &component, const QString &version, QString *errorMessage);
+        int collectGarbage();
+
+        static bool isLink(const QString &path);
+        static bool removeLink(const QString &path);
+
+    private:
+        QString objectPath(const QByteArray &sha256) const;
+
+        static QByteArray hashFile(const QString &file);
+        static bool isMutable(const QString &relativePath);
+        static bool createLink(const QString &link, const QString &target);
+        static bool hardLink(const QString &from, const QString &to);
+        static int linkCount(const QString &file);
+
+        QString bin;
+        QString root;
+    };
+} // namespace Updater
+
+#endif // COMPONENTSTORE_H
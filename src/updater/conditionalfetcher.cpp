@@ -0,0 +1,211 @@
+#include "conditionalfetcher.h"
+#include "../file/json.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QNetworkRequest>
+#include <QSaveFile>
+
+namespace Downloader
+{
+    ConditionalFetcher::ConditionalFetcher(const QUrl &url, const QString &cacheFile, QObject *parent)
+        : QObject(parent), url(url), file(cacheFile), metaFile(cacheFile + ".meta"), defaultMaxAge(0)
+    {
+        meta.fetched = 0;
+        meta.maxAge  = 0;
+
+        QDir().mkpath(QFileInfo(file).absolutePath());
+
+        if (QFile::exists(file)) {
+            document = File::JSON::load(file);
+        }
+        loadMeta();
+    }
+
+    ConditionalFetcher::~ConditionalFetcher() { abort(); }
+
+    void ConditionalFetcher::setUrl(const QUrl &newUrl)
+    {
+        if (url != newUrl) {
+            url = newUrl;
+            // validators of another resource must not be sent
+            meta.eTag.clear();
+            meta.lastModified.clear();
+            meta.fetched = 0;
+        }
+    }
+
+    /**
+     * The freshness lifetime, when the server does not send Cache-Control.
+     */
+    void ConditionalFetcher::setDefaultMaxAge(qint64 seconds) { defaultMaxAge = seconds; }
+
+    QJsonDocument ConditionalFetcher::cached() const { return document; }
+
+    bool ConditionalFetcher::hasCache() const { return !document.isNull(); }
+
+    bool ConditionalFetcher::isFresh() const
+    {
+        if (!hasCache() || meta.fetched == 0) {
+            return false;
+        }
+        const qint64 age = (QDateTime::currentMSecsSinceEpoch() - meta.fetched) / 1000;
+        return age >= 0 && age < meta.maxAge;
+    }
+
+    bool ConditionalFetcher::isRunning() const { return !reply.isNull(); }
+
+    /**
+     * Revalidates the local copy in the background.
+     *
+     * While the copy is fresh, no request is sent and notModified() is emitted.
+     * With revalidate, a conditional request is sent regardless of the freshness.
+     */
+    void ConditionalFetcher::fetch(bool revalidate)
+    {
+        if (isRunning()) {
+            return;
+        }
+
+        if (!revalidate && isFresh()) {
+            qDebug() << "[ConditionalFetcher] Fresh:" << file;
+            QMetaObject::invokeMethod(this, "notModified", Qt::QueuedConnection);
+            return;
+        }
+
+        // the shared HTTP cache may answer, too (a fresh entry, or a 304 turned into its cached response)
+        QNetworkRequest request(url);
+        if (hasCache()) {
+            if (!meta.eTag.isEmpty()) {
+                request.setRawHeader("If-None-Match", meta.eTag);
+            }
+            if (!meta.lastModified.isEmpty()) {
+                request.setRawHeader("If-Modified-Since", meta.lastModified);
+            }
+        }
+
+        reply = NetworkService::shared().get(request);
+        connect(reply, SIGNAL(finished()), this, SLOT(replyFinished()));
+    }
+
+    void ConditionalFetcher::abort()
+    {
+        if (reply) {
+            reply->disconnect(this);
+            reply->abort();
+            reply->deleteLater();
+            reply = nullptr;
+        }
+    }
+
+    void ConditionalFetcher::replyFinished()
+    {
+        QNetworkReply *finished = reply;
+        reply                   = nullptr;
+        finished->deleteLater();
+
+        if (finished->error() != QNetworkReply::NoError) {
+            // the stale copy stays in use
+            qDebug() << "[ConditionalFetcher] Request failed:" << url.toString() << finished->errorString();
+            emit failed(finished->errorString());
+            return;
+        }
+
+        const int status     = finished->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        const bool fromCache = finished->attribute(QNetworkRequest::SourceIsFromCacheAttribute).toBool();
+        bool noStore         = false;
+
+        if ((status == 304 || fromCache) && hasCache()) {
+            qDebug() << "[ConditionalFetcher] Not modified:" << url.toString();
+            updateFreshness(finished, &noStore);
+            if (finished->hasRawHeader("ETag")) {
+                meta.eTag = finished->rawHeader("ETag");
+            }
+            saveMeta();
+            emit notModified();
+            return;
+        }
+
+        QJsonParseError parseError;
+        const QJsonDocument response = QJsonDocument::fromJson(finished->readAll(), &parseError);
+        if (parseError.error != QJsonParseError::NoError) {
+            emit failed(tr("Invalid response from %1: %2").arg(url.toString(), parseError.errorString()));
+            return;
+        }
+
+        document          = response;
+        meta.eTag         = finished->rawHeader("ETag");
+        meta.lastModified = finished->rawHeader("Last-Modified");
+        updateFreshness(finished, &noStore);
+
+        if (noStore) {
+            QFile::remove(file);
+            QFile::remove(metaFile);
+        } else {
+            // never leave a truncated copy behind, the copy is served on the next start
+            QSaveFile saveFile(file);
+            if (saveFile.open(QIODevice::WriteOnly)) {
+                saveFile.write(document.toJson());
+                saveFile.commit();
+            }
+            saveMeta();
+        }
+
+        qDebug() << "[ConditionalFetcher] Updated:" << file;
+        emit updated(document);
+    }
+
+    void ConditionalFetcher::updateFreshness(QNetworkReply *response, bool *noStore)
+    {
+        meta.fetched = QDateTime::currentMSecsSinceEpoch();
+        meta.maxAge  = defaultMaxAge;
+
+        const QByteArray cacheControl = response->rawHeader("Cache-Control").toLower();
+        if (cacheControl.isEmpty()) {
+            return;
+        }
+
+        foreach (QByteArray directive, cacheControl.split(',')) {
+            directive = directive.trimmed();
+            if (directive.startsWith("max-age=")) {
+                meta.maxAge = directive.mid(8).toLongLong();
+            } else if (directive == "no-store") {
+                *noStore = true;
+            }
+        }
+        // "no-cache" and "no-store" win over "max-age"
+        if (*noStore || cacheControl.contains("no-cache")) {
+            meta.maxAge = 0;
+        }
+    }
+
+    void ConditionalFetcher::loadMeta()
+    {
+        if (!QFile::exists(metaFile)) {
+            return;
+        }
+
+        const QJsonObject json = File::JSON::load(metaFile).object();
+        if (json["url"].toString() != url.toString()) {
+            return;
+        }
+        meta.eTag         = json["etag"].toString().toLatin1();
+        meta.lastModified = json["last_modified"].toString().toLatin1();
+        meta.fetched      = json["fetched"].toVariant().toLongLong();
+        meta.maxAge       = json["max_age"].toVariant().toLongLong();
+    }
+
+    void ConditionalFetcher::saveMeta() const
+    {
+        QJsonObject json;
+        json["url"]           = url.toString();
+        json["etag"]          = QString::fromLatin1(meta.eTag);
+        json["last_modified"] = QString::fromLatin1(meta.lastModified);
+        json["fetched"]       = QString::number(meta.fetched);
+        json["max_age"]       = QString::number(meta.maxAge);
+        File::JSON::save(QJsonDocument(json), metaFile);
+    }
+} // namespace Downloader
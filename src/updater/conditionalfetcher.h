@@ -0,0 +1,81 @@
+#ifndef CONDITIONALFETCHER_H
+#define CONDITIONALFETCHER_H
+
+#include <QByteArray>
+#include <QJsonDocument>
+#include <QNetworkReply>
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QUrl>
+
+#include "networkservice.h"
+
+namespace Downloader
+{
+    /**
+     * ConditionalFetcher keeps a local copy of a JSON resource up to date, without blocking.
+     *
+     * The local file is served immediately (stale-while-revalidate), the revalidation
+     * runs in the background. Next to the file, a "<file>.meta" sidecar stores the
+     * ETag, Last-Modified and freshness lifetime of the last response. A revalidation
+     * sends If-None-Match/If-Modified-Since, so an unchanged resource costs a 304 only.
+     *
+     * Cache-Control of the response is honoured: "max-age" sets the freshness lifetime
+     * (no request at all, while fresh), "no-cache" revalidates every time and "no-store"
+     * keeps the response in memory only. Without Cache-Control the default lifetime applies.
+     * Requests go through the shared NetworkService, a response of its HTTP cache counts as not modified.
+     */
+    class ConditionalFetcher : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        ConditionalFetcher(const QUrl &url, const QString &cacheFile, QObject *parent = nullptr);
+        ~ConditionalFetcher();
+
+        void setUrl(const QUrl &url);
+        void setDefaultMaxAge(qint64 seconds);
+
+        QJsonDocument cached() const;
+        bool hasCache() const;
+        bool isFresh() const;
+        bool isRunning() const;
+
+    public slots:
+        void fetch(bool revalidate = false);
+        void abort();
+
+    signals:
+        void updated(const QJsonDocument &document);
+        void notModified();
+        void failed(const QString &errorString);
+
+    private slots:
+        void replyFinished();
+
+    private:
+        struct Meta
+        {
+            QByteArray eTag;
+            QByteArray lastModified;
+            qint64 fetched;
+            qint64 maxAge;
+        };
+
+        void loadMeta();
+        void saveMeta() const;
+        void updateFreshness(QNetworkReply *reply, bool *noStore);
+
+        QUrl url;
+        QString file;
+        QString metaFile;
+        qint64 defaultMaxAge;
+        Meta meta;
+        QJsonDocument document;
+
+        QPointer<QNetworkReply> reply;
+    };
+} // namespace Downloader
+
+#endif // CONDITIONALFETCHER_H
@@ -0,0 +1,395 @@
+#include "deltapatch.h"
+
+#include <QDebug>
+#include <QHash>
+#include <QVector>
+#include <QtEndian>
+
+#include <zlib.h>
+
+#include <cstring>
+
+namespace Updater
+{
+    static const char Magic[]     = "WXMDELTA";
+    static const quint32 Version  = 1;
+    static const int HeaderLength = 8 + 4 + 4 + 8 + 8 + 32 + 32;
+
+    static const char OpEnd  = 0x00;
+    static const char OpCopy = 0x01;
+    static const char OpData = 0x02;
+
+    // blocks of the old file, which are looked up in the new file
+    static const int BlockSize = 32;
+    // literal data is compressed in chunks of this size
+    static const int MaxLiteralLength = 1024 * 1024;
+
+    DeltaPatch::DeltaPatch(const QString &sourceFile, const QString &targetFile)
+        : source(sourceFile), target(targetFile), state(Header), inputPosition(0), targetSize(0),
+          targetHash(QCryptographicHash::Sha256), written(0)
+    {
+    }
+
+    DeltaPatch::~DeltaPatch()
+    {
+        sourceFile.close();
+        targetFile.close();
+    }
+
+    void DeltaPatch::addData(const QByteArray &data)
+    {
+        if (state == Done || state == Failed) {
+            return;
+        }
+        input.append(data);
+
+        bool progress = true;
+        while (progress) {
+            progress = (state == Header) ? readHeader() : (state == Operation) ? readOperation() : false;
+        }
+
+        if (inputPosition > 0) {
+            input.remove(0, inputPosition);
+            inputPosition = 0;
+        }
+    }
+
+    /**
+     * The patch download starts again from the first byte.
+     */
+    void DeltaPatch::restart()
+    {
+        sourceFile.close();
+        targetFile.close();
+        QFile::remove(target);
+
+        state = Header;
+        error.clear();
+        input.clear();
+        inputPosition = 0;
+        targetHash.reset();
+        written = 0;
+    }
+
+    /**
+     * Returns true, if the patch was applied completely and the target has the expected checksum.
+     */
+    bool DeltaPatch::finish()
+    {
+        if (state != Done) {
+            fail(QString("Incomplete patch"));
+        }
+        return state == Done;
+    }
+
+    QString DeltaPatch::errorString() const { return error; }
+
+    bool DeltaPatch::readHeader()
+    {
+        if (input.size() - inputPosition < HeaderLength) {
+            return false;
+        }
+
+        const uchar *p = reinterpret_cast<const uchar *>(input.constData()) + inputPosition;
+        if (std::memcmp(p, Magic, 8) != 0 || qFromLittleEndian<quint32>(p + 8) != Version) {
+            fail(QString("Not a patch file"));
+            return false;
+        }
+
+        const qint64 sourceSize         = static_cast<qint64>(qFromLittleEndian<quint64>(p + 16));
+        targetSize                      = static_cast<qint64>(qFromLittleEndian<quint64>(p + 24));
+        const QByteArray sourceSha256   = QByteArray(reinterpret_cast<const char *>(p + 32), 32);
+        targetSha256                    = QByteArray(reinterpret_cast<const char *>(p + 64), 32);
+        inputPosition += HeaderLength;
+
+        // the patch only applies to exactly the installed version
+        sourceFile.setFileName(source);
+        if (!sourceFile.open(QIODevice::ReadOnly) || sourceFile.size() != sourceSize) {
+            fail(QString("The patch does not apply to %1").arg(source));
+            return false;
+        }
+        QCryptographicHash sourceHash(QCryptographicHash::Sha256);
+        if (!sourceHash.addData(&sourceFile) || sourceHash.result() != sourceSha256) {
+            fail(QString("The patch does not apply to %1").arg(source));
+            return false;
+        }
+
+        targetFile.setFileName(target);
+        if (!targetFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            fail(QString("Cannot create %1: %2").arg(target, targetFile.errorString()));
+            return false;
+        }
+
+        state = Operation;
+        return true;
+    }
+
+    bool DeltaPatch::readOperation()
+    {
+        const int available = input.size() - inputPosition;
+        if (available < 1) {
+            return false;
+        }
+
+        const uchar *p = reinterpret_cast<const uchar *>(input.constData()) + inputPosition;
+
+        switch (static_cast<char>(p[0])) {
+            case OpEnd: {
+                inputPosition += 1;
+                targetFile.close();
+                sourceFile.close();
+                if (written != targetSize || targetHash.result() != targetSha256) {
+                    fail(QString("Checksum mismatch of the patched file"));
+                    return false;
+                }
+                state = Done;
+                return false;
+            }
+            case OpCopy: {
+                if (available < 13) {
+                    return false;
+                }
+                const qint64 offset = static_cast<qint64>(qFromLittleEndian<quint64>(p + 1));
+                qint64 length       = qFromLittleEndian<quint32>(p + 9);
+                inputPosition += 13;
+
+                if (offset < 0 || offset + length > sourceFile.size() || !sourceFile.seek(offset)) {
+                    fail(QString("Invalid copy operation"));
+                    return false;
+                }
+                char buffer[64 * 1024];
+                while (length > 0) {
+                    const qint64 bytesRead = sourceFile.read(buffer, qMin<qint64>(sizeof(buffer), length));
+                    if (bytesRead <= 0) {
+                        fail(QString("Cannot read %1").arg(source));
+                        return false;
+                    }
+                    if (!writeTarget(buffer, bytesRead)) {
+                        return false;
+                    }
+                    length -= bytesRead;
+                }
+                return true;
+            }
+            case OpData: {
+                if (available < 9) {
+                    return false;
+                }
+                const quint32 compressedLength = qFromLittleEndian<quint32>(p + 1);
+                const quint32 length           = qFromLittleEndian<quint32>(p + 5);
+                if (length > static_cast<quint64>(targetSize) || compressedLength > compressBound(length) + 64) {
+                    fail(QString("Invalid data operation"));
+                    return false;
+                }
+                if (static_cast<quint32>(available) < 9 + compressedLength) {
+                    return false;
+                }
+
+                QByteArray data(static_cast<int>(length), Qt::Uninitialized);
+                uLongf dataLength = length;
+                if (uncompress(reinterpret_cast<Bytef *>(data.data()), &dataLength, p + 9, compressedLength) != Z_OK ||
+                    dataLength != length) {
+                    fail(QString("Corrupt data in patch"));
+                    return false;
+                }
+                inputPosition += 9 + static_cast<int>(compressedLength);
+                return writeTarget(data.constData(), length);
+            }
+            default:
+                fail(QString("Unknown patch operation %1").arg(p[0]));
+                return false;
+        }
+    }
+
+    bool DeltaPatch::writeTarget(const char *data, qint64 length)
+    {
+        if (written + length > targetSize || targetFile.write(data, length) != length) {
+            fail(QString("Cannot write %1").arg(target));
+            return false;
+        }
+        targetHash.addData(data, static_cast<int>(length));
+        written += length;
+        return true;
+    }
+
+    void DeltaPatch::fail(const QString &message)
+    {
+        if (state != Failed) {
+            qDebug() << "[DeltaPatch]" << message;
+            error = message;
+            state = Failed;
+        }
+        sourceFile.close();
+        targetFile.close();
+        QFile::remove(target);
+    }
+
+    /**
+     * Creates a patch from the old to the new version of a file, e.g. for a release.
+     */
+    bool DeltaPatch::create(const QString &oldFile, const QString &newFile, const QString &patchFile,
+                            QString *errorMessage)
+    {
+        QFile oldIn(oldFile);
+        QFile newIn(newFile);
+        QFile out(patchFile);
+        if (!oldIn.open(QIODevice::ReadOnly) || !newIn.open(QIODevice::ReadOnly)) {
+            *errorMessage = QString("Cannot read %1 or %2").arg(oldFile, newFile);
+            return false;
+        }
+        if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+            *errorMessage = QString("Cannot create %1").arg(patchFile);
+            return false;
+        }
+
+        const QByteArray oldData = oldIn.readAll();
+        const QByteArray newData = newIn.readAll();
+        const uchar *o           = reinterpret_cast<const uchar *>(oldData.constData());
+        const uchar *n           = reinterpret_cast<const uchar *>(newData.constData());
+        const qint64 oldSize     = oldData.size();
+        const qint64 newSize     = newData.size();
+
+        QByteArray patch;
+        uchar number[8];
+
+        auto appendU32 = [&](quint32 value) {
+            qToLittleEndian<quint32>(value, number);
+            patch.append(reinterpret_cast<const char *>(number), 4);
+        };
+        auto appendU64 = [&](quint64 value) {
+            qToLittleEndian<quint64>(value, number);
+            patch.append(reinterpret_cast<const char *>(number), 8);
+        };
+
+        patch.append(Magic, 8);
+        appendU32(Version);
+        appendU32(BlockSize);
+        appendU64(oldSize);
+        appendU64(newSize);
+        patch.append(QCryptographicHash::hash(oldData, QCryptographicHash::Sha256));
+        patch.append(QCryptographicHash::hash(newData, QCryptographicHash::Sha256));
+
+        // weak checksum of a block: a = sum of the bytes, b = sum of the running sums (both mod 2^16)
+        quint32 a = 0;
+        quint32 b = 0;
+        auto checksum = [&](const uchar *data) {
+            a = 0;
+            b = 0;
+            for (int k = 0; k < BlockSize; ++k) {
+                a += data[k];
+                b += (BlockSize - k) * data[k];
+            }
+            a &= 0xFFFF;
+            b &= 0xFFFF;
+        };
+
+        // index the blocks of the old file
+        QHash<quint32, QVector<qint64>> blocks;
+        for (qint64 offset = 0; offset + BlockSize <= oldSize; offset += BlockSize) {
+            checksum(o + offset);
+            QVector<qint64> &candidates = blocks[a | (b << 16)];
+            if (candidates.size() < 16) {
+                candidates.append(offset);
+            }
+        }
+
+        QByteArray literal;
+        auto flushLiteral = [&]() {
+            if (literal.isEmpty()) {
+                return;
+            }
+            uLongf compressedLength = compressBound(static_cast<uLong>(literal.size()));
+            QByteArray compressed(static_cast<int>(compressedLength), Qt::Uninitialized);
+            compress2(reinterpret_cast<Bytef *>(compressed.data()), &compressedLength,
+                      reinterpret_cast<const Bytef *>(literal.constData()), static_cast<uLong>(literal.size()), 9);
+            patch.append(OpData);
+            appendU32(static_cast<quint32>(compressedLength));
+            appendU32(static_cast<quint32>(literal.size()));
+            patch.append(compressed.constData(), static_cast<int>(compressedLength));
+            literal.clear();
+        };
+
+        // scan the new file with a rolling checksum
+        qint64 i = 0;
+        if (newSize >= BlockSize) {
+            checksum(n);
+        }
+        while (i + BlockSize <= newSize) {
+            qint64 bestOffset = -1;
+            qint64 bestLength = 0;
+
+            const auto it = blocks.constFind(a | (b << 16));
+            if (it != blocks.constEnd()) {
+                for (qint64 offset : it.value()) {
+                    if (std::memcmp(o + offset, n + i, BlockSize) != 0) {
+                        continue;
+                    }
+                    qint64 length = BlockSize;
+                    while (offset + length < oldSize && i + length < newSize && o[offset + length] == n[i + length]) {
+                        ++length;
+                    }
+                    if (length > bestLength) {
+                        bestOffset = offset;
+                        bestLength = length;
+                    }
+                }
+            }
+
+            if (bestLength > 0) {
+                // the match might start within the pending literal, the copy then starts before i
+                while (!literal.isEmpty() && bestOffset > 0 &&
+                       o[bestOffset - 1] == static_cast<uchar>(literal.at(literal.size() - 1))) {
+                    literal.chop(1);
+                    --bestOffset;
+                    ++bestLength;
+                    --i;
+                }
+                flushLiteral();
+
+                // a copy is limited by its 32 bit length
+                while (bestLength > 0) {
+                    const qint64 length = qMin<qint64>(bestLength, 0x7FFFFFFF);
+                    patch.append(OpCopy);
+                    appendU64(static_cast<quint64>(bestOffset));
+                    appendU32(static_cast<quint32>(length));
+                    bestOffset += length;
+                    bestLength -= length;
+                    i += length;
+                }
+                if (i + BlockSize <= newSize) {
+                    checksum(n + i);
+                }
+                continue;
+            }
+
+            literal.append(static_cast<char>(n[i]));
+            if (literal.size() >= MaxLiteralLength) {
+                flushLiteral();
+            }
+
+            // roll the window one byte forward
+            if (i + BlockSize < newSize) {
+                const quint32 out = n[i];
+                const quint32 in  = n[i + BlockSize];
+                a                 = (a - out + in) & 0xFFFF;
+                b                 = (b - BlockSize * out + a) & 0xFFFF;
+            }
+            ++i;
+        }
+
+        if (i < newSize) {
+            literal.append(reinterpret_cast<const char *>(n + i), static_cast<int>(newSize - i));
+        }
+        flushLiteral();
+        patch.append(OpEnd);
+
+        if (out.write(patch) != patch.size()) {
+            *errorMessage = QString("Cannot write %1").arg(patchFile);
+            return false;
+        }
+
+        qDebug() << "[DeltaPatch] Created" << patchFile << "with" << patch.size() << "bytes for" << newSize
+                 << "bytes";
+        return true;
+    }
+} // namespace Updater
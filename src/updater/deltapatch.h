@@ -0,0 +1,74 @@
+#ifndef DELTAPATCH_H
+#define DELTAPATCH_H
+
+#include <QByteArray>
+#include <QCryptographicHash>
+#include <QFile>
+#include <QString>
+
+namespace Updater
+{
+    /**
+     * DeltaPatch is a binary delta between two versions of a file, e.g. "wpn-xm.exe".
+     *
+     * Patch format (little endian):
+     *
+     *   header  "WXMDELTA", u32 version, u32 block size, u64 source size, u64 target size,
+     *           32 bytes SHA-256 of the source, 32 bytes SHA-256 of the target
+     *   ops     0x01 COPY  u64 source offset, u32 length
+     *           0x02 DATA  u32 compressed length, u32 length, zlib compressed bytes
+     *           0x00 END
+     *
+     * create() finds the blocks of the new file, which already exist in the old file,
+     * with a rolling checksum (rsync-style). Everything else is stored compressed.
+     * A typical patch release changes a few functions, so the patch is a few kilobytes.
+     *
+     * The applier is streaming: the patch is fed while it downloads, the target file is
+     * written next to the source and verified against the SHA-256 in the header.
+     */
+    class DeltaPatch
+    {
+    public:
+        DeltaPatch(const QString &sourceFile, const QString &targetFile);
+        ~DeltaPatch();
+
+        void addData(const QByteArray &data);
+        void restart();
+        bool finish();
+        QString errorString() const;
+
+        static bool create(const QString &oldFile, const QString &newFile, const QString &patchFile,
+                           QString *errorMessage);
+
+    private:
+        enum State
+        {
+            Header,
+            Operation,
+            Done,
+            Failed
+        };
+
+        bool readHeader();
+        bool readOperation();
+        bool writeTarget(const char *data, qint64 length);
+        void fail(const QString &message);
+
+        QString source;
+        QString target;
+        State state;
+        QString error;
+
+        QByteArray input;
+        int inputPosition;
+
+        QFile sourceFile;
+        QFile targetFile;
+        qint64 targetSize;
+        QByteArray targetSha256;
+        QCryptographicHash targetHash;
+        qint64 written;
+    };
+} // namespace Updater
+
+#endif // DELTAPATCH_H
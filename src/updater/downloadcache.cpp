@@ -0,0 +1,244 @@
+#include "downloadcache.h"
+#include "../file/json.h"
+
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonObject>
+
+#ifdef Q_OS_WIN
+#include <Windows.h>
+#else
+#include <unistd.h>
+#endif
+
+namespace Downloader
+{
+    DownloadCache::DownloadCache(const QString &rootFolder)
+        : root(QDir::cleanPath(rootFolder)), indexFile(root + "/index.json"), totalSize(0),
+          maxSize(2048LL * 1024 * 1024)
+    {
+        load();
+    }
+
+    /**
+     * The cache shared by the updater and the self-updater.
+     */
+    DownloadCache &DownloadCache::shared()
+    {
+        static DownloadCache cache(QCoreApplication::applicationDirPath() + "/downloads/cache");
+        return cache;
+    }
+
+    QString DownloadCache::objectPath(const QByteArray &sha256) const
+    {
+        return root + "/" + QString::fromLatin1(sha256.left(2)) + "/" + QString::fromLatin1(sha256);
+    }
+
+    bool DownloadCache::contains(const QByteArray &sha256) const { return objects.contains(sha256.toLower()); }
+
+    bool DownloadCache::lookupUrl(const QUrl &url, UrlEntry *entry) const
+    {
+        auto it = urls.constFind(url.toString());
+        if (it == urls.constEnd() || !objects.contains(it.value().sha256)) {
+            return false;
+        }
+        *entry = it.value();
+        return true;
+    }
+
+    /**
+     * Puts the cached file with the given checksum at targetFile.
+     */
+    bool DownloadCache::materialize(const QByteArray &sha256, const QString &targetFile)
+    {
+        const QByteArray key = sha256.toLower();
+        if (!objects.contains(key)) {
+            return false;
+        }
+
+        const QString object = objectPath(key);
+        if (!QFile::exists(object)) {
+            totalSize -= objects.value(key).size;
+            objects.remove(key);
+            save();
+            return false;
+        }
+
+        if (QFile::exists(targetFile)) {
+            QFile::remove(targetFile);
+        }
+        if (!linkOrCopy(object, targetFile)) {
+            qDebug() << "[DownloadCache] Could not materialize" << key << "to" << targetFile;
+            return false;
+        }
+
+        touch(key);
+        save();
+        return true;
+    }
+
+    /**
+     * Adds a completely downloaded and verified file to the cache.
+     */
+    bool DownloadCache::insert(const QString &file, const QByteArray &sha256, const QUrl &url, const QByteArray &eTag,
+                               const QByteArray &lastModified)
+    {
+        const QByteArray key = sha256.toLower();
+        if (key.size() != 64) {
+            return false;
+        }
+
+        if (!objects.contains(key)) {
+            const QString object = objectPath(key);
+            QDir().mkpath(QFileInfo(object).absolutePath());
+
+            if (!QFile::exists(object) && !linkOrCopy(file, object)) {
+                qDebug() << "[DownloadCache] Could not add" << file;
+                return false;
+            }
+
+            Object entry;
+            entry.size     = QFileInfo(object).size();
+            entry.lastUsed = 0;
+            objects.insert(key, entry);
+            totalSize += entry.size;
+        }
+        touch(key);
+
+        UrlEntry urlEntry;
+        urlEntry.sha256       = key;
+        urlEntry.eTag         = eTag;
+        urlEntry.lastModified = lastModified;
+        urls.insert(url.toString(), urlEntry);
+
+        evict();
+        save();
+        return true;
+    }
+
+    void DownloadCache::touch(const QByteArray &sha256)
+    {
+        objects[sha256].lastUsed = QDateTime::currentMSecsSinceEpoch();
+    }
+
+    void DownloadCache::setMaxSize(qint64 bytes)
+    {
+        maxSize = bytes;
+        evict();
+        save();
+    }
+
+    qint64 DownloadCache::size() const { return totalSize; }
+
+    /**
+     * Removes the least recently used files, until the cache fits into maxSize.
+     * The most recently used file is always kept.
+     */
+    void DownloadCache::evict()
+    {
+        while (totalSize > maxSize && objects.size() > 1) {
+            auto oldest = objects.begin();
+            for (auto it = objects.begin(); it != objects.end(); ++it) {
+                if (it.value().lastUsed < oldest.value().lastUsed) {
+                    oldest = it;
+                }
+            }
+
+            const QByteArray key = oldest.key();
+            qDebug() << "[DownloadCache] Evicting" << key;
+
+            QFile::remove(objectPath(key));
+            totalSize -= oldest.value().size;
+            objects.erase(oldest);
+
+            for (auto it = urls.begin(); it != urls.end();) {
+                if (it.value().sha256 == key) {
+                    it = urls.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+    }
+
+    void DownloadCache::load()
+    {
+        const QJsonObject index = File::JSON::load(indexFile).object();
+
+        const QJsonObject objectList = index["objects"].toObject();
+        for (auto it = objectList.constBegin(); it != objectList.constEnd(); ++it) {
+            const QByteArray key = it.key().toLatin1();
+            if (!QFile::exists(objectPath(key))) {
+                continue;
+            }
+
+            const QJsonObject values = it.value().toObject();
+            Object entry;
+            entry.size     = static_cast<qint64>(values["size"].toDouble());
+            entry.lastUsed = static_cast<qint64>(values["lastUsed"].toDouble());
+            objects.insert(key, entry);
+            totalSize += entry.size;
+        }
+
+        const QJsonObject urlList = index["urls"].toObject();
+        for (auto it = urlList.constBegin(); it != urlList.constEnd(); ++it) {
+            const QJsonObject values = it.value().toObject();
+            UrlEntry entry;
+            entry.sha256       = values["sha256"].toString().toLatin1();
+            entry.eTag         = values["etag"].toString().toLatin1();
+            entry.lastModified = values["lastModified"].toString().toLatin1();
+            if (objects.contains(entry.sha256)) {
+                urls.insert(it.key(), entry);
+            }
+        }
+    }
+
+    void DownloadCache::save() const
+    {
+        QJsonObject objectList;
+        for (auto it = objects.constBegin(); it != objects.constEnd(); ++it) {
+            QJsonObject values;
+            values["size"]     = static_cast<double>(it.value().size);
+            values["lastUsed"] = static_cast<double>(it.value().lastUsed);
+            objectList.insert(QString::fromLatin1(it.key()), values);
+        }
+
+        QJsonObject urlList;
+        for (auto it = urls.constBegin(); it != urls.constEnd(); ++it) {
+            QJsonObject values;
+            values["sha256"]       = QString::fromLatin1(it.value().sha256);
+            values["etag"]         = QString::fromLatin1(it.value().eTag);
+            values["lastModified"] = QString::fromLatin1(it.value().lastModified);
+            urlList.insert(it.key(), values);
+        }
+
+        QJsonObject index;
+        index["objects"] = objectList;
+        index["urls"]    = urlList;
+
+        QDir().mkpath(root);
+        File::JSON::save(QJsonDocument(index), indexFile);
+    }
+
+    /**
+     * Hardlinks share the data on disk, so a cached file costs no extra space.
+     * Copying is the fallback for file systems without hardlinks (e.g. FAT32).
+     */
+    bool DownloadCache::linkOrCopy(const QString &from, const QString &to)
+    {
+#ifdef Q_OS_WIN
+        if (CreateHardLinkW(reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(to).utf16()),
+                            reinterpret_cast<LPCWSTR>(QDir::toNativeSeparators(from).utf16()), nullptr)) {
+            return true;
+        }
+#else
+        if (::link(QFile::encodeName(from).constData(), QFile::encodeName(to).constData()) == 0) {
+            return true;
+        }
+#endif
+        return QFile::copy(from, to);
+    }
+} // namespace Downloader
@@ -0,0 +1,69 @@
+#ifndef DOWNLOADCACHE_H
+#define DOWNLOADCACHE_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QString>
+#include <QUrl>
+
+namespace Downloader
+{
+    /**
+     * DownloadCache is a content-addressed store for downloaded files.
+     *
+     * Files are stored by their SHA-256 in "downloads/cache/<ab>/<sha256>" and
+     * handed out as hardlinks (or copies, where hardlinks are not supported).
+     * The URL, ETag and Last-Modified of each download are remembered, so that
+     * a download without a known checksum can be revalidated with a conditional request.
+     *
+     * The cache is limited in size, the least recently used files are evicted first.
+     * Old versions stay in the cache until evicted, so rolling back is a local operation.
+     */
+    class DownloadCache
+    {
+    public:
+        explicit DownloadCache(const QString &rootFolder);
+
+        static DownloadCache &shared();
+
+        struct UrlEntry
+        {
+            QByteArray sha256;
+            QByteArray eTag;
+            QByteArray lastModified;
+        };
+
+        bool contains(const QByteArray &sha256) const;
+        bool lookupUrl(const QUrl &url, UrlEntry *entry) const;
+        bool materialize(const QByteArray &sha256, const QString &targetFile);
+        bool insert(const QString &file, const QByteArray &sha256, const QUrl &url, const QByteArray &eTag,
+                    const QByteArray &lastModified);
+
+        void setMaxSize(qint64 bytes);
+        qint64 size() const;
+
+    private:
+        struct Object
+        {
+            qint64 size;
+            qint64 lastUsed;
+        };
+
+        QString objectPath(const QByteArray &sha256) const;
+        void touch(const QByteArray &sha256);
+        void evict();
+        void load();
+        void save() const;
+
+        static bool linkOrCopy(const QString &from, const QString &to);
+
+        QString root;
+        QString indexFile;
+        QHash<QByteArray, Object> objects;
+        QHash<QString, UrlEntry> urls;
+        qint64 totalSize;
+        qint64 maxSize;
+    };
+} // namespace Downloader
+
+#endif // DOWNLOADCACHE_H
@@ -1,18 +1,20 @@
 #include "downloadmanager.h"
 
 #include <QCoreApplication>
-#include <QSslError>
+
+#include <algorithm>
 
 namespace Downloader
 {
-    DownloadManager::DownloadManager() : queueMode(Parallel), FilesDownloadedCounter(0), FilesToDownloadCounter(0)
+    DownloadManager::DownloadManager()
+        : nam(NetworkService::shared().manager()), queueMode(Parallel), FilesDownloadedCounter(0),
+          FilesToDownloadCounter(0)
     {
-        connect(&nam, SIGNAL(finished(QNetworkReply *)), this, SLOT(finished(QNetworkReply *)));
+        qRegisterMetaType<Downloader::TransferProgress>("Downloader::TransferProgress");
 
-#ifndef QT_NO_SSL
-        connect(&nam, SIGNAL(sslErrors(QNetworkReply *, QList<QSslError>)), this,
-                SLOT(sslErrors(QNetworkReply *, QList<QSslError>)));
-#endif
+        // reads the data, which was held back by a bandwidth limit
+        throttleTimer.setInterval(50);
+        connect(&throttleTimer, SIGNAL(timeout()), this, SLOT(readThrottledTransfers()));
     }
 
     DownloadManager::~DownloadManager() {}
@@ -24,37 +26,48 @@ namespace Downloader
         get(request);
     }
 
-    void DownloadManager::get(QNetworkRequest &request)
+    void DownloadManager::get(QNetworkRequest &request, Priority priority)
     {
         qDebug() << "DownloadManager::get()"
                  << "Download enqueued.";
 
-        // set Request Headers
-        QString appVersion(qApp->applicationName() + qApp->applicationVersion());
-        const static QByteArray userAgent(QByteArray(appVersion.toStdString().c_str()));
-        request.setRawHeader("User-Agent", userAgent);
-        request.setAttribute(QNetworkRequest::HttpPipeliningAllowedAttribute, true);
+        // set Request Headers (user agent, HTTP/2, TLS) of the shared network stack,
+        // range requests of the download fall back to HTTP/1.1
+        NetworkService::shared().prepare(request, NetworkService::Http2);
+        // archives are kept in the DownloadCache, not in the HTTP cache
+        request.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+        request.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
 
         // set download item
         DownloadItem *dl = new DownloadItem(request, nam);
         dl->setDownloadFolder(downloadFolder);
         dl->setDownloadMode(downloadMode);
+        dl->setMaxSegments(maxSegments);
+        dl->setCache(cache);
+        dl->setBandwidthLimit(transferBandwidthLimit);
+        dl->setGlobalBandwidth(&globalBandwidth());
+        dl->priority = priority;
 
         // enqueue the download
         transfers.append(dl);
         FilesToDownloadCounter = transfers.count();
 
-        connect(dl, SIGNAL(transferFinished(TransferItem *)), SLOT(downloadFinished(TransferItem *)));
+        connect(dl, SIGNAL(transferFinished(Downloader::TransferItem *)),
+                SLOT(downloadFinished(Downloader::TransferItem *)));
     }
 
-    void DownloadManager::finished(QNetworkReply *) { qDebug() << "DownloadManager::finished()"; }
-
     void DownloadManager::downloadFinished(Downloader::TransferItem *item)
     {
-        qDebug() << "Download finished " << item->reply->url();
-        qDebug() << " with HTTP Status: " << item->reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
-        if (item->reply->error() != QNetworkReply::NoError) {
-            qDebug() << "and error: " << item->reply->error() << item->reply->errorString();
+        qDebug() << "Download finished " << item->request.url();
+        // skipped downloads have no reply
+        if (item->reply) {
+            qDebug() << " with HTTP Status: " << item->reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            if (item->reply->error() != QNetworkReply::NoError) {
+                qDebug() << "and error: " << item->reply->error() << item->reply->errorString();
+            }
+        }
+        if (item->failed) {
+            qDebug() << "[Downloader] Download failed:" << item->errorString;
         }
         transfers.removeOne(item);
         FilesToDownloadCounter = transfers.count();
@@ -63,36 +76,125 @@ namespace Downloader
         checkForAllDone();
     }
 
+    /**
+     * Schedules the queued transfers.
+     *
+     * Transfers are started by priority (and in the order they were enqueued),
+     * until the concurrency limit is reached. The remaining queued transfers
+     * are told their position in the queue.
+     */
     void DownloadManager::checkForAllDone()
     {
         if (transfers.isEmpty()) {
             qDebug() << "[Downloader] Download queue is now empty! All Done.";
             FilesDownloadedCounter = FilesToDownloadCounter = 0;
+            throttleTimer.stop();
             return;
         }
 
+        // in serial mode, only one transfer runs at a time
+        const int maxRunning = (queueMode == Serial) ? 1 : qMax(1, maxConcurrentTransfers);
+
+        int running = 0;
+        QList<TransferItem *> queued;
         foreach (TransferItem *item, transfers) {
-            if (!item->reply) {
+            if (item->state == TransferItem::Running) {
+                ++running;
+            } else if (item->state == TransferItem::Queued) {
+                queued.append(item);
+            }
+        }
+
+        std::stable_sort(queued.begin(), queued.end(),
+                         [](const TransferItem *a, const TransferItem *b) { return a->priority > b->priority; });
+
+        int position = 0;
+        foreach (TransferItem *item, queued) {
+            if (running < maxRunning) {
                 item->startGetRequest();
-                // by default multiple downloads are processed in parallel.
-                // but in serial mode, only one transfer starts at a time.
-                if (queueMode == Serial) {
-                    break;
-                }
+                ++running;
+            } else {
+                item->setQueuePosition(++position);
             }
         }
+
+        const bool throttled = transferBandwidthLimit > 0 || globalBandwidth().isLimited();
+        if (throttled && running > 0) {
+            throttleTimer.start();
+        } else {
+            throttleTimer.stop();
+        }
     }
 
-#ifndef QT_NO_SSL
-    void DownloadManager::sslErrors(QNetworkReply *, const QList<QSslError> &errors)
+    void DownloadManager::readThrottledTransfers()
     {
-        qDebug() << "sslErrors";
-        foreach (const QSslError &error, errors) {
-            qDebug() << error.errorString();
-            qDebug() << error.certificate().toPem();
+        // higher priorities get the tokens first
+        QList<TransferItem *> running;
+        foreach (TransferItem *item, transfers) {
+            if (item->state == TransferItem::Running) {
+                running.append(item);
+            }
         }
+        std::stable_sort(running.begin(), running.end(),
+                         [](const TransferItem *a, const TransferItem *b) { return a->priority > b->priority; });
+
+        foreach (TransferItem *item, running) {
+            item->readPending();
+        }
+    }
+
+    void DownloadManager::pause(TransferItem *item)
+    {
+        if (!item || !transfers.contains(item)) {
+            return;
+        }
+        item->pause();
+        item->setQueuePosition(0);
+
+        // a paused transfer frees its slot for the next one
+        QMetaObject::invokeMethod(this, "checkForAllDone", Qt::QueuedConnection);
+    }
+
+    void DownloadManager::resume(TransferItem *item)
+    {
+        if (!item || !transfers.contains(item) || item->state != TransferItem::Paused) {
+            return;
+        }
+        item->state = TransferItem::Queued;
+        checkForAllDone();
+    }
+
+    void DownloadManager::pauseAll()
+    {
+        foreach (TransferItem *item, transfers) {
+            pause(item);
+        }
+    }
+
+    void DownloadManager::resumeAll()
+    {
+        foreach (TransferItem *item, transfers) {
+            if (item->state == TransferItem::Paused) {
+                item->state = TransferItem::Queued;
+            }
+        }
+        checkForAllDone();
+    }
+
+    /**
+     * The global bandwidth limit is shared by all download managers,
+     * e.g. the self-updater and the updater dialog.
+     */
+    TokenBucket &DownloadManager::globalBandwidth()
+    {
+        static TokenBucket bucket;
+        return bucket;
+    }
+
+    void DownloadManager::setGlobalBandwidthLimit(qint64 bytesPerSecond)
+    {
+        globalBandwidth().setRate(bytesPerSecond);
     }
-#endif
 
     TransferItem *DownloadManager::findTransfer(const QUrl &url)
     {
@@ -119,4 +221,18 @@ namespace Downloader
     void DownloadManager::setDownloadFolder(QString folder) { downloadFolder = folder; }
 
     void DownloadManager::setDownloadMode(DownloadItem::DownloadMode mode) { downloadMode = mode; }
+
+    void DownloadManager::setMaxSegments(int segmentCount) { maxSegments = segmentCount; }
+
+    void DownloadManager::setCache(DownloadCache *downloadCache) { cache = downloadCache; }
+
+    void DownloadManager::setMaxConcurrentTransfers(int count) { maxConcurrentTransfers = count; }
+
+    void DownloadManager::setTransferBandwidthLimit(qint64 bytesPerSecond)
+    {
+        transferBandwidthLimit = bytesPerSecond;
+        foreach (TransferItem *item, transfers) {
+            item->setBandwidthLimit(bytesPerSecond);
+        }
+    }
 } // namespace Downloader
@@ -1,11 +1,23 @@
 #ifndef DOWNLOADMANAGER_H
 #define DOWNLOADMANAGER_H
 
+#include <QCryptographicHash>
 #include <QElapsedTimer>
 #include <QFile>
+#include <QJsonObject>
 #include <QNetworkAccessManager>
 #include <QNetworkReply>
 #include <QNetworkRequest>
+#include <QPointer>
+#include <QTimer>
+#include <QVector>
+
+#include "downloadcache.h"
+#include "filesink.h"
+#include "mirrorselector.h"
+#include "networkservice.h"
+#include "tokenbucket.h"
+#include "transferprogress.h"
 
 namespace Downloader
 {
@@ -14,14 +26,43 @@ namespace Downloader
         Q_OBJECT
     public:
         TransferItem(const QNetworkRequest &r, QNetworkAccessManager &n);
-        void startGetRequest();
+        virtual void startGetRequest();
+        virtual void pause();
+        virtual void readPending();
+
+        enum State
+        {
+            Queued,
+            Running,
+            Paused,
+            Done
+        };
+
+        void setBandwidthLimit(qint64 bytesPerSecond);
+        void setGlobalBandwidth(TokenBucket *bucket);
+        void setExpectedChecksum(const QByteArray &sha256Hex);
+        void setMirrors(const QList<QUrl> &urls);
+        void setQueuePosition(int position);
     signals:
-        void downloadProgress(QMap<QString, QVariant>);
-        void transferFinished(TransferItem *self);
+        void downloadProgress(const Downloader::TransferProgress &progress);
+        void transferFinished(Downloader::TransferItem *self);
+        void queuePositionChanged(int position);
+        // the bytes of the file in order; the data is only valid during the call
+        void streamData(const QByteArray &data);
+        void streamRestarted();
     public slots:
         void updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal);
     private slots:
         void finished();
+        void emitProgress();
+        void flushProgress();
+
+    protected:
+        qint64 readAllowance(QNetworkReply *source, bool all = false);
+        void consumeBandwidth(qint64 bytes);
+        void applyReadBufferSize(QNetworkReply *source);
+        void addStreamData(const char *data, int length);
+        void resetStream();
 
     public:
         QNetworkRequest request;
@@ -31,10 +72,29 @@ namespace Downloader
         QFile *outputFile;
         QList<QUrl> redirects;
         QElapsedTimer timer;
-        QMap<QString, QVariant> progress;
+        TransferProgress progress;
+        qint64 progressOffset; // bytes already on disk, when the download was resumed
+        State state;
+        int priority;
+        int queuePosition; // 1..n while queued, 0 otherwise
+        TokenBucket bandwidth;
+        TokenBucket *globalBandwidth;
+
+        // the SHA-256 is calculated while the bytes arrive, in file order
+        QCryptographicHash hash;
+        qint64 hashedBytes;
+        QByteArray expectedSha256; // hex, empty = not verified
+        QByteArray sha256; // hex, set when the download is complete
+        QList<QUrl> mirrors; // further URLs of the same file
+        bool failed;
+        QString errorString;
 
     private:
-        QString getSizeHumanReadable(qint64 bytes);
+        QTimer progressTimer;
+        QElapsedTimer progressClock;
+        bool progressChanged;
+        qint64 lastSampleTime;
+        qint64 lastSampleBytes;
     };
 
     class DownloadItem : public TransferItem
@@ -43,7 +103,13 @@ namespace Downloader
     public:
         DownloadItem(const QNetworkRequest &r, QNetworkAccessManager &nam);
         ~DownloadItem();
+        void startGetRequest() override;
+        void pause() override;
+        void readPending() override;
         void setDownloadFolder(QString folder);
+        void setMaxSegments(int segmentCount);
+        void setCache(DownloadCache *downloadCache);
+        QString fileName() const;
         enum DownloadMode
         {
             SkipIfExists,
@@ -53,13 +119,93 @@ namespace Downloader
         void setDownloadMode(DownloadItem::DownloadMode mode);
 
     private:
+        void sendRequest(const QNetworkRequest &r);
+        QString getTargetFilePath();
+        qint64 loadPartialState();
+        void savePartialState();
+        void removePartialState();
+        void checkResponse();
+        void readBody(bool all = false);
+        bool completeDownload();
+        bool hashFileRange(QFile &file, qint64 from, qint64 to);
+        void hashSegments();
+        void stopPaused();
+
+        void sendFirstRequest();
+        QNetworkRequest mirrorRequest() const;
+        QList<QUrl> mirrorCandidates() const;
+        bool canContinueOn(const QUrl &mirror) const;
+        void setRangeHeaders(QNetworkRequest &r, qint64 from, qint64 to = -1) const;
+        bool switchMirror(const QString &reason);
+        void continueOnMirror();
+        bool retrySegment(int i, QNetworkReply *segmentReply);
+
+        bool canSegment() const;
+        void startSegments(qint64 size);
+        void resumeSegments();
+        void requestSegment(int i);
+        int indexOfSegment(QNetworkReply *segmentReply) const;
+        void readSegment(QNetworkReply *segmentReply, bool drain = false);
+        void finishSegment(QNetworkReply *segmentReply);
+        void abortSegments();
+        qint64 loadSegmentState(const QJsonObject &state, qint64 partFileSize);
+
         QString downloadFolder;
         bool downloadSkipped;
-    signals:
-        void transferFinished(Downloader::TransferItem *self);
+
+        // the download is written to "<target>.part", the resume state to "<target>.part.json"
+        QString targetFilePath;
+        QString partFilePath;
+        QString stateFilePath;
+        FileSink sink;
+        QNetworkRequest currentRequest;
+        QByteArray eTag;
+        QByteArray lastModified;
+        qint64 resumeOffset;
+        QElapsedTimer stateTimer;
+        bool responseChecked;
+        bool writeBody;
+        bool restartWithoutRange;
+        bool rangeRetried;
+
+        // segmented download: byte ranges of one file, fetched concurrently
+        struct Segment
+        {
+            qint64 start;
+            qint64 end; // inclusive
+            qint64 offset; // next byte to write
+            QNetworkReply *reply;
+            bool checked;
+            QUrl url; // the URL the segment was requested from
+        };
+        QVector<Segment> segments;
+        int maxSegments;
+        bool segmentingDisabled;
+        qint64 fileSize;
+        qint64 segmentBytes;
+        QUrl segmentUrl;
+
+        DownloadCache *cache;
+        QByteArray cachedSha256; // the cached file, if the request is a revalidation
+
+        // mirrors: the running requests go to currentMirror, eTag and lastModified are from validatorMirror
+        QUrl currentMirror;
+        QUrl validatorMirror;
+        QList<QUrl> failedMirrors;
+        QPointer<MirrorRace> mirrorRace;
+        QTimer mirrorTimer;
+        qint64 mirrorSampleBytes;
+        int slowTicks;
+        bool switchingMirror;
     private slots:
         void readyRead();
         void finished();
+        void segmentReadyRead();
+        void segmentFinished();
+        void completeSegments();
+        void mirrorRaceFinished(const QUrl &winner);
+        void checkMirrorThroughput();
+        void stopMirrorWatchdog();
     };
 
     class DownloadManager : public QObject
@@ -69,36 +215,55 @@ namespace Downloader
         DownloadManager();
         ~DownloadManager();
         void get(QNetworkRequest &request, QString dlFolder, DownloadItem::DownloadMode dlMode);
-        void get(QNetworkRequest &request);
+        enum Priority
+        {
+            LowPriority    = -1,
+            NormalPriority = 0,
+            HighPriority   = 1
+        };
+        void get(QNetworkRequest &request, Priority priority = NormalPriority);
         enum QueueMode
         {
             Parallel,
             Serial
         };
         void setQueueMode(QueueMode mode);
+        void setMaxConcurrentTransfers(int count);
+        void setTransferBandwidthLimit(qint64 bytesPerSecond);
+        static void setGlobalBandwidthLimit(qint64 bytesPerSecond);
         TransferItem *findTransfer(const QUrl &url);
 
+        void pause(TransferItem *item);
+        void resume(TransferItem *item);
+        void pauseAll();
+        void resumeAll();
+
         void setDownloadFolder(QString downloadFolder);
         void setDownloadMode(DownloadItem::DownloadMode mode);
+        void setMaxSegments(int segmentCount);
+        void setCache(DownloadCache *downloadCache);
 
     public slots:
         void checkForAllDone();
 
     private slots:
-        void finished(QNetworkReply *reply);
-#ifndef QT_NO_SSL
-        void sslErrors(QNetworkReply *reply, const QList<QSslError> &errors);
-#endif
-        void downloadFinished(TransferItem *item);
+        void downloadFinished(Downloader::TransferItem *item);
+        void readThrottledTransfers();
 
     private:
         TransferItem *findTransfer(QNetworkReply *reply);
+        static TokenBucket &globalBandwidth();
 
-        QNetworkAccessManager nam;
+        QNetworkAccessManager &nam;
         QList<TransferItem *> transfers;
         QueueMode queueMode;
         QString downloadFolder;
         DownloadItem::DownloadMode downloadMode = DownloadItem::DownloadMode::SkipIfExists;
+        int maxSegments                         = 4;
+        int maxConcurrentTransfers              = 4;
+        DownloadCache *cache                    = &DownloadCache::shared();
+        qint64 transferBandwidthLimit           = 0;
+        QTimer throttleTimer;
 
     public:
         int FilesDownloadedCounter;
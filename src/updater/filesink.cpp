@@ -0,0 +1,368 @@
+#include "filesink.h"
+
+#include <QDebug>
+#include <QMutexLocker>
+#include <QThread>
+
+#ifdef Q_OS_WIN
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600 // SetFileInformationByHandle
+#endif
+#include <Windows.h>
+#include <io.h>
+#elif defined(Q_OS_LINUX)
+#include <fcntl.h>
+#endif
+
+namespace Downloader
+{
+    class FileSink::Writer : public QThread
+    {
+    public:
+        explicit Writer(FileSink *s) : sink(s) {}
+
+    protected:
+        void run() override { sink->writerLoop(); }
+
+    private:
+        FileSink *sink;
+    };
+
+    FileSink::FileSink()
+        : end(0), reserved(0), threaded(false), writer(nullptr), busy(0), stopping(false), error(false)
+    {
+    }
+
+    FileSink::~FileSink() { close(); }
+
+    bool FileSink::open(const QString &fileName, OpenMode mode)
+    {
+        close();
+
+        error = false;
+        errorMessage.clear();
+        end      = 0;
+        reserved = 0;
+
+        // the sink does its own buffering
+        QIODevice::OpenMode flags = QIODevice::ReadWrite | QIODevice::Unbuffered;
+        if (mode == Truncate) {
+            flags |= QIODevice::Truncate;
+        }
+
+        file.setFileName(fileName);
+        if (!file.open(flags)) {
+            setError(file.errorString());
+            return false;
+        }
+        end = file.size();
+
+        if (threaded) {
+            startWriter();
+        }
+        return true;
+    }
+
+    bool FileSink::isOpen() const { return file.isOpen(); }
+
+    /**
+     * Writes the buffered data and closes the file.
+     * Returns false, if any write failed.
+     */
+    bool FileSink::close()
+    {
+        if (!file.isOpen()) {
+            return !hasError();
+        }
+
+        flush();
+        stopWriter();
+
+        // release the reserved space of an unfinished download
+        if (reserved > end) {
+            file.resize(end);
+        }
+        reserved = 0;
+
+        file.close();
+        runs.clear();
+        freeBuffers.clear();
+        return !hasError();
+    }
+
+    /**
+     * Reserves the disk space for a file of the given size, without changing its size.
+     * A file, which is allocated at once, is not fragmented by the many small appends of a download.
+     */
+    bool FileSink::preallocate(qint64 size)
+    {
+        if (!file.isOpen() || size <= end || size <= reserved) {
+            return true;
+        }
+
+        bool allocated = false;
+#ifdef Q_OS_WIN
+        FILE_ALLOCATION_INFO info;
+        info.AllocationSize.QuadPart = size;
+        HANDLE handle                = reinterpret_cast<HANDLE>(_get_osfhandle(file.handle()));
+        allocated = SetFileInformationByHandle(handle, FileAllocationInfo, &info, sizeof(info)) != 0;
+#elif defined(Q_OS_LINUX)
+        allocated = fallocate(file.handle(), FALLOC_FL_KEEP_SIZE, 0, size) == 0;
+#endif
+
+        if (!allocated) {
+            qDebug() << "[FileSink] Could not reserve" << size << "bytes for" << file.fileName();
+            return false;
+        }
+        reserved = size;
+        return true;
+    }
+
+    /**
+     * Sets the size of the file, e.g. for a segmented download, which writes at any position.
+     */
+    bool FileSink::resize(qint64 size)
+    {
+        flush();
+        if (!file.resize(size)) {
+            setError(file.errorString());
+            return false;
+        }
+        end = size;
+        return true;
+    }
+
+    void FileSink::setThreaded(bool enabled)
+    {
+        if (threaded == enabled) {
+            return;
+        }
+        threaded = enabled;
+
+        if (file.isOpen()) {
+            if (threaded) {
+                startWriter();
+            } else {
+                flush();
+                stopWriter();
+            }
+        }
+    }
+
+    /**
+     * Reads up to maxBytes from the source and writes them at the given position.
+     * The observer (e.g. a hash) sees the bytes, while they are in the buffer.
+     * Returns the number of bytes read.
+     */
+    qint64 FileSink::write(qint64 position, QIODevice *source, qint64 maxBytes, const Observer &observer)
+    {
+        if (!file.isOpen() || maxBytes <= 0) {
+            return 0;
+        }
+
+        qint64 total = 0;
+        while (total < maxBytes) {
+            Run &run = runAt(position + total);
+
+            // a buffer is written, when it reaches the next chunk boundary of the file
+            const int capacity = ChunkSize - static_cast<int>(run.position % ChunkSize);
+
+            const qint64 bytesRead =
+                source->read(run.buffer.data() + run.length, qMin<qint64>(capacity - run.length, maxBytes - total));
+            if (bytesRead <= 0) {
+                break;
+            }
+
+            if (observer) {
+                observer(run.buffer.constData() + run.length, static_cast<int>(bytesRead));
+            }
+            run.length += static_cast<int>(bytesRead);
+            total += bytesRead;
+            end = qMax(end, run.position + run.length);
+
+            if (run.length == capacity) {
+                submit(run);
+            }
+        }
+        return total;
+    }
+
+    qint64 FileSink::append(QIODevice *source, qint64 maxBytes, const Observer &observer)
+    {
+        return write(end, source, maxBytes, observer);
+    }
+
+    /**
+     * Writes all buffered data. In threaded mode, this waits for the writer thread.
+     */
+    bool FileSink::flush()
+    {
+        for (Run &run : runs) {
+            submit(run);
+        }
+
+        if (writer) {
+            QMutexLocker locker(&mutex);
+            while (busy > 0) {
+                chunkWritten.wait(&mutex);
+            }
+        }
+        return !hasError();
+    }
+
+    qint64 FileSink::size() const { return end; }
+
+    bool FileSink::hasError() const
+    {
+        QMutexLocker locker(&mutex);
+        return error;
+    }
+
+    QString FileSink::errorString() const
+    {
+        QMutexLocker locker(&mutex);
+        return errorMessage;
+    }
+
+    /**
+     * Returns the buffer, which continues at the position.
+     * Without one, a free buffer is used, or the first one is written to make room.
+     */
+    FileSink::Run &FileSink::runAt(qint64 position)
+    {
+        for (Run &run : runs) {
+            if (run.position + run.length == position) {
+                return run;
+            }
+        }
+
+        int i = -1;
+        for (int j = 0; j < runs.size() && i < 0; ++j) {
+            if (runs.at(j).length == 0) {
+                i = j;
+            }
+        }
+        if (i < 0 && runs.size() < MaxRuns) {
+            Run run;
+            run.buffer = QByteArray(ChunkSize, Qt::Uninitialized);
+            run.length = 0;
+            runs.append(run);
+            i = runs.size() - 1;
+        }
+        if (i < 0) {
+            i = 0;
+            submit(runs[0]);
+        }
+
+        runs[i].position = position;
+        return runs[i];
+    }
+
+    /**
+     * Writes the buffer of a run, directly or by handing it to the writer thread.
+     * The run continues behind the written data with an empty buffer.
+     */
+    void FileSink::submit(Run &run)
+    {
+        if (run.length == 0) {
+            return;
+        }
+
+        if (!writer) {
+            writeChunk(run);
+        } else {
+            QMutexLocker locker(&mutex);
+
+            // limit the memory used by a slow disk
+            while (busy >= MaxQueued) {
+                chunkWritten.wait(&mutex);
+            }
+
+            queue.enqueue(run);
+            ++busy;
+            chunkQueued.wakeOne();
+
+            // continue with a written buffer from the pool
+            if (freeBuffers.isEmpty()) {
+                run.buffer = QByteArray(ChunkSize, Qt::Uninitialized);
+            } else {
+                run.buffer = freeBuffers.takeLast();
+            }
+        }
+
+        run.position += run.length;
+        run.length = 0;
+    }
+
+    void FileSink::writeChunk(const Run &chunk)
+    {
+        // after a failed write, the file ends at the failed chunk
+        if (hasError()) {
+            return;
+        }
+
+        if (!file.seek(chunk.position) || file.write(chunk.buffer.constData(), chunk.length) != chunk.length) {
+            setError(file.errorString());
+            qDebug() << "[FileSink] Write failed:" << file.fileName() << file.errorString();
+        }
+    }
+
+    void FileSink::setError(const QString &message)
+    {
+        QMutexLocker locker(&mutex);
+        if (!error) {
+            error        = true;
+            errorMessage = message;
+        }
+    }
+
+    void FileSink::startWriter()
+    {
+        if (writer) {
+            return;
+        }
+        stopping = false;
+        writer   = new Writer(this);
+        writer->start();
+    }
+
+    void FileSink::stopWriter()
+    {
+        if (!writer) {
+            return;
+        }
+
+        {
+            QMutexLocker locker(&mutex);
+            stopping = true;
+            chunkQueued.wakeAll();
+        }
+        writer->wait();
+        delete writer;
+        writer = nullptr;
+    }
+
+    void FileSink::writerLoop()
+    {
+        QMutexLocker locker(&mutex);
+        forever
+        {
+            while (queue.isEmpty() && !stopping) {
+                chunkQueued.wait(&mutex);
+            }
+            if (queue.isEmpty()) {
+                return;
+            }
+
+            const Run chunk = queue.dequeue();
+
+            locker.unlock();
+            writeChunk(chunk);
+            locker.relock();
+
+            freeBuffers.append(chunk.buffer);
+            --busy;
+            chunkWritten.wakeAll();
+        }
+    }
+} // namespace Downloader
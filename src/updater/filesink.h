@@ -0,0 +1,101 @@
+#ifndef FILESINK_H
+#define FILESINK_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QIODevice>
+#include <QMutex>
+#include <QQueue>
+#include <QVector>
+#include <QWaitCondition>
+
+#include <functional>
+
+namespace Downloader
+{
+    /**
+     * FileSink writes a download to disk.
+     *
+     * Data is read from the reply straight into fixed buffers, which are reused for
+     * the whole download, and written in large chunks aligned to the chunk size.
+     * A segmented download writes at several positions at once, so there is one
+     * buffer per write position ("run").
+     *
+     * The disk space for the whole file is reserved up front, when the size is known.
+     * Optionally, the chunks are written by a writer thread, so that a slow disk
+     * does not block the event loop.
+     */
+    class FileSink
+    {
+    public:
+        FileSink();
+        ~FileSink();
+
+        enum OpenMode
+        {
+            Truncate, // start a new file
+            Append // keep the content, writes continue at the end (or at any position)
+        };
+
+        bool open(const QString &fileName, OpenMode mode);
+        bool isOpen() const;
+        bool close();
+
+        bool preallocate(qint64 size);
+        bool resize(qint64 size);
+        void setThreaded(bool enabled);
+
+        // sees the bytes, while they are in the buffer
+        typedef std::function<void(const char *data, int length)> Observer;
+
+        qint64 write(qint64 position, QIODevice *source, qint64 maxBytes, const Observer &observer = Observer());
+        qint64 append(QIODevice *source, qint64 maxBytes, const Observer &observer = Observer());
+        bool flush();
+
+        qint64 size() const;
+        bool hasError() const;
+        QString errorString() const;
+
+        static const int ChunkSize = 1024 * 1024;
+        static const int MaxRuns   = 8;
+        static const int MaxQueued = 2;
+
+    private:
+        struct Run
+        {
+            QByteArray buffer;
+            qint64 position; // file position of the first buffered byte
+            int length;
+        };
+
+        class Writer;
+
+        Run &runAt(qint64 position);
+        void submit(Run &run);
+        void writeChunk(const Run &chunk);
+        void setError(const QString &message);
+        void startWriter();
+        void stopWriter();
+        void writerLoop();
+
+        QFile file;
+        qint64 end; // logical size of the file
+        qint64 reserved; // disk space reserved beyond "end"
+        QVector<Run> runs;
+
+        // writer thread: full buffers are queued, written buffers come back to the pool
+        bool threaded;
+        Writer *writer;
+        mutable QMutex mutex;
+        QWaitCondition chunkQueued;
+        QWaitCondition chunkWritten;
+        QQueue<Run> queue;
+        QVector<QByteArray> freeBuffers;
+        int busy; // chunks queued or being written
+        bool stopping;
+        bool error;
+        QString errorMessage;
+    };
+} // namespace Downloader
+
+#endif // FILESINK_H
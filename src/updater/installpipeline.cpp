@@ -0,0 +1,179 @@
+#include "installpipeline.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QtConcurrent>
+
+namespace Updater
+{
+    // when the extraction falls this far behind the download, the file is extracted afterwards
+    static const qint64 MaxPendingBytes = 64 * 1024 * 1024;
+
+    InstallPipeline::InstallPipeline(Downloader::DownloadItem *transfer, const QString &targetFolder,
+                                     ZipExtractor::CommitMode mode, const ZipExtractor::EntryFilter &entryFilter,
+                                     QObject *parent)
+        : QObject(parent), target(QDir::cleanPath(targetFolder)), stagingFolder(target + ".extracting"),
+          commitMode(mode), filter(entryFilter), unzip(nullptr), streaming(true), deferredCommit(false)
+    {
+        ZipExtractor::recover(target);
+
+        unzip = new StreamingUnzip(stagingFolder, filter);
+        unzip->moveToThread(&thread);
+        connect(unzip, SIGNAL(finished(bool, QString)), this, SLOT(unzipFinished(bool, QString)));
+        thread.start();
+
+        connect(&extractWatcher, SIGNAL(finished()), this, SLOT(extractFinished()));
+
+        connect(transfer, SIGNAL(streamData(QByteArray)), this, SLOT(streamData(QByteArray)));
+        connect(transfer, SIGNAL(streamRestarted()), this, SLOT(streamRestarted()));
+        connect(transfer, SIGNAL(transferFinished(Downloader::TransferItem *)), this,
+                SLOT(transferFinished(Downloader::TransferItem *)));
+    }
+
+    InstallPipeline::~InstallPipeline()
+    {
+        stopUnzip();
+        extractWatcher.waitForFinished();
+    }
+
+    /**
+     * With a deferred commit, the package is only staged: finished() is emitted, when
+     * "<target>.extracting" is complete. The caller commits it, e.g. with other packages at once.
+     */
+    void InstallPipeline::setDeferredCommit(bool deferred) { deferredCommit = deferred; }
+
+    QString InstallPipeline::stagingPath() const { return stagingFolder; }
+
+    void InstallPipeline::streamData(const QByteArray &data)
+    {
+        if (!streaming) {
+            return;
+        }
+
+        // do not buffer the whole archive in memory, if the disk is slower than the network
+        if (unzip->pendingBytes() > MaxPendingBytes) {
+            qDebug() << "[InstallPipeline] Extraction is behind the download, extracting" << target
+                     << "after the download.";
+            streaming = false;
+            QMetaObject::invokeMethod(unzip, "abort", Qt::QueuedConnection);
+            return;
+        }
+
+        unzip->post(data);
+    }
+
+    void InstallPipeline::streamRestarted()
+    {
+        if (streaming) {
+            QMetaObject::invokeMethod(unzip, "restart", Qt::QueuedConnection);
+        }
+    }
+
+    void InstallPipeline::transferFinished(Downloader::TransferItem *transfer)
+    {
+        auto *download = qobject_cast<Downloader::DownloadItem *>(transfer);
+        archiveFile    = download ? download->fileName() : QString();
+
+        // the checksum was verified by the download, on the same stream
+        if (transfer->failed || archiveFile.isEmpty() || !QFile::exists(archiveFile)) {
+            done(false, transfer->failed ? transfer->errorString : tr("Download failed"));
+            return;
+        }
+
+        if (!streaming) {
+            extractFile();
+            return;
+        }
+
+        // the unzip reports back, after it has processed all data
+        QMetaObject::invokeMethod(unzip, "finish", Qt::QueuedConnection);
+    }
+
+    void InstallPipeline::unzipFinished(bool complete, const QString &errorString)
+    {
+        stopUnzip();
+
+        if (!complete) {
+            qDebug() << "[InstallPipeline] Streaming extraction failed:" << errorString;
+            extractFile();
+            return;
+        }
+
+        if (deferredCommit) {
+            qDebug() << "[InstallPipeline] Staged" << archiveFile << "while downloading.";
+            done(true, QString());
+            return;
+        }
+
+        QString commitError;
+        if (!ZipExtractor::commit(stagingFolder, target, commitMode, &commitError)) {
+            QDir(stagingFolder).removeRecursively();
+            done(false, commitError);
+            return;
+        }
+
+        qDebug() << "[InstallPipeline] Installed" << archiveFile << "to" << target << "while downloading.";
+        done(true, QString());
+    }
+
+    void InstallPipeline::stopUnzip()
+    {
+        if (thread.isRunning()) {
+            thread.quit();
+            thread.wait();
+        }
+        delete unzip;
+        unzip     = nullptr;
+        streaming = false;
+    }
+
+    void InstallPipeline::extractFile()
+    {
+        stopUnzip();
+
+        // the workers of the extractor are waited for, which would block the GUI thread
+        const QString archive                  = archiveFile;
+        const QString targetFolder             = target;
+        const ZipExtractor::EntryFilter filter = this->filter;
+        extractWatcher.setFuture(QtConcurrent::run([archive, targetFolder, filter]() {
+            ZipExtractor extractor(archive);
+            extractor.setEntryFilter(filter);
+            const bool staged = extractor.stage(targetFolder);
+            return qMakePair(staged, extractor.errorString());
+        }));
+    }
+
+    void InstallPipeline::extractFinished()
+    {
+        const QPair<bool, QString> result = extractWatcher.result();
+        if (!result.first) {
+            done(false, result.second);
+            return;
+        }
+
+        if (deferredCommit) {
+            qDebug() << "[InstallPipeline] Staged" << archiveFile;
+            done(true, QString());
+            return;
+        }
+
+        QString commitError;
+        if (!ZipExtractor::commit(stagingFolder, target, commitMode, &commitError)) {
+            done(false, commitError);
+            return;
+        }
+
+        qDebug() << "[InstallPipeline] Installed" << archiveFile << "to" << target;
+        done(true, QString());
+    }
+
+    void InstallPipeline::done(bool success, const QString &errorString)
+    {
+        stopUnzip();
+        if (!success) {
+            QDir(stagingFolder).removeRecursively();
+        }
+        emit finished(success, errorString);
+    }
+} // namespace Updater
@@ -0,0 +1,73 @@
+#ifndef INSTALLPIPELINE_H
+#define INSTALLPIPELINE_H
+
+#include "downloadmanager.h"
+#include "streamingunzip.h"
+#include "zipextractor.h"
+
+#include <QFutureWatcher>
+#include <QObject>
+#include <QPair>
+#include <QPointer>
+#include <QThread>
+
+namespace Updater
+{
+    /**
+     * InstallPipeline overlaps the download, verification and extraction of a ZIP package.
+     *
+     * The bytes of the download are hashed and handed to a StreamingUnzip in a worker
+     * thread on the same pass, so the entries are inflated while the rest of the archive
+     * is still downloading. When the download is complete and its checksum verified,
+     * the staging folder is committed. The total time approaches max(download, extract).
+     *
+     * If the archive can not be streamed (unsupported entries, a download served from the
+     * cache, or extraction falling too far behind), the complete file is extracted with
+     * the ZipExtractor instead, in the background. Only the commit runs on the caller's thread.
+     */
+    class InstallPipeline : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        InstallPipeline(Downloader::DownloadItem *transfer, const QString &targetFolder,
+                        ZipExtractor::CommitMode mode                = ZipExtractor::ReplaceFolder,
+                        const ZipExtractor::EntryFilter &entryFilter = ZipExtractor::EntryFilter(),
+                        QObject *parent                              = nullptr);
+        ~InstallPipeline();
+
+        void setDeferredCommit(bool deferred);
+        QString stagingPath() const;
+
+    signals:
+        void finished(bool success, const QString &errorString);
+
+    private slots:
+        void streamData(const QByteArray &data);
+        void streamRestarted();
+        void transferFinished(Downloader::TransferItem *transfer);
+        void unzipFinished(bool complete, const QString &errorString);
+        void extractFinished();
+
+    private:
+        void stopUnzip();
+        void extractFile();
+        void done(bool success, const QString &errorString);
+
+        QString target;
+        QString stagingFolder;
+        QString archiveFile;
+        ZipExtractor::CommitMode commitMode;
+        ZipExtractor::EntryFilter filter;
+
+        QThread thread;
+        StreamingUnzip *unzip;
+        bool streaming;
+        bool deferredCommit;
+
+        // the extraction of the downloaded file: staged and the error string
+        QFutureWatcher<QPair<bool, QString>> extractWatcher;
+    };
+} // namespace Updater
+
+#endif // INSTALLPIPELINE_H
@@ -0,0 +1,250 @@
+#include "mirrorselector.h"
+#include "../file/json.h"
+#include "networkservice.h"
+
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonObject>
+
+#include <algorithm>
+
+namespace Downloader
+{
+    // mirrors are compared by the time they need for a download of this size
+    static const double ReferenceSize = 8.0 * 1024 * 1024;
+
+    // assumed for a mirror without measurements
+    static const double DefaultLatency    = 200;
+    static const double DefaultThroughput = 1024 * 1024;
+
+    // a mirror, which failed within the last hour, is tried last
+    static const qint64 FailurePenaltyTime = 60 * 60 * 1000;
+
+    // only the best ranked mirrors are probed
+    static const int MaxProbes    = 4;
+    static const int ProbeTimeout = 3000;
+
+    MirrorScores::MirrorScores(const QString &scoreFile) : file(scoreFile), changed(false) { load(); }
+
+    MirrorScores &MirrorScores::shared()
+    {
+        static MirrorScores scores(QDir::currentPath() + "/bin/wpnxm-scp/mirrors.json");
+        return scores;
+    }
+
+    QString MirrorScores::key(const QUrl &mirror)
+    {
+        return mirror.scheme() + "://" + mirror.host() + ":" + QString::number(mirror.port(-1));
+    }
+
+    void MirrorScores::recordLatency(const QUrl &mirror, qint64 milliseconds)
+    {
+        Entry &entry   = entries[key(mirror)];
+        entry.latency  = (entry.latency > 0) ? 0.5 * milliseconds + 0.5 * entry.latency : milliseconds;
+        entry.failures = 0;
+        changed        = true;
+    }
+
+    void MirrorScores::recordThroughput(const QUrl &mirror, double bytesPerSecond)
+    {
+        Entry &entry     = entries[key(mirror)];
+        entry.throughput = (entry.throughput > 0) ? 0.3 * bytesPerSecond + 0.7 * entry.throughput : bytesPerSecond;
+        changed          = true;
+    }
+
+    void MirrorScores::recordFailure(const QUrl &mirror)
+    {
+        Entry &entry = entries[key(mirror)];
+        ++entry.failures;
+        entry.lastFailure = QDateTime::currentMSecsSinceEpoch();
+        changed           = true;
+    }
+
+    /**
+     * The estimated time to fetch the reference size from the mirror, including recent failures.
+     */
+    double MirrorScores::expectedSeconds(const QUrl &mirror) const
+    {
+        const Entry entry = entries.value(key(mirror), Entry{0, 0, 0, 0});
+
+        const double latency    = (entry.latency > 0) ? entry.latency : DefaultLatency;
+        const double throughput = (entry.throughput > 0) ? entry.throughput : DefaultThroughput;
+        double seconds          = latency / 1000 + ReferenceSize / throughput;
+
+        if (entry.failures > 0 && QDateTime::currentMSecsSinceEpoch() - entry.lastFailure < FailurePenaltyTime) {
+            seconds += 60.0 * entry.failures;
+        }
+        return seconds;
+    }
+
+    /**
+     * Returns the mirrors, the best first. Mirrors with equal scores keep their order.
+     */
+    QList<QUrl> MirrorScores::rank(const QList<QUrl> &mirrors) const
+    {
+        QList<QUrl> ranked = mirrors;
+        std::stable_sort(ranked.begin(), ranked.end(), [this](const QUrl &a, const QUrl &b) {
+            return expectedSeconds(a) < expectedSeconds(b);
+        });
+        return ranked;
+    }
+
+    void MirrorScores::load()
+    {
+        if (!QFile::exists(file)) {
+            return;
+        }
+
+        const QJsonObject json = File::JSON::load(file).object();
+        for (auto it = json.begin(); it != json.end(); ++it) {
+            const QJsonObject values = it.value().toObject();
+
+            Entry entry;
+            entry.latency     = values["latency"].toDouble();
+            entry.throughput  = values["throughput"].toDouble();
+            entry.failures    = values["failures"].toInt();
+            entry.lastFailure = static_cast<qint64>(values["last_failure"].toDouble());
+            entries.insert(it.key(), entry);
+        }
+    }
+
+    void MirrorScores::save()
+    {
+        if (!changed) {
+            return;
+        }
+        changed = false;
+
+        QJsonObject json;
+        for (auto it = entries.constBegin(); it != entries.constEnd(); ++it) {
+            QJsonObject values;
+            values["latency"]      = it.value().latency;
+            values["throughput"]   = it.value().throughput;
+            values["failures"]     = it.value().failures;
+            values["last_failure"] = static_cast<double>(it.value().lastFailure);
+            json[it.key()]         = values;
+        }
+
+        QDir().mkpath(QFileInfo(file).absolutePath());
+        File::JSON::save(QJsonDocument(json), file);
+    }
+
+    MirrorRace::MirrorRace(const QList<QUrl> &candidates, QObject *parent)
+        : QObject(parent), mirrors(MirrorScores::shared().rank(candidates).mid(0, MaxProbes)), decided(false)
+    {
+        timer.setSingleShot(true);
+        timer.setInterval(ProbeTimeout);
+        connect(&timer, SIGNAL(timeout()), this, SLOT(timeout()));
+    }
+
+    MirrorRace::~MirrorRace()
+    {
+        if (!decided) {
+            abortProbes();
+            return;
+        }
+
+        // the winning probe completes its 1-byte body on its own, it is not aborted
+        for (QNetworkReply *reply : probes.keys()) {
+            reply->disconnect(this);
+            connect(reply, SIGNAL(finished()), reply, SLOT(deleteLater()));
+        }
+    }
+
+    void MirrorRace::start()
+    {
+        clock.start();
+        timer.start();
+
+        for (const QUrl &mirror : mirrors) {
+            QNetworkRequest probe(mirror);
+            NetworkService::shared().prepare(probe);
+            probe.setRawHeader("Range", "bytes=0-0");
+            probe.setAttribute(QNetworkRequest::RedirectPolicyAttribute, QNetworkRequest::NoLessSafeRedirectPolicy);
+            probe.setAttribute(QNetworkRequest::CacheLoadControlAttribute, QNetworkRequest::AlwaysNetwork);
+            probe.setAttribute(QNetworkRequest::CacheSaveControlAttribute, false);
+
+            QNetworkReply *reply = NetworkService::shared().manager().get(probe);
+            probes.insert(reply, mirror);
+            connect(reply, SIGNAL(metaDataChanged()), this, SLOT(probeResponded()));
+            connect(reply, SIGNAL(finished()), this, SLOT(probeFinished()));
+        }
+    }
+
+    void MirrorRace::probeResponded()
+    {
+        auto *reply      = qobject_cast<QNetworkReply *>(sender());
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+        // redirects are followed
+        if (decided || (status >= 300 && status < 400)) {
+            return;
+        }
+
+        // a 200 means the mirror ignores ranges, it is alive nonetheless
+        if (status == 206 || status == 200) {
+            const QUrl mirror = probes.value(reply);
+            MirrorScores::shared().recordLatency(mirror, clock.elapsed());
+            qDebug() << "[MirrorRace]" << mirror.host() << "answered first, after" << clock.elapsed() << "ms";
+            decide(mirror, reply);
+        }
+    }
+
+    void MirrorRace::probeFinished()
+    {
+        auto *reply       = qobject_cast<QNetworkReply *>(sender());
+        const QUrl mirror = probes.take(reply);
+        reply->deleteLater();
+
+        if (decided) {
+            return;
+        }
+
+        const int status = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+        if (reply->error() != QNetworkReply::NoError || (status != 206 && status != 200)) {
+            qDebug() << "[MirrorRace]" << mirror.host() << "failed:" << status << reply->errorString();
+            MirrorScores::shared().recordFailure(mirror);
+        }
+
+        if (probes.isEmpty()) {
+            decide(QUrl());
+        }
+    }
+
+    void MirrorRace::timeout()
+    {
+        if (!decided) {
+            qDebug() << "[MirrorRace] No mirror answered within" << ProbeTimeout << "ms";
+            decide(QUrl());
+        }
+    }
+
+    /**
+     * The winning probe keeps running until its 1-byte body arrived, aborting it would
+     * close the connection the download is about to reuse. Only the losers are aborted.
+     */
+    void MirrorRace::decide(const QUrl &winner, QNetworkReply *winnerProbe)
+    {
+        decided = true;
+        timer.stop();
+        abortProbes(winnerProbe);
+        MirrorScores::shared().save();
+        emit finished(winner);
+    }
+
+    void MirrorRace::abortProbes(QNetworkReply *except)
+    {
+        const QList<QNetworkReply *> running = probes.keys();
+        for (QNetworkReply *reply : running) {
+            if (reply == except) {
+                continue;
+            }
+            probes.remove(reply);
+            reply->disconnect(this);
+            reply->abort();
+            reply->deleteLater();
+        }
+    }
+} // namespace Downloader
@@ -0,0 +1,91 @@
+#ifndef MIRRORSELECTOR_H
+#define MIRRORSELECTOR_H
+
+#include <QElapsedTimer>
+#include <QHash>
+#include <QList>
+#include <QNetworkReply>
+#include <QObject>
+#include <QTimer>
+#include <QUrl>
+
+namespace Downloader
+{
+    /**
+     * MirrorScores remembers how well the mirrors performed: the latency of the last
+     * probes, the throughput of the last downloads and recent failures.
+     *
+     * Scores are kept per host and persist in "bin/wpnxm-scp/mirrors.json",
+     * so the next run starts with the mirror, which was the best last time.
+     */
+    class MirrorScores
+    {
+    public:
+        explicit MirrorScores(const QString &scoreFile);
+
+        static MirrorScores &shared();
+
+        void recordLatency(const QUrl &mirror, qint64 milliseconds);
+        void recordThroughput(const QUrl &mirror, double bytesPerSecond);
+        void recordFailure(const QUrl &mirror);
+
+        double expectedSeconds(const QUrl &mirror) const;
+        QList<QUrl> rank(const QList<QUrl> &mirrors) const;
+
+        void save();
+
+    private:
+        struct Entry
+        {
+            double latency; // ms, 0 = unknown
+            double throughput; // bytes per second, 0 = unknown
+            int failures;
+            qint64 lastFailure; // ms since epoch
+        };
+
+        static QString key(const QUrl &mirror);
+        void load();
+
+        QString file;
+        QHash<QString, Entry> entries;
+        bool changed;
+    };
+
+    /**
+     * MirrorRace sends a small range request ("bytes=0-0") to each candidate at once.
+     * The first mirror answering with a successful status wins, the other probes are aborted.
+     * The winning probe runs to completion, so the connection (and TLS session) it opened
+     * is returned to the pool and reused by the download.
+     */
+    class MirrorRace : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        MirrorRace(const QList<QUrl> &candidates, QObject *parent = nullptr);
+        ~MirrorRace();
+
+        void start();
+
+    signals:
+        // winner is empty, when no mirror answered in time
+        void finished(const QUrl &winner);
+
+    private slots:
+        void probeResponded();
+        void probeFinished();
+        void timeout();
+
+    private:
+        void decide(const QUrl &winner, QNetworkReply *winnerProbe = nullptr);
+        void abortProbes(QNetworkReply *except = nullptr);
+
+        QList<QUrl> mirrors;
+        QHash<QNetworkReply *, QUrl> probes;
+        QElapsedTimer clock;
+        QTimer timer;
+        bool decided;
+    };
+} // namespace Downloader
+
+#endif // MIRRORSELECTOR_H
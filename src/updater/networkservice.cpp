@@ -0,0 +1,100 @@
+#include "networkservice.h"
+#include "src/settings.h"
+
+#include <QCoreApplication>
+#include <QDebug>
+#include <QDir>
+
+namespace Downloader
+{
+    NetworkService::NetworkService() : diskCache(new QNetworkDiskCache(this))
+    {
+        // the disk cache is owned by the access manager (size in MB)
+        Settings::SettingsManager settings;
+        diskCache->setCacheDirectory(QDir::currentPath() + "/bin/wpnxm-scp/http-cache");
+        diskCache->setMaximumCacheSize(settings.get("updater/httpcachesize", 16).toLongLong() * 1024 * 1024);
+        nam.setCache(diskCache);
+
+#ifndef QT_NO_SSL
+        // TLS sessions are shared between the connections of the access manager and
+        // resumed with session tickets, a reconnect to the same host skips the full handshake
+        sslConfiguration = QSslConfiguration::defaultConfiguration();
+        sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionSharing, false);
+        sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionTickets, false);
+        sslConfiguration.setSslOption(QSsl::SslOptionDisableSessionPersistence, false);
+
+        connect(&nam, SIGNAL(sslErrors(QNetworkReply *, QList<QSslError>)), this,
+                SLOT(sslErrors(QNetworkReply *, QList<QSslError>)));
+#endif
+
+        userAgent = QString(qApp->applicationName() + qApp->applicationVersion()).toUtf8();
+    }
+
+    /**
+     * The network service of the application, lives in the main thread.
+     * It is never destroyed, the access manager must not outlive the application object.
+     */
+    NetworkService &NetworkService::shared()
+    {
+        static NetworkService *service = new NetworkService();
+        return *service;
+    }
+
+    QNetworkAccessManager &NetworkService::manager() { return nam; }
+
+    QNetworkDiskCache *NetworkService::cache() const { return diskCache; }
+
+    /**
+     * Applies the defaults of the service to a request: user agent, protocol and the TLS configuration.
+     * HTTP/2 is opt-in per request, it is negotiated via ALPN and falls back to HTTP/1.1.
+     */
+    void NetworkService::prepare(QNetworkRequest &request, Protocol protocol) const
+    {
+        if (!request.hasRawHeader("User-Agent")) {
+            request.setRawHeader("User-Agent", userAgent);
+        }
+        request.setAttribute(QNetworkRequest::Http2AllowedAttribute, protocol == Http2);
+#ifndef QT_NO_SSL
+        if (request.url().scheme() == "https") {
+            request.setSslConfiguration(sslConfiguration);
+        }
+#endif
+    }
+
+    QNetworkReply *NetworkService::get(QNetworkRequest request, Protocol protocol)
+    {
+        prepare(request, protocol);
+        return nam.get(request);
+    }
+
+    /**
+     * Opens a connection to the host of the url in the background (DNS, TCP and TLS),
+     * so that the first request to it does not wait for the handshake.
+     */
+    void NetworkService::warmUp(const QUrl &url)
+    {
+#ifndef QT_NO_SSL
+        if (url.scheme() == "https") {
+            nam.connectToHostEncrypted(url.host(), url.port(443), sslConfiguration);
+            return;
+        }
+#endif
+        nam.connectToHost(url.host(), url.port(80));
+    }
+
+    void NetworkService::setCacheSize(qint64 bytes) { diskCache->setMaximumCacheSize(bytes); }
+
+    bool NetworkService::isAccessible() const
+    {
+        return nam.networkAccessible() != QNetworkAccessManager::NotAccessible;
+    }
+
+    void NetworkService::sslErrors(QNetworkReply *reply, const QList<QSslError> &errors)
+    {
+        qDebug() << "[NetworkService] SSL errors for" << reply->url().toString();
+        foreach (const QSslError &error, errors) {
+            qDebug() << error.errorString();
+            qDebug() << error.certificate().toPem();
+        }
+    }
+} // namespace Downloader
@@ -0,0 +1,65 @@
+#ifndef NETWORKSERVICE_H
+#define NETWORKSERVICE_H
+
+#include <QNetworkAccessManager>
+#include <QNetworkDiskCache>
+#include <QNetworkReply>
+#include <QNetworkRequest>
+#include <QObject>
+#include <QSslConfiguration>
+#include <QSslError>
+#include <QUrl>
+
+namespace Downloader
+{
+    /**
+     * NetworkService is the network stack of the application.
+     *
+     * The registry, the update check and the downloads share one QNetworkAccessManager,
+     * so they share its connection pool and the TLS sessions of the hosts. A second request
+     * to a host reuses a warm connection, or at least resumes the TLS session, instead of a
+     * full handshake.
+     *
+     * Small responses are kept in a size-capped QNetworkDiskCache ("bin/wpnxm-scp/http-cache").
+     * Downloads are not stored there, they have their own content-addressed DownloadCache.
+     */
+    class NetworkService : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        static NetworkService &shared();
+
+        // HTTP/2 multiplexes all requests to a host over one connection. That suits small requests,
+        // but range requests of one file (segments, mirror probes) need their own connections.
+        enum Protocol
+        {
+            Http1,
+            Http2
+        };
+
+        QNetworkAccessManager &manager();
+        QNetworkDiskCache *cache() const;
+
+        void prepare(QNetworkRequest &request, Protocol protocol = Http1) const;
+        QNetworkReply *get(QNetworkRequest request, Protocol protocol = Http2);
+        void warmUp(const QUrl &url);
+
+        void setCacheSize(qint64 bytes);
+        bool isAccessible() const;
+
+    private slots:
+        void sslErrors(QNetworkReply *reply, const QList<QSslError> &errors);
+
+    private:
+        NetworkService();
+        Q_DISABLE_COPY(NetworkService)
+
+        QNetworkAccessManager nam;
+        QNetworkDiskCache *diskCache;
+        QSslConfiguration sslConfiguration;
+        QByteArray userAgent;
+    };
+} // namespace Downloader
+
+#endif // NETWORKSERVICE_H
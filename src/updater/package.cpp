@@ -1,33 +1,598 @@
 #include "package.h"
+#include "../file/json.h"
+#include "../file/pe.h"
+#include "componentstore.h"
+#include "src/config/phpinstallations.h"
+#include "src/servers.h"
+#include "src/settings.h"
 
-Package::Package(QObject *parent) : QObject(parent) {}
+#include <QCoreApplication>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QTimer>
+#include <QtConcurrent>
+#include <QVersionNumber>
 
-/**
- * Get a list of packages that need to be upgraded.
- */
-QList<QString> Package::listUpgrades()
+#include <functional>
+
+namespace Updater
 {
-    QList<QString> list;
-    list << "foo";
-    return list;
-}
-
-/**
- * Upgrades all packages
- */
-void Package::upgradeAll() {}
-
-/**
- * Upgrade one package
- */
-void Package::upgrade(QString packageName) { Q_UNUSED(packageName); }
-
-/**
- * Get current version of a package
- */
-void Package::version(QString packageName) { Q_UNUSED(packageName); }
-
-/**
- * Install or upgrade package
- */
-void Package::install(QString packageName) { Q_UNUSED(packageName); }
+    // a server releases its files shortly after it was stopped, the swap is retried meanwhile
+    static const int SwapAttempts     = 20;
+    static const int SwapRetryDelayMs = 100;
+
+    Package::Package(QObject *parent)
+        : QObject(parent), inventoryFile(QDir::currentPath() + "/bin/wpnxm-scp/installed.json"), servers(nullptr),
+          isSeedPending(false), swapAttempt(0)
+    {
+        loadInventory();
+
+        connect(&seedWatcher, SIGNAL(finished()), this, SLOT(seedingFinished()));
+
+        // independent packages are downloaded and staged at the same time
+        Settings::SettingsManager settings;
+        downloadManager.setQueueMode(Downloader::DownloadManager::Parallel);
+        downloadManager.setMaxConcurrentTransfers(settings.get("updater/maxconcurrentdownloads", 3).toInt());
+    }
+
+    /**
+     * The software registry, see SoftwareRegistry::Manager.
+     */
+    void Package::setRegistry(const QJsonObject &json)
+    {
+        registry = json;
+        seedInventory();
+    }
+
+    /**
+     * The servers, which are stopped for the swap of their packages.
+     */
+    void Package::setServers(Servers::Servers *serverList) { servers = serverList; }
+
+    bool Package::isRunning() const { return !jobs.isEmpty(); }
+
+    /**
+     * Get a list of packages that need to be upgraded.
+     */
+    QList<QString> Package::listUpgrades()
+    {
+        QList<QString> list;
+        for (auto it = registry.constBegin(); it != registry.constEnd(); ++it) {
+            if (isUpgrade(it.key())) {
+                list << it.key();
+            }
+        }
+        return list;
+    }
+
+    /**
+     * Upgrades all packages
+     */
+    void Package::upgradeAll() { run(listUpgrades()); }
+
+    /**
+     * Upgrade one package
+     */
+    void Package::upgrade(QString packageName)
+    {
+        if (!isUpgrade(packageName)) {
+            qDebug() << "[Package]" << packageName << "is up to date.";
+            emit finished(true);
+            return;
+        }
+        run(QStringList(packageName));
+    }
+
+    /**
+     * Get current version of a package
+     */
+    QString Package::version(QString packageName)
+    {
+        return inventory[packageName].toObject()["version"].toString();
+    }
+
+    /**
+     * Install or upgrade package
+     */
+    void Package::install(QString packageName) { run(QStringList(packageName)); }
+
+    bool Package::isUpgrade(const QString &packageName) const
+    {
+        const QString installed = inventory[packageName].toObject()["version"].toString();
+        const QString latest    = registry[packageName].toObject()["latest"].toObject()["version"].toString();
+        if (!inventory.contains(packageName) || latest.isEmpty()) {
+            return false;
+        }
+        // an installed component of unknown version is upgraded to the latest version
+        if (installed.isEmpty()) {
+            return true;
+        }
+        return QVersionNumber::fromString(latest).normalized() > QVersionNumber::fromString(installed).normalized();
+    }
+
+    /**
+     * Adds the components, which were installed before the inventory existed, with the version found on disk.
+     * These entries are marked as "seeded", they are probed again, until the component is installed by Package.
+     *
+     * Probing reads executables and might spawn "php -v", so it runs in the background.
+     * A component kept in the ComponentStore is seeded right away, its version is the name of the link target.
+     */
+    void Package::seedInventory()
+    {
+        if (seedWatcher.isRunning()) {
+            isSeedPending = true;
+            return;
+        }
+
+        ComponentStore &store = ComponentStore::shared();
+        QHash<QString, QString> folders;
+
+        for (auto it = registry.constBegin(); it != registry.constEnd(); ++it) {
+            const QString name = it.key();
+            if (inventory.contains(name) && !inventory[name].toObject()["seeded"].toBool()) {
+                continue;
+            }
+
+            const QString folder = targetFolderOf(name);
+            if (!QFileInfo(folder).isDir()) {
+                inventory.remove(name);
+                continue;
+            }
+
+            const QString storeVersion = store.activeVersion(name);
+            if (!storeVersion.isEmpty()) {
+                QJsonObject seeded;
+                seeded["version"] = storeVersion;
+                seeded["seeded"]  = true;
+                inventory[name]   = seeded;
+                continue;
+            }
+
+            folders.insert(name, folder);
+        }
+
+        if (folders.isEmpty()) {
+            return;
+        }
+
+        seedWatcher.setFuture(QtConcurrent::run([folders]() {
+            QHash<QString, QString> versions;
+            for (auto it = folders.constBegin(); it != folders.constEnd(); ++it) {
+                versions.insert(it.key(), probeVersion(it.key(), it.value()));
+            }
+            return versions;
+        }));
+    }
+
+    void Package::seedingFinished()
+    {
+        const QHash<QString, QString> versions = seedWatcher.result();
+        for (auto it = versions.constBegin(); it != versions.constEnd(); ++it) {
+            // installed by Package meanwhile
+            if (inventory.contains(it.key()) && !inventory[it.key()].toObject()["seeded"].toBool()) {
+                continue;
+            }
+
+            QJsonObject seeded;
+            seeded["version"]   = it.value();
+            seeded["seeded"]    = true;
+            inventory[it.key()] = seeded;
+        }
+
+        emit inventorySeeded();
+
+        // the registry changed while probing
+        if (isSeedPending) {
+            isSeedPending = false;
+            seedInventory();
+        }
+    }
+
+    /**
+     * Reads the version of an installed component: from php.exe or from the version resource
+     * of "<name>.exe". Returns an empty string, when it is unknown. Runs in a worker thread.
+     */
+    QString Package::probeVersion(const QString &packageName, const QString &folder)
+    {
+        if (QFile::exists(folder + "/php.exe")) {
+            const QList<Configuration::PhpInstallations::Installation> php =
+                Configuration::PhpInstallations::shared().probe(QStringList(folder));
+            return php.isEmpty() ? QString() : php.first().version;
+        }
+
+        const QStringList executables = QStringList() << folder + "/" + packageName + ".exe"
+                                                      << folder + "/bin/" + packageName + ".exe";
+        foreach (const QString &executable, executables) {
+            if (QFile::exists(executable)) {
+                return File::PE::productVersion(executable);
+            }
+        }
+        return QString();
+    }
+
+    QStringList Package::dependenciesOf(const QString &packageName) const
+    {
+        QStringList dependencies;
+        foreach (const QJsonValue &value, registry[packageName].toObject()["depends"].toArray()) {
+            dependencies << value.toString();
+        }
+        return dependencies;
+    }
+
+    QString Package::targetFolderOf(const QString &packageName) const
+    {
+        const QString installDir = registry[packageName].toObject()["install_dir"].toString();
+        if (!installDir.isEmpty() && ZipExtractor::isSafePath(installDir)) {
+            return QDir::cleanPath(QDir::currentPath() + "/" + installDir);
+        }
+        return QDir::cleanPath(QDir::currentPath() + "/bin/" + packageName);
+    }
+
+    /**
+     * Returns the requested packages and their missing dependencies, dependencies first.
+     */
+    QStringList Package::resolve(const QStringList &requested, QString *errorMessage) const
+    {
+        QStringList ordered;
+        QStringList visiting;
+
+        std::function<bool(const QString &, bool)> visit = [&](const QString &name, bool isRequested) {
+            if (ordered.contains(name)) {
+                return true;
+            }
+            if (visiting.contains(name)) {
+                *errorMessage = tr("Circular dependency: %1").arg((visiting << name).join(" -> "));
+                return false;
+            }
+            if (!registry.contains(name)) {
+                *errorMessage = tr("Unknown package: %1").arg(name);
+                return false;
+            }
+            // an installed dependency is left alone
+            if (!isRequested && (inventory.contains(name) || QFileInfo::exists(targetFolderOf(name)))) {
+                return true;
+            }
+
+            visiting << name;
+            foreach (const QString &dependency, dependenciesOf(name)) {
+                if (!visit(dependency, false)) {
+                    return false;
+                }
+            }
+            visiting.removeLast();
+
+            ordered << name;
+            return true;
+        };
+
+        foreach (const QString &name, requested) {
+            if (!visit(name, true)) {
+                return QStringList();
+            }
+        }
+        return ordered;
+    }
+
+    void Package::run(const QStringList &packageNames)
+    {
+        if (isRunning()) {
+            qDebug() << "[Package] An installation is already running.";
+            emit finished(false);
+            return;
+        }
+
+        QString error;
+        order = resolve(packageNames, &error);
+        if (!error.isEmpty()) {
+            qDebug() << "[Package]" << error;
+            foreach (const QString &name, packageNames) {
+                emit packageInstalled(name, false, error);
+            }
+            emit finished(false);
+            return;
+        }
+        if (order.isEmpty()) {
+            emit finished(true);
+            return;
+        }
+
+        qDebug() << "[Package] Installing" << order.join(", ");
+
+        QString downloadFolder(QCoreApplication::applicationDirPath() + QDir::separator() + "downloads");
+        QDir().mkpath(downloadFolder);
+        downloadManager.setDownloadFolder(downloadFolder);
+        downloadManager.setDownloadMode(Downloader::DownloadItem::DownloadMode::SkipIfExists);
+
+        foreach (const QString &name, order) {
+            const QJsonObject latest = registry[name].toObject()["latest"].toObject();
+
+            Job job;
+            job.name         = name;
+            job.version      = latest["version"].toString();
+            job.targetFolder = targetFolderOf(name);
+            job.dependencies = dependenciesOf(name);
+            job.pipeline     = nullptr;
+            job.done         = false;
+            job.staged       = false;
+            job.inStore      = false;
+
+            const QUrl url(latest["url"].toString());
+            if (!url.isValid() || url.host().isEmpty()) {
+                job.done        = true;
+                job.errorString = tr("No download URL for %1").arg(name);
+                jobs.insert(name, job);
+                continue;
+            }
+
+            QNetworkRequest request(url);
+            downloadManager.get(request);
+
+            Downloader::TransferItem *transfer = downloadManager.findTransfer(url);
+            transfer->setExpectedChecksum(latest["sha256"].toString().toLatin1());
+            QList<QUrl> mirrors;
+            foreach (const QJsonValue &mirror, latest["mirrors"].toArray()) {
+                mirrors.append(QUrl(mirror.toString()));
+            }
+            transfer->setMirrors(mirrors);
+
+            // the archive is staged while it downloads, the commit waits for the other packages
+            job.pipeline = new InstallPipeline(qobject_cast<Downloader::DownloadItem *>(transfer), job.targetFolder,
+                                               ZipExtractor::ReplaceFolder, ZipExtractor::EntryFilter(), this);
+            job.pipeline->setDeferredCommit(true);
+            connect(job.pipeline, SIGNAL(finished(bool, QString)), this, SLOT(staged(bool, QString)));
+
+            jobs.insert(name, job);
+        }
+
+        // finally: invoke downloading
+        QMetaObject::invokeMethod(&downloadManager, "checkForAllDone", Qt::QueuedConnection);
+
+        // all packages failed up front
+        bool pending = false;
+        foreach (const Job &job, jobs) {
+            pending |= !job.done;
+        }
+        if (!pending) {
+            QMetaObject::invokeMethod(this, "staged", Qt::QueuedConnection, Q_ARG(bool, false), Q_ARG(QString, ""));
+        }
+    }
+
+    void Package::staged(bool success, const QString &errorString)
+    {
+        auto *pipeline = qobject_cast<InstallPipeline *>(sender());
+
+        for (auto it = jobs.begin(); pipeline && it != jobs.end(); ++it) {
+            if (it->pipeline == pipeline) {
+                it->done        = true;
+                it->staged      = success;
+                it->errorString = errorString;
+                it->pipeline    = nullptr;
+                if (success) {
+                    emit packageStaged(it->name);
+                } else {
+                    qDebug() << "[Package] Staging" << it->name << "failed:" << errorString;
+                }
+                break;
+            }
+        }
+        if (pipeline) {
+            pipeline->deleteLater();
+        }
+
+        foreach (const Job &job, jobs) {
+            if (!job.done) {
+                return;
+            }
+        }
+
+        swapIn();
+    }
+
+    /**
+     * All packages are staged: the servers are stopped, the staging folders are swapped in
+     * (dependencies first) and the servers are started again.
+     */
+    void Package::swapIn()
+    {
+        // a package is only installed, when its dependencies of this run were staged, too
+        QStringList ready;
+        foreach (const QString &name, order) {
+            Job &job  = jobs[name];
+            bool isOk = job.staged;
+            foreach (const QString &dependency, job.dependencies) {
+                if (jobs.contains(dependency) && !ready.contains(dependency)) {
+                    isOk = false;
+                    if (job.errorString.isEmpty()) {
+                        job.errorString = tr("The dependency %1 failed").arg(dependency);
+                    }
+                }
+            }
+            // a component in the store gets a new version folder, only its link is switched
+            job.inStore = isOk && isInStore(job);
+            if (job.inStore) {
+                job.previousVersion = ComponentStore::shared().activeVersion(name);
+                isOk = ComponentStore::shared().importFolder(name, job.version, job.targetFolder + ".extracting",
+                                                             &job.errorString);
+                QDir(job.targetFolder + ".extracting").removeRecursively();
+                job.staged = isOk;
+            }
+            if (isOk) {
+                ready << name;
+            } else if (job.staged) {
+                job.staged = false;
+                QDir(job.targetFolder + ".extracting").removeRecursively();
+            }
+        }
+
+        swapWindow.start();
+
+        swapped.clear();
+        swapError.clear();
+        swapReady      = ready;
+        swapAttempt    = 0;
+        stoppedServers = stopServers(ready);
+
+        swapNext();
+    }
+
+    /**
+     * Swaps in the next package. A swap, which fails because a stopped server did not release
+     * its files yet, is retried by a timer, the event loop keeps running meanwhile.
+     */
+    void Package::swapNext()
+    {
+        while (swapped.size() < swapReady.size()) {
+            const QString name = swapReady.at(swapped.size());
+
+            bool isSwapped = false;
+            if (jobs[name].inStore) {
+                isSwapped = ComponentStore::shared().activate(name, jobs[name].version, &swapError);
+            } else {
+                isSwapped = ZipExtractor::swapFolders(jobs[name].targetFolder + ".extracting",
+                                                      jobs[name].targetFolder, &swapError);
+            }
+
+            if (!isSwapped) {
+                if (++swapAttempt < SwapAttempts) {
+                    QTimer::singleShot(SwapRetryDelayMs, this, SLOT(swapNext()));
+                    return;
+                }
+                break;
+            }
+
+            swapped << name;
+            swapAttempt = 0;
+        }
+
+        finishSwap();
+    }
+
+    void Package::finishSwap()
+    {
+        const QStringList ready = swapReady;
+
+        // all or nothing: a failed swap rolls back the packages, which were already swapped in
+        const bool allSwapped = swapped.size() == ready.size();
+        if (!allSwapped) {
+            qDebug() << "[Package] Swap failed, rolling back:" << swapError;
+            for (int i = swapped.size() - 1; i >= 0; --i) {
+                const Job &job = jobs[swapped.at(i)];
+                if (!job.inStore) {
+                    ZipExtractor::restorePrevious(job.targetFolder);
+                } else if (!job.previousVersion.isEmpty()) {
+                    QString error;
+                    ComponentStore::shared().activate(job.name, job.previousVersion, &error);
+                } else {
+                    // the component was new, it had no active version before
+                    ComponentStore::removeLink(ComponentStore::shared().linkPath(job.name));
+                }
+            }
+            foreach (const QString &name, ready) {
+                QDir(jobs[name].targetFolder + ".extracting").removeRecursively();
+                jobs[name].staged      = false;
+                jobs[name].errorString = swapError;
+            }
+        }
+
+        startServers(stoppedServers);
+
+        qDebug() << "[Package] Swapped" << (allSwapped ? swapped.size() : 0) << "packages in" << swapWindow.elapsed()
+                 << "ms";
+
+        // the previous versions are removed after the servers are up again
+        bool success = true;
+        foreach (const QString &name, order) {
+            const Job &job = jobs[name];
+            if (job.staged && allSwapped) {
+                if (!job.inStore) {
+                    ZipExtractor::recover(job.targetFolder);
+                }
+
+                QJsonObject installed;
+                installed["version"]   = job.version;
+                installed["installed"] = QDateTime::currentDateTime().toString(Qt::ISODate);
+                inventory[name]        = installed;
+            } else {
+                success = false;
+            }
+        }
+        saveInventory();
+
+        const QHash<QString, Job> finishedJobs = jobs;
+        const QStringList finishedOrder        = order;
+        jobs.clear();
+        order.clear();
+
+        foreach (const QString &name, finishedOrder) {
+            const Job &job = finishedJobs[name];
+            emit packageInstalled(name, job.staged && allSwapped, job.errorString);
+        }
+        emit finished(success);
+    }
+
+    /**
+     * Stops the running servers of the packages and returns their names, to start them again.
+     */
+    QStringList Package::stopServers(const QStringList &packageNames)
+    {
+        QStringList running;
+        if (servers == nullptr) {
+            return running;
+        }
+
+        const QStringList serverNames = servers->getListOfServerNames();
+        foreach (QString name, packageNames) {
+            if (!serverNames.contains(name)) {
+                continue;
+            }
+
+            const QString serverName = servers->getCamelCasedServerName(name);
+            Servers::Server *server  = servers->getServer(serverName);
+            if (server == nullptr || Processes::getInstance()->getProcessState(QFileInfo(server->exe).fileName()) !=
+                                         Processes::ProcessState::Running) {
+                continue;
+            }
+
+            qDebug() << "[Package] Stopping" << serverName << "for the update.";
+            QMetaObject::invokeMethod(servers, QString("stop" + serverName).toLatin1().constData(),
+                                      Qt::DirectConnection);
+            running << serverName;
+        }
+        return running;
+    }
+
+    void Package::startServers(const QStringList &serverNames)
+    {
+        foreach (const QString &serverName, serverNames) {
+            qDebug() << "[Package] Starting" << serverName << "after the update.";
+            QMetaObject::invokeMethod(servers, QString("start" + serverName).toLatin1().constData(),
+                                      Qt::DirectConnection);
+        }
+    }
+
+    /**
+     * True, when "bin/<package>" is a link into the ComponentStore.
+     */
+    bool Package::isInStore(const Job &job) const
+    {
+        return QDir::cleanPath(job.targetFolder) == ComponentStore::shared().linkPath(job.name) &&
+               ComponentStore::shared().isManaged(job.name);
+    }
+
+    void Package::loadInventory()
+    {
+        if (QFile::exists(inventoryFile)) {
+            inventory = File::JSON::load(inventoryFile).object();
+        }
+    }
+
+    void Package::saveInventory()
+    {
+        QDir().mkpath(QFileInfo(inventoryFile).absolutePath());
+        File::JSON::save(QJsonDocument(inventory), inventoryFile);
+    }
+} // namespace Updater
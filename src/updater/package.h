@@ -1,24 +1,122 @@
 #ifndef PACKAGE_H
 #define PACKAGE_H
 
+#include <QElapsedTimer>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QJsonObject>
 #include <QObject>
+#include <QStringList>
 
-class Package : public QObject
+#include "downloadmanager.h"
+#include "installpipeline.h"
+
+namespace Servers
+{
+    class Servers;
+}
+
+namespace Updater
 {
-    Q_OBJECT
-public:
-    explicit Package(QObject *parent = 0);
+    /**
+     * Package installs and upgrades the software components of the server stack.
+     *
+     * The latest versions come from the software registry, the installed versions from
+     * the inventory ("bin/wpnxm-scp/installed.json"). Components, which were installed before
+     * the inventory existed, are added with the version found on disk; an unknown version is
+     * upgradable. The versions are probed in the background, inventorySeeded() is emitted then.
+     * A component may list the registry keys it "depends" on, missing dependencies are installed with it.
+     *
+     * All packages of a run are downloaded and staged concurrently: every archive is
+     * extracted into "<target>.extracting" while it downloads (see InstallPipeline).
+     * When everything is staged, the affected servers are stopped, the staging folders
+     * are swapped in by renames in dependency order, and the servers are started again.
+     * The servers are down for a few renames, not for downloads or extractions.
+     * A component kept in the ComponentStore is imported as a new version instead,
+     * its swap only switches the link.
+     * If a swap fails, all packages of the run are rolled back.
+     */
+    class Package : public QObject
+    {
+        Q_OBJECT
+    public:
+        explicit Package(QObject *parent = nullptr);
+
+        void setRegistry(const QJsonObject &registry);
+        void setServers(Servers::Servers *servers);
+        bool isRunning() const;
+
+        QList<QString> listUpgrades();
+
+        void upgradeAll();
+        void upgrade(QString packageName);
+        void install(QString packageName);
+        QString version(QString packageName);
+
+    signals:
+        void packageStaged(const QString &packageName);
+        void packageInstalled(const QString &packageName, bool success, const QString &errorString);
+        void finished(bool success);
+        void inventorySeeded();
+
+    private slots:
+        void staged(bool success, const QString &errorString);
+        void seedingFinished();
+        void swapNext();
+
+    private:
+        struct Job
+        {
+            QString name;
+            QString version;
+            QString targetFolder;
+            QStringList dependencies;
+            InstallPipeline *pipeline;
+            bool done;
+            bool staged;
+            bool inStore; // "bin/<name>" links into the ComponentStore
+            QString previousVersion;
+            QString errorString;
+        };
+
+        QStringList resolve(const QStringList &requested, QString *errorMessage) const;
+        QStringList dependenciesOf(const QString &packageName) const;
+        QString targetFolderOf(const QString &packageName) const;
+        bool isUpgrade(const QString &packageName) const;
+        void seedInventory();
+        static QString probeVersion(const QString &packageName, const QString &folder);
+        bool isInStore(const Job &job) const;
+
+        void run(const QStringList &packageNames);
+        void swapIn();
+        void finishSwap();
+        QStringList stopServers(const QStringList &packageNames);
+        void startServers(const QStringList &serverNames);
+
+        void loadInventory();
+        void saveInventory();
 
-    QList<QString> listUpgrades();
+        QJsonObject registry;
+        QJsonObject inventory;
+        QString inventoryFile;
+        Servers::Servers *servers;
+        Downloader::DownloadManager downloadManager;
 
-    void upgradeAll();
-    void upgrade(QString packageName);
-    void install(QString packageName);
-    void version(QString packageName);
+        // the versions of the components found on disk, probed in the background
+        QFutureWatcher<QHash<QString, QString>> seedWatcher;
+        bool isSeedPending;
 
-signals:
+        QStringList order; // the packages of the running install, dependencies first
+        QHash<QString, Job> jobs;
 
-public slots:
-};
+        // the swap of the running install
+        QStringList swapReady;
+        QStringList swapped;
+        QStringList stoppedServers;
+        QString swapError;
+        int swapAttempt;
+        QElapsedTimer swapWindow;
+    };
+} // namespace Updater
 
 #endif // PACKAGE_H
@@ -0,0 +1,370 @@
+#include "streamingunzip.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QtEndian>
+
+#include <cstring>
+
+namespace Updater
+{
+    static const quint32 LocalHeaderSignature           = 0x04034b50;
+    static const quint32 DataDescriptorSignature        = 0x08074b50;
+    static const quint32 CentralHeaderSignature         = 0x02014b50;
+    static const quint32 EndOfCentralDirectorySignature = 0x06054b50;
+
+    static const quint16 FlagEncrypted      = 0x0001;
+    static const quint16 FlagDataDescriptor = 0x0008;
+    static const quint16 FlagUtf8           = 0x0800;
+
+    static const quint16 MethodStored   = 0;
+    static const quint16 MethodDeflated = 8;
+
+    StreamingUnzip::StreamingUnzip(const QString &stagingFolder, const ZipExtractor::EntryFilter &filter)
+        : staging(stagingFolder), entryFilter(filter), state(LocalHeader), inputPosition(0), pending(0),
+          outputBuffer(256 * 1024, Qt::Uninitialized)
+    {
+        std::memset(&stream, 0, sizeof(stream));
+        // negative window bits: raw deflate data, as stored in a zip archive
+        inflateInit2(&stream, -MAX_WBITS);
+
+        QDir(staging).removeRecursively();
+        QDir().mkpath(staging);
+    }
+
+    StreamingUnzip::~StreamingUnzip()
+    {
+        inflateEnd(&stream);
+        outFile.close();
+    }
+
+    /**
+     * Hands data over to the thread of the unzip. The data is copied,
+     * because the buffer of the download is reused.
+     */
+    void StreamingUnzip::post(const QByteArray &data)
+    {
+        pending.fetchAndAddOrdered(data.size());
+        QMetaObject::invokeMethod(this, "addData", Qt::QueuedConnection,
+                                  Q_ARG(QByteArray, QByteArray(data.constData(), data.size())));
+    }
+
+    qint64 StreamingUnzip::pendingBytes() const { return pending.load(); }
+
+    /**
+     * The download starts again from the first byte.
+     */
+    void StreamingUnzip::restart()
+    {
+        outFile.close();
+        inflateReset(&stream);
+        input.clear();
+        inputPosition = 0;
+        error.clear();
+        state = LocalHeader;
+
+        QDir(staging).removeRecursively();
+        QDir().mkpath(staging);
+    }
+
+    void StreamingUnzip::abort() { fail(QString("Aborted")); }
+
+    void StreamingUnzip::finish()
+    {
+        outFile.close();
+        if (state != CentralDirectory && state != Failed) {
+            fail(QString("Unexpected end of zip archive"));
+        }
+        emit finished(state == CentralDirectory, error);
+    }
+
+    void StreamingUnzip::addData(const QByteArray &data)
+    {
+        pending.fetchAndAddOrdered(-data.size());
+
+        if (state == CentralDirectory || state == Failed) {
+            return;
+        }
+        input.append(data);
+
+        bool progress = true;
+        while (progress) {
+            switch (state) {
+                case LocalHeader:
+                    progress = readLocalHeader();
+                    break;
+                case EntryData:
+                    progress = readEntryData();
+                    break;
+                case DataDescriptor:
+                    progress = readDataDescriptor();
+                    break;
+                default:
+                    progress = false;
+            }
+        }
+
+        // drop the consumed input
+        if (state == CentralDirectory || state == Failed) {
+            input.clear();
+            inputPosition = 0;
+        } else if (inputPosition > 0) {
+            input.remove(0, inputPosition);
+            inputPosition = 0;
+        }
+    }
+
+    bool StreamingUnzip::readLocalHeader()
+    {
+        const int available = input.size() - inputPosition;
+        if (available < 4) {
+            return false;
+        }
+
+        const uchar *p         = reinterpret_cast<const uchar *>(input.constData()) + inputPosition;
+        const quint32 signature = qFromLittleEndian<quint32>(p);
+
+        // the central directory follows the last entry
+        if (signature == CentralHeaderSignature || signature == EndOfCentralDirectorySignature) {
+            state = CentralDirectory;
+            return false;
+        }
+        if (signature != LocalHeaderSignature) {
+            fail(QString("Invalid local file header"));
+            return false;
+        }
+
+        if (available < 30) {
+            return false;
+        }
+        const int nameLength  = qFromLittleEndian<quint16>(p + 26);
+        const int extraLength = qFromLittleEndian<quint16>(p + 28);
+        if (available < 30 + nameLength + extraLength) {
+            return false;
+        }
+
+        entry.flags            = qFromLittleEndian<quint16>(p + 6);
+        entry.method           = qFromLittleEndian<quint16>(p + 8);
+        entry.modified         = fromDosTime(qFromLittleEndian<quint16>(p + 10), qFromLittleEndian<quint16>(p + 12));
+        entry.crc              = qFromLittleEndian<quint32>(p + 14);
+        entry.compressedSize   = qFromLittleEndian<quint32>(p + 18);
+        entry.uncompressedSize = qFromLittleEndian<quint32>(p + 22);
+        entry.zip64            = false;
+
+        const char *name = reinterpret_cast<const char *>(p + 30);
+        const QString entryName =
+            (entry.flags & FlagUtf8) ? QString::fromUtf8(name, nameLength) : QString::fromLocal8Bit(name, nameLength);
+
+        // ZIP64 extended information: the 64 bit sizes replace the 0xFFFFFFFF placeholders
+        const uchar *extra    = p + 30 + nameLength;
+        const uchar *extraEnd = extra + extraLength;
+        while (extra + 4 <= extraEnd) {
+            const quint16 id   = qFromLittleEndian<quint16>(extra);
+            const quint16 size = qFromLittleEndian<quint16>(extra + 2);
+            const uchar *field = extra + 4;
+            if (id == 0x0001) {
+                entry.zip64 = true;
+                if (entry.uncompressedSize == 0xFFFFFFFF && field + 8 <= extraEnd) {
+                    entry.uncompressedSize = qFromLittleEndian<quint64>(field);
+                    field += 8;
+                }
+                if (entry.compressedSize == 0xFFFFFFFF && field + 8 <= extraEnd) {
+                    entry.compressedSize = qFromLittleEndian<quint64>(field);
+                }
+            }
+            extra += 4 + size;
+        }
+
+        inputPosition += 30 + nameLength + extraLength;
+
+        if (entry.flags & FlagEncrypted) {
+            fail(QString("Encrypted entry %1").arg(entryName));
+            return false;
+        }
+        if (entry.method != MethodStored && entry.method != MethodDeflated) {
+            fail(QString("Unsupported compression method %1 of %2").arg(entry.method).arg(entryName));
+            return false;
+        }
+        if (entry.method == MethodStored && (entry.flags & FlagDataDescriptor)) {
+            fail(QString("Stored entry %1 has no size").arg(entryName));
+            return false;
+        }
+
+        entry.remaining = (entry.flags & FlagDataDescriptor) ? -1 : entry.compressedSize;
+        entry.actualCrc = crc32(0, Z_NULL, 0);
+        entry.written   = 0;
+
+        if (entryName.endsWith("/")) {
+            if (!entryFilter && ZipExtractor::isSafePath(entryName)) {
+                QDir().mkpath(staging + "/" + entryName);
+            }
+            entry.path.clear();
+        } else {
+            entry.path = entryFilter ? entryFilter(entryName) : entryName;
+        }
+        entry.skip = entry.path.isEmpty();
+
+        if (!entry.skip) {
+            if (!ZipExtractor::isSafePath(entry.path)) {
+                fail(QString("Unsafe path in zip archive: %1").arg(entryName));
+                return false;
+            }
+            entry.path = QDir::cleanPath(entry.path);
+
+            const QString fileName = staging + "/" + entry.path;
+            QDir().mkpath(QFileInfo(fileName).path());
+            outFile.setFileName(fileName);
+            if (!outFile.open(QIODevice::WriteOnly | QIODevice::Truncate)) {
+                fail(QString("Cannot create %1: %2").arg(entry.path, outFile.errorString()));
+                return false;
+            }
+        }
+
+        if (entry.method == MethodDeflated) {
+            inflateReset(&stream);
+        }
+
+        state = EntryData;
+        return true;
+    }
+
+    bool StreamingUnzip::readEntryData()
+    {
+        qint64 available = input.size() - inputPosition;
+        if (entry.remaining >= 0) {
+            available = qMin(available, entry.remaining);
+        }
+        const char *data = input.constData() + inputPosition;
+
+        if (entry.method == MethodStored) {
+            if (available > 0 && !writeOutput(data, static_cast<int>(available))) {
+                return false;
+            }
+            inputPosition += static_cast<int>(available);
+            entry.remaining -= available;
+            return entry.remaining == 0 && finishEntry();
+        }
+
+        stream.next_in  = reinterpret_cast<Bytef *>(const_cast<char *>(data));
+        stream.avail_in = static_cast<uInt>(available);
+
+        int result = Z_OK;
+        do {
+            stream.next_out  = reinterpret_cast<Bytef *>(outputBuffer.data());
+            stream.avail_out = static_cast<uInt>(outputBuffer.size());
+
+            result = inflate(&stream, Z_NO_FLUSH);
+            if (result != Z_OK && result != Z_STREAM_END && result != Z_BUF_ERROR) {
+                fail(QString("Cannot inflate %1: %2").arg(entry.path, QString::fromLatin1(stream.msg)));
+                return false;
+            }
+
+            const int produced = outputBuffer.size() - static_cast<int>(stream.avail_out);
+            if (produced > 0 && !writeOutput(outputBuffer.constData(), produced)) {
+                return false;
+            }
+        } while (result != Z_STREAM_END && stream.avail_out == 0);
+
+        const qint64 consumed = available - stream.avail_in;
+        inputPosition += static_cast<int>(consumed);
+        if (entry.remaining >= 0) {
+            entry.remaining -= consumed;
+        }
+
+        if (result == Z_STREAM_END) {
+            if (entry.remaining > 0) {
+                fail(QString("Compressed size mismatch of %1").arg(entry.path));
+                return false;
+            }
+            return finishEntry();
+        }
+        if (entry.remaining == 0) {
+            fail(QString("Truncated deflate stream of %1").arg(entry.path));
+        }
+        return false;
+    }
+
+    bool StreamingUnzip::readDataDescriptor()
+    {
+        const int available = input.size() - inputPosition;
+        if (available < 4) {
+            return false;
+        }
+
+        const uchar *p = reinterpret_cast<const uchar *>(input.constData()) + inputPosition;
+
+        // the signature of the data descriptor is optional
+        const int header      = (qFromLittleEndian<quint32>(p) == DataDescriptorSignature) ? 4 : 0;
+        const int sizeLength  = entry.zip64 ? 8 : 4;
+        const int totalLength = header + 4 + 2 * sizeLength;
+        if (available < totalLength) {
+            return false;
+        }
+
+        const quint32 crc = qFromLittleEndian<quint32>(p + header);
+        const qint64 uncompressedSize =
+            entry.zip64 ? static_cast<qint64>(qFromLittleEndian<quint64>(p + header + 4 + sizeLength))
+                        : static_cast<qint64>(qFromLittleEndian<quint32>(p + header + 4 + sizeLength));
+
+        inputPosition += totalLength;
+        return verifyEntry(crc, uncompressedSize);
+    }
+
+    bool StreamingUnzip::finishEntry()
+    {
+        if (entry.flags & FlagDataDescriptor) {
+            state = DataDescriptor;
+            return true;
+        }
+        return verifyEntry(entry.crc, entry.uncompressedSize);
+    }
+
+    bool StreamingUnzip::verifyEntry(quint32 crc, qint64 uncompressedSize)
+    {
+        if (entry.actualCrc != crc || entry.written != uncompressedSize) {
+            fail(QString("CRC error in %1").arg(entry.path));
+            return false;
+        }
+
+        if (!entry.skip) {
+            if (entry.modified.isValid()) {
+                outFile.setFileTime(entry.modified, QFileDevice::FileModificationTime);
+            }
+            outFile.close();
+        }
+
+        state = LocalHeader;
+        return true;
+    }
+
+    bool StreamingUnzip::writeOutput(const char *data, int length)
+    {
+        // skipped entries are inflated as well, to find their end and to check them
+        entry.actualCrc = crc32(entry.actualCrc, reinterpret_cast<const Bytef *>(data), static_cast<uInt>(length));
+        entry.written += length;
+
+        if (!entry.skip && outFile.write(data, length) != length) {
+            fail(QString("Cannot write %1: %2").arg(entry.path, outFile.errorString()));
+            return false;
+        }
+        return true;
+    }
+
+    void StreamingUnzip::fail(const QString &message)
+    {
+        if (state != Failed) {
+            qDebug() << "[StreamingUnzip]" << message;
+            error = message;
+            state = Failed;
+        }
+        outFile.close();
+    }
+
+    QDateTime StreamingUnzip::fromDosTime(quint16 time, quint16 date)
+    {
+        const QDate day((date >> 9) + 1980, (date >> 5) & 0x0F, date & 0x1F);
+        const QTime clock(time >> 11, (time >> 5) & 0x3F, (time & 0x1F) * 2);
+        return QDateTime(day, clock);
+    }
+} // namespace Updater
@@ -0,0 +1,106 @@
+#ifndef STREAMINGUNZIP_H
+#define STREAMINGUNZIP_H
+
+#include "zipextractor.h"
+
+#include <QAtomicInteger>
+#include <QByteArray>
+#include <QDateTime>
+#include <QFile>
+#include <QObject>
+#include <QString>
+
+#include <zlib.h>
+
+namespace Updater
+{
+    /**
+     * StreamingUnzip extracts a ZIP archive, while it is being downloaded.
+     *
+     * The archive is fed in file order. Every entry is inflated (raw deflate, zlib) as soon
+     * as its local file header and data have arrived, and its CRC is checked at the end of
+     * the entry. The archive is complete, when the central directory is reached.
+     *
+     * Entries are written into a staging folder, committing it is left to the caller.
+     * Encrypted entries and stored entries with a data descriptor (their size is unknown
+     * until the central directory) can not be streamed: the unzip fails and the caller
+     * extracts the downloaded file instead.
+     *
+     * The object is meant to live in a worker thread, data is handed over with post().
+     */
+    class StreamingUnzip : public QObject
+    {
+        Q_OBJECT
+
+    public:
+        StreamingUnzip(const QString &stagingFolder, const ZipExtractor::EntryFilter &filter);
+        ~StreamingUnzip();
+
+        // thread-safe
+        void post(const QByteArray &data);
+        qint64 pendingBytes() const;
+
+    public slots:
+        void restart();
+        void abort();
+        void finish();
+
+    signals:
+        void finished(bool complete, const QString &errorString);
+
+    private slots:
+        void addData(const QByteArray &data);
+
+    private:
+        enum State
+        {
+            LocalHeader,
+            EntryData,
+            DataDescriptor,
+            CentralDirectory, // all entries are extracted
+            Failed
+        };
+
+        bool readLocalHeader();
+        bool readEntryData();
+        bool readDataDescriptor();
+        bool finishEntry();
+        bool verifyEntry(quint32 crc, qint64 uncompressedSize);
+        bool writeOutput(const char *data, int length);
+        void fail(const QString &message);
+
+        static QDateTime fromDosTime(quint16 time, quint16 date);
+
+        QString staging;
+        ZipExtractor::EntryFilter entryFilter;
+        State state;
+        QString error;
+
+        QByteArray input;
+        int inputPosition;
+        QAtomicInteger<qint64> pending;
+
+        z_stream stream;
+        QByteArray outputBuffer;
+
+        // the current entry
+        struct Entry
+        {
+            QString path;
+            quint16 flags;
+            quint16 method;
+            quint32 crc;
+            qint64 compressedSize;
+            qint64 uncompressedSize;
+            qint64 remaining; // compressed bytes left, -1 = unknown (data descriptor)
+            bool zip64;
+            bool skip;
+            quint32 actualCrc;
+            qint64 written;
+            QDateTime modified;
+        } entry;
+        QFile outFile;
+    };
+} // namespace Updater
+
+#endif // STREAMINGUNZIP_H
@@ -0,0 +1,44 @@
+#include "tokenbucket.h"
+
+#include <limits>
+
+namespace Downloader
+{
+    TokenBucket::TokenBucket() : bytesPerSecond(0), tokens(0) {}
+
+    void TokenBucket::setRate(qint64 rate)
+    {
+        bytesPerSecond = qMax<qint64>(0, rate);
+        tokens         = 0;
+        clock.start();
+    }
+
+    qint64 TokenBucket::rate() const { return bytesPerSecond; }
+
+    bool TokenBucket::isLimited() const { return bytesPerSecond > 0; }
+
+    void TokenBucket::refill()
+    {
+        const qint64 elapsed = clock.restart();
+        const double burst   = qMax(bytesPerSecond / 4.0, 16.0 * 1024);
+
+        tokens = qMin(burst, tokens + elapsed * bytesPerSecond / 1000.0);
+    }
+
+    qint64 TokenBucket::available()
+    {
+        if (!isLimited()) {
+            return std::numeric_limits<qint64>::max();
+        }
+
+        refill();
+        return tokens > 0 ? static_cast<qint64>(tokens) : 0;
+    }
+
+    void TokenBucket::consume(qint64 bytes)
+    {
+        if (isLimited()) {
+            tokens -= bytes;
+        }
+    }
+} // namespace Downloader
@@ -0,0 +1,36 @@
+#ifndef TOKENBUCKET_H
+#define TOKENBUCKET_H
+
+#include <QElapsedTimer>
+
+namespace Downloader
+{
+    /**
+     * TokenBucket limits the bandwidth of transfers.
+     *
+     * Tokens (bytes) are refilled continuously at the configured rate, up to a burst
+     * of a quarter second. Reading more than available puts the bucket into debt,
+     * which is paid back by the following refills. A rate of 0 means unlimited.
+     */
+    class TokenBucket
+    {
+    public:
+        TokenBucket();
+
+        void setRate(qint64 bytesPerSecond);
+        qint64 rate() const;
+        bool isLimited() const;
+
+        qint64 available();
+        void consume(qint64 bytes);
+
+    private:
+        void refill();
+
+        qint64 bytesPerSecond;
+        double tokens;
+        QElapsedTimer clock;
+    };
+} // namespace Downloader
+
+#endif // TOKENBUCKET_H
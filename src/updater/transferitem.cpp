@@ -1,19 +1,45 @@
 #include "downloadmanager.h"
+#include "../file/json.h"
 
 #include <QDir>
+#include <QFileInfo>
+#include <QJsonArray>
+#include <QJsonObject>
 
 namespace Downloader
 {
+    // segments are at least 4 MB, smaller downloads use a single connection
+    static const qint64 MinSegmentSize = 4 * 1024 * 1024;
+
+    // progress updates are coalesced to this rate
+    static const int ProgressFramesPerSecond = 15;
+
+    // larger downloads are written to disk by a writer thread
+    static const qint64 ThreadedWriteSize = 32 * 1024 * 1024;
+
+    // a mirror, which stays below this speed for a few seconds, is replaced by the next one
+    static const qint64 MinMirrorSpeed  = 32 * 1024;
+    static const int SlowMirrorSeconds = 5;
+
     TransferItem::TransferItem(const QNetworkRequest &r, QNetworkAccessManager &n)
-        : request(r), reply(nullptr), nam(n), inputFile(nullptr), outputFile(nullptr)
+        : request(r), reply(nullptr), nam(n), inputFile(nullptr), outputFile(nullptr), progressOffset(0), state(Queued),
+          priority(0), queuePosition(0), globalBandwidth(nullptr), hash(QCryptographicHash::Sha256), hashedBytes(0),
+          failed(false), progressChanged(false), lastSampleTime(0), lastSampleBytes(0)
     {
         // qDebug() << "New TransferItem instantiated";
+
+        progressTimer.setInterval(1000 / ProgressFramesPerSecond);
+        connect(&progressTimer, SIGNAL(timeout()), this, SLOT(emitProgress()));
+
+        // the final progress is emitted before anyone else is told, that the transfer finished
+        connect(this, SIGNAL(transferFinished(Downloader::TransferItem *)), this, SLOT(flushProgress()));
     }
 
     void TransferItem::startGetRequest()
     {
         qDebug() << "TransferItem::startRequest()";
 
+        state = Running;
         reply = nam.get(request);
 
         connect(reply, SIGNAL(readyRead()), this, SLOT(readyRead()));
@@ -23,123 +49,852 @@ namespace Downloader
         timer.start();
     }
 
-    void TransferItem::finished() { emit transferFinished(this); }
+    void TransferItem::finished()
+    {
+        state = Done;
+        emit transferFinished(this);
+    }
+
+    void TransferItem::pause()
+    {
+        if (state == Running && reply && reply->isRunning()) {
+            state = Paused;
+            reply->abort();
+        } else if (state == Queued) {
+            state = Paused;
+        }
+    }
+
+    void TransferItem::readPending() {}
+
+    void TransferItem::setBandwidthLimit(qint64 bytesPerSecond) { bandwidth.setRate(bytesPerSecond); }
+
+    void TransferItem::setGlobalBandwidth(TokenBucket *bucket) { globalBandwidth = bucket; }
+
+    void TransferItem::setExpectedChecksum(const QByteArray &sha256Hex) { expectedSha256 = sha256Hex.toLower(); }
+
+    void TransferItem::setMirrors(const QList<QUrl> &urls) { mirrors = urls; }
+
+    void TransferItem::setQueuePosition(int position)
+    {
+        if (queuePosition != position) {
+            queuePosition = position;
+            emit queuePositionChanged(position);
+        }
+    }
+
+    /**
+     * Returns how many bytes may be read from the reply within the bandwidth limits.
+     * The rest stays in the read buffer of the reply, until readPending() is called again.
+     */
+    qint64 TransferItem::readAllowance(QNetworkReply *source, bool all)
+    {
+        qint64 allowed = source->bytesAvailable();
+        if (!all) {
+            allowed = qMin(allowed, bandwidth.available());
+            if (globalBandwidth) {
+                allowed = qMin(allowed, globalBandwidth->available());
+            }
+        }
+        return allowed;
+    }
+
+    void TransferItem::consumeBandwidth(qint64 bytes)
+    {
+        bandwidth.consume(bytes);
+        if (globalBandwidth) {
+            globalBandwidth->consume(bytes);
+        }
+    }
+
+    /**
+     * A throttled reply must not buffer the whole download in memory,
+     * so its read buffer is limited to about a quarter second of data.
+     */
+    void TransferItem::applyReadBufferSize(QNetworkReply *source)
+    {
+        qint64 rate = bandwidth.rate();
+        if (globalBandwidth && globalBandwidth->isLimited()) {
+            rate = rate > 0 ? qMin(rate, globalBandwidth->rate()) : globalBandwidth->rate();
+        }
+        if (rate > 0) {
+            source->setReadBufferSize(qMax<qint64>(64 * 1024, rate / 4));
+        }
+    }
+
+    // SLOT
+    /**
+     * All bytes of the file pass through here once, in file order: they are hashed
+     * and handed to a stream consumer, e.g. the pipelined install.
+     */
+    void TransferItem::addStreamData(const char *data, int length)
+    {
+        hash.addData(data, length);
+        hashedBytes += length;
+        emit streamData(QByteArray::fromRawData(data, length));
+    }
+
+    /**
+     * The file is received again from the start.
+     */
+    void TransferItem::resetStream()
+    {
+        hash.reset();
+        hashedBytes = 0;
+        emit streamRestarted();
+    }
 
     // SLOT
     void TransferItem::updateDownloadProgress(qint64 bytesReceived, qint64 bytesTotal)
     {
-        progress["bytesReceived"] = QString::number(bytesReceived);
-        progress["bytesTotal"]    = QString::number(bytesTotal);
-        progress["size"]          = getSizeHumanReadable(outputFile->size());
-        progress["speed"] = QString::number((double)outputFile->size() / timer.elapsed(), 'f', 0).append(" KB/s");
-        // progress["time"]          =
-        // QString::number((double)timer.elapsed()/1000,'f',2).append("s");
-        // progress["eta"]           =
-        progress["percentage"] =
-            (bytesTotal > 0) ? QString::number(bytesReceived * 100 / bytesTotal).append("%") : "0 %";
+        // the reply only counts the bytes of the current request, add the bytes of a resumed download
+        progress.bytesReceived = bytesReceived + progressOffset;
+        progress.bytesTotal    = (bytesTotal > 0) ? bytesTotal + progressOffset : -1;
 
-        emit downloadProgress(progress);
+        // progress is only stored here, it is emitted at a fixed frame rate
+        progressChanged = true;
+        if (!progressTimer.isActive()) {
+            progressTimer.start();
+        }
     }
 
-    QString TransferItem::getSizeHumanReadable(qint64 bytes)
+    /**
+     * Emits the progress at most once per frame and updates the speed estimate.
+     *
+     * The speed is an exponentially weighted moving average of the per-frame
+     * throughput, which keeps the ETA stable when the throughput jitters.
+     */
+    void TransferItem::emitProgress()
     {
-        float num = bytes;
-        QStringList list;
-        list << "KB"
-             << "MB"
-             << "GB"
-             << "TB";
+        if (!progressChanged) {
+            progressTimer.stop();
+            return;
+        }
+        progressChanged = false;
+
+        const qint64 now = progressClock.isValid() ? progressClock.elapsed() : 0;
+        if (!progressClock.isValid() || progress.bytesReceived < lastSampleBytes) {
+            progressClock.start();
+            lastSampleTime  = 0;
+            lastSampleBytes = progress.bytesReceived;
+        } else if (now > lastSampleTime) {
+            const double sample = (progress.bytesReceived - lastSampleBytes) * 1000.0 / (now - lastSampleTime);
+            progress.bytesPerSecond =
+                (progress.bytesPerSecond > 0) ? 0.2 * sample + 0.8 * progress.bytesPerSecond : sample;
+            lastSampleTime  = now;
+            lastSampleBytes = progress.bytesReceived;
+        }
+
+        if (progress.bytesTotal > 0 && progress.bytesPerSecond > 0) {
+            progress.secondsRemaining =
+                static_cast<qint64>((progress.bytesTotal - progress.bytesReceived) / progress.bytesPerSecond);
+        } else {
+            progress.secondsRemaining = -1;
+        }
 
-        QStringListIterator i(list);
-        QString unit("bytes");
+        emit downloadProgress(progress);
+    }
 
-        while (num >= 1024.0 && i.hasNext()) {
-            unit = i.next();
-            num /= 1024.0;
+    void TransferItem::flushProgress()
+    {
+        if (progressChanged) {
+            emitProgress();
         }
-        return QString::fromLatin1("%1 %2").arg(num, 3, 'f', 1).arg(unit);
+        progressTimer.stop();
     }
 
     DownloadItem::DownloadItem(const QNetworkRequest &r, QNetworkAccessManager &manager)
-        : TransferItem(r, manager), downloadFolder()
+        : TransferItem(r, manager), downloadFolder(), downloadSkipped(false), resumeOffset(0), responseChecked(false),
+          writeBody(false), restartWithoutRange(false), rangeRetried(false), maxSegments(4), segmentingDisabled(false),
+          fileSize(0), segmentBytes(0), cache(nullptr), mirrorSampleBytes(0), slowTicks(0), switchingMirror(false)
     {
+        mirrorTimer.setInterval(1000);
+        connect(&mirrorTimer, SIGNAL(timeout()), this, SLOT(checkMirrorThroughput()));
+        connect(this, SIGNAL(transferFinished(Downloader::TransferItem *)), this, SLOT(stopMirrorWatchdog()));
     }
 
     DownloadItem::~DownloadItem() {}
 
-    void DownloadItem::readyRead()
+    void DownloadItem::startGetRequest()
     {
-        // qDebug() << "DownloadItem::readyRead() ...";
+        qDebug() << "DownloadItem::startGetRequest()";
+
+        // a resumed (previously paused) download starts over with a fresh state
+        state               = Running;
+        reply               = nullptr;
+        restartWithoutRange = false;
+        rangeRetried        = false;
+        segments.clear();
+        redirects.clear();
+        setQueuePosition(0);
+        resetStream();
+        failed = false;
+        errorString.clear();
+        cachedSha256.clear();
+        failedMirrors.clear();
+        switchingMirror = false;
 
-        if (!outputFile) {
-            outputFile = new QFile(this);
+        if (targetFilePath.isEmpty()) {
+            targetFilePath = getTargetFilePath();
+            partFilePath   = targetFilePath + ".part";
+            stateFilePath  = partFilePath + ".json";
         }
 
-        if (!outputFile->isOpen()) {
-            // qDebug() << reply->header(QNetworkRequest::ContentTypeHeader) <<
-            QVariant v2 = reply->header(QNetworkRequest::ContentLengthHeader); // there is a invalid value
-            if (v2.type() != QVariant::Invalid) {
-                // int ContentLength = v2.toInt();
-                qDebug() << "ContentLengthHeader:" + v2.toString();
+        qDebug() << "[DownloadItem] Download Filepath (Target):" << targetFilePath;
+
+        if (downloadMode == DownloadMode::SkipIfExists && QFile::exists(targetFilePath)) {
+            qDebug() << "[DownloadItem] DownloadMode::SkipIfExists - File exists:" << targetFilePath;
+
+            // an existing file is only trusted, when it has the expected checksum
+            if (!expectedSha256.isEmpty()) {
+                QFile existingFile(targetFilePath);
+                if (existingFile.open(QIODevice::ReadOnly)) {
+                    hashFileRange(existingFile, 0, existingFile.size());
+                }
+                sha256 = hash.result().toHex();
             }
 
-            // get filename from URL
-            QString fileName = reply->url().path();
-            fileName         = fileName.mid(fileName.lastIndexOf('/') + 1);
-            if (fileName.isEmpty()) {
-                fileName = QLatin1String("index.html"); // fallback filename
+            // a verified file was streamed completely, a pipelined install can use it as is
+            if (expectedSha256.isEmpty() || sha256 == expectedSha256) {
+                downloadSkipped = true;
+                QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
+                return;
             }
-            qDebug() << "[DownloadItem::readyRead] Filename from URL:" << fileName;
 
-            if (!downloadFolder.endsWith(QDir::separator())) {
-                downloadFolder.append(QDir::separator());
+            qDebug() << "[DownloadItem] Checksum mismatch of the existing file, downloading again.";
+            QFile::remove(targetFilePath);
+            resetStream();
+        }
+
+        // a file with a known checksum is served from the cache, without any request
+        if (cache && !expectedSha256.isEmpty() && cache->materialize(expectedSha256, targetFilePath)) {
+            // replayed like an existing file, so stream consumers (pipelined installs, delta patches) get the data
+            QFile cachedFile(targetFilePath);
+            if (cachedFile.open(QIODevice::ReadOnly) && hashFileRange(cachedFile, 0, cachedFile.size()) &&
+                hash.result().toHex() == expectedSha256) {
+                qDebug() << "[DownloadItem] Served from cache:" << targetFilePath;
+                sha256          = expectedSha256;
+                downloadSkipped = true;
+                QMetaObject::invokeMethod(this, "finished", Qt::QueuedConnection);
+                return;
             }
 
-            QString downloadFilePath = QDir::toNativeSeparators(downloadFolder.append(fileName));
+            qDebug() << "[DownloadItem] The cached file is unreadable or corrupt, downloading again.";
+            cachedFile.close();
+            QFile::remove(targetFilePath);
+            resetStream();
+        }
 
-            outputFile->setFileName(downloadFilePath);
+        // with mirrors, the fastest one is selected by a race of small range requests
+        const QList<QUrl> candidates = mirrorCandidates();
+        if (candidates.size() > 1) {
+            delete mirrorRace;
+            mirrorRace = new MirrorRace(candidates, this);
+            connect(mirrorRace, SIGNAL(finished(QUrl)), this, SLOT(mirrorRaceFinished(QUrl)));
+            mirrorRace->start();
+            timer.start();
+            return;
+        }
 
-            qDebug() << "[DownloadItem::readyRead] Download Filepath (Target):" << downloadFilePath;
+        currentMirror = request.url();
+        sendFirstRequest();
+        timer.start();
+    }
 
-            if (downloadMode == DownloadMode::SkipIfExists) {
-                qDebug() << "[DownloadItem::readyRead] DownloadMode::SkipIfExists - File exists:"
-                         << outputFile->exists();
-                if (outputFile->exists()) {
-                    downloadSkipped = true;
-                    reply->abort();
-                    return;
-                }
-                outputFile->open(QIODevice::WriteOnly | QIODevice::Truncate);
-            } else if (downloadMode == DownloadMode::Overwrite) {
-                // if the file already exists, overwrite (delete and write)
-                if (outputFile->exists()) {
-                    outputFile->remove();
+    void DownloadItem::mirrorRaceFinished(const QUrl &winner)
+    {
+        mirrorRace->deleteLater();
+
+        // paused meanwhile
+        if (state != Running) {
+            return;
+        }
+
+        currentMirror = winner.isEmpty() ? MirrorScores::shared().rank(mirrorCandidates()).first() : winner;
+        sendFirstRequest();
+    }
+
+    void DownloadItem::sendFirstRequest()
+    {
+        // continue a previously interrupted download, if the server still has the same file
+        resumeOffset = loadPartialState();
+
+        // without a checksum, only the mirror, which sent the validators, can continue the file
+        if ((resumeOffset > 0 || !segments.isEmpty()) && !canContinueOn(currentMirror)) {
+            if (mirrorCandidates().contains(validatorMirror)) {
+                currentMirror = validatorMirror;
+            } else {
+                removePartialState();
+            }
+        }
+
+        if (mirrorCandidates().size() > 1) {
+            mirrorSampleBytes = resumeOffset;
+            slowTicks         = 0;
+            mirrorTimer.start();
+        }
+
+        if (!segments.isEmpty()) {
+            resumeSegments();
+            return;
+        }
+
+        QNetworkRequest rangeRequest(mirrorRequest());
+        if (resumeOffset > 0) {
+            qDebug() << "[DownloadItem] Resuming" << partFilePath << "at byte" << resumeOffset;
+            setRangeHeaders(rangeRequest, resumeOffset);
+        } else if (currentMirror == request.url()) {
+            // otherwise revalidate a cached download of the same URL: "304 Not Modified" is served from the cache
+            DownloadCache::UrlEntry cached;
+            if (cache && cache->lookupUrl(request.url(), &cached)) {
+                cachedSha256 = cached.sha256;
+                if (!cached.eTag.isEmpty()) {
+                    rangeRequest.setRawHeader("If-None-Match", cached.eTag);
                 }
-                outputFile->open(QIODevice::WriteOnly | QIODevice::Truncate);
-            } else if (downloadMode == DownloadMode::Enumerate) {
-                // if the file already exists, append a number, e.g. "file.zip.1"
-                for (int i = 1; i < 1000; i++) {
-                    if (!outputFile->exists() && outputFile->open(QIODevice::WriteOnly | QIODevice::Truncate)) {
-                        break;
-                    }
-                    QString enumedFileName   = QString(QLatin1String("%1.%2")).arg(fileName).arg(i);
-                    QString downloadFilePath = QDir::toNativeSeparators(downloadFolder.append(enumedFileName));
-                    outputFile->setFileName(downloadFilePath);
+                if (!cached.lastModified.isEmpty()) {
+                    rangeRequest.setRawHeader("If-Modified-Since", cached.lastModified);
                 }
             }
+        }
+
+        sendRequest(rangeRequest);
+    }
+
+    void DownloadItem::sendRequest(const QNetworkRequest &r)
+    {
+        currentRequest  = r;
+        responseChecked = false;
+        writeBody       = false;
+
+        reply = nam.get(currentRequest);
+        reply->setParent(this);
+        applyReadBufferSize(reply);
+        connect(reply, SIGNAL(readyRead()), this, SLOT(readyRead()));
+        connect(reply, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(updateDownloadProgress(qint64, qint64)));
+        connect(reply, SIGNAL(finished()), this, SLOT(finished()));
+    }
+
+    /**
+     * The request URL and the mirrors, all of them serve the same file.
+     */
+    QList<QUrl> DownloadItem::mirrorCandidates() const
+    {
+        QList<QUrl> candidates;
+        candidates.append(request.url());
+        for (const QUrl &mirror : mirrors) {
+            if (mirror.isValid() && !candidates.contains(mirror)) {
+                candidates.append(mirror);
+            }
+        }
+        return candidates;
+    }
+
+    QNetworkRequest DownloadItem::mirrorRequest() const
+    {
+        QNetworkRequest r(request);
+        if (currentMirror.isValid()) {
+            r.setUrl(currentMirror);
+        }
+        // the mirror race probes over HTTP/1.1, the download reuses the connection of the winner
+        if (!mirrors.isEmpty()) {
+            r.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
+        }
+        return r;
+    }
+
+    /**
+     * ETag and Last-Modified only identify the file on the mirror, which sent them.
+     * Another mirror can continue the file, when the checksum verifies the result.
+     */
+    bool DownloadItem::canContinueOn(const QUrl &mirror) const
+    {
+        return mirror == validatorMirror || !expectedSha256.isEmpty();
+    }
+
+    void DownloadItem::setRangeHeaders(QNetworkRequest &r, qint64 from, qint64 to) const
+    {
+        QByteArray range = "bytes=" + QByteArray::number(from) + "-";
+        if (to >= 0) {
+            range += QByteArray::number(to);
+        }
+        r.setRawHeader("Range", range);
+
+        // parallel ranges of one file are only parallel on separate connections, not multiplexed on one
+        r.setAttribute(QNetworkRequest::Http2AllowedAttribute, false);
+
+        const QByteArray validator = eTag.isEmpty() ? lastModified : eTag;
+        if (currentMirror == validatorMirror && !validator.isEmpty()) {
+            r.setRawHeader("If-Range", validator);
+        }
+    }
+
+    /**
+     * Marks the current mirror as failed and selects the next best one.
+     * Returns false, if there is no mirror left.
+     */
+    bool DownloadItem::switchMirror(const QString &reason)
+    {
+        const QList<QUrl> candidates = MirrorScores::shared().rank(mirrorCandidates());
+        if (candidates.size() < 2) {
+            return false;
+        }
+
+        MirrorScores::shared().recordFailure(currentMirror);
+        failedMirrors.append(currentMirror);
 
-            // if file still not open, abort
-            if (!outputFile->isOpen()) {
-                qDebug() << "[DownloadItem::readyRead] couldn't open output file" << outputFile->fileName();
+        for (const QUrl &mirror : candidates) {
+            if (!failedMirrors.contains(mirror)) {
+                qDebug() << "[DownloadItem] Switching from" << currentMirror.host() << "to" << mirror.host() << "-"
+                         << reason;
+                currentMirror = mirror;
+                segmentUrl    = mirror;
+                slowTicks     = 0;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    /**
+     * Continues the download on currentMirror at the current byte offset,
+     * or from the start, if the file can not be continued there.
+     */
+    void DownloadItem::continueOnMirror()
+    {
+        switchingMirror = false;
+
+        // keep everything received so far
+        if (sink.isOpen()) {
+            if (writeBody) {
+                readBody(true);
+            }
+            savePartialState();
+            sink.close();
+        }
+        reply->deleteLater();
+        redirects.clear();
+
+        QNetworkRequest continueRequest(mirrorRequest());
+        resumeOffset = QFileInfo(partFilePath).size();
+        if (resumeOffset > 0 && canContinueOn(currentMirror)) {
+            qDebug() << "[DownloadItem] Continuing at byte" << resumeOffset << "from" << currentMirror;
+            setRangeHeaders(continueRequest, resumeOffset);
+        } else {
+            removePartialState();
+        }
+
+        sendRequest(continueRequest);
+        timer.restart();
+    }
+
+    /**
+     * A segment failed (or its mirror was replaced): it is continued on the current mirror.
+     */
+    bool DownloadItem::retrySegment(int i, QNetworkReply *segmentReply)
+    {
+        if (state != Running || failed || expectedSha256.isEmpty() || mirrorCandidates().size() < 2) {
+            return false;
+        }
+
+        // the segment failed on the current mirror, otherwise the mirror was already switched
+        if (segments.at(i).url == segmentUrl && !switchMirror(segmentReply->errorString())) {
+            return false;
+        }
+
+        segmentReply->deleteLater();
+        requestSegment(i);
+        return true;
+    }
+
+    /**
+     * Measures the throughput of the current mirror once per second. A mirror, which is
+     * slower than MinMirrorSpeed for SlowMirrorSeconds, is replaced by the next one.
+     */
+    void DownloadItem::checkMirrorThroughput()
+    {
+        if (state != Running || switchingMirror) {
+            return;
+        }
+
+        const qint64 bytesPerSecond = progress.bytesReceived - mirrorSampleBytes;
+        mirrorSampleBytes           = progress.bytesReceived;
+
+        // data held back by the bandwidth limit is not the fault of the mirror
+        bool throttled = reply && reply->bytesAvailable() > 0;
+        for (const Segment &segment : segments) {
+            throttled |= segment.reply && segment.reply->bytesAvailable() > 0;
+        }
+        if (throttled) {
+            slowTicks = 0;
+            return;
+        }
+
+        if (bytesPerSecond > 0) {
+            MirrorScores::shared().recordThroughput(currentMirror, bytesPerSecond);
+        }
+
+        slowTicks = (bytesPerSecond < MinMirrorSpeed) ? slowTicks + 1 : 0;
+
+        // without a checksum, a switch would start from zero
+        if (slowTicks < SlowMirrorSeconds || (expectedSha256.isEmpty() && (hashedBytes > 0 || !segments.isEmpty()))) {
+            return;
+        }
+
+        if (!switchMirror(tr("slower than %1 KB/s").arg(MinMirrorSpeed / 1024))) {
+            return;
+        }
+
+        if (!segments.isEmpty()) {
+            // the segments are requested from the new mirror, when they finished
+            abortSegments();
+        } else if (reply && reply->isRunning()) {
+            switchingMirror = true;
+            reply->abort();
+        }
+    }
+
+    void DownloadItem::stopMirrorWatchdog()
+    {
+        mirrorTimer.stop();
+        if (mirrorCandidates().size() > 1) {
+            MirrorScores::shared().save();
+        }
+    }
+
+    /**
+     * The target filename is taken from the requested URL, not from the URL of a redirect,
+     * so that a resumed download ends up in the same file.
+     */
+    QString DownloadItem::getTargetFilePath()
+    {
+        QString fileName = request.url().path();
+        fileName         = fileName.mid(fileName.lastIndexOf('/') + 1);
+        if (fileName.isEmpty()) {
+            fileName = QLatin1String("index.html"); // fallback filename
+        }
+        qDebug() << "[DownloadItem] Filename from URL:" << fileName;
+
+        if (!downloadFolder.endsWith(QDir::separator())) {
+            downloadFolder.append(QDir::separator());
+        }
+
+        QString downloadFilePath = QDir::toNativeSeparators(downloadFolder + fileName);
+
+        if (downloadMode == DownloadMode::Enumerate) {
+            // if the file already exists, append a number, e.g. "file.zip.1"
+            for (int i = 1; i < 1000 && QFile::exists(downloadFilePath); i++) {
+                QString enumedFileName = QString(QLatin1String("%1.%2")).arg(fileName).arg(i);
+                downloadFilePath       = QDir::toNativeSeparators(downloadFolder + enumedFileName);
+            }
+        }
+
+        return downloadFilePath;
+    }
+
+    /**
+     * Reads the sidecar of a ".part" file and returns the offset to resume at.
+     * Returns 0, if there is nothing to resume. Stale partial files are removed.
+     */
+    qint64 DownloadItem::loadPartialState()
+    {
+        QFile partFile(partFilePath);
+        if (!partFile.exists()) {
+            QFile::remove(stateFilePath);
+            return 0;
+        }
+
+        QJsonObject state = File::JSON::load(stateFilePath).object();
+
+        eTag            = state["etag"].toString().toLatin1();
+        lastModified    = state["lastModified"].toString().toLatin1();
+        validatorMirror = QUrl(state["mirror"].toString(request.url().toString()));
+
+        // a weak ETag can not be used for a range request (RFC 7233 3.2)
+        if (eTag.startsWith("W/")) {
+            eTag.clear();
+        }
+
+        if (state["url"].toString() != request.url().toString() || (eTag.isEmpty() && lastModified.isEmpty())) {
+            removePartialState();
+            return 0;
+        }
+
+        if (state.contains("segments")) {
+            return loadSegmentState(state, partFile.size());
+        }
+
+        // the sidecar is written periodically, so the part file might contain a few more bytes
+        const qint64 offset = qMin(static_cast<qint64>(state["offset"].toDouble()), partFile.size());
+        if (offset < partFile.size() && !partFile.resize(offset)) {
+            removePartialState();
+            return 0;
+        }
+
+        return offset;
+    }
+
+    void DownloadItem::savePartialState()
+    {
+        stateTimer.start();
+
+        // without a validator there is no safe way to resume
+        if (eTag.isEmpty() && lastModified.isEmpty()) {
+            return;
+        }
+
+        qint64 offset = 0;
+        if (!segments.isEmpty()) {
+            sink.flush();
+            offset = segmentBytes;
+        } else if (sink.isOpen()) {
+            sink.flush();
+            offset = sink.size();
+        } else {
+            offset = QFileInfo(partFilePath).size();
+        }
+
+        QJsonObject state;
+        state["url"]          = request.url().toString();
+        state["etag"]         = QString::fromLatin1(eTag);
+        state["lastModified"] = QString::fromLatin1(lastModified);
+        state["mirror"]       = validatorMirror.toString();
+        state["offset"]       = static_cast<double>(offset);
+
+        // segments are stored as [start, end, offset]
+        if (!segments.isEmpty()) {
+            QJsonArray segmentList;
+            for (const Segment &segment : segments) {
+                segmentList.append(QJsonArray({static_cast<double>(segment.start), static_cast<double>(segment.end),
+                                               static_cast<double>(segment.offset)}));
+            }
+            state["size"]     = static_cast<double>(fileSize);
+            state["segments"] = segmentList;
+        }
+
+        File::JSON::save(QJsonDocument(state), stateFilePath);
+    }
+
+    void DownloadItem::removePartialState()
+    {
+        sink.close();
+        QFile::remove(partFilePath);
+        resetStream();
+        QFile::remove(stateFilePath);
+        eTag.clear();
+        lastModified.clear();
+        validatorMirror.clear();
+        resumeOffset = 0;
+        segments.clear();
+        segmentBytes = 0;
+    }
+
+    /**
+     * Inspects the response headers and opens the part file for writing.
+     *
+     * 206 Partial Content appends to the part file. 200 OK means the server ignored
+     * the range or the file changed since (If-Range), so the download starts from zero.
+     * Bodies of redirects and error pages are never written to the file.
+     */
+    void DownloadItem::checkResponse()
+    {
+        responseChecked = true;
+        writeBody       = false;
+
+        const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
+        if (statusCode != 200 && statusCode != 206) {
+            if (statusCode < 300 || statusCode >= 400) {
+                qDebug() << "[DownloadItem] HTTP Status" << statusCode << "for" << reply->url();
+            }
+            return;
+        }
+
+        QVariant contentLength = reply->header(QNetworkRequest::ContentLengthHeader);
+        if (contentLength.isValid()) {
+            qDebug() << "ContentLengthHeader:" + contentLength.toString();
+        }
+
+        eTag            = reply->rawHeader("ETag");
+        lastModified    = reply->rawHeader("Last-Modified");
+        validatorMirror = currentMirror;
+        if (eTag.startsWith("W/")) {
+            eTag.clear();
+        }
+
+        if (statusCode == 206) {
+            // "Content-Range: bytes 1000-1999/2000"
+            const QByteArray contentRange = reply->rawHeader("Content-Range");
+            const int dash                = contentRange.indexOf('-');
+            const qint64 rangeStart       = contentRange.mid(6, dash - 6).trimmed().toLongLong();
+            const qint64 rangeTotal       = contentRange.mid(contentRange.indexOf('/') + 1).toLongLong();
+
+            // another mirror must have a file of the same size
+            if (!contentRange.startsWith("bytes ") || rangeStart != resumeOffset ||
+                (fileSize > 0 && rangeTotal > 0 && rangeTotal != fileSize)) {
+                qDebug() << "[DownloadItem] Unexpected Content-Range" << contentRange << "for offset" << resumeOffset;
+                restartWithoutRange = true;
                 reply->abort();
                 return;
             }
+            fileSize = rangeTotal;
+
+            // the bytes already on disk are hashed once (unless they were hashed on the way),
+            // the rest is hashed while it arrives
+            if (hashedBytes > resumeOffset) {
+                resetStream();
+            }
+            QFile partFile(partFilePath);
+            if (!partFile.open(QIODevice::ReadOnly) || !hashFileRange(partFile, hashedBytes, resumeOffset)) {
+                qDebug() << "[DownloadItem] Could not read" << partFilePath;
+                restartWithoutRange = true;
+                reply->abort();
+                return;
+            }
+            partFile.close();
+
+            sink.open(partFilePath, FileSink::Append);
+        } else {
+            if (resumeOffset > 0) {
+                qDebug() << "[DownloadItem] Server sent the full file, restarting from zero.";
+            }
+            resumeOffset = 0;
+            fileSize     = contentLength.toLongLong();
+            if (hashedBytes > 0) {
+                resetStream();
+            }
+
+            if (canSegment()) {
+                startSegments(contentLength.toLongLong());
+                return;
+            }
+
+            sink.open(partFilePath, FileSink::Truncate);
+        }
+
+        progressOffset = resumeOffset;
+
+        // if file still not open, abort
+        if (!sink.isOpen()) {
+            qDebug() << "[DownloadItem] couldn't open output file" << partFilePath << sink.errorString();
+            reply->abort();
+            return;
+        }
+
+        // reserve the disk space for the whole file up front
+        if (contentLength.isValid()) {
+            const qint64 size = resumeOffset + contentLength.toLongLong();
+            sink.setThreaded(size >= ThreadedWriteSize);
+            sink.preallocate(size);
+        }
+
+        qDebug() << reply->url() << " -> " << partFilePath;
+
+        savePartialState();
+        writeBody = true;
+    }
+
+    void DownloadItem::readyRead()
+    {
+        if (!responseChecked) {
+            checkResponse();
+        }
+
+        // the first request turned into the first segment
+        if (!segments.isEmpty()) {
+            readSegment(qobject_cast<QNetworkReply *>(sender()));
+            return;
+        }
+
+        // discard the body of redirects and error pages
+        if (!writeBody) {
+            reply->readAll();
+            return;
+        }
+
+        readBody();
+    }
+
+    void DownloadItem::readBody(bool all)
+    {
+        // write reply to file, the bytes are hashed (and streamed) on the way
+        const qint64 length = sink.append(reply, readAllowance(reply, all),
+                                          [this](const char *data, int size) { addStreamData(data, size); });
+        consumeBandwidth(length);
+
+        if (sink.hasError()) {
+            qDebug() << "[DownloadItem] couldn't write output file" << partFilePath << sink.errorString();
+            failed      = true;
+            errorString = sink.errorString();
+            reply->abort();
+            return;
+        }
+
+        // keep the resume offset reasonably fresh, in case the application crashes
+        if (stateTimer.elapsed() > 1000) {
+            savePartialState();
+        }
+    }
+
+    /**
+     * Continues reading data, which was held back by the bandwidth limit.
+     */
+    void DownloadItem::readPending()
+    {
+        if (state != Running) {
+            return;
+        }
+
+        if (!segments.isEmpty()) {
+            QList<QNetworkReply *> running;
+            for (const Segment &segment : segments) {
+                if (segment.reply && segment.reply->bytesAvailable() > 0) {
+                    running.append(segment.reply);
+                }
+            }
+            for (QNetworkReply *segmentReply : running) {
+                readSegment(segmentReply);
+            }
+            return;
+        }
 
-            qDebug() << reply->url() << " -> " << outputFile->fileName();
+        if (reply && writeBody && reply->bytesAvailable() > 0) {
+            readBody();
         }
+    }
 
-        // write reply to file
-        outputFile->write(reply->readAll());
+    /**
+     * Pausing aborts the running requests and keeps the part file,
+     * so that the download is resumed with a range request later.
+     */
+    void DownloadItem::pause()
+    {
+        if (state == Queued) {
+            state = Paused;
+            return;
+        }
+        if (state != Running) {
+            return;
+        }
+
+        state = Paused;
+
+        if (!segments.isEmpty()) {
+            abortSegments();
+        } else if (reply && reply->isRunning()) {
+            reply->abort();
+        } else {
+            stopPaused();
+        }
+    }
+
+    void DownloadItem::stopPaused()
+    {
+        if (sink.isOpen()) {
+            savePartialState();
+            sink.close();
+        }
+        timer.invalidate();
+        qDebug() << "[DownloadItem] Paused" << request.url();
     }
 
     void DownloadItem::finished()
@@ -148,11 +903,36 @@ namespace Downloader
 
         // handle a download skip, file exists
         if (downloadSkipped) {
+            state = Done;
             timer.invalidate();
             emit transferFinished(this);
             return;
         }
 
+        if (state == Paused) {
+            if (!segments.isEmpty()) {
+                finishSegment(qobject_cast<QNetworkReply *>(sender()));
+            } else {
+                if (sink.isOpen() && writeBody) {
+                    readBody(true);
+                }
+                stopPaused();
+            }
+            return;
+        }
+
+        // an empty body does not trigger readyRead()
+        if (!responseChecked) {
+            checkResponse();
+        }
+
+        if (!segments.isEmpty()) {
+            finishSegment(qobject_cast<QNetworkReply *>(sender()));
+            return;
+        }
+
+        const int statusCode = reply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+
         // handle redirect
         if (reply->attribute(QNetworkRequest::RedirectionTargetAttribute).isValid()) {
             QUrl url = reply->attribute(QNetworkRequest::RedirectionTargetAttribute).toUrl();
@@ -163,38 +943,535 @@ namespace Downloader
             } else if (redirects.count() > 10) {
                 qDebug() << "[DownloadItem] Too Many Redirects";
             } else {
-                downloadMode = DownloadMode::Overwrite;
-                // follow redirect
-                if (outputFile && outputFile->isOpen()) {
-                    if (!outputFile->seek(0) || !outputFile->resize(0)) {
-                        outputFile->close();
-                        outputFile->remove();
-                    }
-                }
+                // follow redirect, keeping the Range and If-Range headers
+                QNetworkRequest redirectRequest(currentRequest);
+                redirectRequest.setUrl(url);
                 reply->deleteLater();
-                reply = nam.get(QNetworkRequest(url));
-                reply->setParent(this);
-                connect(reply, SIGNAL(readyRead()), this, SLOT(readyRead()));
-                connect(reply, SIGNAL(downloadProgress(qint64, qint64)), this,
-                        SLOT(updateDownloadProgress(qint64, qint64)));
-                connect(reply, SIGNAL(finished()), this, SLOT(finished()));
+                sendRequest(redirectRequest);
                 timer.restart();
                 redirects.append(url);
                 return;
             }
         }
+
+        // 416 Range Not Satisfiable: either the part file is already complete or it is stale
+        if (statusCode == 416 && resumeOffset > 0) {
+            const QByteArray contentRange = reply->rawHeader("Content-Range"); // "bytes */2000"
+            if (contentRange.startsWith("bytes */") && contentRange.mid(8).toLongLong() == resumeOffset) {
+                qDebug() << "[DownloadItem] Part file is already complete.";
+                writeBody = true;
+            } else {
+                restartWithoutRange = true;
+            }
+        }
+
+        if (restartWithoutRange && !rangeRetried) {
+            rangeRetried        = true;
+            restartWithoutRange = false;
+            removePartialState();
+            reply->deleteLater();
+            sendRequest(mirrorRequest());
+            timer.restart();
+            return;
+        }
+
+        // the range was rejected again, after the restart without it: the part file is useless
+        if (restartWithoutRange) {
+            qDebug() << "[DownloadItem] Range rejected again, giving up:" << reply->url();
+            removePartialState();
+            failed      = true;
+            errorString = tr("The server sent an unexpected range of the file");
+            state       = Done;
+            timer.invalidate();
+            emit transferFinished(this);
+            return;
+        }
+
+        if (statusCode == 304 && !cachedSha256.isEmpty()) {
+            const QByteArray cachedFile = cachedSha256;
+            cachedSha256.clear();
+
+            if (cache->materialize(cachedFile, targetFilePath)) {
+                qDebug() << "[DownloadItem] Not modified, served from cache:" << targetFilePath;
+                sha256 = cachedFile;
+                state  = Done;
+                timer.invalidate();
+                emit transferFinished(this);
+                return;
+            }
+
+            // the cached file is gone, download it again
+            reply->deleteLater();
+            sendRequest(request);
+            timer.restart();
+            return;
+        }
+
+        // a failing (or too slow) mirror: continue the download on the next one
+        const bool mirrorFailed = reply->error() != QNetworkReply::NoError &&
+                                  reply->error() != QNetworkReply::OperationCanceledError;
+        if (!failed && (switchingMirror || (mirrorFailed && switchMirror(reply->errorString())))) {
+            continueOnMirror();
+            return;
+        }
+
         // normal download finish (not redirected, not skipped)
 
-        // write reply to file
-        if (outputFile && outputFile->isOpen()) {
-            outputFile->write(reply->readAll());
-            outputFile->close();
+        if (sink.isOpen()) {
+            if (writeBody) {
+                readBody(true);
+            }
+            if (!sink.close() && !failed) {
+                failed      = true;
+                errorString = sink.errorString();
+            }
         }
 
+        if (writeBody && !failed && reply->error() == QNetworkReply::NoError) {
+            completeDownload();
+        } else {
+            if (QFile::exists(partFilePath)) {
+                // keep the part file for a later resume
+                qDebug() << "[DownloadItem] Download interrupted:" << reply->errorString();
+                savePartialState();
+            }
+            if (!failed) {
+                failed      = true;
+                errorString = reply->error() != QNetworkReply::NoError ? reply->errorString()
+                                                                       : tr("Download interrupted");
+            }
+        }
+
+        state = Done;
         timer.invalidate();
         emit transferFinished(this);
     }
 
+    /**
+     * The download is complete: verify the checksum and move the part file into place.
+     */
+    bool DownloadItem::completeDownload()
+    {
+        // normally everything is hashed already, this only catches up in special cases (e.g. 416)
+        QFile partFile(partFilePath);
+        if (partFile.open(QIODevice::ReadOnly)) {
+            if (hashedBytes < partFile.size()) {
+                hashFileRange(partFile, hashedBytes, partFile.size());
+            }
+            partFile.close();
+        }
+
+        sha256 = hash.result().toHex();
+
+        if (!expectedSha256.isEmpty() && sha256 != expectedSha256) {
+            qDebug() << "[DownloadItem] Checksum mismatch for" << request.url() << "expected" << expectedSha256 << "got"
+                     << sha256;
+            failed      = true;
+            errorString = tr("Checksum mismatch");
+            removePartialState();
+            return false;
+        }
+
+        if (QFile::exists(targetFilePath)) {
+            QFile::remove(targetFilePath);
+        }
+        if (!QFile::rename(partFilePath, targetFilePath)) {
+            qDebug() << "[DownloadItem] Could not rename" << partFilePath << "to" << targetFilePath;
+            failed      = true;
+            errorString = tr("Could not rename %1").arg(partFilePath);
+        }
+        QFile::remove(stateFilePath);
+
+        if (!failed && cache) {
+            cache->insert(targetFilePath, sha256, request.url(), eTag, lastModified);
+        }
+        return !failed;
+    }
+
+    /**
+     * Adds the bytes [from, to) of a file to the checksum.
+     */
+    bool DownloadItem::hashFileRange(QFile &file, qint64 from, qint64 to)
+    {
+        if (!file.seek(from)) {
+            return false;
+        }
+
+        QByteArray buffer(256 * 1024, Qt::Uninitialized);
+        while (from < to) {
+            const qint64 bytesRead = file.read(buffer.data(), qMin<qint64>(buffer.size(), to - from));
+            if (bytesRead <= 0) {
+                return false;
+            }
+            addStreamData(buffer.constData(), static_cast<int>(bytesRead));
+            from += bytesRead;
+        }
+        return true;
+    }
+
+    /**
+     * Segments arrive out of order, but the checksum needs the bytes in order.
+     * Data of the segment at the hash position is hashed directly, when it arrives.
+     * Data, which was written ahead, is read back once (from the page cache),
+     * when the hash position reaches it.
+     */
+    void DownloadItem::hashSegments()
+    {
+        QFile partFile(partFilePath);
+        for (const Segment &segment : segments) {
+            if (hashedBytes < segment.start || hashedBytes > segment.end) {
+                continue;
+            }
+            if (segment.offset > hashedBytes) {
+                sink.flush();
+                if (!partFile.isOpen() && !partFile.open(QIODevice::ReadOnly)) {
+                    return;
+                }
+                hashFileRange(partFile, hashedBytes, segment.offset);
+            }
+            if (segment.offset <= segment.end) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * A download is split into segments, when the file is large enough and the server
+     * supports range requests. A validator is needed, so that all segments are
+     * guaranteed to come from the same version of the file.
+     */
+    bool DownloadItem::canSegment() const
+    {
+        const qint64 contentLength = reply->header(QNetworkRequest::ContentLengthHeader).toLongLong();
+
+        return maxSegments > 1 && !segmentingDisabled && contentLength >= 2 * MinSegmentSize &&
+               reply->rawHeader("Accept-Ranges").contains("bytes") && (!eTag.isEmpty() || !lastModified.isEmpty());
+    }
+
+    /**
+     * Splits the download into byte ranges, which are fetched concurrently.
+     *
+     * The running request becomes the first segment and is aborted, when it reaches
+     * the start of the second segment. The other segments are requested with "Range".
+     * All segments write into the pre-allocated part file at their own position.
+     */
+    void DownloadItem::startSegments(qint64 size)
+    {
+        sink.setThreaded(size >= ThreadedWriteSize);
+        if (!sink.open(partFilePath, FileSink::Truncate) || !sink.preallocate(size) || !sink.resize(size)) {
+            qDebug() << "[DownloadItem] couldn't pre-allocate output file" << partFilePath << size;
+            sink.close();
+            reply->abort();
+            return;
+        }
+
+        fileSize       = size;
+        segmentBytes   = 0;
+        progressOffset = 0;
+        resetStream();
+
+        // request the other segments from the final URL, to avoid a redirect per segment
+        segmentUrl = reply->url();
+
+        const int count            = static_cast<int>(qMin<qint64>(maxSegments, size / MinSegmentSize));
+        const qint64 segmentLength = size / count;
+
+        segments.clear();
+        for (int i = 0; i < count; ++i) {
+            Segment segment;
+            segment.start   = i * segmentLength;
+            segment.end     = (i == count - 1) ? size - 1 : (i + 1) * segmentLength - 1;
+            segment.offset  = segment.start;
+            segment.reply   = nullptr;
+            segment.checked = false;
+            segments.append(segment);
+        }
+
+        qDebug() << "[DownloadItem]" << reply->url() << "->" << partFilePath << "in" << count << "segments";
+
+        // the first segment is the running request
+        disconnect(reply, SIGNAL(downloadProgress(qint64, qint64)), this, SLOT(updateDownloadProgress(qint64, qint64)));
+        segments[0].reply   = reply;
+        segments[0].checked = true;
+        segments[0].url     = segmentUrl;
+
+        for (int i = 1; i < segments.size(); ++i) {
+            requestSegment(i);
+        }
+
+        savePartialState();
+    }
+
+    /**
+     * Continues a segmented download, which was interrupted.
+     */
+    void DownloadItem::resumeSegments()
+    {
+        sink.setThreaded(fileSize >= ThreadedWriteSize);
+        if (!sink.open(partFilePath, FileSink::Append)) {
+            qDebug() << "[DownloadItem] couldn't open output file" << partFilePath;
+            removePartialState();
+            sendRequest(mirrorRequest());
+            return;
+        }
+
+        progressOffset = segmentBytes;
+        segmentUrl     = currentMirror;
+
+        // hash the finished start of the file
+        resetStream();
+        hashSegments();
+
+        qDebug() << "[DownloadItem] Resuming" << partFilePath << "at" << segmentBytes << "of" << fileSize << "bytes";
+
+        for (int i = 0; i < segments.size(); ++i) {
+            if (segments.at(i).offset <= segments.at(i).end) {
+                requestSegment(i);
+            }
+        }
+
+        // all segments were done, only the rename was missing
+        if (reply == nullptr) {
+            QMetaObject::invokeMethod(this, "completeSegments", Qt::QueuedConnection);
+        }
+    }
+
+    void DownloadItem::requestSegment(int i)
+    {
+        Segment &segment = segments[i];
+
+        QNetworkRequest segmentRequest(request);
+        segmentRequest.setUrl(segmentUrl);
+        segmentRequest.setAttribute(QNetworkRequest::FollowRedirectsAttribute, true);
+        setRangeHeaders(segmentRequest, segment.offset, segment.end);
+
+        segment.checked = false;
+        segment.url     = segmentUrl;
+        segment.reply   = nam.get(segmentRequest);
+        segment.reply->setParent(this);
+        applyReadBufferSize(segment.reply);
+        connect(segment.reply, SIGNAL(readyRead()), this, SLOT(segmentReadyRead()));
+        connect(segment.reply, SIGNAL(finished()), this, SLOT(segmentFinished()));
+
+        // the manager reports the status of the last reply
+        reply = segment.reply;
+    }
+
+    int DownloadItem::indexOfSegment(QNetworkReply *segmentReply) const
+    {
+        for (int i = 0; i < segments.size(); ++i) {
+            if (segments.at(i).reply == segmentReply) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void DownloadItem::segmentReadyRead() { readSegment(qobject_cast<QNetworkReply *>(sender())); }
+
+    void DownloadItem::segmentFinished() { finishSegment(qobject_cast<QNetworkReply *>(sender())); }
+
+    void DownloadItem::readSegment(QNetworkReply *segmentReply, bool drain)
+    {
+        const int i = indexOfSegment(segmentReply);
+        if (i < 0) {
+            segmentReply->readAll();
+            return;
+        }
+
+        Segment &segment = segments[i];
+
+        // a segment must be answered with exactly the requested range of the same file
+        if (!segment.checked) {
+            segment.checked = true;
+
+            const int statusCode          = segmentReply->attribute(QNetworkRequest::HttpStatusCodeAttribute).toInt();
+            const QByteArray contentRange = segmentReply->rawHeader("Content-Range");
+            const int dash                = contentRange.indexOf('-');
+
+            if (statusCode != 206 || contentRange.mid(6, dash - 6).trimmed().toLongLong() != segment.offset) {
+                qDebug() << "[DownloadItem] Segment" << i << "failed with HTTP Status" << statusCode << contentRange;
+                restartWithoutRange = true;
+                abortSegments();
+                return;
+            }
+        }
+
+        // the first segment is open ended, its data beyond the range stays unread
+        const qint64 allowed = qMin(readAllowance(segmentReply, drain), segment.end + 1 - segment.offset);
+        const bool inOrder   = segment.offset == hashedBytes;
+        const qint64 length  = sink.write(segment.offset, segmentReply, allowed,
+                                         [this, inOrder](const char *data, int size) {
+                                             if (inOrder) {
+                                                 addStreamData(data, size);
+                                             }
+                                         });
+        consumeBandwidth(length);
+
+        if (sink.hasError()) {
+            qDebug() << "[DownloadItem] couldn't write output file" << partFilePath << sink.errorString();
+            failed      = true;
+            errorString = sink.errorString();
+            abortSegments();
+            return;
+        }
+
+        if (length > 0) {
+            segment.offset += length;
+            segmentBytes += length;
+
+            if (segment.offset == segment.end + 1) {
+                hashSegments();
+            }
+        }
+
+        updateDownloadProgress(segmentBytes - progressOffset, fileSize - progressOffset);
+
+        // the first segment is an open ended request, stop it at the end of its range
+        if (segment.offset > segment.end && segmentReply->isRunning()) {
+            segmentReply->abort();
+            return;
+        }
+
+        if (stateTimer.elapsed() > 1000) {
+            savePartialState();
+        }
+    }
+
+    void DownloadItem::finishSegment(QNetworkReply *segmentReply)
+    {
+        const int i = indexOfSegment(segmentReply);
+        if (i < 0) {
+            return;
+        }
+
+        if (!restartWithoutRange && segmentReply->bytesAvailable() > 0) {
+            readSegment(segmentReply, true);
+        }
+
+        segments[i].reply = nullptr;
+
+        if (segments.at(i).offset <= segments.at(i).end && !restartWithoutRange) {
+            if (retrySegment(i, segmentReply)) {
+                return;
+            }
+            qDebug() << "[DownloadItem] Segment" << i << "interrupted:" << segmentReply->errorString();
+        }
+
+        for (const Segment &segment : segments) {
+            if (segment.reply != nullptr) {
+                return;
+            }
+        }
+
+        // all segments stopped, finish outside of the signal handler of the reply
+        QMetaObject::invokeMethod(this, "completeSegments", Qt::QueuedConnection);
+    }
+
+    void DownloadItem::abortSegments()
+    {
+        QList<QNetworkReply *> running;
+        for (const Segment &segment : segments) {
+            if (segment.reply != nullptr) {
+                running.append(segment.reply);
+            }
+        }
+        for (QNetworkReply *segmentReply : running) {
+            segmentReply->abort();
+        }
+    }
+
+    void DownloadItem::completeSegments()
+    {
+        if (state == Paused) {
+            stopPaused();
+            return;
+        }
+
+        // a segment was rejected: the file changed or the server does not handle ranges well
+        if (restartWithoutRange && !rangeRetried) {
+            rangeRetried        = true;
+            restartWithoutRange = false;
+            segmentingDisabled  = true;
+            removePartialState();
+            sendRequest(mirrorRequest());
+            timer.restart();
+            return;
+        }
+
+        bool complete = !restartWithoutRange;
+        for (const Segment &segment : segments) {
+            complete &= segment.offset > segment.end;
+        }
+
+        if (complete && sink.close() && !failed) {
+            completeDownload();
+        } else {
+            // keep the part file and the segment offsets for a later resume
+            savePartialState();
+            sink.close();
+            if (!failed && sink.hasError()) {
+                failed      = true;
+                errorString = sink.errorString();
+            }
+            // a segment stopped short of its range: the part file is not the whole file
+            if (!failed && !complete) {
+                failed      = true;
+                errorString = tr("Download interrupted");
+            }
+        }
+
+        state = Done;
+        timer.invalidate();
+        emit transferFinished(this);
+    }
+
+    /**
+     * Restores the segments of an interrupted segmented download from its sidecar.
+     */
+    qint64 DownloadItem::loadSegmentState(const QJsonObject &state, qint64 partFileSize)
+    {
+        fileSize = static_cast<qint64>(state["size"].toDouble());
+
+        // the part file is pre-allocated, it must have the full size
+        if (fileSize <= 0 || partFileSize != fileSize || segmentingDisabled) {
+            removePartialState();
+            return 0;
+        }
+
+        segments.clear();
+        segmentBytes = 0;
+
+        const QJsonArray segmentList = state["segments"].toArray();
+        for (const QJsonValue &value : segmentList) {
+            const QJsonArray values = value.toArray();
+
+            Segment segment;
+            segment.start   = static_cast<qint64>(values.at(0).toDouble());
+            segment.end     = static_cast<qint64>(values.at(1).toDouble());
+            segment.offset  = static_cast<qint64>(values.at(2).toDouble());
+            segment.reply   = nullptr;
+            segment.checked = false;
+
+            if (segment.start > segment.end || segment.end >= fileSize || segment.offset < segment.start ||
+                segment.offset > segment.end + 1) {
+                removePartialState();
+                return 0;
+            }
+
+            segmentBytes += segment.offset - segment.start;
+            segments.append(segment);
+        }
+
+        return segmentBytes;
+    }
+
+    QString DownloadItem::fileName() const { return targetFilePath; }
+
+    void DownloadItem::setMaxSegments(int segmentCount) { maxSegments = segmentCount; }
+
+    void DownloadItem::setCache(DownloadCache *downloadCache) { cache = downloadCache; }
+
     void DownloadItem::setDownloadFolder(QString folder) { downloadFolder = folder; }
 
     void DownloadItem::setDownloadMode(DownloadItem::DownloadMode mode) { downloadMode = mode; }
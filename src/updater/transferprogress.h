@@ -0,0 +1,25 @@
+#ifndef TRANSFERPROGRESS_H
+#define TRANSFERPROGRESS_H
+
+#include <QMetaType>
+
+namespace Downloader
+{
+    /**
+     * TransferProgress is a plain snapshot of the progress of a transfer.
+     *
+     * It carries numbers only. Human readable strings are formatted by the view,
+     * when the progress is actually painted.
+     */
+    struct TransferProgress
+    {
+        qint64 bytesReceived    = 0;
+        qint64 bytesTotal       = -1; // -1 = unknown
+        double bytesPerSecond   = 0; // smoothed (EWMA)
+        qint64 secondsRemaining = -1; // -1 = unknown
+    };
+} // namespace Downloader
+
+Q_DECLARE_METATYPE(Downloader::TransferProgress)
+
+#endif // TRANSFERPROGRESS_H
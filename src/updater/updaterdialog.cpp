@@ -16,11 +16,30 @@ namespace Updater
 
         setWindowTitle("WPN-XM Server Control Panel - Updater");
 
-        softwareRegistry = new SoftwareRegistry::Manager();
+        // the registry is served from its local copy, the dialog opens without waiting for the network
+        softwareRegistry = new SoftwareRegistry::Manager(this);
+        connect(softwareRegistry, SIGNAL(registryUpdated()), this, SLOT(registryUpdated()));
+        connect(softwareRegistry, SIGNAL(registryFailed(QString)), this, SLOT(registryFailed(QString)));
+
+        // download scheduling: limit the number of connections and the bandwidth (KB/s, 0 = unlimited),
+        // so that a batch of updates does not starve the rest of the system
+        Settings::SettingsManager settings;
+        downloadManager.setMaxConcurrentTransfers(settings.get("updater/maxconcurrentdownloads", 3).toInt());
+        Downloader::DownloadManager::setGlobalBandwidthLimit(settings.get("updater/bandwidthlimit", 0).toLongLong() *
+                                                             1024);
+        Downloader::DownloadCache::shared().setMaxSize(settings.get("updater/cachesize", 2048).toLongLong() * 1024 *
+                                                       1024);
+
+        connect(&package, SIGNAL(packageInstalled(QString, bool, QString)), this,
+                SLOT(packageInstalled(QString, bool, QString)));
+        connect(&package, SIGNAL(inventorySeeded()), this, SLOT(inventorySeeded()));
 
         initModel(softwareRegistry->getServerStackSoftwareRegistry());
 
         initView();
+
+        // revalidate the registry in the background, the model is updated, when it changed
+        softwareRegistry->refresh();
     }
 
     UpdaterDialog::~UpdaterDialog() { delete ui; }
@@ -29,6 +48,48 @@ namespace Updater
     {
         model = new QStandardItemModel(0, 4, this);
 
+        updateModel(json);
+
+        /**
+         * Set Header Labels for Table
+         */
+        QStringList headerLabels;
+        // Table               1              (hidden)           2               3
+        // (hidden)        4
+        headerLabels << "Software Component"
+                     << "WebsiteURL"
+                     << "Your Version"
+                     << "Latest Version"
+                     << "DownloadURL"
+                     << "Actions";
+        model->setHorizontalHeaderLabels(headerLabels);
+
+        /**
+         * Setup SortingProxy for the Model
+         */
+        sortFilterProxyModel = new QSortFilterProxyModel(this);
+        sortFilterProxyModel->setSourceModel(model);
+        // sorting is case-insensitive
+        sortFilterProxyModel->setSortCaseSensitivity(Qt::CaseInsensitive);
+        // filtering is case-insensitive and using the software name column
+        sortFilterProxyModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
+        sortFilterProxyModel->setFilterKeyColumn(Columns::SoftwareComponent);
+    }
+
+    /**
+     * Updates the rows of the model with the registry data.
+     *
+     * Existing rows are updated in place, so that running downloads keep their row.
+     */
+    void UpdaterDialog::updateModel(QJsonObject json)
+    {
+        QHash<QString, int> rowOfSoftware;
+        for (int row = 0; row < model->rowCount(); ++row) {
+            rowOfSoftware.insert(model->item(row, Columns::SoftwareComponent)->data(RegistryKeyRole).toString(), row);
+        }
+
+        package.setRegistry(json);
+
         /**
          * @brief jsonObject has the following item structure:
          *
@@ -37,6 +98,7 @@ namespace Updater
          *     "wpnxmscp": {
          *       "latest": {
          *           "url": "https://github.com/WPN-XM/../file.zip",
+         *           "mirrors": ["https://mirror.example.org/../file.zip"],   (optional)
          *           "version": "0.8.4"
          *       },
          *       "name": "WPN-XM Server Control Panel x86",
@@ -52,7 +114,7 @@ namespace Updater
             QList<QStandardItem *> rowItems;
 
             // The "key" is the registry name of the software component.
-            // QString *registrySoftwareName = QString(iter.key());
+            const QString registrySoftwareName = iter.key();
 
             // The "value" is the data of the software component
             QJsonObject software = iter.value().toObject();
@@ -62,10 +124,24 @@ namespace Updater
             // qDebug() << latestVersion["url"].toString() <<
             // latestVersion["version"].toString();
 
+            if (rowOfSoftware.contains(registrySoftwareName)) {
+                const int row = rowOfSoftware.value(registrySoftwareName);
+                model->item(row, Columns::SoftwareComponent)->setText("      " + software["name"].toString());
+                model->item(row, Columns::WebsiteURL)->setText(software["website"].toString());
+                model->item(row, Columns::YourVersion)->setText(installedVersionOf(registrySoftwareName));
+                model->item(row, Columns::LatestVersion)->setText(latestVersionMap["version"].toString());
+                QStandardItem *downloadURL = model->item(row, Columns::DownloadURL);
+                downloadURL->setText(latestVersionMap["url"].toString());
+                downloadURL->setData(latestVersionMap["sha256"].toString(), ChecksumRole);
+                downloadURL->setData(latestVersionMap["mirrors"].toStringList(), MirrorsRole);
+                continue;
+            }
+
             // Table Columns
 
             // Software Name
             QStandardItem *softwareName = new QStandardItem("      " + software["name"].toString());
+            softwareName->setData(registrySoftwareName, RegistryKeyRole);
             rowItems.append(softwareName);
 
             // Website Link
@@ -73,8 +149,7 @@ namespace Updater
             rowItems.append(websiteURL);
 
             // Installed Version (= Your current version)
-            QString installedVersionString  = "1.2.3"; // TODO: detect currently installed versions
-            QStandardItem *installedVersion = new QStandardItem(installedVersionString);
+            QStandardItem *installedVersion = new QStandardItem(installedVersionOf(registrySoftwareName));
             installedVersion->setTextAlignment(Qt::AlignCenter);
             rowItems.append(installedVersion);
 
@@ -85,6 +160,8 @@ namespace Updater
 
             // Download URL for Latest Version
             QStandardItem *latestVersionURL = new QStandardItem(latestVersionMap["url"].toString());
+            latestVersionURL->setData(latestVersionMap["sha256"].toString(), ChecksumRole);
+            latestVersionURL->setData(latestVersionMap["mirrors"].toStringList(), MirrorsRole);
             rowItems.append(latestVersionURL);
 
             // Action
@@ -123,31 +200,23 @@ namespace Updater
 
             model->appendRow(rowItems);
         }
+    }
 
-        /**
-         * Set Header Labels for Table
-         */
-        QStringList headerLabels;
-        // Table               1              (hidden)           2               3
-        // (hidden)        4
-        headerLabels << "Software Component"
-                     << "WebsiteURL"
-                     << "Your Version"
-                     << "Latest Version"
-                     << "DownloadURL"
-                     << "Actions";
-        model->setHorizontalHeaderLabels(headerLabels);
+    void UpdaterDialog::registryUpdated()
+    {
+        qDebug() << "[UpdaterDialog] Software Registry changed, updating the list.";
+        updateModel(softwareRegistry->getServerStackSoftwareRegistry());
+    }
 
-        /**
-         * Setup SortingProxy for the Model
-         */
-        sortFilterProxyModel = new QSortFilterProxyModel(this);
-        sortFilterProxyModel->setSourceModel(model);
-        // sorting is case-insensitive
-        sortFilterProxyModel->setSortCaseSensitivity(Qt::CaseInsensitive);
-        // filtering is case-insensitive and using the software name column
-        sortFilterProxyModel->setFilterCaseSensitivity(Qt::CaseInsensitive);
-        sortFilterProxyModel->setFilterKeyColumn(Columns::SoftwareComponent);
+    void UpdaterDialog::registryFailed(const QString &errorString)
+    {
+        // with a local copy, the list stays usable, the failure is only reported without one
+        if (softwareRegistry->hasServerStackSoftwareRegistry()) {
+            qDebug() << "[UpdaterDialog] Software Registry not revalidated:" << errorString;
+            return;
+        }
+
+        QMessageBox::critical(this, "Request Failure", errorString, QMessageBox::Ok);
     }
 
     void UpdaterDialog::initView()
@@ -232,13 +301,24 @@ namespace Updater
         // enqueue download request
         downloadManager.get(request);
 
-        // setup progressbar
+        // the archive is verified against the checksum of the registry, if it has one
         Downloader::TransferItem *transfer = downloadManager.findTransfer(downloadURL);
+        QModelIndex indexURL               = index.model()->index(index.row(), Columns::DownloadURL, QModelIndex());
+        transfer->setExpectedChecksum(indexURL.data(ChecksumRole).toString().toLatin1());
+
+        // further URLs of the same archive, the fastest mirror is used
+        QList<QUrl> mirrors;
+        foreach (const QString &mirror, indexURL.data(MirrorsRole).toStringList()) {
+            mirrors.append(QUrl(mirror));
+        }
+        transfer->setMirrors(mirrors);
+
+        // setup progressbar
         ProgressBarUpdater *progressBar    = new ProgressBarUpdater(this, index.row());
-        connect(transfer, SIGNAL(downloadProgress(QMap<QString, QVariant>)), progressBar,
-                SLOT(updateProgress(QMap<QString, QVariant>)));
-        connect(transfer, SIGNAL(transferFinished(Downloader::TransferItem * t)), progressBar,
-                SLOT(downloadFinished(Downloader::TransferItem * t)));
+        connect(transfer, SIGNAL(downloadProgress(Downloader::TransferProgress)), progressBar,
+                SLOT(updateProgress(Downloader::TransferProgress)));
+        connect(transfer, SIGNAL(transferFinished(Downloader::TransferItem *)), progressBar,
+                SLOT(downloadFinished(Downloader::TransferItem *)));
 
         // finally: invoke downloading
         QMetaObject::invokeMethod(&downloadManager, "checkForAllDone", Qt::QueuedConnection);
@@ -251,31 +331,24 @@ namespace Updater
         index = model->index(currentRow, UpdaterDialog::Columns::Action);
     }
 
-    void ProgressBarUpdater::updateProgress(const QMap<QString, QVariant>& progress)
+    void ProgressBarUpdater::updateProgress(const Downloader::TransferProgress &progress)
     {
-        // update the "progress" data in the model
-        model->setData(index, progress);
-        model->dataChanged(index, index);
+        // update the "progress" data in the model, the delegate formats it when painting
+        model->setData(index, QVariant::fromValue(progress));
     }
 
     void ProgressBarUpdater::downloadFinished(Downloader::TransferItem *transfer)
     {
         qDebug() << "ProgressBarUpdater::downloadFinished";
 
-        // if this transfer is a redirect, do not switch to the install button, when
-        // we reach 100%
-        // the progress bar is needed for possible other redirects and the final
-        // download indication
-        if (transfer->reply->attribute(QNetworkRequest::RedirectionTargetAttribute).isValid()) {
-            return;
-        }
-
-        // when we reach 100%, "hide" progressBar and "show" Install Button
-        else if (progress["bytesReceived"] == progress["bytesTotal"]) {
+        // redirects are followed inside of the transfer, so this is the final result:
+        // "hide" progressBar and "show" Install Button, or the Download Button again to retry
+        if (transfer->failed || (transfer->reply && transfer->reply->error() != QNetworkReply::NoError &&
+                                 transfer->reply->error() != QNetworkReply::OperationCanceledError)) {
+            model->setData(index, ActionColumnItemDelegate::DownloadPushButton, ActionColumnItemDelegate::WidgetRole);
+        } else {
             model->setData(index, ActionColumnItemDelegate::InstallPushButton, ActionColumnItemDelegate::WidgetRole);
         }
-
-        model->dataChanged(index, index);
     }
 
     QUrl UpdaterDialog::getDownloadUrl(const QModelIndex &index)
@@ -284,7 +357,61 @@ namespace Updater
         return QUrl(ui->tableView_1->model()->data(indexURL).toString());
     }
 
-    void UpdaterDialog::doInstall(const QModelIndex &index) { Q_UNUSED(index); }
+    /**
+     * The servers are stopped for the swap of their packages and started again.
+     */
+    void UpdaterDialog::setServers(Servers::Servers *servers) { package.setServers(servers); }
+
+    void UpdaterDialog::doInstall(const QModelIndex &index)
+    {
+        if (package.isRunning()) {
+            QMessageBox::information(this, "Install", "Please wait until the running installation is finished.");
+            return;
+        }
+
+        QModelIndex indexName     = index.model()->index(index.row(), Columns::SoftwareComponent, QModelIndex());
+        const QString packageName = indexName.data(RegistryKeyRole).toString();
+
+        qDebug() << "[UpdaterDialog] Installing" << packageName;
+
+        // the archive is taken from the downloads folder, dependencies are installed along
+        package.install(packageName);
+    }
+
+    void UpdaterDialog::packageInstalled(const QString &packageName, bool success, const QString &errorString)
+    {
+        if (!success) {
+            QMessageBox::critical(this, "Install Failure", QString("%1: %2").arg(packageName, errorString),
+                                  QMessageBox::Ok);
+            return;
+        }
+
+        for (int row = 0; row < model->rowCount(); ++row) {
+            if (model->item(row, Columns::SoftwareComponent)->data(RegistryKeyRole).toString() == packageName) {
+                model->item(row, Columns::YourVersion)->setText(installedVersionOf(packageName));
+                model->item(row, Columns::Action)
+                    ->setData(ActionColumnItemDelegate::DownloadPushButton, ActionColumnItemDelegate::WidgetRole);
+                break;
+            }
+        }
+    }
+
+    /**
+     * The versions of the components found on disk were probed in the background.
+     */
+    void UpdaterDialog::inventorySeeded()
+    {
+        for (int row = 0; row < model->rowCount(); ++row) {
+            const QString packageName = model->item(row, Columns::SoftwareComponent)->data(RegistryKeyRole).toString();
+            model->item(row, Columns::YourVersion)->setText(installedVersionOf(packageName));
+        }
+    }
+
+    QString UpdaterDialog::installedVersionOf(const QString &packageName)
+    {
+        const QString version = package.version(packageName);
+        return version.isEmpty() ? QString("-") : version;
+    }
 
     void UpdaterDialog::downloadsFinished()
     {
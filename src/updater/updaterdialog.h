@@ -17,7 +17,9 @@
 #include "src/file/json.h"
 #include "src/registry/registrymanager.h"
 
+#include "src/settings.h"
 #include "src/updater/downloadmanager.h"
+#include "src/updater/package.h"
 
 #include "actioncolumnitemdelegate.h"
 #include "softwarecolumnitemdelegate.h"
@@ -37,7 +39,9 @@ namespace Updater
         explicit UpdaterDialog(QWidget *parent = nullptr);
         ~UpdaterDialog();
         void initModel(QJsonObject json);
+        void updateModel(QJsonObject json);
         void initView();
+        void setServers(Servers::Servers *servers);
         enum Columns
         {
             // Column   0             1             2             3            4 5
@@ -48,6 +52,12 @@ namespace Updater
             DownloadURL,
             Action
         };
+        // the SHA-256 of the latest version is stored on the DownloadURL item
+        static const int ChecksumRole = Qt::UserRole + 2;
+        // the registry key of the software is stored on the SoftwareComponent item
+        static const int RegistryKeyRole = Qt::UserRole + 3;
+        // the mirrors of the latest version (QStringList) are stored on the DownloadURL item
+        static const int MirrorsRole = Qt::UserRole + 4;
         Ui::UpdaterDialog *ui;
 
     protected:
@@ -55,10 +65,12 @@ namespace Updater
         QSortFilterProxyModel *sortFilterProxyModel;
         SoftwareRegistry::Manager *softwareRegistry;
         Downloader::DownloadManager downloadManager;
+        Package package;
 
     private:
         QUrl getDownloadUrl(const QModelIndex &index);
         bool validateURL(const QUrl &url);
+        QString installedVersionOf(const QString &packageName);
         Updater::SoftwareColumnItemDelegate *softwareDelegate;
         Updater::ActionColumnItemDelegate *actionDelegate;
     signals:
@@ -69,6 +81,10 @@ namespace Updater
         void downloadsFinished();
     private slots:
         void on_searchLineEdit_textChanged(const QString &arg1);
+        void registryUpdated();
+        void registryFailed(const QString &errorString);
+        void packageInstalled(const QString &packageName, bool success, const QString &errorString);
+        void inventorySeeded();
     };
 
     class ProgressBarUpdater : public QObject
@@ -77,12 +93,9 @@ namespace Updater
     public:
         explicit ProgressBarUpdater(UpdaterDialog *parent = nullptr, int currentRow = 0);
     public slots:
-        void updateProgress(const QMap<QString, QVariant> &progress);
+        void updateProgress(const Downloader::TransferProgress &progress);
         void downloadFinished(Downloader::TransferItem *transfer);
 
-    private:
-        QMap<QString, QVariant> progress;
-
     protected:
         QModelIndex index;
         QAbstractItemModel *model;
@@ -0,0 +1,430 @@
+#include "zipextractor.h"
+
+#include "quazip/quazip.h"
+#include "quazip/quazipfile.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QFuture>
+#include <QPair>
+#include <QSet>
+#include <QThread>
+#include <QtConcurrent>
+
+#include <algorithm>
+
+#ifdef Q_OS_WIN
+#include <Windows.h>
+#else
+#include <cstdio>
+#endif
+
+namespace Updater
+{
+    ZipExtractor::ZipExtractor(const QString &archiveFile) : archive(archiveFile), threadCount(0), failed(0) {}
+
+    void ZipExtractor::setEntryFilter(const EntryFilter &filter) { entryFilter = filter; }
+
+    /**
+     * 0 uses one worker per core.
+     */
+    void ZipExtractor::setThreadCount(int count) { threadCount = count; }
+
+    bool ZipExtractor::extract(const QString &targetFolder, CommitMode mode)
+    {
+        const QString target = QDir::cleanPath(targetFolder);
+
+        if (!stage(target)) {
+            return false;
+        }
+
+        QString commitError;
+        if (!commit(stagingFolder, target, mode, &commitError)) {
+            fail(commitError);
+            QDir(stagingFolder).removeRecursively();
+            qDebug() << "[ZipExtractor] Extraction failed:" << errorString();
+            return false;
+        }
+
+        qDebug() << "[ZipExtractor] Extracted" << archive << "to" << target;
+        return true;
+    }
+
+    /**
+     * Extracts the archive into "<target>.extracting", without touching the target.
+     * The staging folder is committed later, e.g. together with other packages.
+     * This blocks until all workers finished, call it from a worker thread (see InstallPipeline).
+     */
+    bool ZipExtractor::stage(const QString &targetFolder)
+    {
+        const QString target = QDir::cleanPath(targetFolder);
+
+        // the staging folder is a sibling of the target, so that the commit is a rename on the same volume
+        stagingFolder = target + ".extracting";
+        failed        = 0;
+        error.clear();
+
+        recover(target);
+        QDir(stagingFolder).removeRecursively();
+
+        if (!readCentralDirectory()) {
+            return false;
+        }
+
+        // all folders are created up front, the workers only create files
+        for (const QString &folder : folders) {
+            if (!QDir().mkpath(stagingFolder + "/" + folder)) {
+                fail(QString("Cannot create folder %1").arg(folder));
+                QDir(stagingFolder).removeRecursively();
+                return false;
+            }
+        }
+
+        const int ideal       = threadCount > 0 ? threadCount : QThread::idealThreadCount();
+        const int workerCount = qBound(1, ideal, qMax(1, entries.size()));
+
+        qDebug() << "[ZipExtractor] Extracting" << entries.size() << "files from" << archive << "with" << workerCount
+                 << "workers";
+
+        QVector<QFuture<void>> workers;
+        for (const QVector<int> &batch : distribute(workerCount)) {
+            workers.append(QtConcurrent::run(this, &ZipExtractor::extractBatch, batch));
+        }
+        for (QFuture<void> &worker : workers) {
+            worker.waitForFinished();
+        }
+
+        if (failed.load()) {
+            QDir(stagingFolder).removeRecursively();
+            qDebug() << "[ZipExtractor] Extraction failed:" << errorString();
+            return false;
+        }
+
+        return true;
+    }
+
+    QStringList ZipExtractor::extractedFiles() const
+    {
+        QStringList files;
+        for (const Entry &entry : entries) {
+            files.append(entry.path);
+        }
+        return files;
+    }
+
+    QString ZipExtractor::errorString() const
+    {
+        QMutexLocker locker(&mutex);
+        return error;
+    }
+
+    /**
+     * Restores the previous target folder, if a commit was interrupted between its two renames.
+     */
+    void ZipExtractor::recover(const QString &targetFolder)
+    {
+        const QString target   = QDir::cleanPath(targetFolder);
+        const QString previous = target + ".previous";
+
+        if (!QFileInfo::exists(previous)) {
+            return;
+        }
+        if (QFileInfo::exists(target)) {
+            QDir(previous).removeRecursively();
+        } else {
+            qDebug() << "[ZipExtractor] Restoring" << target << "after an interrupted update";
+            QDir().rename(previous, target);
+        }
+    }
+
+    bool ZipExtractor::readCentralDirectory()
+    {
+        entries.clear();
+        folders.clear();
+
+        QuaZip zip(archive);
+        if (!zip.open(QuaZip::mdUnzip)) {
+            fail(QString("Cannot open zip archive %1, error: %2").arg(archive).arg(zip.getZipError()));
+            return false;
+        }
+
+        const QList<QuaZipFileInfo64> infos = zip.getFileInfoList64();
+        zip.close();
+
+        if (zip.getZipError() != UNZ_OK) {
+            fail(QString("Cannot read the central directory of %1, error: %2").arg(archive).arg(zip.getZipError()));
+            return false;
+        }
+
+        QSet<QString> folderSet;
+        for (int i = 0; i < infos.size(); ++i) {
+            const QuaZipFileInfo64 &info = infos.at(i);
+
+            if (info.name.endsWith("/")) {
+                if (!entryFilter && isSafePath(info.name)) {
+                    folderSet.insert(QDir::cleanPath(info.name));
+                }
+                continue;
+            }
+
+            const QString path = entryFilter ? entryFilter(info.name) : info.name;
+            if (path.isEmpty()) {
+                continue;
+            }
+            if (!isSafePath(path)) {
+                fail(QString("Unsafe path in zip archive: %1").arg(info.name));
+                return false;
+            }
+
+            Entry entry;
+            entry.index    = i;
+            entry.path     = QDir::cleanPath(path);
+            entry.size     = static_cast<qint64>(info.uncompressedSize);
+            entry.modified = info.dateTime;
+            entries.append(entry);
+
+            const QString folder = QFileInfo(entry.path).path();
+            if (folder != ".") {
+                folderSet.insert(folder);
+            }
+        }
+
+        folders = folderSet.toList();
+        folders.append(QString("."));
+        return true;
+    }
+
+    /**
+     * Distributes the entries over the workers, so that every worker inflates about the same
+     * number of bytes. The batches are in archive order, so a worker walks the archive forward.
+     */
+    QVector<QVector<int>> ZipExtractor::distribute(int workerCount) const
+    {
+        QVector<int> bySize(entries.size());
+        for (int i = 0; i < entries.size(); ++i) {
+            bySize[i] = i;
+        }
+        std::stable_sort(bySize.begin(), bySize.end(),
+                         [this](int a, int b) { return entries.at(a).size > entries.at(b).size; });
+
+        QVector<QVector<int>> batches(workerCount);
+        QVector<qint64> load(workerCount, 0);
+        for (int i : bySize) {
+            const int worker = static_cast<int>(std::min_element(load.begin(), load.end()) - load.begin());
+            batches[worker].append(i);
+            // small files are dominated by the per-file overhead
+            load[worker] += entries.at(i).size + 64 * 1024;
+        }
+
+        for (QVector<int> &batch : batches) {
+            std::sort(batch.begin(), batch.end());
+        }
+        return batches;
+    }
+
+    /**
+     * Worker: extracts the entries of a batch through an own archive handle.
+     */
+    void ZipExtractor::extractBatch(const QVector<int> &batch)
+    {
+        if (batch.isEmpty()) {
+            return;
+        }
+
+        QuaZip zip(archive);
+        if (!zip.open(QuaZip::mdUnzip)) {
+            fail(QString("Cannot open zip archive %1, error: %2").arg(archive).arg(zip.getZipError()));
+            return;
+        }
+
+        QuaZipFile zippedFile(&zip);
+        QByteArray buffer(256 * 1024, Qt::Uninitialized);
+
+        // walking the central directory is cheap: only headers are read, nothing is inflated
+        int next  = 0;
+        int index = 0;
+        for (bool more = zip.goToFirstFile(); more && next < batch.size(); more = zip.goToNextFile(), ++index) {
+            if (failed.load()) {
+                return;
+            }
+
+            const Entry &entry = entries.at(batch.at(next));
+            if (entry.index != index) {
+                continue;
+            }
+            ++next;
+
+            QFile outFile(stagingFolder + "/" + entry.path);
+            if (!zippedFile.open(QIODevice::ReadOnly) || !outFile.open(QIODevice::WriteOnly)) {
+                fail(QString("Cannot extract %1").arg(entry.path));
+                return;
+            }
+
+            qint64 bytesRead;
+            while ((bytesRead = zippedFile.read(buffer.data(), buffer.size())) > 0) {
+                if (outFile.write(buffer.constData(), bytesRead) != bytesRead) {
+                    fail(QString("Cannot write %1: %2").arg(entry.path, outFile.errorString()));
+                    return;
+                }
+            }
+
+            // closing checks the CRC
+            zippedFile.close();
+            if (bytesRead < 0 || zippedFile.getZipError() != UNZ_OK) {
+                fail(QString("Cannot inflate %1, error: %2").arg(entry.path).arg(zippedFile.getZipError()));
+                return;
+            }
+
+            if (entry.modified.isValid()) {
+                outFile.setFileTime(entry.modified, QFileDevice::FileModificationTime);
+            }
+            outFile.close();
+        }
+
+        if (next < batch.size()) {
+            fail(QString("Unexpected end of zip archive %1").arg(archive));
+        }
+    }
+
+    /**
+     * Commits a completely extracted staging folder.
+     *
+     * ReplaceFolder: target -> target.previous, staging -> target, then target.previous is removed.
+     * If the process dies between the two renames, recover() restores the previous folder.
+     *
+     * MergeFiles: every file replaces its counterpart in the target folder by a rename. The replaced
+     * files are kept as "<file>.previous" and put back, when a file can not be replaced, so the target
+     * folder has either all new or all old files. A ".previous" file, which is in use (a loaded DLL),
+     * is left behind on success.
+     */
+    bool ZipExtractor::commit(const QString &stagingFolder, const QString &targetFolder, CommitMode mode,
+                              QString *errorMessage)
+    {
+        if (mode == ReplaceFolder) {
+            if (!swapFolders(stagingFolder, targetFolder, errorMessage)) {
+                return false;
+            }
+            QDir(targetFolder + ".previous").removeRecursively();
+            return true;
+        }
+
+        const QDir staging(stagingFolder);
+        QStringList files;
+        QDirIterator it(stagingFolder, QDir::Files | QDir::Hidden, QDirIterator::Subdirectories);
+        while (it.hasNext()) {
+            files << it.next();
+        }
+
+        // the targets, which were replaced so far, and whether they existed before
+        QVector<QPair<QString, bool>> replaced;
+
+        auto rollback = [&replaced]() {
+            for (int i = replaced.size() - 1; i >= 0; --i) {
+                const QString &target = replaced.at(i).first;
+                if (replaced.at(i).second) {
+                    replaceFile(target + ".previous", target);
+                } else {
+                    QFile::remove(target);
+                }
+            }
+        };
+
+        for (const QString &file : files) {
+            const QString target   = targetFolder + "/" + staging.relativeFilePath(file);
+            const bool hasPrevious = QFileInfo::exists(target);
+
+            QDir().mkpath(QFileInfo(target).path());
+            if (hasPrevious && !replaceFile(target, target + ".previous")) {
+                rollback();
+                *errorMessage = QString("Cannot move %1 aside, is it in use?").arg(target);
+                return false;
+            }
+            if (!replaceFile(file, target)) {
+                if (hasPrevious) {
+                    replaceFile(target + ".previous", target);
+                }
+                rollback();
+                *errorMessage = QString("Cannot replace %1").arg(target);
+                return false;
+            }
+            replaced.append(qMakePair(target, hasPrevious));
+        }
+
+        for (const auto &entry : replaced) {
+            if (entry.second) {
+                QFile::remove(entry.first + ".previous");
+            }
+        }
+        QDir(stagingFolder).removeRecursively();
+        return true;
+    }
+
+    /**
+     * Swaps the staging folder in with two renames. The old folder is kept as "<target>.previous",
+     * until it is removed by recover(), or put back by restorePrevious().
+     */
+    bool ZipExtractor::swapFolders(const QString &stagingFolder, const QString &targetFolder, QString *errorMessage)
+    {
+        const QString previous = targetFolder + ".previous";
+        const bool hasPrevious = QFileInfo::exists(targetFolder);
+
+        QDir(previous).removeRecursively();
+        if (hasPrevious && !QDir().rename(targetFolder, previous)) {
+            *errorMessage = QString("Cannot move %1 aside, is a file in use?").arg(targetFolder);
+            return false;
+        }
+        if (!QDir().rename(stagingFolder, targetFolder)) {
+            if (hasPrevious) {
+                QDir().rename(previous, targetFolder);
+            }
+            *errorMessage = QString("Cannot move %1 to %2").arg(stagingFolder, targetFolder);
+            return false;
+        }
+        return true;
+    }
+
+    /**
+     * Undoes swapFolders(): the new folder is removed and the previous folder is put back.
+     * A folder, which was installed fresh (there is no previous folder), is removed only.
+     */
+    void ZipExtractor::restorePrevious(const QString &targetFolder)
+    {
+        const QString previous = targetFolder + ".previous";
+        QDir(targetFolder).removeRecursively();
+        if (QFileInfo::exists(previous)) {
+            QDir().rename(previous, targetFolder);
+        }
+    }
+
+    void ZipExtractor::fail(const QString &message)
+    {
+        QMutexLocker locker(&mutex);
+        if (failed.testAndSetOrdered(0, 1)) {
+            error = message;
+        }
+    }
+
+    /**
+     * Rejects absolute paths and paths leaving the target folder ("zip slip").
+     */
+    bool ZipExtractor::isSafePath(const QString &path)
+    {
+        const QString cleaned = QDir::cleanPath(path);
+        return !cleaned.isEmpty() && !QDir::isAbsolutePath(cleaned) && !cleaned.contains(':') &&
+               cleaned != ".." && !cleaned.startsWith("../");
+    }
+
+    bool ZipExtractor::replaceFile(const QString &source, const QString &target)
+    {
+#ifdef Q_OS_WIN
+        return MoveFileExW(reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(source).utf16()),
+                           reinterpret_cast<const wchar_t *>(QDir::toNativeSeparators(target).utf16()),
+                           MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+        return std::rename(QFile::encodeName(source).constData(), QFile::encodeName(target).constData()) == 0;
+#endif
+    }
+} // namespace Updater
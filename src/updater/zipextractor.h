@@ -0,0 +1,84 @@
+#ifndef ZIPEXTRACTOR_H
+#define ZIPEXTRACTOR_H
+
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QMutex>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+namespace Updater
+{
+    /**
+     * ZipExtractor extracts a ZIP archive with a pool of worker threads.
+     *
+     * The central directory is read once. The entries are distributed over the workers
+     * by size (largest first, to the least loaded worker), and every worker inflates its
+     * entries through an own archive handle. Everything is extracted into a staging folder
+     * next to the target, which is only committed by a rename, when all entries were
+     * extracted and passed the CRC check. An interrupted extraction leaves the target untouched.
+     */
+    class ZipExtractor
+    {
+    public:
+        explicit ZipExtractor(const QString &archiveFile);
+
+        enum CommitMode
+        {
+            ReplaceFolder, // the target folder is swapped with the staging folder
+            MergeFiles // the files are moved into the target folder, all replaced files are restored on failure
+        };
+
+        // maps the name of an entry to its path in the target folder, an empty path skips the entry
+        typedef std::function<QString(const QString &entryName)> EntryFilter;
+
+        void setEntryFilter(const EntryFilter &filter);
+        void setThreadCount(int count);
+
+        bool extract(const QString &targetFolder, CommitMode mode = ReplaceFolder);
+        bool stage(const QString &targetFolder);
+
+        QStringList extractedFiles() const;
+        QString errorString() const;
+
+        static void recover(const QString &targetFolder);
+        static bool commit(const QString &stagingFolder, const QString &targetFolder, CommitMode mode,
+                           QString *errorMessage);
+        static bool swapFolders(const QString &stagingFolder, const QString &targetFolder, QString *errorMessage);
+        static void restorePrevious(const QString &targetFolder);
+        static bool isSafePath(const QString &path);
+
+    private:
+        struct Entry
+        {
+            int index; // position in the central directory
+            QString path; // relative to the target folder
+            qint64 size;
+            QDateTime modified;
+        };
+
+        bool readCentralDirectory();
+        QVector<QVector<int>> distribute(int workerCount) const;
+        void extractBatch(const QVector<int> &batch);
+        void fail(const QString &message);
+
+        static bool replaceFile(const QString &source, const QString &target);
+
+        QString archive;
+        QString stagingFolder;
+        EntryFilter entryFilter;
+        int threadCount;
+
+        QVector<Entry> entries;
+        QStringList folders;
+
+        QAtomicInt failed;
+        mutable QMutex mutex;
+        QString error;
+    };
+} // namespace Updater
+
+#endif // ZIPEXTRACTOR_H
@@ -0,0 +1,61 @@
+#
+#    WPN-XM Server Control Panel - install pipeline benchmark
+#
+#    Serves a generated ZIP archive from a throttled local HTTP server and measures
+#    the download alone, the extraction alone and the pipelined install (InstallPipeline).
+#    The pipelined install should take about max(download, extract), not their sum.
+#
+#    qmake tests/bench_install/bench_install.pro && make && ./bench_install [MiB] [KiB/s]
+#
+
+TEMPLATE = app
+TARGET   = bench_install
+
+CONFIG += console c++14 release
+CONFIG -= app_bundle
+
+QT += core network concurrent
+QT -= gui
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+ROOT = $$PWD/../..
+
+INCLUDEPATH += $$ROOT
+
+# ZLIB
+INCLUDEPATH += $$ROOT/libs/zlib/include
+LIBS += -L$$ROOT/libs/zlib/lib -lzlib
+
+# QuaZIP
+INCLUDEPATH += $$ROOT/libs/quazip/include
+LIBS += -L$$ROOT/libs/quazip/lib -lquazip
+
+HEADERS += \
+    $$ROOT/src/file/json.h \
+    $$ROOT/src/settings.h \
+    $$ROOT/src/updater/downloadcache.h \
+    $$ROOT/src/updater/downloadmanager.h \
+    $$ROOT/src/updater/filesink.h \
+    $$ROOT/src/updater/installpipeline.h \
+    $$ROOT/src/updater/mirrorselector.h \
+    $$ROOT/src/updater/networkservice.h \
+    $$ROOT/src/updater/streamingunzip.h \
+    $$ROOT/src/updater/tokenbucket.h \
+    $$ROOT/src/updater/transferprogress.h \
+    $$ROOT/src/updater/zipextractor.h
+
+SOURCES += \
+    $$ROOT/src/file/json.cpp \
+    $$ROOT/src/settings.cpp \
+    $$ROOT/src/updater/downloadcache.cpp \
+    $$ROOT/src/updater/downloadmanager.cpp \
+    $$ROOT/src/updater/filesink.cpp \
+    $$ROOT/src/updater/installpipeline.cpp \
+    $$ROOT/src/updater/mirrorselector.cpp \
+    $$ROOT/src/updater/networkservice.cpp \
+    $$ROOT/src/updater/streamingunzip.cpp \
+    $$ROOT/src/updater/tokenbucket.cpp \
+    $$ROOT/src/updater/transferitem.cpp \
+    $$ROOT/src/updater/zipextractor.cpp \
+    main.cpp
@@ -0,0 +1,229 @@
+#include "src/updater/downloadmanager.h"
+#include "src/updater/installpipeline.h"
+#include "src/updater/zipextractor.h"
+
+#include "quazip/quazip.h"
+#include "quazip/quazipfile.h"
+
+#include <QCoreApplication>
+#include <QCryptographicHash>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QHostAddress>
+#include <QSharedPointer>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTextStream>
+#include <QTimer>
+
+/**
+ * Writes a deflated archive with "megabytes" of text-like content in 1 MiB entries.
+ * The content is random enough to compress only to about half, like binaries do.
+ */
+static bool createArchive(const QString &fileName, int megabytes)
+{
+    QuaZip zip(fileName);
+    if (!zip.open(QuaZip::mdCreate)) {
+        return false;
+    }
+
+    quint32 seed = 2463534242u;
+    QByteArray data(1024 * 1024, Qt::Uninitialized);
+
+    for (int i = 0; i < megabytes; ++i) {
+        for (int j = 0; j < data.size(); ++j) {
+            // xorshift32, mapped to 16 letters
+            seed ^= seed << 13;
+            seed ^= seed >> 17;
+            seed ^= seed << 5;
+            data[j] = static_cast<char>('a' + (seed & 15));
+        }
+
+        QuaZipFile entry(&zip);
+        const QString name = QString("package/bin/file%1.dat").arg(i);
+        if (!entry.open(QIODevice::WriteOnly, QuaZipNewInfo(name)) || entry.write(data) != data.size()) {
+            return false;
+        }
+        entry.close();
+    }
+
+    zip.close();
+    return zip.getZipError() == 0;
+}
+
+/**
+ * A local HTTP server, which sends one file at "bytesPerSecond" in 10 ms slices.
+ * Every request gets the complete file ("200 OK"), ranges are not supported.
+ */
+static void serveThrottled(QTcpServer *server, const QByteArray &body, qint64 bytesPerSecond)
+{
+    QObject::connect(server, &QTcpServer::newConnection, server, [server, body, bytesPerSecond]() {
+        QTcpSocket *socket = server->nextPendingConnection();
+        auto *timer        = new QTimer(socket);
+        auto request       = QSharedPointer<QByteArray>::create();
+        auto offset        = QSharedPointer<qint64>::create(-1);
+
+        QObject::connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+
+        QObject::connect(socket, &QTcpSocket::readyRead, socket, [socket, timer, request, offset, body]() {
+            request->append(socket->readAll());
+            if (*offset >= 0 || !request->contains("\r\n\r\n")) {
+                return;
+            }
+            socket->write("HTTP/1.1 200 OK\r\n"
+                          "Content-Type: application/zip\r\n"
+                          "Content-Length: " +
+                          QByteArray::number(body.size()) +
+                          "\r\n"
+                          "Connection: close\r\n\r\n");
+            *offset = 0;
+            timer->start(10);
+        });
+
+        QObject::connect(timer, &QTimer::timeout, socket, [socket, timer, offset, body, bytesPerSecond]() {
+            const qint64 slice = qMax<qint64>(1, bytesPerSecond / 100);
+            const qint64 chunk = qMin<qint64>(slice, body.size() - *offset);
+            socket->write(body.constData() + *offset, chunk);
+            *offset += chunk;
+
+            if (*offset >= body.size()) {
+                timer->stop();
+                socket->disconnectFromHost();
+            }
+        });
+    });
+}
+
+static Downloader::DownloadItem *startDownload(Downloader::DownloadManager &manager, const QUrl &url,
+                                               const QByteArray &sha256)
+{
+    QNetworkRequest request(url);
+    manager.get(request);
+
+    auto *download = qobject_cast<Downloader::DownloadItem *>(manager.findTransfer(url));
+    download->setExpectedChecksum(sha256);
+    QMetaObject::invokeMethod(&manager, "checkForAllDone", Qt::QueuedConnection);
+    return download;
+}
+
+static qint64 measureDownload(Downloader::DownloadManager &manager, const QUrl &url, const QByteArray &sha256,
+                              bool *ok)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QEventLoop loop;
+    Downloader::DownloadItem *download = startDownload(manager, url, sha256);
+    QObject::connect(download, &Downloader::TransferItem::transferFinished, &loop,
+                     [&loop, ok](Downloader::TransferItem *transfer) {
+                         *ok = !transfer->failed;
+                         loop.quit();
+                     });
+    loop.exec();
+
+    return timer.elapsed();
+}
+
+static qint64 measureExtract(const QString &archiveFile, const QString &targetFolder, bool *ok)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    Updater::ZipExtractor extractor(archiveFile);
+    *ok = extractor.extract(targetFolder);
+
+    return timer.elapsed();
+}
+
+static qint64 measurePipeline(Downloader::DownloadManager &manager, const QUrl &url, const QByteArray &sha256,
+                              const QString &targetFolder, bool *ok)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QEventLoop loop;
+    Downloader::DownloadItem *download = startDownload(manager, url, sha256);
+    auto *pipeline                     = new Updater::InstallPipeline(download, targetFolder);
+    QObject::connect(pipeline, &Updater::InstallPipeline::finished, &loop,
+                     [&loop, ok](bool success, const QString &errorString) {
+                         if (!success) {
+                             QTextStream(stdout) << "Pipelined install failed: " << errorString << "\n";
+                         }
+                         *ok = success;
+                         loop.quit();
+                     });
+    loop.exec();
+    delete pipeline;
+
+    return timer.elapsed();
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const QStringList args      = app.arguments();
+    const int megabytes         = args.size() > 1 ? args.at(1).toInt() : 64;
+    const qint64 bytesPerSecond = (args.size() > 2 ? args.at(2).toLongLong() : 16 * 1024) * 1024;
+
+    QDir work(QDir::temp().filePath("bench_install"));
+    work.removeRecursively();
+    QDir().mkpath(work.filePath("downloads"));
+
+    const QString archiveFile = work.filePath("package.zip");
+    if (!createArchive(archiveFile, megabytes)) {
+        out << "ERROR: creating the archive failed.\n";
+        return 1;
+    }
+
+    QFile archive(archiveFile);
+    archive.open(QIODevice::ReadOnly);
+    const QByteArray body   = archive.readAll();
+    const QByteArray sha256 = QCryptographicHash::hash(body, QCryptographicHash::Sha256).toHex();
+    archive.close();
+
+    QTcpServer server;
+    if (!server.listen(QHostAddress::LocalHost)) {
+        out << "ERROR: " << server.errorString() << "\n";
+        return 1;
+    }
+    serveThrottled(&server, body, bytesPerSecond);
+    const QUrl url(QString("http://127.0.0.1:%1/package.zip").arg(server.serverPort()));
+
+    // a plain download of the whole file: no cache, no segments, no existing file
+    Downloader::DownloadManager manager;
+    manager.setDownloadFolder(work.filePath("downloads"));
+    manager.setDownloadMode(Downloader::DownloadItem::DownloadMode::Overwrite);
+    manager.setMaxSegments(1);
+    manager.setCache(nullptr);
+
+    out << "Archive: " << megabytes << " MiB in " << body.size() / 1024 << " KiB, served at "
+        << bytesPerSecond / 1024 << " KiB/s\n";
+    out.flush();
+
+    bool downloaded = false;
+    bool extracted  = false;
+    bool installed  = false;
+
+    const qint64 downloadMs = measureDownload(manager, url, sha256, &downloaded);
+    const qint64 extractMs  = measureExtract(archiveFile, work.filePath("extracted"), &extracted);
+    const qint64 pipelineMs = measurePipeline(manager, url, sha256, work.filePath("installed"), &installed);
+
+    out << "  download only:    " << downloadMs << " ms\n"
+        << "  extract only:     " << extractMs << " ms\n"
+        << "  sequential (sum): " << downloadMs + extractMs << " ms\n"
+        << "  pipelined:        " << pipelineMs << " ms, "
+        << static_cast<double>(pipelineMs) / qMax<qint64>(1, qMax(downloadMs, extractMs))
+        << "x of max(download, extract)\n";
+
+    work.removeRecursively();
+
+    if (!downloaded || !extracted || !installed) {
+        out << "ERROR: a step failed, the timings are meaningless.\n";
+        return 1;
+    }
+
+    return 0;
+}
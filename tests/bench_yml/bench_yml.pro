@@ -0,0 +1,34 @@
+#
+#    WPN-XM Server Control Panel - YAML conversion benchmark
+#
+#    Compares the conversion of a large mongod.conf-style document into a QVariant tree
+#    with the former QRegExp based scalar classification and with File::Yml.
+#
+#    qmake tests/bench_yml/bench_yml.pro && make && ./bench_yml [sections] [runs]
+#
+
+TEMPLATE = app
+TARGET   = bench_yml
+
+CONFIG += console c++14 release
+CONFIG -= app_bundle
+
+QT += core
+QT -= gui
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+ROOT = $$PWD/../..
+
+INCLUDEPATH += $$ROOT
+
+# YAML-CPP
+INCLUDEPATH += $$ROOT/libs/yaml-cpp/include
+LIBS += -L$$ROOT/libs/yaml-cpp/lib -llibyaml-cppmd
+
+HEADERS += \
+    $$ROOT/src/file/yml.h
+
+SOURCES += \
+    $$ROOT/src/file/yml.cpp \
+    main.cpp
@@ -0,0 +1,166 @@
+#include "src/file/yml.h"
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QTextStream>
+
+#include <limits>
+
+/**
+ * The conversion before the scalar classification was rewritten, kept as the baseline.
+ */
+namespace Former
+{
+    const QRegExp _yamlScalarTrueValues  = QRegExp("true|True|TRUE|on|On|ON");
+    const QRegExp _yamlScalarFalseValues = QRegExp("false|False|FALSE|off|Off|OFF");
+
+    QVariant yamlToVariant(const YAML::Node &node);
+
+    QVariant yamlScalarToVariant(const YAML::Node &scalarNode)
+    {
+        std::string stdScalar = scalarNode.as<std::string>();
+        QString scalarString  = QString::fromStdString(stdScalar);
+        if (_yamlScalarTrueValues.exactMatch(scalarString))
+            return QVariant(true);
+        if (_yamlScalarFalseValues.exactMatch(scalarString))
+            return QVariant(false);
+        if (QRegExp("[-+]?\\d+").exactMatch(scalarString))
+            return QVariant(scalarString.toInt());
+        if (QRegExp(R"([-+]?\d*\.?\d+)").exactMatch(scalarString))
+            return QVariant(scalarString.toDouble());
+        return QVariant(scalarString);
+    }
+
+    QVariant yamlSequenceToVariant(const YAML::Node &sequenceNode)
+    {
+        QVariantList vl;
+        for (YAML::const_iterator it = sequenceNode.begin(); it != sequenceNode.end(); ++it) {
+            vl << yamlToVariant(*it);
+        }
+        return vl;
+    }
+
+    QVariant yamlMapToVariant(const YAML::Node &mapNode)
+    {
+        QVariantMap vm;
+        for (YAML::const_iterator it = mapNode.begin(); it != mapNode.end(); ++it) {
+            vm.insert(QString::fromStdString(it->first.as<std::string>()), yamlToVariant(it->second));
+        }
+        return vm;
+    }
+
+    QVariant yamlToVariant(const YAML::Node &node)
+    {
+        switch (node.Type()) {
+        case YAML::NodeType::Scalar:
+            return yamlScalarToVariant(node);
+        case YAML::NodeType::Sequence:
+            return yamlSequenceToVariant(node);
+        case YAML::NodeType::Map:
+            return yamlMapToVariant(node);
+        case YAML::NodeType::Null:
+        case YAML::NodeType::Undefined:
+            return QVariant();
+        }
+        return QVariant();
+    }
+} // namespace Former
+
+/**
+ * A mongod.conf with "sections" copies of its option groups, every scalar type occurs in each copy.
+ */
+static std::string generateDocument(int sections)
+{
+    QString yaml;
+    QTextStream out(&yaml);
+
+    for (int i = 0; i < sections; ++i) {
+        out << "instance" << i << ":\n"
+            << "  systemLog:\n"
+            << "    destination: file\n"
+            << "    path: logs/mongodb" << i << ".log\n"
+            << "    logAppend: true\n"
+            << "    verbosity: " << (i % 5) << "\n"
+            << "    quiet: off\n"
+            << "  storage:\n"
+            << "    dbPath: data/mongodb" << i << "\n"
+            << "    directoryPerDB: False\n"
+            << "    journal:\n"
+            << "      enabled: TRUE\n"
+            << "      commitIntervalMs: 100\n"
+            << "    wiredTiger:\n"
+            << "      engineConfig:\n"
+            << "        cacheSizeGB: 0.25\n"
+            << "        journalCompressor: snappy\n"
+            << "  net:\n"
+            << "    bindIp: 127.0.0.1\n"
+            << "    port: " << (27017 + i) << "\n"
+            << "    ipv6: Off\n"
+            << "    maxIncomingConnections: 65536\n"
+            << "  operationProfiling:\n"
+            << "    mode: slowOp\n"
+            << "    slowOpThresholdMs: -100\n"
+            << "    slowOpSampleRate: .5\n"
+            << "  setParameter:\n"
+            << "    enableLocalhostAuthBypass: false\n"
+            << "  replication:\n"
+            << "    replSetName: rs" << i << "\n"
+            << "    members:\n"
+            << "      - localhost:" << (27017 + i) << "\n"
+            << "      - 42\n"
+            << "      - on\n"
+            << "      - 1.5\n";
+    }
+
+    out.flush();
+    return yaml.toStdString();
+}
+
+template <typename Convert>
+static qint64 bestOf(int runs, const YAML::Node &node, Convert convert, QVariant *result)
+{
+    qint64 best = std::numeric_limits<qint64>::max();
+    for (int run = 0; run < runs; ++run) {
+        QElapsedTimer timer;
+        timer.start();
+        *result = convert(node);
+        best    = qMin(best, timer.nsecsElapsed());
+    }
+    return best;
+}
+
+int main(int argc, char *argv[])
+{
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    const QStringList args = app.arguments();
+    const int sections     = args.size() > 1 ? args.at(1).toInt() : 5000;
+    const int runs         = args.size() > 2 ? args.at(2).toInt() : 5;
+
+    QElapsedTimer timer;
+    timer.start();
+    const std::string document = generateDocument(sections);
+    const YAML::Node node      = YAML::Load(document);
+    out << "Parsed " << sections << " sections (" << document.size() / 1024 << " KiB) with yaml-cpp in "
+        << timer.elapsed() << " ms, parsing is not part of the measurement.\n";
+
+    QVariant before;
+    QVariant after;
+    const qint64 beforeNsecs = bestOf(runs, node, &Former::yamlToVariant, &before);
+    const qint64 afterNsecs  = bestOf(runs, node, &YAML::yamlToVariant, &after);
+
+    out << "yamlToVariant, best of " << runs << " runs:\n"
+        << "  before (QRegExp): " << beforeNsecs / 1000000.0 << " ms\n"
+        << "  after:            " << afterNsecs / 1000000.0 << " ms\n"
+        << "  speedup:          " << static_cast<double>(beforeNsecs) / qMax<qint64>(afterNsecs, 1) << "x\n";
+
+    // both conversions have to produce the same tree, otherwise the comparison is meaningless
+    if (before != after) {
+        out << "ERROR: the conversions differ.\n";
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,33 @@
+#
+#    WPN-XM Server Control Panel - DeltaPatch test
+#
+#    Creates patches between two versions of a file, applies them and compares the result.
+#
+#    qmake tests/test_deltapatch/test_deltapatch.pro && make && ./test_deltapatch
+#
+
+TEMPLATE = app
+TARGET   = test_deltapatch
+
+CONFIG += console c++14 testcase
+CONFIG -= app_bundle
+
+QT += core testlib
+QT -= gui
+
+DEFINES += QT_DEPRECATED_WARNINGS
+
+ROOT = $$PWD/../..
+
+INCLUDEPATH += $$ROOT
+
+# ZLIB
+INCLUDEPATH += $$ROOT/libs/zlib/include
+LIBS += -L$$ROOT/libs/zlib/lib -lzlib
+
+HEADERS += \
+    $$ROOT/src/updater/deltapatch.h
+
+SOURCES += \
+    $$ROOT/src/updater/deltapatch.cpp \
+    tst_deltapatch.cpp
@@ -0,0 +1,145 @@
+#include "src/updater/deltapatch.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+using Updater::DeltaPatch;
+
+class TestDeltaPatch : public QObject
+{
+    Q_OBJECT
+
+private slots:
+    void roundTrip_data();
+    void roundTrip();
+    void rejectsOtherSource();
+
+private:
+    static QByteArray randomBytes(int size, quint32 seed);
+    static bool writeFile(const QString &fileName, const QByteArray &data);
+    static QByteArray readFile(const QString &fileName);
+};
+
+/**
+ * Incompressible content, a block of it occurs only once in the file.
+ */
+QByteArray TestDeltaPatch::randomBytes(int size, quint32 seed)
+{
+    QByteArray data(size, Qt::Uninitialized);
+    for (int i = 0; i < size; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        data[i] = static_cast<char>(seed & 0xFF);
+    }
+    return data;
+}
+
+bool TestDeltaPatch::writeFile(const QString &fileName, const QByteArray &data)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::WriteOnly | QIODevice::Truncate) && file.write(data) == data.size();
+}
+
+QByteArray TestDeltaPatch::readFile(const QString &fileName)
+{
+    QFile file(fileName);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+void TestDeltaPatch::roundTrip_data()
+{
+    QTest::addColumn<QByteArray>("oldData");
+    QTest::addColumn<QByteArray>("newData");
+
+    const QByteArray base = randomBytes(20000, 2463534242u);
+
+    QByteArray start = base;
+    start.replace(0, 4, "WPNX");
+    QTest::newRow("edit at the start") << base << start;
+
+    QByteArray middle = base;
+    middle.replace(10000, 7, "changed");
+    QTest::newRow("edit in the middle") << base << middle;
+
+    QByteArray end = base;
+    end.replace(end.size() - 5, 5, "tail!");
+    QTest::newRow("edit at the end") << base << end;
+
+    // an insertion shifts the rest, the matches are found by the rolling checksum
+    QByteArray twoEdits = base;
+    twoEdits.insert(5000, randomBytes(13, 7));
+    twoEdits.insert(15000, randomBytes(11, 9));
+    QTest::newRow("two insertions") << base << twoEdits;
+
+    QByteArray startMiddleEnd = base;
+    startMiddleEnd.insert(0, "prefix");
+    startMiddleEnd.remove(9000, 40);
+    startMiddleEnd.append("suffix");
+    QTest::newRow("edits at the start, middle and end") << base << startMiddleEnd;
+
+    // a match, which extends backwards into the pending literal
+    QByteArray backwards = base;
+    backwards[8000] = static_cast<char>(backwards.at(8000) ^ 0x55);
+    QTest::newRow("single byte changed") << base << backwards;
+
+    QTest::newRow("identical") << base << base;
+    QTest::newRow("old file empty") << QByteArray() << base;
+    QTest::newRow("new file empty") << base << QByteArray();
+    QTest::newRow("shorter than a block") << base.left(10) << base.left(20);
+    QTest::newRow("unrelated files") << base << randomBytes(5000, 12345);
+}
+
+void TestDeltaPatch::roundTrip()
+{
+    QFETCH(QByteArray, oldData);
+    QFETCH(QByteArray, newData);
+
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString oldFile   = dir.filePath("wpn-xm.exe.old");
+    const QString newFile   = dir.filePath("wpn-xm.exe");
+    const QString patchFile = dir.filePath("wpn-xm.patch");
+    const QString target    = dir.filePath("wpn-xm.exe.new");
+    QVERIFY(writeFile(oldFile, oldData));
+    QVERIFY(writeFile(newFile, newData));
+
+    QString errorMessage;
+    QVERIFY2(DeltaPatch::create(oldFile, newFile, patchFile, &errorMessage), qPrintable(errorMessage));
+    const QByteArray patch = readFile(patchFile);
+
+    // the patch is applied while it downloads, in chunks of any size
+    for (int chunkSize : {1, 7, 4096, patch.size()}) {
+        DeltaPatch delta(oldFile, target);
+        for (int offset = 0; offset < patch.size(); offset += chunkSize) {
+            delta.addData(patch.mid(offset, chunkSize));
+        }
+        QVERIFY2(delta.finish(), qPrintable(delta.errorString()));
+        QCOMPARE(readFile(target), newData);
+    }
+}
+
+void TestDeltaPatch::rejectsOtherSource()
+{
+    QTemporaryDir dir;
+    QVERIFY(dir.isValid());
+    const QString oldFile   = dir.filePath("old");
+    const QString newFile   = dir.filePath("new");
+    const QString patchFile = dir.filePath("patch");
+    QVERIFY(writeFile(oldFile, randomBytes(4096, 1)));
+    QVERIFY(writeFile(newFile, randomBytes(4096, 2)));
+
+    QString errorMessage;
+    QVERIFY(DeltaPatch::create(oldFile, newFile, patchFile, &errorMessage));
+
+    // a patch only applies to exactly the version it was created from
+    QVERIFY(writeFile(oldFile, randomBytes(4096, 3)));
+    DeltaPatch delta(oldFile, dir.filePath("target"));
+    delta.addData(readFile(patchFile));
+    QVERIFY(!delta.finish());
+}
+
+QTEST_APPLESS_MAIN(TestDeltaPatch)
+
+#include "tst_deltapatch.moc"
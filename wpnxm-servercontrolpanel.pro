@@ -33,7 +33,7 @@ DEPLOYMENT.display_name = WPN-XM Server Control Panel
 
 CONFIG += qt console c++14
 
-QT += core network widgets
+QT += core network widgets concurrent
 
 # The following define makes your compiler emit warnings if you use
 # any feature of Qt which as been marked as deprecated (the exact warnings
@@ -77,14 +77,23 @@ HEADERS += \
     src/config/configurationdialog.h \
     src/config/nginxaddserverdialog.h \
     src/config/nginxaddupstreamdialog.h \
+    src/config/nginxupstreams.h \
+    src/config/nginxvhosts.h \
+    src/config/phpextensions.h \
+    src/config/phpinstallations.h \
+    src/dns/dnsresponder.h \
     src/file/filehandling.h \
     src/file/csv.h \
     src/file/ini.h \
     src/file/json.h \
+    src/file/nginxconfig.h \
+    src/file/pe.h \
+    src/file/phpini.h \
     src/file/yml.h \
     src/hostmanager/adddialog.h \
     src/hostmanager/host.h \
     src/hostmanager/hostmanagerdialog.h \
+    src/hostmanager/hostsfile.h \
     src/hostmanager/hosttablemodel.h \
     src/jobscheduler.h \
     src/mainwindow.h \
@@ -103,10 +112,22 @@ HEADERS += \
     src/tooltips/TrayTooltip.h \
     src/tray.h \
     src/updater/actioncolumnitemdelegate.h \
+    src/updater/componentstore.h \
+    src/updater/conditionalfetcher.h \
+    src/updater/deltapatch.h \
+    src/updater/downloadcache.h \
     src/updater/downloadmanager.h \
+    src/updater/filesink.h \
+    src/updater/installpipeline.h \
+    src/updater/mirrorselector.h \
+    src/updater/networkservice.h \
     src/updater/package.h \
     src/updater/softwarecolumnitemdelegate.h \
+    src/updater/streamingunzip.h \
+    src/updater/tokenbucket.h \
+    src/updater/transferprogress.h \
     src/updater/updaterdialog.h \
+    src/updater/zipextractor.h \
     src/version.h \
     src/windowsapi.h
 
@@ -116,14 +137,23 @@ SOURCES += \
     src/config/configurationdialog.cpp \
     src/config/nginxaddserverdialog.cpp \
     src/config/nginxaddupstreamdialog.cpp \
+    src/config/nginxupstreams.cpp \
+    src/config/nginxvhosts.cpp \
+    src/config/phpextensions.cpp \
+    src/config/phpinstallations.cpp \
+    src/dns/dnsresponder.cpp \
     src/file/csv.cpp \    
     src/file/filehandling.cpp \
     src/file/ini.cpp \
     src/file/json.cpp \
+    src/file/nginxconfig.cpp \
+    src/file/pe.cpp \
+    src/file/phpini.cpp \
     src/file/yml.cpp \
     src/hostmanager/adddialog.cpp \
     src/hostmanager/host.cpp \
     src/hostmanager/hostmanagerdialog.cpp \
+    src/hostmanager/hostsfile.cpp \
     src/hostmanager/hosttablemodel.cpp \
     src/jobscheduler.cpp \
     src/mainwindow.cpp \
@@ -142,11 +172,22 @@ SOURCES += \
     src/tooltips/TrayTooltip.cpp \
     src/tray.cpp \
     src/updater/actioncolumnitemdelegate.cpp \
+    src/updater/componentstore.cpp \
+    src/updater/conditionalfetcher.cpp \
+    src/updater/deltapatch.cpp \
+    src/updater/downloadcache.cpp \
     src/updater/downloadmanager.cpp \
+    src/updater/filesink.cpp \
+    src/updater/installpipeline.cpp \
+    src/updater/mirrorselector.cpp \
+    src/updater/networkservice.cpp \
     src/updater/package.cpp \
     src/updater/softwarecolumnitemdelegate.cpp \
+    src/updater/streamingunzip.cpp \
+    src/updater/tokenbucket.cpp \
     src/updater/transferitem.cpp \
     src/updater/updaterdialog.cpp \
+    src/updater/zipextractor.cpp \
     src/windowsapi.cpp
 
 RESOURCES += \